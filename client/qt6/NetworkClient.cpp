@@ -862,7 +862,15 @@ void NetworkClient::parsePacket(quint16 cmd, const QByteArray &jsonData)
         case CMD_NOTIFY_FRIEND_STATUS:
             qDebug() << "=== CMD_NOTIFY_FRIEND_STATUS received ===";
             qDebug() << "Object:" << obj;
-            if (obj.contains("user_id") && obj.contains("status")) {
+            if (obj.contains("updates")) {
+                // Several friends changed within the same window
+                for (const QJsonValue &v : obj["updates"].toArray()) {
+                    QJsonObject u = v.toObject();
+                    emit friendStatusChanged(u["user_id"].toVariant().toLongLong(),
+                                             u["status"].toString(),
+                                             u["room_id"].toVariant().toLongLong());
+                }
+            } else if (obj.contains("user_id") && obj.contains("status")) {
                 qint64 userId = obj["user_id"].toVariant().toLongLong();
                 QString status = obj["status"].toString();
                 qint64 roomId = obj.contains("room_id") ? obj["room_id"].toVariant().toLongLong() : 0;
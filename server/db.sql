@@ -100,6 +100,29 @@ CREATE TABLE question (
 
 CREATE INDEX idx_question_diff ON question(difficulty_level);
 
+-- Server giữ câu hỏi trong bộ nhớ (question bank) và LISTEN kênh này:
+-- payload "INSERT:<id>", "UPDATE:<id>", "DELETE:<id>" hoặc "TRUNCATE"
+CREATE OR REPLACE FUNCTION notify_question_changed() RETURNS trigger AS $$
+BEGIN
+  IF TG_OP = 'TRUNCATE' THEN
+    PERFORM pg_notify('question_changed', 'TRUNCATE');
+  ELSIF TG_OP = 'DELETE' THEN
+    PERFORM pg_notify('question_changed', 'DELETE:' || OLD.question_id);
+  ELSE
+    PERFORM pg_notify('question_changed', TG_OP || ':' || NEW.question_id);
+  END IF;
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_question_changed
+  AFTER INSERT OR UPDATE OR DELETE ON question
+  FOR EACH ROW EXECUTE FUNCTION notify_question_changed();
+
+CREATE TRIGGER trg_question_truncated
+  AFTER TRUNCATE ON question
+  FOR EACH STATEMENT EXECUTE FUNCTION notify_question_changed();
+
 -- =========================
 -- ROOMS
 -- =========================
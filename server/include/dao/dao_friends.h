@@ -15,6 +15,8 @@ typedef enum {
 int dao_friends_send_request(int64_t from_user, int64_t to_user);
 int dao_friends_respond_request(int64_t from_user, int64_t to_user, bool accept);
 int dao_friends_list(int64_t user_id, /* OUT */ void **result_json);
+// Chỉ lấy user_id của bạn bè (ACCEPTED); *out_ids do caller free
+int dao_friends_list_ids(int64_t user_id, /* OUT */ int64_t **out_ids, int *out_count);
 int dao_friends_update_status(int64_t user_id, int64_t friend_id, friend_status_t status);
 int dao_friends_get_info(int64_t user_id, int64_t friend_id, void **result_json);
 int dao_friends_get_pending_requests(int64_t user_id, void **result_json);
@@ -2,15 +2,28 @@
 #define DAO_ONEVN_H
 
 #include <stdint.h>
+#include "db_batch.h"
+
+// Một câu trả lời trong journal của round (answer = '\0' khi hết giờ)
+typedef struct {
+    int64_t user_id;
+    char answer;
+    int is_correct;
+    int score_gained;
+    double time_left;
+    double answered_at;    // Unix time (giây) lúc server nhận câu trả lời
+} OneVNAnswer;
 
 // Tạo 1vN session từ room
 int dao_onevn_create_session(int64_t room_id, int64_t *out_session_id);
 
 // Cập nhật players JSONB
 int dao_onevn_update_players(int64_t session_id, const char *players_json);
+int dao_onevn_queue_update_players(DbBatch *b, int64_t session_id, const char *players_json);
 
 // Kết thúc session và lưu kết quả
 int dao_onevn_end_session(int64_t session_id, int64_t winner_id);
+int dao_onevn_queue_end_session(DbBatch *b, int64_t session_id, int64_t winner_id);
 
 // Lấy thông tin session
 int dao_onevn_get_session(int64_t session_id, int64_t *room_id, int64_t *winner_id, char *status, char *players_json, size_t json_len);
@@ -20,12 +33,36 @@ int dao_onevn_get_user_history(int64_t user_id, void **json_history);
 
 // Tạo round mới (khi bắt đầu round)
 int dao_onevn_create_round(int64_t session_id, int round_number, int64_t question_id, const char *difficulty, int64_t *out_round_id);
+// Bản _async chạy trên executor của pool, cùng hàng đợi với các lần ghi round
+// của session (round được tạo trước khi các câu trả lời của nó được ghi)
+int dao_onevn_create_round_async(int64_t session_id, int round_number, int64_t question_id, const char *difficulty);
 
 // Kết thúc round
 int dao_onevn_end_round(int64_t round_id);
+int dao_onevn_queue_end_round(DbBatch *b, int64_t session_id, int round_number);
 
 // Lưu câu trả lời của player
 int dao_onevn_save_player_answer(int64_t round_id, int64_t user_id, char answer, int is_correct, int score_gained, double time_left);
+int dao_onevn_queue_save_answers(DbBatch *b, int64_t session_id, int round_number,
+                                 const OneVNAnswer *answers, int count);
+
+// Ghi cả round một lần: mọi câu trả lời (một INSERT nhiều dòng), kết thúc
+// round và players JSONB, chung một round trip. Round được tìm theo
+// (session_id, round_number); round_number <= 0 chỉ cập nhật players;
+// players_json NULL thì bỏ qua. Bản _async chép dữ liệu rồi chạy
+// trên executor của pool, không chặn event loop; các round của cùng một
+// session được ghi lần lượt theo thứ tự gửi.
+int dao_onevn_save_round(int64_t session_id, int round_number, const OneVNAnswer *answers,
+                         int count, const char *players_json);
+int dao_onevn_save_round_async(int64_t session_id, int round_number, const OneVNAnswer *answers,
+                               int count, const char *players_json);
+
+// Kết thúc game: players cuối cùng, kết thúc session và đóng room (FINISHED)
+// trong một round trip. Bản _async chạy sau các lần ghi round của session.
+int dao_onevn_finish_session(int64_t session_id, int64_t room_id, int64_t winner_id,
+                             const char *players_json);
+int dao_onevn_finish_session_async(int64_t session_id, int64_t room_id, int64_t winner_id,
+                                   const char *players_json);
 
 // Lấy chi tiết replay của session
 int dao_onevn_get_replay_details(int64_t session_id, void **json_replay);
@@ -4,17 +4,30 @@
 
 #include <stdint.h>
 
-typedef struct {
-    int64_t question_id;
-    char    difficulty[16];
-    char    content[1024];
-    char    op_a[512];
-    char    op_b[512];
-    char    op_c[512];
-    char    op_d[512];
-    char    correct_op[2];
+// Questions are shared, read-only objects handed out by the question bank
+// (service/question_bank.h). Text fields point to interned strings, so the
+// same option text is stored once however many questions and games use it.
+typedef struct Question {
+    int64_t     question_id;
+    char        difficulty[16];
+    const char *content;
+    const char *op_a;
+    const char *op_b;
+    const char *op_c;
+    const char *op_d;
+    char        correct_op[2];
+    int         refs;          // the bank and every game holding it
 } Question;
 
-int dao_question_get_random(const char *difficulty, Question *out_q);
+// Called once per row; q and its strings are only valid during the call.
+// Return 0 to continue, -1 to stop (dao_question_load_all then returns -1).
+typedef int (*dao_question_fn)(const Question *q, void *arg);
+
+// Stream every question from the database
+int dao_question_load_all(dao_question_fn fn, void *arg);
+
+// Call fn with one question, or not at all if it does not exist.
+// Returns 0, or -1 on a database error.
+int dao_question_get_by_id(int64_t question_id, dao_question_fn fn, void *arg);
 
 #endif
@@ -2,6 +2,7 @@
 #define DAO_ROOMS_H
 
 #include <stdint.h>
+#include "db_batch.h"
 
 typedef enum {
     ROOM_STATUS_WAITING,
@@ -24,4 +25,15 @@ int dao_rooms_update_config(int64_t room_id, int easy_count, int medium_count, i
 int dao_rooms_get_owner(int64_t room_id, int64_t *owner_id);
 int dao_rooms_list_waiting(void **result_json);  // List rooms with status WAITING, include owner name and member count
 
+// Pipelined variants: queue on a batch (see db_batch.h); outputs are filled
+// in by db_batch_run, and a JSON output set there must be freed even if the
+// batch as a whole failed
+int dao_rooms_queue_leave(DbBatch *b, int64_t room_id, int64_t user_id);
+int dao_rooms_queue_delete(DbBatch *b, int64_t room_id);
+int dao_rooms_queue_mark_eliminated(DbBatch *b, int64_t room_id, int64_t user_id);
+int dao_rooms_queue_update_status(DbBatch *b, int64_t room_id, room_status_t status);
+int dao_rooms_queue_get_status(DbBatch *b, int64_t room_id, room_status_t *status);
+int dao_rooms_queue_get_owner(DbBatch *b, int64_t room_id, int64_t *owner_id);
+int dao_rooms_queue_get_members(DbBatch *b, int64_t room_id, void **result_json);
+
 #endif
@@ -2,11 +2,34 @@
 #define DAO_STATS_H
 
 #include <stdint.h>
+#include "db_async.h"
+#include "db_batch.h"
 
 int dao_stats_get_profile(int64_t user_id, void **json_profile);
 int dao_stats_get_leaderboard(int limit, void **json_leaderboard);
 int dao_stats_get_match_history(int64_t user_id, void **json_history);
+
+// Non-blocking variants for the event loop: cb receives the same JSON the
+// blocking readers return (see db_async_query_json)
+int dao_stats_get_profile_async(int64_t user_id, db_json_cb cb, void *arg);
+int dao_stats_get_leaderboard_async(int limit, db_json_cb cb, void *arg);
+
+// Every user's total wins (quickmode + 1vN), e.g. to seed the in-memory
+// leaderboard. fn returns 0 to continue, -1 to stop (the call returns -1).
+typedef int (*dao_stats_wins_fn)(int64_t user_id, const char *username, int total_wins, void *arg);
+int dao_stats_load_wins(dao_stats_wins_fn fn, void *arg);
+
 int dao_stats_update_quickmode_game(int64_t user_id, int is_win);
-int dao_stats_update_onevn_game(int64_t winner_id, int64_t *player_ids, int *player_scores, int *player_eliminated, int player_count);
+// One transaction with every player's 1vN games/wins update
+int dao_stats_update_onevn_game(int64_t winner_id, const int64_t *player_ids, int player_count);
+
+// Queue the per-player 1vN updates on a batch (see db_batch.h)
+int dao_stats_queue_onevn_game(DbBatch *b, int64_t winner_id, const int64_t *player_ids, int player_count);
+
+// Fire-and-forget variant: the update runs on a DB pool thread, or inline
+// when the pool is not running
+int dao_stats_update_quickmode_game_async(int64_t user_id, int is_win);
+// Copies player_ids: the game state may be freed right after the call
+int dao_stats_update_onevn_game_async(int64_t winner_id, const int64_t *player_ids, int player_count);
 
 #endif
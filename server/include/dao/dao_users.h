@@ -22,6 +22,15 @@ int dao_users_find_by_id(int64_t user_id, User *out_user);
 
 // auth: 1 = đúng, 0 = sai, <0 lỗi DB
 int dao_users_check_password(const char *username, const char *password, int64_t *out_user_id);
+// Như trên, trả thêm thông tin user (out_user có thể NULL)
+int dao_users_authenticate(const char *username, const char *password, User *out_user);
+
+// Username + avatar của nhiều user trong một query (không lấy password).
+// fn được gọi một lần cho mỗi user tồn tại. 0=OK, -1 lỗi DB
+typedef void (*dao_users_identity_fn)(int64_t user_id, const char *username,
+                                      const char *avatar_img, void *arg);
+int dao_users_find_identities(const int64_t *user_ids, int count,
+                              dao_users_identity_fn fn, void *arg);
 
 // Search users by username (partial match), returns JSON array
 int dao_users_search_by_username(const char *query, int limit, void **result_json);
@@ -29,4 +38,8 @@ int dao_users_search_by_username(const char *query, int limit, void **result_jso
 // Update user avatar, 0=OK, -1 if error
 int dao_users_update_avatar(int64_t user_id, const char *avatar_path);
 
+// Đổi username và password (hash lại) của một user.
+// 0=OK, -1 lỗi, -2 nếu username đã thuộc về user khác
+int dao_users_update_credentials(int64_t user_id, const char *username, const char *password);
+
 #endif
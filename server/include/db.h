@@ -9,11 +9,20 @@ extern PGconn *db_conn;
 // conninfo ví dụ: "host=localhost port=5432 dbname=ltm_group04 user=postgres password=1"
 int  db_connect(const char *conninfo);
 void db_disconnect(void);
-int  db_is_ok(void);
+int  db_is_ok(void);         // connection db_get_conn returns is usable
 
-// returns the global libpq connection (NULL if not connected)
+// returns the connection bound to the calling thread, otherwise the global
+// libpq connection (NULL if not connected). A global connection that went
+// bad is reset first (with backoff) and its statements prepared again.
 PGconn *db_get_conn(void);
 
+// Bind conn to the calling thread for db_get_conn. A thread that has bound
+// a connection never falls back to the global one (NULL means "no DB").
+void db_bind_thread_conn(PGconn *conn);
+
+// conninfo passed to the last db_connect (NULL if never connected)
+const char *db_get_conninfo(void);
+
 // compatibility helpers used by tests
 // db_init: look for DB_CONN env var, call db_connect
 int db_init(void);
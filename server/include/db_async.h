@@ -0,0 +1,56 @@
+// server/include/db_async.h
+//
+// Non-blocking PostgreSQL access for the event loops. Every event-loop thread
+// owns one DbAsync: a libpq connection in non-blocking mode whose socket sits
+// in that loop's epoll set. Queries are queued FIFO, sent with
+// PQsendQueryPrepared, and their callback runs on the same thread once the
+// result has arrived, so a slow query no longer stalls the loop. A lost
+// connection is reopened with PQconnectStart/PQconnectPoll from the same
+// epoll set; until that finishes, queries use the blocking fallback.
+#ifndef DB_ASYNC_H
+#define DB_ASYNC_H
+
+#include <stdint.h>
+#include <libpq-fe.h>
+#include "db_stmt.h"
+
+typedef struct DbAsync DbAsync;
+
+// Query completion. res is NULL when the query could not be sent or the
+// connection failed; it is cleared after the callback returns.
+typedef void (*db_async_cb)(PGresult *res, void *arg);
+
+// Turns a query result into a malloc'ed JSON string. Returns 0 or -1.
+typedef int (*db_json_builder)(PGresult *res, char **out_json);
+
+// Completion for JSON readers: rc 0 with json (owned by the callee) or
+// rc -1 with json NULL.
+typedef void (*db_json_cb)(int rc, char *json, void *arg);
+
+// Open a connection for the loop behind epoll_fd. Returns NULL on error.
+DbAsync *db_async_new(const char *conninfo, int epoll_fd);
+void db_async_free(DbAsync *db);
+
+// Bind the calling event-loop thread to its connection
+void db_async_set_current(DbAsync *db);
+DbAsync *db_async_get_current(void);
+
+// Socket readiness (EPOLLIN/EPOLLOUT) for db's connection; runs callbacks
+void db_async_handle_event(DbAsync *db, uint32_t events);
+
+// Queue a prepared statement on the calling thread's connection. stmt must
+// stay valid until completion (DAO statics); params (may be NULL) are
+// copied. Without an async connection (tools, tests) the query runs on the
+// blocking connection and cb is called before this returns.
+// Returns 0 if cb will be (or has been) called, -1 on error.
+int db_async_query(DbStmt *stmt, const DbParams *params, db_async_cb cb, void *arg);
+
+// db_async_query + build: cb gets the JSON produced by build
+int db_async_query_json(DbStmt *stmt, const DbParams *params,
+                        db_json_builder build, db_json_cb cb, void *arg);
+
+// Blocking counterpart of db_async_query_json on db_get_conn()
+int db_query_json(DbStmt *stmt, const DbParams *params,
+                  db_json_builder build, char **out_json);
+
+#endif
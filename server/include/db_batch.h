@@ -0,0 +1,49 @@
+// server/include/db_batch.h
+//
+// Write bursts over libpq pipeline mode. A handler queues several prepared
+// statements on one connection and db_batch_run sends them with a single
+// sync, so the whole burst costs one network round trip instead of one per
+// statement. Everything queued before the sync runs in one implicit
+// transaction: if a statement fails, the ones after it are skipped and the
+// earlier ones are rolled back.
+#ifndef DB_BATCH_H
+#define DB_BATCH_H
+
+#include <libpq-fe.h>
+#include "db_stmt.h"
+
+// Per-statement completion, called from db_batch_run with the statement's
+// result (cleared afterwards). Returns 0, or -1 to fail the batch.
+// NULL accepts any COMMAND_OK / TUPLES_OK result.
+typedef int (*db_batch_fn)(PGresult *res, void *arg);
+
+typedef struct {
+    DbStmt *stmt;
+    int prepare;               // a PQsendPrepare went out right before it
+    int queued;                // the statement itself went out
+    db_batch_fn done;
+    void *arg;
+} DbBatchEntry;
+
+typedef struct {
+    PGconn *conn;
+    DbBatchEntry *entries;
+    int count;
+    int cap;
+    int failed;                // a send failed; db_batch_run returns -1
+} DbBatch;
+
+// Start a batch on db_get_conn(). Returns 0, or -1 if there is no usable
+// connection (db_batch_add / db_batch_run then fail without side effects).
+int  db_batch_begin(DbBatch *b);
+
+// Queue stmt with params (copied by libpq, may be NULL). done (may be NULL)
+// gets the result once the batch has run. Returns 0 or -1.
+int  db_batch_add(DbBatch *b, DbStmt *stmt, const DbParams *params,
+                  db_batch_fn done, void *arg);
+
+// Send everything queued, wait for the results, leave pipeline mode and
+// release the batch. Returns 0 if every statement succeeded, else -1.
+int  db_batch_run(DbBatch *b);
+
+#endif
@@ -0,0 +1,58 @@
+// server/include/db_pool.h
+//
+// Pool of blocking PostgreSQL connections plus a small executor. DAO jobs
+// submitted with db_pool_submit run on executor threads, each holding one
+// pooled connection (db_get_conn() returns it on that thread), so slow
+// writes and large reads run in parallel instead of on an event loop. The
+// job's completion is posted back to the loop that submitted it.
+//
+// Connections are health-checked when taken from the pool (a SELECT 1 after
+// a long idle period) and reopened with exponential backoff when lost.
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include <stdint.h>
+#include <libpq-fe.h>
+
+#define DB_POOL_DEFAULT_SIZE 4
+#define DB_POOL_MAX_SIZE 32
+
+typedef void (*db_job_fn)(void *arg);
+
+// Loop integration, set once by the server before any job is submitted:
+// current() names the calling thread's event loop (NULL if none) and
+// post() queues fn(arg) on that loop. Returns 0 or -1.
+typedef void *(*db_pool_loop_fn)(void);
+typedef int (*db_pool_post_fn)(void *loop, db_job_fn fn, void *arg);
+void db_pool_set_loop_hooks(db_pool_loop_fn current, db_pool_post_fn post);
+
+// Open size connections (DB_POOL_DEFAULT_SIZE if size <= 0) and start as
+// many executor threads. Returns 0 on success, -1 on error.
+int  db_pool_init(const char *conninfo, int size);
+
+// Finish queued jobs, stop the executor and close every connection
+void db_pool_shutdown(void);
+
+// Block until no job is queued or running (completions may still be
+// waiting in loop mailboxes)
+void db_pool_wait_idle(void);
+
+// Borrow a connection, blocking while all are in use. Returns NULL if the
+// pool is not running or the connection could not be (re)opened; otherwise
+// give it back with db_pool_release.
+PGconn *db_pool_acquire(void);
+void db_pool_release(PGconn *conn);
+
+// Run run(arg) on an executor thread, then done(arg) (may be NULL) on the
+// submitting thread's event loop under the service lock. Without a pool
+// both run on the caller's thread before this returns; without a loop done
+// runs on the executor thread.
+// Returns 0 if the job was accepted, -1 on error (nothing runs).
+int  db_pool_submit(db_job_fn run, db_job_fn done, void *arg);
+
+// db_pool_submit for jobs that must not overtake each other: jobs with the
+// same key (e.g. a session_id) run one at a time, in submission order.
+// key 0 means no ordering, like db_pool_submit.
+int  db_pool_submit_keyed(int64_t key, db_job_fn run, db_job_fn done, void *arg);
+
+#endif
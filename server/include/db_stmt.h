@@ -0,0 +1,62 @@
+// server/include/db_stmt.h
+//
+// Prepared-statement registry for the DAO layer. Every DAO query is a
+// static DbStmt; db_exec_stmt prepares it on the connection the first time
+// it runs there and then goes through PQexecPrepared, so PostgreSQL parses
+// and plans each query once per connection instead of on every call.
+// Which statements a connection has prepared is kept with the connection
+// itself (libpq instance data), so a new or reset connection starts empty;
+// db_stmt_prepare_all re-prepares the known statements right after a
+// (re)connect.
+#ifndef DB_STMT_H
+#define DB_STMT_H
+
+#include <stdint.h>
+#include <libpq-fe.h>
+
+#define DB_STMT_MAX 128
+#define DB_STMT_MAX_PARAMS 8
+
+// Parameter types (pg_type OIDs). 0 lets the server infer the type.
+#define DB_TYPE_ANY  0
+#define DB_TYPE_BOOL 16
+#define DB_TYPE_INT8 20
+
+typedef struct DbStmt {
+    const char *name;          // server-side statement name, unique
+    const char *sql;
+    int nparams;
+    Oid types[DB_STMT_MAX_PARAMS];
+    int id;                    // registry slot + 1, assigned on first use
+} DbStmt;
+
+// Bound parameters. int64 ids and booleans go in binary format, the rest
+// as text. Binary values live inside the struct: do not copy it.
+typedef struct {
+    int count;
+    const char *values[DB_STMT_MAX_PARAMS];
+    int lengths[DB_STMT_MAX_PARAMS];
+    int formats[DB_STMT_MAX_PARAMS];
+    unsigned char bin[DB_STMT_MAX_PARAMS][8];
+} DbParams;
+
+void db_params_init(DbParams *p);
+void db_param_text(DbParams *p, const char *value);   // NULL binds SQL NULL
+void db_param_int8(DbParams *p, int64_t value);
+void db_param_bool(DbParams *p, int value);
+
+// Run stmt on conn with params (NULL when it takes none). Prepares the
+// statement on conn first if needed. Returns the result (NULL only when
+// conn is NULL or out of memory); the caller PQclears it.
+PGresult *db_exec_stmt(PGconn *conn, DbStmt *stmt, const DbParams *params);
+
+// For callers that send queries themselves (non-blocking connections,
+// pipelines): is stmt prepared on conn / record whether it is
+int  db_stmt_is_prepared(PGconn *conn, DbStmt *stmt);
+void db_stmt_set_prepared(PGconn *conn, DbStmt *stmt, int prepared);
+
+// Prepare every statement used so far on a freshly opened connection.
+// Returns 0 on success, -1 if any statement failed to prepare.
+int  db_stmt_prepare_all(PGconn *conn);
+
+#endif
@@ -8,6 +8,14 @@
 
 #define READ_BUFFER_SIZE 8192
 
+// Default cap on bytes queued for a client that is not reading fast enough
+#define OUTQ_DEFAULT_HIGH_WATER (256 * 1024)
+
+// Send priorities: low-priority frames (presence, chat) are the first to be
+// dropped when a client's outbound queue passes the high-water mark.
+#define SEND_PRIORITY_NORMAL 0
+#define SEND_PRIORITY_LOW    1
+
 // User status for invite system
 typedef enum {
 	USER_STATUS_ONLINE = 0,          // In lobby
@@ -15,6 +23,54 @@ typedef enum {
 	USER_STATUS_IN_GAME = 2          // Playing game (QuickMode or 1vN)
 } UserStatus;
 
+struct SessionManager;
+
+// Max frames decoded before they are handed to the dispatcher
+#define MAX_FRAMES_PER_BATCH 32
+
+// One decoded request frame. The payload is a borrowed view into the
+// session's read buffer, valid until the next client_session_read_frames()
+// call on that session; it is not NUL-terminated (see
+// dispatcher_handle_batch). NULL when payload_len == 0.
+typedef struct ClientFrame {
+	uint16_t cmd;
+	uint32_t payload_len;
+	char *payload;
+	size_t end;                // offset just past the frame in the read buffer
+} ClientFrame;
+
+// Result of client_session_read_frames()
+typedef enum {
+	CLIENT_READ_DRAINED = 0,   // socket drained (EAGAIN), wait for the next event
+	CLIENT_READ_MORE = 1,      // batch full, call again after dispatching it
+	CLIENT_READ_CLOSED = -1    // peer closed or protocol/socket error
+} ClientReadStatus;
+
+// Max bytes of per-recipient header kept inline in a queued chunk
+#define OUT_HEADER_MAX 8
+
+// Max iovecs gathered into one write when flushing the queue
+#define OUT_IOV_MAX 64
+
+// Refcounted payload bytes. A broadcast encodes its payload once and every
+// recipient's queue holds a reference instead of a copy.
+typedef struct SharedFrame {
+	int refcount;              // updated atomically, frames cross threads
+	uint32_t len;
+	char data[];
+} SharedFrame;
+
+// One queued outbound frame (or the unsent tail of one): a small inline
+// header, which may differ per recipient, followed by a shared payload.
+typedef struct OutChunk {
+	struct OutChunk *next;
+	SharedFrame *frame;        // payload (NULL for header-only chunks)
+	unsigned char hdr[OUT_HEADER_MAX];
+	uint8_t hdr_len;
+	size_t off;                // bytes of hdr+payload already written
+	int priority;
+} OutChunk;
+
 typedef struct ClientSession {
 	int socket_fd;             // socket file descriptor, -1 if unused
 	int64_t user_id;           // authenticated user id (0 if not logged in)
@@ -22,22 +78,81 @@ typedef struct ClientSession {
 	int64_t room_id;           // current room id (0 if not in room)
 	UserStatus status;         // current user status
 	
-	// Buffer for partial packet reads
-	char read_buffer[READ_BUFFER_SIZE];
+	// Receive buffer. Frames are dispatched in place, the extra byte lets
+	// the last payload be NUL-terminated without copying it out.
+	char read_buffer[READ_BUFFER_SIZE + 1];
 	size_t read_buffer_len;    // Current bytes in buffer
-	size_t expected_len;       // Expected total packet length (0 = reading header)
-	uint16_t pending_cmd;      // Command from header (if header read)
+	size_t read_consumed;      // bytes of frames handed out by the last read
+
+	// DB jobs of this connection in flight (see session_manager_submit_db).
+	// While one is, later frames wait in read_buffer: db_paused stops the
+	// reads and the owner resumes them once the last job has completed.
+	int db_wait;
+	int db_paused;
+	int resume_queued;
+	struct ClientSession *resume_next;
+
+	// Owning event loop (NULL when used outside the server, e.g. tests)
+	struct SessionManager *owner;
+	uint64_t conn_id;          // unique per connection within the owner
+	int slot;                  // index in owner->sessions
+	int mailbox_pending;       // posted to owner's mailbox, not yet delivered (atomic)
+	struct ClientSession *room_prev; // intrusive room membership list
+	struct ClientSession *room_next;
+
+	// Outbound queue, flushed when the socket becomes writable (EPOLLOUT)
+	OutChunk *out_head;
+	OutChunk *out_tail;
+	size_t out_bytes;          // bytes still queued
+	int out_armed;             // EPOLLOUT currently requested
+	int closing;               // write error or slow consumer: disconnect pending
+	int close_pending;         // shut down once the queue has been flushed
+	uint64_t dropped_frames;   // low-priority frames dropped for this client
 } ClientSession;
 
 // create/free
 ClientSession *client_session_new(int socket_fd);
 void client_session_free(ClientSession *sess);
 
-// send raw bytes to client (returns number of bytes sent or -1)
+// Shared payload buffers
+SharedFrame *shared_frame_new(const void *data, uint32_t len);
+SharedFrame *shared_frame_ref(SharedFrame *frame);
+void shared_frame_unref(SharedFrame *frame);
+
+// Send hdr (hdr_len <= OUT_HEADER_MAX bytes) followed by payload, writing
+// what the socket accepts now with a single gather write and queueing the
+// rest. If frame is non-NULL, payload must be frame->data and the queue
+// takes a reference instead of copying; otherwise payload is copied only
+// when it cannot be written immediately.
+// Returns the byte count if sent or queued, 0 if a low-priority frame was
+// dropped, -1 on error.
+ssize_t client_session_sendv(ClientSession *sess, const void *hdr, size_t hdr_len,
+                             const char *payload, size_t payload_len,
+                             SharedFrame *frame, int priority);
+
+// Queue raw bytes for the client (see client_session_sendv)
 ssize_t client_session_send(ClientSession *sess, const void *buf, size_t len);
+ssize_t client_session_send_priority(ClientSession *sess, const void *buf, size_t len, int priority);
+
+// Write queued data until the queue is empty or the socket would block.
+// Arms/disarms EPOLLOUT as needed. Returns 0 on success, -1 on error.
+int client_session_flush(ClientSession *sess);
+
+// High-water mark (bytes) applied to every session's outbound queue
+void client_session_set_high_water(size_t bytes);
+size_t client_session_get_high_water(void);
+
+// Ask the owning event loop to shut the connection down after pending
+// output; the normal disconnect path then cleans the session up.
+void client_session_close(ClientSession *sess);
 
-// Read packet from socket (handles partial reads)
-// Returns: 1 if complete packet read, 0 if more data needed, -1 on error
-int client_session_read_packet(ClientSession *sess, uint16_t *cmd, char **payload, uint32_t *payload_len);
+// Read from the socket until EAGAIN (or the buffer is full) and decode
+// every complete frame, up to max_frames. The read_consumed bytes of the
+// previous call's frames are discarded first; frames the dispatcher left
+// (see dispatcher_handle_batch) and a trailing partial frame stay buffered.
+// *nframes receives the number of frames stored in frames; they are valid
+// even when CLIENT_READ_CLOSED is returned.
+ClientReadStatus client_session_read_frames(ClientSession *sess, ClientFrame *frames,
+                                            int max_frames, int *nframes);
 
 #endif
@@ -5,6 +5,14 @@
 #include <stdint.h>
 #include "service/client_session.h"
 
+// payload is borrowed (it points into the session's read buffer) and is
+// only valid for the duration of the call; handlers must copy what they keep.
+// It is NUL-terminated, or NULL when payload_len is 0.
 void dispatcher_handle_packet(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len);
 
+// Handle frames decoded from one read, in order. Stops early if the
+// session starts closing, or after a request that waits for the database
+// (the remaining frames stay buffered, see session_manager_submit_db).
+void dispatcher_handle_batch(ClientSession *sess, ClientFrame *frames, int nframes);
+
 #endif
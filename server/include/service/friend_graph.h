@@ -0,0 +1,31 @@
+// server/include/service/friend_graph.h
+//
+// Accepted friendships of the users who are online, kept in memory so that
+// presence fan-out never touches the database. A user's friends are loaded
+// once at login and dropped at logout/disconnect; the friend handlers keep
+// the loaded lists in step when a request is accepted or a friend removed.
+// Thread-safe.
+#ifndef FRIEND_GRAPH_H
+#define FRIEND_GRAPH_H
+
+#include <stdint.h>
+
+// Load user_id's friends from the database (replaces a loaded list).
+// Returns 0 or -1; on error the user is still tracked, with no friends.
+int  friend_graph_load(int64_t user_id);
+
+// Drop user_id's list once they went offline
+void friend_graph_forget(int64_t user_id);
+
+// a and b became / stopped being friends (lists not loaded are left alone)
+void friend_graph_add_edge(int64_t a, int64_t b);
+void friend_graph_remove_edge(int64_t a, int64_t b);
+
+// Friends of user_id that are online (loaded), as a malloc'd array in
+// *out_ids (NULL when empty). Returns the count, or -1 if user_id is not
+// loaded.
+int  friend_graph_online_friends(int64_t user_id, int64_t **out_ids);
+
+void friend_graph_clear(void);
+
+#endif
@@ -0,0 +1,46 @@
+// server/include/service/leaderboard.h
+//
+// In-memory leaderboard of every user by total wins (quickmode + 1vN),
+// kept in an indexable skip list: each link stores how many entries it
+// skips, so top-K, rank-of-user and "who is around me" are all O(log n)
+// plus the entries returned. Order matches the old SQL: total_wins DESC,
+// then username ASC (byte order), then user_id. Seeded from the database
+// at startup, then kept current by the services that record wins.
+// Thread-safe.
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+
+#define LEADERBOARD_DEFAULT_LIMIT  20
+#define LEADERBOARD_MAX_LIMIT      100
+#define LEADERBOARD_DEFAULT_AROUND 5
+#define LEADERBOARD_MAX_AROUND     50
+
+// (Re)load every user from the database. Returns 0 or -1.
+int  leaderboard_load(void);
+
+// 1 once leaderboard_load succeeded
+int  leaderboard_is_loaded(void);
+
+// Insert or reposition a user (e.g. a new account with 0 wins)
+int  leaderboard_put(int64_t user_id, const char *username, int total_wins);
+
+// Record wins for a user already on the board
+void leaderboard_add_wins(int64_t user_id, int delta);
+
+// 1-based rank of user_id (0 if unknown); *out_wins may be NULL
+int  leaderboard_rank(int64_t user_id, int *out_wins);
+
+int  leaderboard_size(void);
+
+// Response for CMD_REQ_LEADERBOARD, malloc'd:
+//   {"leaderboard": [top limit], "my_rank": r, "my_total_wins": w,
+//    "around": [ranks r-around .. r+around]}
+// Entries are {"rank", "user_id", "username", "total_wins"}. The my_* and
+// around fields are omitted when user_id is not on the board.
+char *leaderboard_json(int64_t user_id, int limit, int around);
+
+void leaderboard_free(void);
+
+#endif
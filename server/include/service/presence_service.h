@@ -0,0 +1,30 @@
+// server/include/service/presence_service.h
+//
+// Friend presence notifications (CMD_NOTIFY_FRIEND_STATUS). A status change
+// is sent only to the user's friends that are online (see friend_graph.h).
+// Changes are held for PRESENCE_COALESCE_MS: a user going online ->
+// in_waiting_room -> in_game inside that window produces one update with
+// the last state, and every recipient gets all the updates of the window
+// in a single frame:
+//   one update:  {"user_id": 7, "status": "online", "room_id": 0}
+//   several:     {"updates": [{...}, {...}]}
+// Like the other service handlers, call it under session_manager_lock();
+// the flush runs on the game timer, which holds the same lock.
+#ifndef PRESENCE_SERVICE_H
+#define PRESENCE_SERVICE_H
+
+#include <stdint.h>
+
+#define PRESENCE_COALESCE_MS 200
+
+// Record user_id's new status ("online", "offline", "in_waiting_room", ...).
+// Publish "offline" before friend_graph_forget(): recipients are taken now.
+void presence_publish(int64_t user_id, const char *status, int64_t room_id);
+
+// Send every pending update now (also what the timer runs)
+void presence_flush(void);
+
+// Drop pending updates without sending them
+void presence_clear(void);
+
+#endif
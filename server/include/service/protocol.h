@@ -27,6 +27,14 @@ void protocol_send_error(ClientSession *sess, uint16_t cmd, const char *error_ms
 // Sends a simple OK response without JSON body (payload length 0)
 void protocol_send_simple_ok(ClientSession *sess, uint16_t cmd);
 
+// Encode-once fan-out: build the payload a single time with
+// protocol_frame_new, send it to each recipient with protocol_send_frame
+// (only the 8-byte header, which carries the recipient's user_id, is built
+// per recipient) and drop the caller's reference with shared_frame_unref.
+// protocol_frame_new returns NULL for an empty payload.
+SharedFrame *protocol_frame_new(const char *json, uint32_t len);
+void protocol_send_frame(ClientSession *sess, uint16_t cmd, SharedFrame *frame);
+
 #endif
 
 
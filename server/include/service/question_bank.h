@@ -0,0 +1,56 @@
+// server/include/service/question_bank.h
+//
+// In-memory question bank. Every valid question is loaded once into a pool
+// per difficulty; games take their questions from it with a partial
+// Fisher-Yates shuffle: O(count) per draw, no duplicates, no retries and no
+// database round trip. Question text is interned, so identical strings
+// ("True", "1990", ...) are stored once.
+//
+// Drawn questions are reference counted: a game keeps its questions alive
+// with the reference it got from question_bank_draw and gives it back with
+// question_release. All functions are thread-safe.
+//
+// Edits go live without a restart: a trigger on the question table
+// NOTIFYs question_changed (see db.sql) and a listener thread applies each
+// insert, update or delete to the pools. A changed question is replaced by
+// a new object, so games keep the version they drew.
+#ifndef QUESTION_BANK_H
+#define QUESTION_BANK_H
+
+#include "dao/dao_question.h"
+
+// (Re)load every question from the database. Games holding questions from
+// the previous load keep them. Returns 0 or -1 (the old pools stay).
+int  question_bank_load(void);
+
+// Number of questions available for a difficulty ("EASY", "MEDIUM", "HARD")
+int  question_bank_count(const char *difficulty);
+
+// Fill out with up to count distinct random questions of a difficulty, each
+// with a reference for the caller. Loads the bank on first use.
+// Returns how many were drawn (fewer if the pool is smaller), or -1.
+int  question_bank_draw(const char *difficulty, Question **out, int count);
+
+// Deal a game's whole deck in one call: *easy EASY, then *medium MEDIUM,
+// then *hard HARD questions into out (room for all of them), all distinct.
+// A short pool deals fewer; the counts are updated to what was dealt.
+// Returns the deck size, or -1.
+int  question_bank_deal(int *easy, int *medium, int *hard, Question **out);
+
+// Apply one question_changed payload ("INSERT:<id>", "UPDATE:<id>",
+// "DELETE:<id>" or "TRUNCATE"). Reads the row on db_get_conn().
+int  question_bank_apply(const char *payload);
+
+// Start / stop the thread that LISTENs on its own connection. After a lost
+// connection it reconnects with backoff and reloads the whole bank, since
+// notifications sent meanwhile are gone.
+int  question_bank_listen(const char *conninfo);
+void question_bank_stop_listening(void);
+
+void question_retain(Question *q);
+void question_release(Question *q);
+
+// Drop the pools (questions still held by games are freed on release)
+void question_bank_free(void);
+
+#endif
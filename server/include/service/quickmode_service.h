@@ -14,7 +14,7 @@ typedef struct QuickModeSession {
 	ClientSession *client_session;
 	int current_round;              // Current round (1-15)
 	int score;                      // Number of correct answers (0-15)
-	Question questions[15];         // 15 questions loaded at start
+	Question *questions[15];        // 15 questions drawn at start (one reference each)
 	char answers[15];               // Answers submitted ('A'/'B'/'C'/'D' or '\0')
 	int correct[15];                // 1=correct, 0=wrong
 	time_t start_time;              // Game start time
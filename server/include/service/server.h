@@ -4,6 +4,11 @@
 
 // start a simple server bound to bind_addr (NULL for any) and port (string), e.g. "9000".
 // Returns 0 on success or -1 on failure.
+// Runs one event-loop thread per online CPU.
 int start_server(const char *bind_addr, const char *portstr);
 
+// Same as start_server with an explicit number of event-loop threads
+// (<= 0 picks one per online CPU). Blocks until SIGINT/SIGTERM.
+int start_server_workers(const char *bind_addr, const char *portstr, int worker_count);
+
 #endif
\ No newline at end of file
@@ -3,17 +3,49 @@
 #define SESSION_MANAGER_H
 
 #include <stdbool.h>
+#include <pthread.h>
 #include "service/client_session.h"
+#include "utils/idmap.h"
 #include <sys/epoll.h>
 
 #define MAX_EPOLL_EVENTS 64
 #define MAX_SESSIONS 1024
+#define MAX_SERVER_WORKERS 64
+
+// Work posted to a manager from another thread: a frame to queue on one of
+// its sessions, or a call to run on its loop (call set, the rest unused).
+// An empty item with close_after set only requests a shutdown.
+typedef struct MailboxItem {
+	struct MailboxItem *next;
+	void (*call)(void *arg);   // deferred work, run under the service lock
+	void *call_arg;
+	int socket_fd;             // target connection
+	uint64_t conn_id;          // guards against fd reuse after disconnect
+	int priority;              // SEND_PRIORITY_*
+	int close_after;           // shutdown the connection once data is queued
+	unsigned char hdr[OUT_HEADER_MAX];
+	uint8_t hdr_len;
+	SharedFrame *frame;        // reference owned by the item (may be NULL)
+} MailboxItem;
 
 typedef struct SessionManager {
 	ClientSession **sessions;  // Array of session pointers
 	int max_sessions;
 	int session_count;
 	int epoll_fd;
+	IdMap by_fd;               // socket_fd -> session
+	int *free_slots;           // stack of unused indexes in sessions
+	int free_count;
+
+	// Multi-reactor: each event-loop thread owns one manager
+	int worker_id;             // index of the owning event-loop thread
+	int wake_fd;               // eventfd, readable when the mailbox has work
+	pthread_mutex_t mailbox_lock;
+	MailboxItem *mailbox_head;
+	MailboxItem *mailbox_tail;
+	int draining;              // delivering a posted item: write it directly
+	uint64_t next_conn_id;
+	ClientSession *resume_head; // paused sessions whose DB jobs completed
 } SessionManager;
 
 // Create/destroy session manager
@@ -26,6 +58,34 @@ int session_manager_remove(SessionManager *mgr, int socket_fd);
 int session_manager_remove_by_user_id(SessionManager *mgr, int64_t user_id, ClientSession *exclude_sess);
 ClientSession *session_manager_get_by_fd(SessionManager *mgr, int socket_fd);
 
+// Session still connected as (socket_fd, conn_id), or NULL once it is gone.
+// Use it to find a client again after deferred work (mailbox, async DB).
+ClientSession *session_manager_find_conn(SessionManager *mgr, int socket_fd, uint64_t conn_id);
+
+// A client to answer once deferred work is done, found again with
+// session_ref_get (NULL if it disconnected in the meantime)
+typedef struct {
+	SessionManager *mgr;       // NULL outside the server (tests)
+	ClientSession *sess;       // used directly only when mgr is NULL
+	int socket_fd;
+	uint64_t conn_id;
+} SessionRef;
+
+void session_ref_init(SessionRef *ref, ClientSession *sess);
+ClientSession *session_ref_get(const SessionRef *ref);
+
+// Run a handler's blocking DAO work off the event loop: run(arg) on a DB
+// pool thread without the service lock, then done(arg) back on this loop
+// under it. The connection's later frames are not dispatched before done
+// has run, so its requests are still answered one after the other.
+// Returns 0 if the job was accepted, -1 on error (nothing runs).
+int session_manager_submit_db(ClientSession *sess, void (*run)(void *arg),
+                              void (*done)(void *arg), void *arg);
+
+// Next paused session whose DB jobs have all completed (NULL if none); the
+// owning loop reads and dispatches its buffered frames again. Owner only.
+ClientSession *session_manager_pop_resumed(SessionManager *mgr);
+
 // Epoll management
 int session_manager_epoll_add(SessionManager *mgr, int fd, uint32_t events);
 int session_manager_epoll_modify(SessionManager *mgr, int fd, uint32_t events);
@@ -37,22 +97,61 @@ int session_manager_get_epoll_fd(SessionManager *mgr);
 // Get count
 int session_manager_count(SessionManager *mgr);
 
-// Update session's room_id
+// Update session's room_id and move it to that room's member list
+// (0 leaves the current room). Use this instead of assigning sess->room_id.
 void session_manager_set_room(ClientSession *sess, int64_t room_id);
 
-// Get session by user_id
+// Get session by user_id (O(1), across every registered manager)
 ClientSession *session_manager_get_by_user_id(int64_t user_id);
 
+// Attach a logged-in user to a session (user_id 0 detaches it) and keep the
+// user_id index in sync. Use this instead of assigning sess->user_id.
+void session_manager_bind_user(ClientSession *sess, int64_t user_id);
+
 // Send message to a specific user (if online)
 int session_manager_send_to_user(int64_t user_id, uint16_t cmd, const char *json, uint32_t json_len);
 
-// Broadcast message to all sessions in a room
+// Broadcast message to all sessions in a room (cost scales with room size).
+// The payload is encoded once and shared by every member's queue.
 int session_manager_broadcast_to_room(int64_t room_id, uint16_t cmd, const char *json, uint32_t json_len);
 
-// Set/get global session manager instance
+// Set/get global session manager instance.
+// get_global returns the calling event-loop thread's manager when there is one.
 void session_manager_set_global(SessionManager *mgr);
 SessionManager *session_manager_get_global(void);
 
+// ========== Multi-reactor support ==========
+
+// Register a per-thread manager so user/room lookups can see its sessions
+int session_manager_register(SessionManager *mgr);
+void session_manager_unregister_all(void);
+
+// Bind the calling thread to the manager it runs the event loop for
+void session_manager_set_current(SessionManager *mgr);
+SessionManager *session_manager_get_current(void);
+
+// Lock serializing service handlers, timers and session directory changes.
+// Socket I/O and framing run outside of it, in parallel on every loop.
+void session_manager_lock(void);
+void session_manager_unlock(void);
+
+// Queue a frame (or a close request) for a session owned by another thread.
+// Takes over the caller's reference to frame on success.
+// Returns 0 on success, -1 on error.
+int session_manager_post_send(SessionManager *mgr, ClientSession *sess,
+                              const void *hdr, size_t hdr_len, SharedFrame *frame,
+                              int priority, int close_after);
+
+// Run fn(arg) on mgr's event loop under the service lock (e.g. completion
+// of a DB pool job). Returns 0 on success, -1 on error.
+int session_manager_post_call(SessionManager *mgr, void (*fn)(void *arg), void *arg);
+
+// Deliver queued mailbox work; called by the owning thread when wake_fd fires
+void session_manager_drain_mailbox(SessionManager *mgr);
+
+// Wake the owning thread's epoll_wait (e.g. on shutdown)
+void session_manager_wake(SessionManager *mgr);
+
 // User status management for invite system
 const char *session_get_status_string(int64_t user_id);
 bool session_can_invite_user(int64_t target_user_id, int64_t from_room_id);
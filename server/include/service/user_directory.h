@@ -0,0 +1,33 @@
+// server/include/service/user_directory.h
+//
+// Bounded in-memory directory of user identities (username, avatar), keyed
+// by user_id and shared by all services. Entries hold the JSON-escaped
+// fragments ready to paste between quotes, so building a chat line or a
+// friend list needs neither a query nor an escape. Filled at login and on
+// demand (misses are loaded in one query, without the password hash);
+// least recently used entries are evicted past the capacity. Thread-safe.
+#ifndef USER_DIRECTORY_H
+#define USER_DIRECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define USER_DIRECTORY_CAPACITY 10000
+
+// Remember a user's identity (replaces an existing entry)
+int  user_directory_put(int64_t user_id, const char *username, const char *avatar_img);
+
+// Load every id not cached yet with one query. Returns 0 or -1.
+int  user_directory_prefetch(const int64_t *user_ids, int count);
+
+// Copy the escaped username / avatar into out, loading the user on a miss.
+// Returns 0, or -1 if the user does not exist (out is then "").
+int  user_directory_username_json(int64_t user_id, char *out, size_t out_len);
+int  user_directory_avatar_json(int64_t user_id, char *out, size_t out_len);
+
+// Forget a user after their name or avatar changed
+void user_directory_invalidate(int64_t user_id);
+
+void user_directory_clear(void);
+
+#endif
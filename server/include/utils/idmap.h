@@ -0,0 +1,39 @@
+// Open-addressing hash map from 64-bit ids (user_id, fd, room_id, ...) to pointers
+#ifndef UTIL_IDMAP_H
+#define UTIL_IDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	int64_t key;
+	void *value;               // NULL marks an empty slot
+} IdMapEntry;
+
+// Linear probing with backward-shift deletion (no tombstones).
+// Capacity is a power of two and grows to keep the load factor under 0.7.
+// Not thread-safe: callers provide their own locking.
+typedef struct IdMap {
+	IdMapEntry *entries;
+	size_t capacity;
+	size_t count;
+} IdMap;
+
+// Returns 0 on success, -1 on allocation failure
+int idmap_init(IdMap *map, size_t initial_capacity);
+void idmap_free(IdMap *map);
+void idmap_clear(IdMap *map);
+
+// Returns the value stored for key, or NULL
+void *idmap_get(const IdMap *map, int64_t key);
+
+// Insert or replace. value must not be NULL. Returns 0 on success, -1 on error.
+int idmap_put(IdMap *map, int64_t key, void *value);
+
+// Remove key; returns the value it had, or NULL if absent
+void *idmap_remove(IdMap *map, int64_t key);
+
+// Iterate: for (size_t i = 0; i < map->capacity; i++) if (map->entries[i].value) ...
+// The map must not be modified while iterating.
+
+#endif
@@ -1,12 +1,71 @@
 #ifndef UTIL_JSON_H
 #define UTIL_JSON_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Escape a C string for JSON and return a newly allocated string.
 // Caller must free the returned pointer.
 char *util_json_escape(const char *s);
 
+// ---- Request payloads ----
+// util_json_parse() reads a payload object once into a field table: each
+// top-level key and value is a span into the payload (nothing allocated),
+// indexed by a small hash so every lookup is O(1). Nested objects and
+// arrays are validated and kept as raw spans. Lookups compare the key
+// exactly, so "id" never matches "friend_id" or text inside a value.
+
+#define JSON_MAX_FIELDS 32
+
+typedef enum {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+typedef struct {
+    const char *key;      // Between the quotes, still escaped
+    const char *value;    // Strings: between the quotes, still escaped; others: the raw token
+    uint32_t key_len;
+    uint32_t value_len;
+    JsonType type;
+    int is_integer;       // Numbers without fraction or exponent
+} JsonField;
+
+typedef struct {
+    JsonField fields[JSON_MAX_FIELDS];
+    int count;
+    uint8_t index[JSON_MAX_FIELDS * 2];  // key hash slot -> field + 1
+} JsonObject;
+
+// Parse a NUL-terminated JSON object. Returns 0, or -1 if it is not valid
+// JSON or has more than JSON_MAX_FIELDS fields; obj is then left empty, so
+// every lookup misses. The payload must outlive obj. A repeated key keeps
+// its first value.
+int util_json_parse(const char *json, JsonObject *obj);
+
+// Field by key, or NULL
+const JsonField *util_json_find(const JsonObject *obj, const char *key);
+
+// String field with escapes decoded (\uXXXX to UTF-8), newly allocated.
+// NULL if missing, not a string, or it would contain a NUL byte.
+char *util_json_obj_string(const JsonObject *obj, const char *key);
+
+// Number fields. Return 1 and store the value, or 0 if missing, not a
+// number, not an integer (int/int64) or out of range.
+int util_json_obj_int(const JsonObject *obj, const char *key, int *out);
+int util_json_obj_int64(const JsonObject *obj, const char *key, long long *out);
+int util_json_obj_double(const JsonObject *obj, const char *key, double *out);
+
+// ---- Fragment scanning ----
+// The helpers below look for the key anywhere in the text (no parsing), so
+// they also work on pieces of larger documents. Use util_json_parse() for
+// request payloads.
+
 // Very small helper: extract a JSON string field value by key ("key": "value")
 // Returns newly allocated string with the value or NULL if not found.
 char *util_json_get_string(const char *json, const char *key);
@@ -0,0 +1,72 @@
+// Asynchronous leveled logging with per-subsystem categories.
+//
+// LOG_* macros format the message on the calling thread and push it into a
+// lock-free ring; a background thread writes batches to stdout/stderr.
+// Event loops never block on a slow pipe: when the ring is full the message
+// is dropped and counted. Before log_init() (unit tests, tools) messages are
+// written synchronously.
+#ifndef UTIL_LOG_H
+#define UTIL_LOG_H
+
+#include <stdint.h>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+// Calls below this level are removed at compile time (-DLOG_COMPILE_LEVEL=1
+// strips every LOG_DEBUG). The runtime level filters the rest.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+typedef enum {
+	LOG_CAT_SERVER = 0,
+	LOG_CAT_SESSION,
+	LOG_CAT_PROTOCOL,
+	LOG_CAT_DISPATCHER,
+	LOG_CAT_AUTH,
+	LOG_CAT_FRIENDS,
+	LOG_CAT_QUICKMODE,
+	LOG_CAT_ONEVN,
+	LOG_CAT_STATS,
+	LOG_CAT_DB,
+	LOG_CAT_COUNT
+} LogCategory;
+
+// Per-category runtime level, read without locking on every LOG_* call
+extern unsigned char g_log_levels[LOG_CAT_COUNT];
+
+static inline int log_enabled(LogCategory cat, int level) {
+	return level >= __atomic_load_n(&g_log_levels[cat], __ATOMIC_RELAXED);
+}
+
+// Start the writer thread. spec is a level ("debug", "info", "warn",
+// "error", "off") optionally followed by per-category overrides, e.g.
+// "info,onevn=debug,friends=warn". NULL keeps the default (info).
+// Returns 0 on success, -1 on error.
+int log_init(const char *spec);
+
+// Flush everything queued and stop the writer thread
+void log_shutdown(void);
+
+void log_set_level(LogCategory cat, int level);
+
+// Use the LOG_* macros instead, they skip formatting when filtered out
+void log_write(LogCategory cat, int level, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+#define LOG_AT(level, cat, ...) \
+	do { \
+		if ((level) >= LOG_COMPILE_LEVEL && log_enabled((cat), (level))) \
+			log_write((cat), (level), __VA_ARGS__); \
+	} while (0)
+
+#define LOG_DEBUG(cat, ...) LOG_AT(LOG_LEVEL_DEBUG, cat, __VA_ARGS__)
+#define LOG_INFO(cat, ...)  LOG_AT(LOG_LEVEL_INFO, cat, __VA_ARGS__)
+#define LOG_WARN(cat, ...)  LOG_AT(LOG_LEVEL_WARN, cat, __VA_ARGS__)
+#define LOG_ERROR(cat, ...) LOG_AT(LOG_LEVEL_ERROR, cat, __VA_ARGS__)
+
+#endif
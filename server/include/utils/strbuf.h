@@ -0,0 +1,33 @@
+// Growable string builder for JSON responses of unbounded size
+#ifndef UTIL_STRBUF_H
+#define UTIL_STRBUF_H
+
+#include <stddef.h>
+
+// data is NUL-terminated once anything was appended. An allocation failure
+// sets failed and makes later appends no-ops; check it once at the end.
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+	int failed;
+} StrBuf;
+
+#define STRBUF_INIT { NULL, 0, 0, 0 }
+
+void strbuf_init(StrBuf *sb);
+void strbuf_free(StrBuf *sb);
+
+// Empty the buffer but keep its memory for the next build
+void strbuf_reset(StrBuf *sb);
+
+void strbuf_append(StrBuf *sb, const char *s, size_t n);
+void strbuf_appends(StrBuf *sb, const char *s);
+void strbuf_appendf(StrBuf *sb, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+// Hand the string to the caller (free() it) and leave the buffer empty.
+// Returns NULL if an append failed.
+char *strbuf_detach(StrBuf *sb);
+
+#endif
@@ -39,23 +39,36 @@ typedef void (*timer_callback_t)(int64_t context_id, void *user_data);
 
 /**
  * Create a game timer with callback (for async operations)
- * Returns: timer ID (>= 0) on success, -1 on error
+ * Returns: timer ID (> 0) on success, -1 on error
  * Note: Named game_timer_* to avoid conflict with POSIX timer_create
  */
 int game_timer_create(int timeout_seconds, int64_t context_id, timer_callback_t callback, void *user_data);
 
+/**
+ * Same as game_timer_create with a timeout in milliseconds (CLOCK_MONOTONIC)
+ */
+int game_timer_create_ms(int timeout_ms, int64_t context_id, timer_callback_t callback, void *user_data);
+
 /**
  * Cancel a game timer by ID
  */
 void game_timer_cancel(int timer_id);
 
 /**
- * Check and run expired game timers (call this periodically in main loop)
+ * Run every expired game timer. Call it when the fd from game_timer_get_fd()
+ * becomes readable; it re-arms that fd for the next deadline.
  */
 void game_timer_check_and_run(void);
 
 /**
- * Cleanup expired game timers
+ * timerfd (non-blocking) that becomes readable at the next timer deadline.
+ * Add it to an epoll set instead of polling game_timer_check_and_run.
+ * Returns: fd on success, -1 on error
+ */
+int game_timer_get_fd(void);
+
+/**
+ * Drop every pending game timer without running it
  */
 void game_timer_cleanup(void);
 
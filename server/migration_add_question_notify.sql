@@ -0,0 +1,27 @@
+-- Migration: Notify the server when questions change
+-- The server keeps the questions in memory (question bank) and LISTENs on
+-- channel question_changed; payload "INSERT:<id>", "UPDATE:<id>",
+-- "DELETE:<id>" or "TRUNCATE". Safe to run more than once.
+
+CREATE OR REPLACE FUNCTION notify_question_changed() RETURNS trigger AS $$
+BEGIN
+  IF TG_OP = 'TRUNCATE' THEN
+    PERFORM pg_notify('question_changed', 'TRUNCATE');
+  ELSIF TG_OP = 'DELETE' THEN
+    PERFORM pg_notify('question_changed', 'DELETE:' || OLD.question_id);
+  ELSE
+    PERFORM pg_notify('question_changed', TG_OP || ':' || NEW.question_id);
+  END IF;
+  RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS trg_question_changed ON question;
+CREATE TRIGGER trg_question_changed
+  AFTER INSERT OR UPDATE OR DELETE ON question
+  FOR EACH ROW EXECUTE FUNCTION notify_question_changed();
+
+DROP TRIGGER IF EXISTS trg_question_truncated ON question;
+CREATE TRIGGER trg_question_truncated
+  AFTER TRUNCATE ON question
+  FOR EACH STATEMENT EXECUTE FUNCTION notify_question_changed();
@@ -3,24 +3,28 @@
 #include <string.h>
 #include <libpq-fe.h>
 #include "db.h"
+#include "db_stmt.h"
 #include "utils/json.h"
 #include "dao/dao_chat.h"
 
+static DbStmt STMT_CHAT_SEND_DM = {
+    .name = "chat_send_dm",
+    .sql = "INSERT INTO messages (sender_id, receiver_id, message) "
+           "VALUES ($1, $2, $3);",
+    .nparams = 3, .types = { DB_TYPE_INT8, DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_chat_send_dm(int64_t sender_id, int64_t receiver_id, const char *content) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO messages (sender_id, receiver_id, message) "
-        "VALUES ($1, $2, $3);";
-
-    char buf_sender[32], buf_receiver[32];
-    snprintf(buf_sender, sizeof(buf_sender), "%ld", sender_id);
-    snprintf(buf_receiver, sizeof(buf_receiver), "%ld", receiver_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, sender_id);
+    db_param_int8(&params, receiver_id);
+    db_param_text(&params, content);
 
-    const char *params[3] = { buf_sender, buf_receiver, content };
-
-    PGresult *res = PQexecParams(conn, sql, 3, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_SEND_DM, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_CHAT] send_dm error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -30,21 +34,24 @@ int dao_chat_send_dm(int64_t sender_id, int64_t receiver_id, const char *content
     return 0;
 }
 
+static DbStmt STMT_CHAT_SEND_ROOM = {
+    .name = "chat_send_room",
+    .sql = "INSERT INTO messages (sender_id, room_id, message) "
+           "VALUES ($1, $2, $3);",
+    .nparams = 3, .types = { DB_TYPE_INT8, DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_chat_send_room(int64_t sender_id, int64_t room_id, const char *content) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO messages (sender_id, room_id, message) "
-        "VALUES ($1, $2, $3);";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, sender_id);
+    db_param_int8(&params, room_id);
+    db_param_text(&params, content);
 
-    char buf_sender[32], buf_room[32];
-    snprintf(buf_sender, sizeof(buf_sender), "%ld", sender_id);
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-
-    const char *params[3] = { buf_sender, buf_room, content };
-
-    PGresult *res = PQexecParams(conn, sql, 3, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_SEND_ROOM, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_CHAT] send_room error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -54,21 +61,24 @@ int dao_chat_send_room(int64_t sender_id, int64_t room_id, const char *content)
     return 0;
 }
 
+static DbStmt STMT_CHAT_FETCH_OFFLINE = {
+    .name = "chat_fetch_offline",
+    .sql = "SELECT id, sender_id, message, created_at "
+           "FROM messages "
+           "WHERE receiver_id = $1 AND is_read = FALSE "
+           "ORDER BY created_at ASC;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_chat_fetch_offline(int64_t user_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "SELECT id, sender_id, message, created_at "
-        "FROM messages "
-        "WHERE receiver_id = $1 AND is_read = FALSE "
-        "ORDER BY created_at ASC;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
 
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_FETCH_OFFLINE, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_CHAT] fetch_offline error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -117,22 +127,25 @@ int dao_chat_fetch_offline(int64_t user_id, void **result_json) {
     return 0;
 }
 
+static DbStmt STMT_CHAT_FETCH_OFFLINE_FROM = {
+    .name = "chat_fetch_offline_from",
+    .sql = "SELECT id, sender_id, message, created_at "
+           "FROM messages "
+           "WHERE receiver_id = $1 AND sender_id = $2 AND is_read = FALSE "
+           "ORDER BY created_at ASC;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_chat_fetch_offline_from_sender(int64_t receiver_id, int64_t sender_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "SELECT id, sender_id, message, created_at "
-        "FROM messages "
-        "WHERE receiver_id = $1 AND sender_id = $2 AND is_read = FALSE "
-        "ORDER BY created_at ASC;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, receiver_id);
+    db_param_int8(&params, sender_id);
 
-    char buf_recv[32], buf_sender[32];
-    snprintf(buf_recv, sizeof(buf_recv), "%ld", receiver_id);
-    snprintf(buf_sender, sizeof(buf_sender), "%ld", sender_id);
-    const char *params[2] = { buf_recv, buf_sender };
-
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_FETCH_OFFLINE_FROM, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_CHAT] fetch_offline_from_sender error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -181,27 +194,30 @@ int dao_chat_fetch_offline_from_sender(int64_t receiver_id, int64_t sender_id, v
     return 0;
 }
 
+// Fetch all messages where:
+// 1. (sender_id = user_id AND receiver_id = friend_id) - messages sent by user
+// 2. OR (sender_id = friend_id AND receiver_id = user_id) - messages received from friend
+static DbStmt STMT_CHAT_FETCH_CONVERSATION = {
+    .name = "chat_fetch_conversation",
+    .sql = "SELECT id, sender_id, message, created_at "
+           "FROM messages "
+           "WHERE ((sender_id = $1 AND receiver_id = $2) OR (sender_id = $2 AND receiver_id = $1)) "
+           "AND room_id IS NULL "
+           "ORDER BY created_at ASC;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 // Fetch all messages (sent and received) between two users
 int dao_chat_fetch_conversation(int64_t user_id, int64_t friend_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    // Fetch all messages where:
-    // 1. (sender_id = user_id AND receiver_id = friend_id) - messages sent by user
-    // 2. OR (sender_id = friend_id AND receiver_id = user_id) - messages received from friend
-    const char *sql =
-        "SELECT id, sender_id, message, created_at "
-        "FROM messages "
-        "WHERE ((sender_id = $1 AND receiver_id = $2) OR (sender_id = $2 AND receiver_id = $1)) "
-        "AND room_id IS NULL "
-        "ORDER BY created_at ASC;";
-
-    char buf_user[32], buf_friend[32];
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
-    snprintf(buf_friend, sizeof(buf_friend), "%ld", friend_id);
-    const char *params[2] = { buf_user, buf_friend };
-
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    db_param_int8(&params, friend_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_FETCH_CONVERSATION, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_CHAT] fetch_conversation error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -269,19 +285,22 @@ int dao_chat_fetch_conversation(int64_t user_id, int64_t friend_id, void **resul
     return 0;
 }
 
+static DbStmt STMT_CHAT_MARK_READ = {
+    .name = "chat_mark_read",
+    .sql = "UPDATE messages SET is_read = TRUE "
+           "WHERE receiver_id = $1 AND is_read = FALSE;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_chat_mark_read(int64_t user_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE messages SET is_read = TRUE "
-        "WHERE receiver_id = $1 AND is_read = FALSE;";
-
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_CHAT_MARK_READ, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_CHAT] mark_read error: %s\n", PQerrorMessage(conn));
         PQclear(res);
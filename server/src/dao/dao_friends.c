@@ -3,6 +3,7 @@
 #include <string.h>
 #include <libpq-fe.h>
 #include "../include/db.h"
+#include "db_stmt.h"
 #include "dao/dao_friends.h"
 #include "utils/json.h"
 
@@ -19,23 +20,24 @@ static const char *friend_status_to_str(friend_status_t st) {
 // Add DECLINED status
 #define FRIEND_STATUS_DECLINED 3
 
+static DbStmt STMT_FRIENDS_SEND_REQUEST = {
+    .name = "friends_send_request",
+    .sql = "INSERT INTO friend_relationships (user_id, peer_user_id, status) "
+           "VALUES ($1, $2, 'PENDING') "
+           "ON CONFLICT (user_id, peer_user_id) DO UPDATE SET status = 'PENDING', responded_at = NULL;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_friends_send_request(int64_t from_user, int64_t to_user) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO friend_relationships (user_id, peer_user_id, status) "
-        "VALUES ($1, $2, 'PENDING') "
-        "ON CONFLICT (user_id, peer_user_id) DO UPDATE SET status = 'PENDING', responded_at = NULL;";
-
-    const char *params[2];
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", from_user);
-    snprintf(buf2, sizeof(buf2), "%ld", to_user);
-    params[0] = buf1;
-    params[1] = buf2;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, from_user);
+    db_param_int8(&params, to_user);
 
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_SEND_REQUEST, &params);
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_FRIENDS] send_request error: %s\n", PQerrorMessage(conn));
@@ -46,24 +48,25 @@ int dao_friends_send_request(int64_t from_user, int64_t to_user) {
     return 0;
 }
 
+static DbStmt STMT_FRIENDS_RESPOND = {
+    .name = "friends_respond_request",
+    .sql = "UPDATE friend_relationships "
+           "SET status = $3, responded_at = NOW() "
+           "WHERE user_id = $1 AND peer_user_id = $2 AND status = 'PENDING';",
+    .nparams = 3, .types = { DB_TYPE_INT8, DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_friends_respond_request(int64_t from_user, int64_t to_user, bool accept) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE friend_relationships "
-        "SET status = $3, responded_at = NOW() "
-        "WHERE user_id = $1 AND peer_user_id = $2 AND status = 'PENDING';";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, from_user);
+    db_param_int8(&params, to_user);
+    db_param_text(&params, accept ? "ACCEPTED" : "DECLINED");
 
-    const char *params[3];
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", from_user);
-    snprintf(buf2, sizeof(buf2), "%ld", to_user);
-    params[0] = buf1;
-    params[1] = buf2;
-    params[2] = accept ? "ACCEPTED" : "DECLINED";
-
-    PGresult *res = PQexecParams(conn, sql, 3, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_RESPOND, &params);
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_FRIENDS] respond_request error: %s\n", PQerrorMessage(conn));
@@ -75,23 +78,26 @@ int dao_friends_respond_request(int64_t from_user, int64_t to_user, bool accept)
     return (affected > 0) ? 0 : -1;
 }
 
+static DbStmt STMT_FRIENDS_LIST = {
+    .name = "friends_list",
+    .sql = "SELECT u.user_id, u.username, f.status "
+           "FROM friend_relationships f "
+           "JOIN users u ON u.user_id = f.peer_user_id "
+           "WHERE f.user_id = $1 AND f.status = 'ACCEPTED';",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 // Ở đây mình giả sử bạn dùng JSON/Jansson phía service.
 // DAO có thể trả về raw PGresult, nhưng để đơn giản ta trả về void* chứa JSON string.
 int dao_friends_list(int64_t user_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "SELECT u.user_id, u.username, f.status "
-        "FROM friend_relationships f "
-        "JOIN users u ON u.user_id = f.peer_user_id "
-        "WHERE f.user_id = $1 AND f.status = 'ACCEPTED';";
-
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_LIST, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_FRIENDS] list error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -143,21 +149,62 @@ int dao_friends_list(int64_t user_id, void **result_json) {
     return 0;
 }
 
-int dao_friends_update_status(int64_t user_id, int64_t friend_id, friend_status_t status) {
+static DbStmt STMT_FRIENDS_LIST_IDS = {
+    .name = "friends_list_ids",
+    .sql = "SELECT peer_user_id FROM friend_relationships "
+           "WHERE user_id = $1 AND status = 'ACCEPTED';",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+int dao_friends_list_ids(int64_t user_id, int64_t **out_ids, int *out_count) {
     PGconn *conn = db_get_conn();
-    if (!conn) return -1;
+    if (!conn || !out_ids || !out_count) return -1;
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_LIST_IDS, &params);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "[DAO_FRIENDS] list_ids error: %s\n", PQerrorMessage(conn));
+        PQclear(res);
+        return -1;
+    }
+
+    int rows = PQntuples(res);
+    int64_t *ids = NULL;
+    if (rows > 0) {
+        ids = malloc(sizeof(int64_t) * (size_t)rows);
+        if (!ids) { PQclear(res); return -1; }
+        for (int i = 0; i < rows; ++i) {
+            ids[i] = atoll(PQgetvalue(res, i, 0));
+        }
+    }
+    PQclear(res);
+
+    *out_ids = ids;
+    *out_count = rows;
+    return 0;
+}
 
-    const char *sql =
-        "UPDATE friend_relationships SET status = $3 "
-        "WHERE user_id = $1 AND peer_user_id = $2;";
+static DbStmt STMT_FRIENDS_UPDATE_STATUS = {
+    .name = "friends_update_status",
+    .sql = "UPDATE friend_relationships SET status = $3 "
+           "WHERE user_id = $1 AND peer_user_id = $2;",
+    .nparams = 3, .types = { DB_TYPE_INT8, DB_TYPE_INT8, DB_TYPE_ANY }
+};
 
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", user_id);
-    snprintf(buf2, sizeof(buf2), "%ld", friend_id);
+int dao_friends_update_status(int64_t user_id, int64_t friend_id, friend_status_t status) {
+    PGconn *conn = db_get_conn();
+    if (!conn) return -1;
 
-    const char *params[3] = { buf1, buf2, friend_status_to_str(status) };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    db_param_int8(&params, friend_id);
+    db_param_text(&params, friend_status_to_str(status));
 
-    PGresult *res = PQexecParams(conn, sql, 3, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_UPDATE_STATUS, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_FRIENDS] update_status error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -167,22 +214,25 @@ int dao_friends_update_status(int64_t user_id, int64_t friend_id, friend_status_
     return 0;
 }
 
+static DbStmt STMT_FRIENDS_GET_INFO = {
+    .name = "friends_get_info",
+    .sql = "SELECT u.user_id, u.username, COALESCE(u.avatar_img, '') as avatar_img, f.status "
+           "FROM friend_relationships f "
+           "JOIN users u ON u.user_id = f.peer_user_id "
+           "WHERE f.user_id = $1 AND f.peer_user_id = $2 AND f.status = 'ACCEPTED';",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_friends_get_info(int64_t user_id, int64_t friend_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
     
-    const char *sql =
-        "SELECT u.user_id, u.username, COALESCE(u.avatar_img, '') as avatar_img, f.status "
-        "FROM friend_relationships f "
-        "JOIN users u ON u.user_id = f.peer_user_id "
-        "WHERE f.user_id = $1 AND f.peer_user_id = $2 AND f.status = 'ACCEPTED';";
-    
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", user_id);
-    snprintf(buf2, sizeof(buf2), "%ld", friend_id);
-    const char *params[2] = { buf1, buf2 };
-    
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    db_param_int8(&params, friend_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_GET_INFO, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_FRIENDS] get_info error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -217,21 +267,24 @@ int dao_friends_get_info(int64_t user_id, int64_t friend_id, void **result_json)
     return 0;
 }
 
+static DbStmt STMT_FRIENDS_GET_PENDING = {
+    .name = "friends_get_pending",
+    .sql = "SELECT u.user_id, u.username, COALESCE(u.avatar_img, '') as avatar_img "
+           "FROM friend_relationships f "
+           "JOIN users u ON u.user_id = f.user_id "
+           "WHERE f.peer_user_id = $1 AND f.status = 'PENDING';",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_friends_get_pending_requests(int64_t user_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
     
-    const char *sql =
-        "SELECT u.user_id, u.username, COALESCE(u.avatar_img, '') as avatar_img "
-        "FROM friend_relationships f "
-        "JOIN users u ON u.user_id = f.user_id "
-        "WHERE f.peer_user_id = $1 AND f.status = 'PENDING';";
-    
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
-    
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_GET_PENDING, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_FRIENDS] get_pending_requests error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -286,21 +339,24 @@ int dao_friends_get_pending_requests(int64_t user_id, void **result_json) {
     return 0;
 }
 
+static DbStmt STMT_FRIENDS_ARE_FRIENDS = {
+    .name = "friends_are_friends",
+    .sql = "SELECT COUNT(*) FROM friend_relationships "
+           "WHERE ((user_id = $1 AND peer_user_id = $2) OR (user_id = $2 AND peer_user_id = $1)) "
+           "AND status = 'ACCEPTED';",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_friends_are_friends(int64_t user_id1, int64_t user_id2, bool *are_friends) {
     PGconn *conn = db_get_conn();
     if (!conn || !are_friends) return -1;
     
-    const char *sql =
-        "SELECT COUNT(*) FROM friend_relationships "
-        "WHERE ((user_id = $1 AND peer_user_id = $2) OR (user_id = $2 AND peer_user_id = $1)) "
-        "AND status = 'ACCEPTED';";
-    
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", user_id1);
-    snprintf(buf2, sizeof(buf2), "%ld", user_id2);
-    const char *params[2] = { buf1, buf2 };
-    
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id1);
+    db_param_int8(&params, user_id2);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_ARE_FRIENDS, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_FRIENDS] are_friends error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -314,21 +370,24 @@ int dao_friends_are_friends(int64_t user_id1, int64_t user_id2, bool *are_friend
     return 0;
 }
 
+static DbStmt STMT_FRIENDS_REMOVE = {
+    .name = "friends_remove",
+    .sql = "DELETE FROM friend_relationships "
+           "WHERE (user_id = $1 AND peer_user_id = $2) OR (user_id = $2 AND peer_user_id = $1);",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_friends_remove(int64_t user_id, int64_t friend_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
     
     // Delete both directions of the friendship relationship
-    const char *sql =
-        "DELETE FROM friend_relationships "
-        "WHERE (user_id = $1 AND peer_user_id = $2) OR (user_id = $2 AND peer_user_id = $1);";
-    
-    char buf1[32], buf2[32];
-    snprintf(buf1, sizeof(buf1), "%ld", user_id);
-    snprintf(buf2, sizeof(buf2), "%ld", friend_id);
-    const char *params[2] = { buf1, buf2 };
-    
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    db_param_int8(&params, friend_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_FRIENDS_REMOVE, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_FRIENDS] remove error: %s\n", PQerrorMessage(conn));
         PQclear(res);
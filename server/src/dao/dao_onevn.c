@@ -1,25 +1,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <libpq-fe.h>
 #include "db.h"
+#include "db_async.h"
+#include "db_batch.h"
+#include "db_pool.h"
+#include "db_stmt.h"
 #include "dao/dao_onevn.h"
+#include "dao/dao_rooms.h"
 #include "utils/json.h"
 
+static DbStmt STMT_ONEVN_CREATE_SESSION = {
+    .name = "onevn_create_session",
+    .sql = "INSERT INTO onevn_sessions (room_id, status, players) "
+           "VALUES ($1, 'IN_PROGRESS', '[]'::jsonb) "
+           "RETURNING session_id;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_onevn_create_session(int64_t room_id, int64_t *out_session_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO onevn_sessions (room_id, status, players) "
-        "VALUES ($1, 'IN_PROGRESS', '[]'::jsonb) "
-        "RETURNING session_id;";
-
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_CREATE_SESSION, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_ONEVN] create_session error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -36,19 +45,25 @@ int dao_onevn_create_session(int64_t room_id, int64_t *out_session_id) {
     return 0;
 }
 
+static DbStmt STMT_ONEVN_UPDATE_PLAYERS = {
+    .name = "onevn_update_players",
+    // A finished session keeps its final players: a round write that lands
+    // late must not overwrite them
+    .sql = "UPDATE onevn_sessions SET players = $2::jsonb "
+           "WHERE session_id = $1 AND status = 'IN_PROGRESS';",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_onevn_update_players(int64_t session_id, const char *players_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE onevn_sessions SET players = $2::jsonb "
-        "WHERE session_id = $1;";
-
-    char buf_session[32];
-    snprintf(buf_session, sizeof(buf_session), "%ld", session_id);
-    const char *params[2] = { buf_session, players_json };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    db_param_text(&params, players_json);
 
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_UPDATE_PLAYERS, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ONEVN] update_players error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -58,20 +73,30 @@ int dao_onevn_update_players(int64_t session_id, const char *players_json) {
     return 0;
 }
 
+static DbStmt STMT_ONEVN_ABORT_SESSION = {
+    .name = "onevn_abort_session",
+    .sql = "UPDATE onevn_sessions SET status = 'ABORTED', ended_at = NOW() "
+           "WHERE session_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+static DbStmt STMT_ONEVN_END_SESSION = {
+    .name = "onevn_end_session",
+    .sql = "UPDATE onevn_sessions SET status = 'FINISHED', winner_id = $2, ended_at = NOW() "
+           "WHERE session_id = $1;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_onevn_end_session(int64_t session_id, int64_t winner_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE onevn_sessions SET status = 'FINISHED', winner_id = $2, ended_at = NOW() "
-        "WHERE session_id = $1;";
-
-    char buf_session[32], buf_winner[32];
-    snprintf(buf_session, sizeof(buf_session), "%ld", session_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
     if (winner_id > 0) {
-        snprintf(buf_winner, sizeof(buf_winner), "%ld", winner_id);
-        const char *params[2] = { buf_session, buf_winner };
-        PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+        db_param_int8(&params, winner_id);
+        PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_END_SESSION, &params);
         if (PQresultStatus(res) != PGRES_COMMAND_OK) {
             fprintf(stderr, "[DAO_ONEVN] end_session error: %s\n", PQerrorMessage(conn));
             PQclear(res);
@@ -80,11 +105,7 @@ int dao_onevn_end_session(int64_t session_id, int64_t winner_id) {
         PQclear(res);
     } else {
         // No winner (aborted)
-        const char *sql2 =
-            "UPDATE onevn_sessions SET status = 'ABORTED', ended_at = NOW() "
-            "WHERE session_id = $1;";
-        const char *params[1] = { buf_session };
-        PGresult *res = PQexecParams(conn, sql2, 1, NULL, params, NULL, NULL, 0);
+        PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_ABORT_SESSION, &params);
         if (PQresultStatus(res) != PGRES_COMMAND_OK) {
             fprintf(stderr, "[DAO_ONEVN] end_session error: %s\n", PQerrorMessage(conn));
             PQclear(res);
@@ -95,19 +116,34 @@ int dao_onevn_end_session(int64_t session_id, int64_t winner_id) {
     return 0;
 }
 
+int dao_onevn_queue_end_session(DbBatch *b, int64_t session_id, int64_t winner_id) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    if (winner_id <= 0) {
+        // No winner (aborted)
+        return db_batch_add(b, &STMT_ONEVN_ABORT_SESSION, &params, NULL, NULL);
+    }
+    db_param_int8(&params, winner_id);
+    return db_batch_add(b, &STMT_ONEVN_END_SESSION, &params, NULL, NULL);
+}
+
+static DbStmt STMT_ONEVN_GET_SESSION = {
+    .name = "onevn_get_session",
+    .sql = "SELECT room_id, winner_id, status, players::text "
+           "FROM onevn_sessions WHERE session_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_onevn_get_session(int64_t session_id, int64_t *room_id, int64_t *winner_id, char *status, char *players_json, size_t json_len) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "SELECT room_id, winner_id, status, players::text "
-        "FROM onevn_sessions WHERE session_id = $1;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
 
-    char buf_session[32];
-    snprintf(buf_session, sizeof(buf_session), "%ld", session_id);
-    const char *params[1] = { buf_session };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_GET_SESSION, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_ONEVN] get_session error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -133,44 +169,39 @@ int dao_onevn_get_session(int64_t session_id, int64_t *room_id, int64_t *winner_
     return 0;
 }
 
-int dao_onevn_get_user_history(int64_t user_id, void **json_history) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
-
-    // Query sessions where user has played (based on onevn_player_answers)
-    // Use LEFT JOIN to get player data from JSONB if available, otherwise use player_answers data
-    const char *sql =
-        "SELECT DISTINCT s.session_id, s.room_id, s.winner_id, s.status, "
-        "       s.started_at, s.ended_at, "
-        "       COALESCE((p.player->>'score')::int, a.total_score, 0) as final_score, "
-        "       COALESCE((p.player->>'rank')::int, 0) as final_rank, "
-        "       CASE WHEN s.winner_id = $1 THEN 1 ELSE 0 END as is_winner "
-        "FROM onevn_sessions s "
-        "INNER JOIN ("
-        "    SELECT r.session_id, pa.user_id, SUM(pa.score_gained) as total_score "
-        "    FROM onevn_rounds r "
-        "    INNER JOIN onevn_player_answers pa ON r.round_id = pa.round_id "
-        "    WHERE pa.user_id = $1 "
-        "    GROUP BY r.session_id, pa.user_id"
-        ") a ON s.session_id = a.session_id "
-        "LEFT JOIN LATERAL ("
-        "    SELECT elem as player "
-        "    FROM jsonb_array_elements(s.players) elem "
-        "    WHERE (elem->>'user_id')::bigint = $1 "
-        "    LIMIT 1"
-        ") p ON true "
-        "WHERE s.status = 'FINISHED' "
-        "ORDER BY s.ended_at DESC NULLS LAST, s.started_at DESC "
-        "LIMIT 50;";
-
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+// Sessions where the user has played (based on onevn_player_answers).
+// LEFT JOIN to get player data from JSONB if available, otherwise use player_answers data
+static DbStmt STMT_ONEVN_USER_HISTORY = {
+    .name = "onevn_user_history",
+    .sql = "SELECT DISTINCT s.session_id, s.room_id, s.winner_id, s.status, "
+           "       s.started_at, s.ended_at, "
+           "       COALESCE((p.player->>'score')::int, a.total_score, 0) as final_score, "
+           "       COALESCE((p.player->>'rank')::int, 0) as final_rank, "
+           "       CASE WHEN s.winner_id = $1 THEN 1 ELSE 0 END as is_winner "
+           "FROM onevn_sessions s "
+           "INNER JOIN ("
+           "    SELECT r.session_id, pa.user_id, SUM(pa.score_gained) as total_score "
+           "    FROM onevn_rounds r "
+           "    INNER JOIN onevn_player_answers pa ON r.round_id = pa.round_id "
+           "    WHERE pa.user_id = $1 "
+           "    GROUP BY r.session_id, pa.user_id"
+           ") a ON s.session_id = a.session_id "
+           "LEFT JOIN LATERAL ("
+           "    SELECT elem as player "
+           "    FROM jsonb_array_elements(s.players) elem "
+           "    WHERE (elem->>'user_id')::bigint = $1 "
+           "    LIMIT 1"
+           ") p ON true "
+           "WHERE s.status = 'FINISHED' "
+           "ORDER BY s.ended_at DESC NULLS LAST, s.started_at DESC "
+           "LIMIT 50;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+static int build_user_history_json(PGresult *res, char **json_history) {
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ONEVN] get_user_history error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
+        fprintf(stderr, "[DAO_ONEVN] get_user_history error: %s\n",
+                res ? PQresultErrorMessage(res) : "no result");
         return -1;
     }
 
@@ -178,7 +209,7 @@ int dao_onevn_get_user_history(int64_t user_id, void **json_history) {
     size_t cap = 1024;
     size_t used = 0;
     char *out = malloc(cap);
-    if (!out) { PQclear(res); return -1; }
+    if (!out) return -1;
     out[used++] = '[';
 
     for (int i = 0; i < rows; ++i) {
@@ -210,7 +241,7 @@ int dao_onevn_get_user_history(int64_t user_id, void **json_history) {
         if (used + (size_t)need + 3 >= cap) {
             cap = (used + (size_t)need + 3) * 2;
             char *tmp = realloc(out, cap);
-            if (!tmp) { free(out); free(esc_status); free(esc_started); free(esc_ended); PQclear(res); return -1; }
+            if (!tmp) { free(out); free(esc_status); free(esc_started); free(esc_ended); return -1; }
             out = tmp;
         }
 
@@ -230,33 +261,46 @@ int dao_onevn_get_user_history(int64_t user_id, void **json_history) {
 
     if (used + 2 >= cap) {
         char *tmp = realloc(out, used + 2);
-        if (!tmp) { free(out); PQclear(res); return -1; }
+        if (!tmp) { free(out); return -1; }
         out = tmp;
         cap = used + 2;
     }
     out[used++] = ']';
     out[used] = '\0';
     *json_history = out;
-    PQclear(res);
     return 0;
 }
 
+int dao_onevn_get_user_history(int64_t user_id, void **json_history) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    return db_query_json(&STMT_ONEVN_USER_HISTORY, &params, build_user_history_json, (char **)json_history);
+}
+
+static DbStmt STMT_ONEVN_CREATE_ROUND = {
+    .name = "onevn_create_round",
+    .sql = "INSERT INTO onevn_rounds (session_id, round_number, question_id, difficulty) "
+           "VALUES ($1, $2, $3, $4) "
+           "RETURNING round_id;",
+    .nparams = 4, .types = { DB_TYPE_INT8, DB_TYPE_ANY, DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_onevn_create_round(int64_t session_id, int round_number, int64_t question_id, const char *difficulty, int64_t *out_round_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO onevn_rounds (session_id, round_number, question_id, difficulty) "
-        "VALUES ($1, $2, $3, $4) "
-        "RETURNING round_id;";
-
-    char buf_session[32], buf_round[16], buf_question[32];
-    snprintf(buf_session, sizeof(buf_session), "%ld", session_id);
+    char buf_round[16];
     snprintf(buf_round, sizeof(buf_round), "%d", round_number);
-    snprintf(buf_question, sizeof(buf_question), "%ld", question_id);
-    const char *params[4] = { buf_session, buf_round, buf_question, difficulty };
 
-    PGresult *res = PQexecParams(conn, sql, 4, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    db_param_text(&params, buf_round);
+    db_param_int8(&params, question_id);
+    db_param_text(&params, difficulty);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_CREATE_ROUND, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_ONEVN] create_round error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -273,19 +317,53 @@ int dao_onevn_create_round(int64_t session_id, int round_number, int64_t questio
     return 0;
 }
 
+typedef struct {
+    int64_t session_id;
+    int round_number;
+    int64_t question_id;
+    char difficulty[16];
+} RoundCreateJob;
+
+static void round_create_run(void *arg) {
+    RoundCreateJob *job = arg;
+    int64_t round_id = 0;
+    dao_onevn_create_round(job->session_id, job->round_number, job->question_id,
+                           job->difficulty, &round_id);
+    free(job);
+}
+
+int dao_onevn_create_round_async(int64_t session_id, int round_number, int64_t question_id,
+                                 const char *difficulty) {
+    RoundCreateJob *job = calloc(1, sizeof(RoundCreateJob));
+    if (job) {
+        job->session_id = session_id;
+        job->round_number = round_number;
+        job->question_id = question_id;
+        strncpy(job->difficulty, difficulty, sizeof(job->difficulty) - 1);
+        // Same key as the round writes: the round exists before its answers
+        if (db_pool_submit_keyed(session_id, round_create_run, NULL, job) == 0) return 0;
+        free(job);
+    }
+    int64_t round_id = 0;
+    return dao_onevn_create_round(session_id, round_number, question_id, difficulty, &round_id);
+}
+
+static DbStmt STMT_ONEVN_END_ROUND = {
+    .name = "onevn_end_round",
+    .sql = "UPDATE onevn_rounds SET ended_at = NOW() "
+           "WHERE round_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_onevn_end_round(int64_t round_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE onevn_rounds SET ended_at = NOW() "
-        "WHERE round_id = $1;";
-
-    char buf_round[32];
-    snprintf(buf_round, sizeof(buf_round), "%ld", round_id);
-    const char *params[1] = { buf_round };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, round_id);
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_END_ROUND, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ONEVN] end_round error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -295,66 +373,51 @@ int dao_onevn_end_round(int64_t round_id) {
     return 0;
 }
 
+static DbStmt STMT_ONEVN_END_ROUND_NUMBER = {
+    .name = "onevn_end_round_number",
+    .sql = "UPDATE onevn_rounds SET ended_at = NOW() "
+           "WHERE session_id = $1 AND round_number = $2;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
+static DbStmt STMT_ONEVN_SAVE_ANSWER = {
+    .name = "onevn_save_answer",
+    .sql = "INSERT INTO onevn_player_answers (round_id, user_id, answer, is_correct, score_gained, time_left) "
+           "VALUES ($1, $2, $3, $4, $5, $6) "
+           "ON CONFLICT (round_id, user_id) DO UPDATE SET "
+           "  answer = EXCLUDED.answer, "
+           "  is_correct = EXCLUDED.is_correct, "
+           "  score_gained = EXCLUDED.score_gained, "
+           "  time_left = EXCLUDED.time_left, "
+           "  answered_at = NOW();",
+    .nparams = 6, .types = { DB_TYPE_INT8, DB_TYPE_INT8, DB_TYPE_ANY, DB_TYPE_BOOL, DB_TYPE_ANY, DB_TYPE_ANY }
+};
+
 int dao_onevn_save_player_answer(int64_t round_id, int64_t user_id, char answer, int is_correct, int score_gained, double time_left) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql = "INSERT INTO onevn_player_answers (round_id, user_id, answer, is_correct, score_gained, time_left) "
-                      "VALUES ($1, $2, $3, $4, $5, $6) "
-                      "ON CONFLICT (round_id, user_id) DO UPDATE SET "
-                      "  answer = EXCLUDED.answer, "
-                      "  is_correct = EXCLUDED.is_correct, "
-                      "  score_gained = EXCLUDED.score_gained, "
-                      "  time_left = EXCLUDED.time_left, "
-                      "  answered_at = NOW();";
-
-    char buf_round[32], buf_user[32], buf_answer[2], buf_correct[8], buf_score[16], buf_time[32];
-    snprintf(buf_round, sizeof(buf_round), "%ld", round_id);
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
-    snprintf(buf_correct, sizeof(buf_correct), "%s", is_correct ? "true" : "false");
+    char buf_answer[2], buf_score[16], buf_time[32];
     snprintf(buf_score, sizeof(buf_score), "%d", score_gained);
-    
-    const char *params[6];
-    int paramLengths[6];
-    int paramFormats[6];
-    
-    params[0] = buf_round;
-    params[1] = buf_user;
-    paramLengths[0] = (int)strlen(buf_round);
-    paramLengths[1] = (int)strlen(buf_user);
-    paramFormats[0] = 0;  // text
-    paramFormats[1] = 0;  // text
-    
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, round_id);
+    db_param_int8(&params, user_id);
     if (answer == '\0') {
-        // Timeout case - answer is NULL (use -1 for paramLengths to indicate NULL)
-        params[2] = NULL;
-        params[5] = NULL;  // time_left is NULL
-        paramLengths[2] = -1;  // -1 indicates NULL
-        paramLengths[5] = -1;  // -1 indicates NULL
-        paramFormats[2] = 0;
-        paramFormats[5] = 0;
+        // Timeout case - answer and time_left are NULL
+        db_param_text(&params, NULL);
     } else {
-        // Normal answer
         buf_answer[0] = answer;
         buf_answer[1] = '\0';
-        params[2] = buf_answer;
-        paramLengths[2] = 1;
-        paramFormats[2] = 0;
-        
+        db_param_text(&params, buf_answer);
         snprintf(buf_time, sizeof(buf_time), "%.2f", time_left);
-        params[5] = buf_time;
-        paramLengths[5] = (int)strlen(buf_time);
-        paramFormats[5] = 0;
-    }
-    
-    params[3] = buf_correct;
-    params[4] = buf_score;
-    paramLengths[3] = (int)strlen(buf_correct);
-    paramLengths[4] = (int)strlen(buf_score);
-    paramFormats[3] = 0;
-    paramFormats[4] = 0;
-
-    PGresult *res = PQexecParams(conn, sql, 6, NULL, params, paramLengths, paramFormats, 0);
+    }
+    db_param_bool(&params, is_correct);
+    db_param_text(&params, buf_score);
+    db_param_text(&params, answer == '\0' ? NULL : buf_time);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_ONEVN_SAVE_ANSWER, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ONEVN] save_player_answer error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -364,191 +427,406 @@ int dao_onevn_save_player_answer(int64_t round_id, int64_t user_id, char answer,
     return 0;
 }
 
-int dao_onevn_get_replay_details(int64_t session_id, void **json_replay) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
+// Session, rounds (with their question) and answers in one round trip:
+// one row per answer, or one row per round without answers, or a single
+// row with NULL round columns for a session that has no rounds yet.
+static DbStmt STMT_ONEVN_REPLAY = {
+    .name = "onevn_replay",
+    .sql = "SELECT s.session_id, s.room_id, s.winner_id, s.status, s.players::text, "
+           "       r.round_id, r.round_number, r.difficulty, r.started_at, r.ended_at, "
+           "       r.question_id, r.content, r.\"opA\", r.\"opB\", r.\"opC\", r.\"opD\", r.correct_op, r.explanation, "
+           "       a.user_id, a.answer, a.is_correct::text, a.score_gained, a.time_left, a.answered_at "
+           "FROM onevn_sessions s "
+           "LEFT JOIN ("
+           "    SELECT rr.round_id, rr.session_id, rr.round_number, rr.difficulty, rr.started_at, rr.ended_at, "
+           "           rr.question_id, q.content, q.\"opA\", q.\"opB\", q.\"opC\", q.\"opD\", q.correct_op, q.explanation "
+           "    FROM onevn_rounds rr "
+           "    JOIN question q ON rr.question_id = q.question_id"
+           ") r ON r.session_id = s.session_id "
+           "LEFT JOIN onevn_player_answers a ON a.round_id = r.round_id "
+           "WHERE s.session_id = $1 "
+           "ORDER BY r.round_number ASC, a.answered_at ASC;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+// Append formatted text to a growing buffer. Returns 0 or -1 (out of memory).
+static int replay_appendf(char **out, size_t *used, size_t *cap, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int need = vsnprintf(*out + *used, *cap - *used, fmt, ap);
+    va_end(ap);
+    if (need < 0) return -1;
+
+    if (*used + (size_t)need + 1 > *cap) {
+        size_t new_cap = (*used + (size_t)need + 1) * 2;
+        char *tmp = realloc(*out, new_cap);
+        if (!tmp) return -1;
+        *out = tmp;
+        *cap = new_cap;
+        va_start(ap, fmt);
+        vsnprintf(*out + *used, *cap - *used, fmt, ap);
+        va_end(ap);
+    }
+    *used += (size_t)need;
+    return 0;
+}
+
+// Escaped copy of a column ("" for NULL); never returns NULL unless out of memory
+static char *replay_escape(PGresult *res, int row, int col) {
+    char *esc = util_json_escape(PQgetisnull(res, row, col) ? "" : PQgetvalue(res, row, col));
+    return esc ? esc : strdup("");
+}
+
+static int replay_append_round(PGresult *res, int row, char **out, size_t *used, size_t *cap, int first) {
+    char *esc_difficulty = replay_escape(res, row, 7);
+    char *esc_started = replay_escape(res, row, 8);
+    char *esc_ended = replay_escape(res, row, 9);
+    char *esc_content = replay_escape(res, row, 11);
+    char *esc_opA = replay_escape(res, row, 12);
+    char *esc_opB = replay_escape(res, row, 13);
+    char *esc_opC = replay_escape(res, row, 14);
+    char *esc_opD = replay_escape(res, row, 15);
+    char *esc_correct_op = replay_escape(res, row, 16);
+    char *esc_explanation = replay_escape(res, row, 17);
+
+    int rc = -1;
+    if (esc_difficulty && esc_started && esc_ended && esc_content && esc_opA && esc_opB &&
+        esc_opC && esc_opD && esc_correct_op && esc_explanation) {
+        rc = replay_appendf(out, used, cap,
+            "%s{\"round_id\":%s,\"round_number\":%s,\"difficulty\":\"%s\","
+            "\"question_id\":%s,\"content\":\"%s\",\"opA\":\"%s\",\"opB\":\"%s\",\"opC\":\"%s\",\"opD\":\"%s\","
+            "\"correct_op\":\"%s\",\"explanation\":\"%s\",\"started_at\":\"%s\",\"ended_at\":\"%s\",\"answers\":[",
+            first ? "" : ",", PQgetvalue(res, row, 5), PQgetvalue(res, row, 6), esc_difficulty,
+            PQgetvalue(res, row, 10), esc_content, esc_opA, esc_opB, esc_opC, esc_opD,
+            esc_correct_op, esc_explanation, esc_started, esc_ended);
+    }
+
+    free(esc_difficulty); free(esc_started); free(esc_ended); free(esc_content);
+    free(esc_opA); free(esc_opB); free(esc_opC); free(esc_opD);
+    free(esc_correct_op); free(esc_explanation);
+    return rc;
+}
 
-    // Get session info
-    int64_t room_id = 0, winner_id = 0;
-    char status[32] = {0};
-    char players_json[4096] = {0};
-    if (dao_onevn_get_session(session_id, &room_id, &winner_id, status, players_json, sizeof(players_json)) != 0) {
+static int replay_append_answer(PGresult *res, int row, char **out, size_t *used, size_t *cap, int first) {
+    // NULL answer / time_left means the player timed out
+    char *esc_answer = PQgetisnull(res, row, 19) ? NULL : replay_escape(res, row, 19);
+    char *esc_answered_at = replay_escape(res, row, 23);
+    if (!esc_answered_at) {
+        free(esc_answer);
         return -1;
     }
 
-    // Get rounds with questions and answers
-    const char *sql =
-        "SELECT r.round_id, r.round_number, r.difficulty, r.started_at, r.ended_at, "
-        "       r.question_id, q.content, q.\"opA\", q.\"opB\", q.\"opC\", q.\"opD\", q.correct_op, q.explanation "
-        "FROM onevn_rounds r "
-        "JOIN question q ON r.question_id = q.question_id "
-        "WHERE r.session_id = $1 "
-        "ORDER BY r.round_number ASC;";
+    char answer_json[16];
+    if (esc_answer && esc_answer[0] != '\0') {
+        snprintf(answer_json, sizeof(answer_json), "\"%.8s\"", esc_answer);
+    } else {
+        snprintf(answer_json, sizeof(answer_json), "null");
+    }
 
-    char buf_session[32];
-    snprintf(buf_session, sizeof(buf_session), "%ld", session_id);
-    const char *params[1] = { buf_session };
+    int rc = replay_appendf(out, used, cap,
+        "%s{\"user_id\":%s,\"answer\":%s,\"is_correct\":%s,\"score_gained\":%s,\"time_left\":%s,\"answered_at\":\"%s\"}",
+        first ? "" : ",", PQgetvalue(res, row, 18), answer_json,
+        PQgetisnull(res, row, 20) ? "false" : PQgetvalue(res, row, 20),
+        PQgetisnull(res, row, 21) ? "0" : PQgetvalue(res, row, 21),
+        PQgetisnull(res, row, 22) ? "null" : PQgetvalue(res, row, 22),
+        esc_answered_at);
+
+    free(esc_answer);
+    free(esc_answered_at);
+    return rc;
+}
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static int build_replay_json(PGresult *res, char **json_replay) {
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ONEVN] get_replay_details error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
+        fprintf(stderr, "[DAO_ONEVN] get_replay_details error: %s\n",
+                res ? PQresultErrorMessage(res) : "no result");
+        return -1;
+    }
+
+    int rows = PQntuples(res);
+    if (rows == 0) {
+        // Unknown session
         return -1;
     }
 
-    int round_rows = PQntuples(res);
     size_t cap = 4096;
     size_t used = 0;
     char *out = malloc(cap);
-    if (!out) { PQclear(res); return -1; }
+    if (!out) return -1;
+    out[0] = '\0';
+
+    // Session columns repeat on every row
+    char *esc_status = replay_escape(res, 0, 3);
+    const char *winner_id = PQgetvalue(res, 0, 2);
+    int rc = esc_status ? 0 : -1;
+    if (rc == 0) {
+        rc = replay_appendf(&out, &used, &cap,
+            "{\"session_id\":%s,\"room_id\":%s,\"winner_id\":%s,\"status\":\"%s\","
+            "\"players\":%s,\"rounds\":[",
+            PQgetvalue(res, 0, 0), PQgetvalue(res, 0, 1),
+            (!PQgetisnull(res, 0, 2) && winner_id[0] != '\0' && strcmp(winner_id, "0") != 0) ? winner_id : "null",
+            esc_status, PQgetisnull(res, 0, 4) ? "[]" : PQgetvalue(res, 0, 4));
+    }
+    free(esc_status);
+
+    // Rows arrive ordered by round, then answer time: open a round object
+    // whenever round_id changes and close it before the next one
+    const char *current_round = NULL;
+    int rounds = 0, answers = 0;
+    for (int i = 0; rc == 0 && i < rows; ++i) {
+        if (PQgetisnull(res, i, 5)) continue;  // session without rounds
+        const char *round_id = PQgetvalue(res, i, 5);
+        if (!current_round || strcmp(current_round, round_id) != 0) {
+            if (current_round) rc = replay_appendf(&out, &used, &cap, "]}");
+            if (rc == 0) rc = replay_append_round(res, i, &out, &used, &cap, rounds == 0);
+            current_round = round_id;
+            rounds++;
+            answers = 0;
+        }
+        if (rc == 0 && !PQgetisnull(res, i, 18)) {
+            rc = replay_append_answer(res, i, &out, &used, &cap, answers == 0);
+            answers++;
+        }
+    }
+    if (rc == 0 && current_round) rc = replay_appendf(&out, &used, &cap, "]}");
+    if (rc == 0) rc = replay_appendf(&out, &used, &cap, "]}");
 
-    // Start JSON object
-    char buf_winner[32];
-    if (winner_id > 0) {
-        snprintf(buf_winner, sizeof(buf_winner), "%ld", winner_id);
-    }
-    used += snprintf(out + used, cap - used,
-        "{\"session_id\":%ld,\"room_id\":%ld,\"winner_id\":%s,\"status\":\"%s\","
-        "\"players\":%s,\"rounds\":[",
-        session_id, room_id, winner_id > 0 ? buf_winner : "null", status, players_json);
-
-    for (int i = 0; i < round_rows; ++i) {
-        const char *round_id = PQgetvalue(res, i, 0);
-        const char *round_number = PQgetvalue(res, i, 1);
-        const char *difficulty = PQgetvalue(res, i, 2);
-        const char *started_at = PQgetvalue(res, i, 3);
-        const char *ended_at = PQgetvalue(res, i, 4);
-        const char *question_id = PQgetvalue(res, i, 5);
-        const char *content = PQgetvalue(res, i, 6);
-        const char *opA = PQgetvalue(res, i, 7);
-        const char *opB = PQgetvalue(res, i, 8);
-        const char *opC = PQgetvalue(res, i, 9);
-        const char *opD = PQgetvalue(res, i, 10);
-        const char *correct_op = PQgetvalue(res, i, 11);
-        const char *explanation = PQgetvalue(res, i, 12);
-
-        // Escape strings
-        char *esc_difficulty = util_json_escape(difficulty ? difficulty : "");
-        char *esc_content = util_json_escape(content ? content : "");
-        char *esc_opA = util_json_escape(opA ? opA : "");
-        char *esc_opB = util_json_escape(opB ? opB : "");
-        char *esc_opC = util_json_escape(opC ? opC : "");
-        char *esc_opD = util_json_escape(opD ? opD : "");
-        char *esc_correct_op = util_json_escape(correct_op ? correct_op : "");
-        char *esc_explanation = util_json_escape(explanation ? explanation : "");
-        char *esc_started = util_json_escape(started_at ? started_at : "");
-        char *esc_ended = util_json_escape(ended_at ? ended_at : "");
+    if (rc != 0) {
+        free(out);
+        return -1;
+    }
+    *json_replay = out;
+    return 0;
+}
+
+int dao_onevn_get_replay_details(int64_t session_id, void **json_replay) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    return db_query_json(&STMT_ONEVN_REPLAY, &params, build_replay_json, (char **)json_replay);
+}
+
+// A round's answers in one INSERT: each column arrives as an array literal
+// and unnest() turns them back into rows. The round is found by its number,
+// so the writer never waits for the round_id of the INSERT that created it.
+static DbStmt STMT_ONEVN_SAVE_ANSWERS = {
+    .name = "onevn_save_answers",
+    .sql = "INSERT INTO onevn_player_answers "
+           "    (round_id, user_id, answer, is_correct, score_gained, time_left, answered_at) "
+           "SELECT r.round_id, a.user_id, a.answer, a.is_correct, a.score_gained, a.time_left, "
+           "       to_timestamp(a.answered_at) "
+           "FROM onevn_rounds r, "
+           "     unnest($3::bigint[], $4::text[], $5::boolean[], $6::int[], $7::float8[], $8::float8[]) "
+           "     AS a(user_id, answer, is_correct, score_gained, time_left, answered_at) "
+           "WHERE r.session_id = $1 AND r.round_number = $2 "
+           "ON CONFLICT (round_id, user_id) DO UPDATE SET "
+           "  answer = EXCLUDED.answer, "
+           "  is_correct = EXCLUDED.is_correct, "
+           "  score_gained = EXCLUDED.score_gained, "
+           "  time_left = EXCLUDED.time_left, "
+           "  answered_at = EXCLUDED.answered_at;",
+    .nparams = 8, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
+enum { ANS_USER, ANS_ANSWER, ANS_CORRECT, ANS_SCORE, ANS_TIME, ANS_AT, ANS_COLS };
+
+// Array literals ("{...}") for each column of answers
+static int build_answer_arrays(const OneVNAnswer *answers, int count, char *cols[ANS_COLS]) {
+    size_t used[ANS_COLS] = {0}, cap[ANS_COLS];
+    int rc = 0;
+    for (int c = 0; c < ANS_COLS; c++) {
+        cap[c] = 64;
+        cols[c] = malloc(cap[c]);
+        if (!cols[c]) rc = -1;
+    }
+    for (int c = 0; c < ANS_COLS && rc == 0; c++) {
+        rc = replay_appendf(&cols[c], &used[c], &cap[c], "{");
+    }
 
-        // Get answers for this round
-        const char *sql_answers =
-            "SELECT user_id, answer, is_correct, score_gained, time_left, answered_at "
-            "FROM onevn_player_answers "
-            "WHERE round_id = $1 "
-            "ORDER BY answered_at ASC;";
-
-        char buf_round[32];
-        snprintf(buf_round, sizeof(buf_round), "%s", round_id);
-        const char *params_answers[1] = { buf_round };
-        PGresult *res_answers = PQexecParams(conn, sql_answers, 1, NULL, params_answers, NULL, NULL, 0);
-
-        size_t answers_json_cap = 512;
-        size_t answers_json_used = 0;
-        char *answers_json = malloc(answers_json_cap);
-        if (!answers_json) answers_json_used = 0;
-        else answers_json[answers_json_used++] = '[';
-
-        if (res_answers && PQresultStatus(res_answers) == PGRES_TUPLES_OK) {
-            int answer_rows = PQntuples(res_answers);
-            for (int j = 0; j < answer_rows; ++j) {
-                const char *user_id = PQgetvalue(res_answers, j, 0);
-                const char *answer = PQgetvalue(res_answers, j, 1);
-                const char *is_correct = PQgetvalue(res_answers, j, 2);
-                const char *score_gained = PQgetvalue(res_answers, j, 3);
-                const char *time_left = PQgetvalue(res_answers, j, 4);
-                const char *answered_at = PQgetvalue(res_answers, j, 5);
-
-                // Handle NULL answer (timeout)
-                const char *answer_val = answer && strlen(answer) > 0 ? answer : "";
-                char *esc_answer = answer_val[0] != '\0' ? util_json_escape(answer_val) : strdup("\"\"");
-                char *esc_answered_at = util_json_escape(answered_at ? answered_at : "");
-                const char *answer_json = answer_val[0] != '\0' ? esc_answer : "null";
-                const char *time_left_val = time_left && strlen(time_left) > 0 ? time_left : "null";
-
-                int need_ans = snprintf(NULL, 0,
-                    "{\"user_id\":%s,\"answer\":%s,\"is_correct\":%s,\"score_gained\":%s,\"time_left\":%s,\"answered_at\":\"%s\"}",
-                    user_id, answer_json, is_correct, score_gained ? score_gained : "0", time_left_val, esc_answered_at);
-
-                if (answers_json_used + (size_t)need_ans + 3 >= answers_json_cap) {
-                    answers_json_cap = (answers_json_used + (size_t)need_ans + 3) * 2;
-                    char *tmp = realloc(answers_json, answers_json_cap);
-                    if (!tmp) { free(answers_json); free(esc_answer); free(esc_answered_at); answers_json = NULL; break; }
-                    answers_json = tmp;
-                }
-
-                if (j > 0) answers_json[answers_json_used++] = ',';
-                answers_json_used += snprintf(answers_json + answers_json_used, answers_json_cap - answers_json_used,
-                    "{\"user_id\":%s,\"answer\":%s,\"is_correct\":%s,\"score_gained\":%s,\"time_left\":%s,\"answered_at\":\"%s\"}",
-                    user_id, answer_json, is_correct, score_gained ? score_gained : "0", time_left_val, esc_answered_at);
-
-                free(esc_answer);
-                free(esc_answered_at);
-            }
+    for (int i = 0; i < count && rc == 0; i++) {
+        const OneVNAnswer *a = &answers[i];
+        const char *sep = i > 0 ? "," : "";
+        // Only printable ASCII goes into the literal; " and \ are escaped
+        int timeout = a->answer < 0x20 || a->answer > 0x7E;
+        const char *esc = a->answer == '"' || a->answer == '\\' ? "\\" : "";
+        if (replay_appendf(&cols[ANS_USER], &used[ANS_USER], &cap[ANS_USER], "%s%lld", sep, (long long)a->user_id) != 0 ||
+            (timeout ? replay_appendf(&cols[ANS_ANSWER], &used[ANS_ANSWER], &cap[ANS_ANSWER], "%sNULL", sep)
+                     : replay_appendf(&cols[ANS_ANSWER], &used[ANS_ANSWER], &cap[ANS_ANSWER], "%s\"%s%c\"", sep, esc, a->answer)) != 0 ||
+            replay_appendf(&cols[ANS_CORRECT], &used[ANS_CORRECT], &cap[ANS_CORRECT], "%s%s", sep, a->is_correct ? "t" : "f") != 0 ||
+            replay_appendf(&cols[ANS_SCORE], &used[ANS_SCORE], &cap[ANS_SCORE], "%s%d", sep, a->score_gained) != 0 ||
+            (timeout ? replay_appendf(&cols[ANS_TIME], &used[ANS_TIME], &cap[ANS_TIME], "%sNULL", sep)
+                     : replay_appendf(&cols[ANS_TIME], &used[ANS_TIME], &cap[ANS_TIME], "%s%.2f", sep, a->time_left)) != 0 ||
+            replay_appendf(&cols[ANS_AT], &used[ANS_AT], &cap[ANS_AT], "%s%.3f", sep, a->answered_at) != 0) {
+            rc = -1;
         }
-        if (res_answers) PQclear(res_answers);
-        if (answers_json) {
-            if (answers_json_used + 2 >= answers_json_cap) {
-                char *tmp = realloc(answers_json, answers_json_used + 2);
-                if (tmp) { answers_json = tmp; answers_json_cap = answers_json_used + 2; }
-            }
-            answers_json[answers_json_used++] = ']';
-            answers_json[answers_json_used] = '\0';
-        } else {
-            answers_json = strdup("[]");
+    }
+
+    for (int c = 0; c < ANS_COLS && rc == 0; c++) {
+        rc = replay_appendf(&cols[c], &used[c], &cap[c], "}");
+    }
+    if (rc != 0) {
+        for (int c = 0; c < ANS_COLS; c++) {
+            free(cols[c]);
+            cols[c] = NULL;
         }
+    }
+    return rc;
+}
 
-        int need = snprintf(NULL, 0,
-            "{\"round_id\":%s,\"round_number\":%s,\"difficulty\":\"%s\","
-            "\"question_id\":%s,\"content\":\"%s\",\"opA\":\"%s\",\"opB\":\"%s\",\"opC\":\"%s\",\"opD\":\"%s\","
-            "\"correct_op\":\"%s\",\"explanation\":\"%s\",\"started_at\":\"%s\",\"ended_at\":\"%s\",\"answers\":%s}",
-            round_id, round_number, esc_difficulty, question_id, esc_content,
-            esc_opA, esc_opB, esc_opC, esc_opD, esc_correct_op, esc_explanation,
-            esc_started, esc_ended, answers_json);
+int dao_onevn_queue_save_answers(DbBatch *b, int64_t session_id, int round_number,
+                                 const OneVNAnswer *answers, int count) {
+    if (count <= 0) return 0;
 
-        if (used + (size_t)need + 3 >= cap) {
-            cap = (used + (size_t)need + 3) * 2;
-            char *tmp = realloc(out, cap);
-            if (!tmp) {
-                free(out); free(esc_difficulty); free(esc_content); free(esc_opA); free(esc_opB);
-                free(esc_opC); free(esc_opD); free(esc_correct_op); free(esc_explanation);
-                free(esc_started); free(esc_ended); free(answers_json); PQclear(res); return -1;
-            }
-            out = tmp;
+    char *cols[ANS_COLS];
+    if (build_answer_arrays(answers, count, cols) != 0) {
+        fprintf(stderr, "[DAO_ONEVN] save_answers: out of memory\n");
+        b->failed = 1;
+        return -1;
+    }
+
+    char buf_round[16];
+    snprintf(buf_round, sizeof(buf_round), "%d", round_number);
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    db_param_text(&params, buf_round);
+    for (int c = 0; c < ANS_COLS; c++) db_param_text(&params, cols[c]);
+
+    // libpq copies the parameters when the statement is queued
+    int rc = db_batch_add(b, &STMT_ONEVN_SAVE_ANSWERS, &params, NULL, NULL);
+    for (int c = 0; c < ANS_COLS; c++) free(cols[c]);
+    return rc;
+}
+
+int dao_onevn_queue_end_round(DbBatch *b, int64_t session_id, int round_number) {
+    char buf_round[16];
+    snprintf(buf_round, sizeof(buf_round), "%d", round_number);
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    db_param_text(&params, buf_round);
+    return db_batch_add(b, &STMT_ONEVN_END_ROUND_NUMBER, &params, NULL, NULL);
+}
+
+int dao_onevn_queue_update_players(DbBatch *b, int64_t session_id, const char *players_json) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, session_id);
+    db_param_text(&params, players_json);
+    return db_batch_add(b, &STMT_ONEVN_UPDATE_PLAYERS, &params, NULL, NULL);
+}
+
+int dao_onevn_save_round(int64_t session_id, int round_number, const OneVNAnswer *answers,
+                         int count, const char *players_json) {
+    DbBatch batch;
+    if (db_batch_begin(&batch) == 0) {
+        if (round_number > 0) {
+            dao_onevn_queue_save_answers(&batch, session_id, round_number, answers, count);
+            dao_onevn_queue_end_round(&batch, session_id, round_number);
         }
+        if (players_json) dao_onevn_queue_update_players(&batch, session_id, players_json);
+    }
+    if (db_batch_run(&batch) != 0) {
+        fprintf(stderr, "[DAO_ONEVN] save_round error: session %lld round %d\n",
+                (long long)session_id, round_number);
+        return -1;
+    }
+    return 0;
+}
 
-        if (i > 0) out[used++] = ',';
-        used += snprintf(out + used, cap - used,
-            "{\"round_id\":%s,\"round_number\":%s,\"difficulty\":\"%s\","
-            "\"question_id\":%s,\"content\":\"%s\",\"opA\":\"%s\",\"opB\":\"%s\",\"opC\":\"%s\",\"opD\":\"%s\","
-            "\"correct_op\":\"%s\",\"explanation\":\"%s\",\"started_at\":\"%s\",\"ended_at\":\"%s\",\"answers\":%s}",
-            round_id, round_number, esc_difficulty, question_id, esc_content,
-            esc_opA, esc_opB, esc_opC, esc_opD, esc_correct_op, esc_explanation,
-            esc_started, esc_ended, answers_json);
+typedef struct {
+    int64_t session_id;
+    int round_number;
+    OneVNAnswer *answers;
+    int count;
+    char *players_json;
+} RoundWriteJob;
+
+static void round_write_run(void *arg) {
+    RoundWriteJob *job = arg;
+    dao_onevn_save_round(job->session_id, job->round_number, job->answers, job->count,
+                         job->players_json);
+    free(job->answers);
+    free(job->players_json);
+    free(job);
+}
 
-        free(esc_difficulty); free(esc_content); free(esc_opA); free(esc_opB);
-        free(esc_opC); free(esc_opD); free(esc_correct_op); free(esc_explanation);
-        free(esc_started); free(esc_ended); free(answers_json);
+int dao_onevn_save_round_async(int64_t session_id, int round_number, const OneVNAnswer *answers,
+                               int count, const char *players_json) {
+    RoundWriteJob *job = calloc(1, sizeof(RoundWriteJob));
+    if (!job) goto sync;
+    job->session_id = session_id;
+    job->round_number = round_number;
+    job->count = count;
+    if (count > 0) {
+        job->answers = malloc((size_t)count * sizeof(OneVNAnswer));
+        if (!job->answers) goto sync;
+        memcpy(job->answers, answers, (size_t)count * sizeof(OneVNAnswer));
+    }
+    if (players_json) {
+        job->players_json = strdup(players_json);
+        if (!job->players_json) goto sync;
     }
+    // One session's rounds are written in order: a late round N must not
+    // put older players back after round N+1
+    if (db_pool_submit_keyed(session_id, round_write_run, NULL, job) == 0) return 0;
+
+sync:
+    if (job) {
+        free(job->answers);
+        free(job->players_json);
+        free(job);
+    }
+    return dao_onevn_save_round(session_id, round_number, answers, count, players_json);
+}
 
-    if (used + 3 >= cap) {
-        char *tmp = realloc(out, used + 3);
-        if (!tmp) { free(out); PQclear(res); return -1; }
-        out = tmp;
-        cap = used + 3;
+int dao_onevn_finish_session(int64_t session_id, int64_t room_id, int64_t winner_id,
+                             const char *players_json) {
+    DbBatch batch;
+    if (db_batch_begin(&batch) == 0) {
+        if (players_json) dao_onevn_queue_update_players(&batch, session_id, players_json);
+        dao_onevn_queue_end_session(&batch, session_id, winner_id);
+        dao_rooms_queue_update_status(&batch, room_id, ROOM_STATUS_FINISHED);
+    }
+    if (db_batch_run(&batch) != 0) {
+        fprintf(stderr, "[DAO_ONEVN] finish_session error: session %lld\n", (long long)session_id);
+        return -1;
     }
-    out[used++] = ']';
-    out[used++] = '}';
-    out[used] = '\0';
-    *json_replay = out;
-    PQclear(res);
     return 0;
 }
+
+typedef struct {
+    int64_t session_id;
+    int64_t room_id;
+    int64_t winner_id;
+    char *players_json;
+} SessionFinishJob;
+
+static void session_finish_run(void *arg) {
+    SessionFinishJob *job = arg;
+    dao_onevn_finish_session(job->session_id, job->room_id, job->winner_id, job->players_json);
+    free(job->players_json);
+    free(job);
+}
+
+int dao_onevn_finish_session_async(int64_t session_id, int64_t room_id, int64_t winner_id,
+                                   const char *players_json) {
+    SessionFinishJob *job = calloc(1, sizeof(SessionFinishJob));
+    if (job) {
+        job->session_id = session_id;
+        job->room_id = room_id;
+        job->winner_id = winner_id;
+        job->players_json = players_json ? strdup(players_json) : NULL;
+        // Queued behind the session's round writes, so the last round lands
+        // before the session is closed
+        if ((!players_json || job->players_json) &&
+            db_pool_submit_keyed(session_id, session_finish_run, NULL, job) == 0) {
+            return 0;
+        }
+        free(job->players_json);
+        free(job);
+    }
+    return dao_onevn_finish_session(session_id, room_id, winner_id, players_json);
+}
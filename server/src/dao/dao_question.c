@@ -3,53 +3,70 @@
 #include <string.h>
 #include <stdlib.h>
 #include "db.h"
+#include "db_stmt.h"
 #include "dao/dao_question.h"
 
-int dao_question_get_random(const char *difficulty, Question *out_q) {
-    if (!db_is_ok()) return -1;
-
-    const char *sql =
-        "SELECT question_id, difficulty_level, content, "
-        "       \"opA\", \"opB\", \"opC\", \"opD\", correct_op "
-        "FROM question "
-        "WHERE difficulty_level = $1 "
-        "ORDER BY random() LIMIT 1;";
-
-    const char *params[1] = { difficulty };
-    int paramLengths[1]   = { (int)strlen(difficulty) };
-    int paramFormats[1]   = { 0 };
-
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 1,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0);
+static DbStmt STMT_QUESTION_LOAD_ALL = {
+    .name = "question_load_all",
+    .sql = "SELECT question_id, difficulty_level, content, "
+           "       \"opA\", \"opB\", \"opC\", \"opD\", correct_op "
+           "FROM question;",
+    .nparams = 0
+};
 
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        db_log_error(res, "dao_question_get_random failed");
-        return -1;
+static DbStmt STMT_QUESTION_GET_BY_ID = {
+    .name = "question_get_by_id",
+    .sql = "SELECT question_id, difficulty_level, content, "
+           "       \"opA\", \"opB\", \"opC\", \"opD\", correct_op "
+           "FROM question WHERE question_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+// Hand each row of res to fn
+static int question_rows(PGresult *res, dao_question_fn fn, void *arg) {
+    int rc = 0;
+    int rows = PQntuples(res);
+    for (int i = 0; i < rows && rc == 0; i++) {
+        Question q;
+        memset(&q, 0, sizeof(q));
+        q.question_id = atoll(PQgetvalue(res, i, 0));
+        strncpy(q.difficulty, PQgetvalue(res, i, 1), sizeof(q.difficulty) - 1);
+        q.content = PQgetvalue(res, i, 2);
+        q.op_a = PQgetvalue(res, i, 3);
+        q.op_b = PQgetvalue(res, i, 4);
+        q.op_c = PQgetvalue(res, i, 5);
+        q.op_d = PQgetvalue(res, i, 6);
+        strncpy(q.correct_op, PQgetvalue(res, i, 7), 1);
+        rc = fn(&q, arg);
     }
+    return rc;
+}
+
+// Runs on db_get_conn(): the caller's thread may have its own connection
+static int question_query(DbStmt *stmt, const DbParams *params, const char *what,
+                          dao_question_fn fn, void *arg) {
+    PGconn *conn = db_get_conn();
+    if (!conn || PQstatus(conn) != CONNECTION_OK || !fn) return -1;
 
-    if (PQntuples(res) == 0) {
+    PGresult *res = db_exec_stmt(conn, stmt, params);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "[DAO_QUESTION] %s error: %s\n", what, PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
 
-    if (out_q) {
-        memset(out_q, 0, sizeof(*out_q));
-        out_q->question_id = atoll(PQgetvalue(res, 0, 0));
-        strncpy(out_q->difficulty, PQgetvalue(res, 0, 1), 15);
-        strncpy(out_q->content, PQgetvalue(res, 0, 2), 1023);
-        strncpy(out_q->op_a, PQgetvalue(res, 0, 3), 511);
-        strncpy(out_q->op_b, PQgetvalue(res, 0, 4), 511);
-        strncpy(out_q->op_c, PQgetvalue(res, 0, 5), 511);
-        strncpy(out_q->op_d, PQgetvalue(res, 0, 6), 511);
-        strncpy(out_q->correct_op, PQgetvalue(res, 0, 7), 1);
-    }
-
+    int rc = question_rows(res, fn, arg);
     PQclear(res);
-    return 0;
+    return rc;
+}
+
+int dao_question_load_all(dao_question_fn fn, void *arg) {
+    return question_query(&STMT_QUESTION_LOAD_ALL, NULL, "load_all", fn, arg);
+}
+
+int dao_question_get_by_id(int64_t question_id, dao_question_fn fn, void *arg) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, question_id);
+    return question_query(&STMT_QUESTION_GET_BY_ID, &params, "get_by_id", fn, arg);
 }
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <libpq-fe.h>
 #include "db.h"
+#include "db_batch.h"
+#include "db_stmt.h"
 #include "utils/json.h"
 #include "dao/dao_rooms.h"
 
@@ -22,22 +24,25 @@ int dao_rooms_create(int64_t owner_id, int64_t *out_room_id) {
     return dao_rooms_create_with_config(owner_id, 5, 5, 5, out_room_id);
 }
 
+static DbStmt STMT_ROOMS_JOIN = {
+    .name = "rooms_join",
+    .sql = "INSERT INTO room_members (room_id, user_id) "
+           "VALUES ($1, $2) "
+           "ON CONFLICT (room_id, user_id) DO NOTHING;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_rooms_join(int64_t room_id, int64_t user_id, int is_owner) {
     (void)is_owner;  // Unused parameter (kept for compatibility)
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
-    const char *sql =
-        "INSERT INTO room_members (room_id, user_id) "
-        "VALUES ($1, $2) "
-        "ON CONFLICT (room_id, user_id) DO NOTHING;";
-
-    char buf_room[32], buf_user[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
 
-    const char *params[2] = { buf_room, buf_user };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_int8(&params, user_id);
 
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_JOIN, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ROOMS] join error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -47,19 +52,22 @@ int dao_rooms_join(int64_t room_id, int64_t user_id, int is_owner) {
     return 0;
 }
 
+static DbStmt STMT_ROOMS_LEAVE = {
+    .name = "rooms_leave",
+    .sql = "DELETE FROM room_members WHERE room_id=$1 AND user_id=$2;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_rooms_leave(int64_t room_id, int64_t user_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql = "DELETE FROM room_members WHERE room_id=$1 AND user_id=$2;";
-
-    char buf_room[32], buf_user[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_int8(&params, user_id);
 
-    const char *params[2] = { buf_room, buf_user };
-
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_LEAVE, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ROOMS] leave error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -69,61 +77,68 @@ int dao_rooms_leave(int64_t room_id, int64_t user_id) {
     return 0;
 }
 
-int dao_rooms_delete(int64_t room_id) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
+int dao_rooms_queue_leave(DbBatch *b, int64_t room_id, int64_t user_id) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_int8(&params, user_id);
+    return db_batch_add(b, &STMT_ROOMS_LEAVE, &params, NULL, NULL);
+}
 
-    // Delete members first (due to FK constraint)
-    const char *sql1 = "DELETE FROM room_members WHERE room_id = $1;";
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
+static DbStmt STMT_ROOMS_DELETE_MEMBERS = {
+    .name = "rooms_delete_members",
+    .sql = "DELETE FROM room_members WHERE room_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
 
-    PGresult *res1 = PQexecParams(conn, sql1, 1, NULL, params, NULL, NULL, 0);
-    if (PQresultStatus(res1) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "[DAO_ROOMS] delete members error: %s\n", PQerrorMessage(conn));
-        PQclear(res1);
-        return -1;
-    }
-    PQclear(res1);
-
-    // Then delete room
-    const char *sql2 = "DELETE FROM room WHERE room_id = $1;";
-    PGresult *res2 = PQexecParams(conn, sql2, 1, NULL, params, NULL, NULL, 0);
-    if (PQresultStatus(res2) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "[DAO_ROOMS] delete room error: %s\n", PQerrorMessage(conn));
-        PQclear(res2);
+static DbStmt STMT_ROOMS_DELETE = {
+    .name = "rooms_delete",
+    .sql = "DELETE FROM room WHERE room_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+int dao_rooms_delete(int64_t room_id) {
+    DbBatch batch;
+    if (db_batch_begin(&batch) != 0) return -1;
+    dao_rooms_queue_delete(&batch, room_id);
+    if (db_batch_run(&batch) != 0) {
+        fprintf(stderr, "[DAO_ROOMS] delete error for room %ld\n", room_id);
         return -1;
     }
-    PQclear(res2);
     return 0;
 }
 
-int dao_rooms_get_members(int64_t room_id, void **result_json) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
-
-    const char *sql =
-        "SELECT rm.user_id, u.username, COALESCE(rm.eliminated, false) as eliminated "
-        "FROM room_members rm JOIN users u ON u.user_id = rm.user_id "
-        "WHERE rm.room_id = $1 "
-        "ORDER BY rm.user_id;";
+int dao_rooms_queue_delete(DbBatch *b, int64_t room_id) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
 
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
+    // Members first (FK constraint); both statements share one round trip
+    // and one transaction
+    if (db_batch_add(b, &STMT_ROOMS_DELETE_MEMBERS, &params, NULL, NULL) != 0) return -1;
+    return db_batch_add(b, &STMT_ROOMS_DELETE, &params, NULL, NULL);
+}
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static DbStmt STMT_ROOMS_GET_MEMBERS = {
+    .name = "rooms_get_members",
+    .sql = "SELECT rm.user_id, u.username, COALESCE(rm.eliminated, false) as eliminated "
+           "FROM room_members rm JOIN users u ON u.user_id = rm.user_id "
+           "WHERE rm.room_id = $1 "
+           "ORDER BY rm.user_id;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+static int rooms_members_done(PGresult *res, void *arg) {
+    void **result_json = arg;
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ROOMS] get_members error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
+        fprintf(stderr, "[DAO_ROOMS] get_members error: %s\n", PQresultErrorMessage(res));
         return -1;
     }
 
     int rows = PQntuples(res);
     size_t cap = 256; size_t used = 0;
     char *out = malloc(cap);
-    if (!out) { PQclear(res); return -1; }
+    if (!out) return -1;
     out[used++] = '[';
 
     for (int i = 0; i < rows; ++i) {
@@ -140,7 +155,7 @@ int dao_rooms_get_members(int64_t room_id, void **result_json) {
         if (used + (size_t)need + 3 >= cap) {
             cap = (used + (size_t)need + 3) * 2;
             char *tmp = realloc(out, cap);
-            if (!tmp) { free(out); free(esc); PQclear(res); return -1; }
+            if (!tmp) { free(out); free(esc); return -1; }
             out = tmp;
         }
 
@@ -152,27 +167,52 @@ int dao_rooms_get_members(int64_t room_id, void **result_json) {
 
     if (used + 2 >= cap) {
         char *tmp = realloc(out, used + 2);
-        if (!tmp) { free(out); PQclear(res); return -1; }
+        if (!tmp) { free(out); return -1; }
         out = tmp; cap = used + 2;
     }
     out[used++] = ']'; out[used] = '\0';
 
     *result_json = out;
-    PQclear(res);
     return 0;
 }
 
-int dao_rooms_update_status(int64_t room_id, room_status_t status) {
+int dao_rooms_get_members(int64_t room_id, void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql = "UPDATE room SET status = $2 WHERE room_id = $1;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
 
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[2] = { buf_room, room_status_to_str(status) };
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_GET_MEMBERS, &params);
+    int rc = rooms_members_done(res, result_json);
+    PQclear(res);
+    return rc;
+}
+
+int dao_rooms_queue_get_members(DbBatch *b, int64_t room_id, void **result_json) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    return db_batch_add(b, &STMT_ROOMS_GET_MEMBERS, &params, rooms_members_done, result_json);
+}
+
+static DbStmt STMT_ROOMS_UPDATE_STATUS = {
+    .name = "rooms_update_status",
+    .sql = "UPDATE room SET status = $2 WHERE room_id = $1;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
 
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+int dao_rooms_update_status(int64_t room_id, room_status_t status) {
+    PGconn *conn = db_get_conn();
+    if (!conn) return -1;
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_text(&params, room_status_to_str(status));
+
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_UPDATE_STATUS, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ROOMS] update_status error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -182,27 +222,27 @@ int dao_rooms_update_status(int64_t room_id, room_status_t status) {
     return 0;
 }
 
-int dao_rooms_get_status(int64_t room_id, room_status_t *status) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
-
-    const char *sql = "SELECT status FROM room WHERE room_id = $1;";
+int dao_rooms_queue_update_status(DbBatch *b, int64_t room_id, room_status_t status) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_text(&params, room_status_to_str(status));
+    return db_batch_add(b, &STMT_ROOMS_UPDATE_STATUS, &params, NULL, NULL);
+}
 
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
+static DbStmt STMT_ROOMS_GET_STATUS = {
+    .name = "rooms_get_status",
+    .sql = "SELECT status FROM room WHERE room_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static int rooms_status_done(PGresult *res, void *arg) {
+    room_status_t *status = arg;
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ROOMS] get_status error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
-        return -1;
-    }
-
-    if (PQntuples(res) == 0) {
-        PQclear(res);
+        fprintf(stderr, "[DAO_ROOMS] get_status error: %s\n", PQresultErrorMessage(res));
         return -1;
     }
+    if (PQntuples(res) == 0) return -1;
 
     const char *status_str = PQgetvalue(res, 0, 0);
     if (strcmp(status_str, "WAITING") == 0) {
@@ -217,59 +257,100 @@ int dao_rooms_get_status(int64_t room_id, room_status_t *status) {
         *status = ROOM_STATUS_WAITING;  // default
     }
 
-    PQclear(res);
     return 0;
 }
 
-int dao_rooms_create_with_config(int64_t owner_id, int easy_count, int medium_count, int hard_count, int64_t *out_room_id) {
+int dao_rooms_get_status(int64_t room_id, room_status_t *status) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "INSERT INTO room (owner_id, status, easy_count, medium_count, hard_count) "
-        "VALUES ($1, 'WAITING', $2, $3, $4) RETURNING room_id;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
 
-    char buf_owner[32], buf_easy[32], buf_medium[32], buf_hard[32];
-    snprintf(buf_owner, sizeof(buf_owner), "%ld", owner_id);
-    snprintf(buf_easy, sizeof(buf_easy), "%d", easy_count);
-    snprintf(buf_medium, sizeof(buf_medium), "%d", medium_count);
-    snprintf(buf_hard, sizeof(buf_hard), "%d", hard_count);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_GET_STATUS, &params);
+    int rc = rooms_status_done(res, status);
+    PQclear(res);
+    return rc;
+}
 
-    const char *params[4] = { buf_owner, buf_easy, buf_medium, buf_hard };
+int dao_rooms_queue_get_status(DbBatch *b, int64_t room_id, room_status_t *status) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    return db_batch_add(b, &STMT_ROOMS_GET_STATUS, &params, rooms_status_done, status);
+}
 
-    PGresult *res = PQexecParams(conn, sql, 4, NULL, params, NULL, NULL, 0);
+static DbStmt STMT_ROOMS_CREATE = {
+    .name = "rooms_create",
+    .sql = "INSERT INTO room (owner_id, status, easy_count, medium_count, hard_count) "
+           "VALUES ($1, 'WAITING', $2, $3, $4) RETURNING room_id;",
+    .nparams = 4, .types = { DB_TYPE_INT8 }
+};
+
+// Adds the owner to the room just created on this session, so it can go
+// out in the same pipeline as STMT_ROOMS_CREATE
+static DbStmt STMT_ROOMS_JOIN_CREATED = {
+    .name = "rooms_join_created",
+    .sql = "INSERT INTO room_members (room_id, user_id) "
+           "VALUES (currval(pg_get_serial_sequence('room', 'room_id')), $1) "
+           "ON CONFLICT (room_id, user_id) DO NOTHING;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+static int rooms_create_done(PGresult *res, void *arg) {
+    int64_t *out_room_id = arg;
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ROOMS] create_with_config error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
+        fprintf(stderr, "[DAO_ROOMS] create_with_config error: %s\n", PQresultErrorMessage(res));
         return -1;
     }
+    if (PQntuples(res) != 1) return -1;
 
-    if (PQntuples(res) == 1) {
-        *out_room_id = atoll(PQgetvalue(res, 0, 0));
-    } else {
-        PQclear(res);
-        return -1;
-    }
-    PQclear(res);
+    *out_room_id = atoll(PQgetvalue(res, 0, 0));
+    return 0;
+}
 
-    // Add owner to room_members
-    int rc = dao_rooms_join(*out_room_id, owner_id, 1);
-    return rc;
+int dao_rooms_create_with_config(int64_t owner_id, int easy_count, int medium_count, int hard_count, int64_t *out_room_id) {
+    char buf_easy[32], buf_medium[32], buf_hard[32];
+    snprintf(buf_easy, sizeof(buf_easy), "%d", easy_count);
+    snprintf(buf_medium, sizeof(buf_medium), "%d", medium_count);
+    snprintf(buf_hard, sizeof(buf_hard), "%d", hard_count);
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, owner_id);
+    db_param_text(&params, buf_easy);
+    db_param_text(&params, buf_medium);
+    db_param_text(&params, buf_hard);
+
+    DbParams join_params;
+    db_params_init(&join_params);
+    db_param_int8(&join_params, owner_id);
+
+    // Create the room and add the owner to room_members in one round trip
+    DbBatch batch;
+    if (db_batch_begin(&batch) != 0) return -1;
+    db_batch_add(&batch, &STMT_ROOMS_CREATE, &params, rooms_create_done, out_room_id);
+    db_batch_add(&batch, &STMT_ROOMS_JOIN_CREATED, &join_params, NULL, NULL);
+    return db_batch_run(&batch);
 }
 
+static DbStmt STMT_ROOMS_GET_CONFIG = {
+    .name = "rooms_get_config",
+    .sql = "SELECT easy_count, medium_count, hard_count "
+           "FROM room WHERE room_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_rooms_get_config(int64_t room_id, int *easy_count, int *medium_count, int *hard_count) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "SELECT easy_count, medium_count, hard_count "
-        "FROM room WHERE room_id = $1;";
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
 
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_GET_CONFIG, &params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_ROOMS] get_config error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -289,23 +370,30 @@ int dao_rooms_get_config(int64_t room_id, int *easy_count, int *medium_count, in
     return 0;
 }
 
+static DbStmt STMT_ROOMS_UPDATE_CONFIG = {
+    .name = "rooms_update_config",
+    .sql = "UPDATE room SET easy_count = $2, medium_count = $3, hard_count = $4 "
+           "WHERE room_id = $1;",
+    .nparams = 4, .types = { DB_TYPE_INT8 }
+};
+
 int dao_rooms_update_config(int64_t room_id, int easy_count, int medium_count, int hard_count) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql =
-        "UPDATE room SET easy_count = $2, medium_count = $3, hard_count = $4 "
-        "WHERE room_id = $1;";
-
-    char buf_room[32], buf_easy[32], buf_medium[32], buf_hard[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
+    char buf_easy[32], buf_medium[32], buf_hard[32];
     snprintf(buf_easy, sizeof(buf_easy), "%d", easy_count);
     snprintf(buf_medium, sizeof(buf_medium), "%d", medium_count);
     snprintf(buf_hard, sizeof(buf_hard), "%d", hard_count);
 
-    const char *params[4] = { buf_room, buf_easy, buf_medium, buf_hard };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_text(&params, buf_easy);
+    db_param_text(&params, buf_medium);
+    db_param_text(&params, buf_hard);
 
-    PGresult *res = PQexecParams(conn, sql, 4, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_UPDATE_CONFIG, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ROOMS] update_config error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -315,51 +403,66 @@ int dao_rooms_update_config(int64_t room_id, int easy_count, int medium_count, i
     return 0;
 }
 
-int dao_rooms_get_owner(int64_t room_id, int64_t *owner_id) {
-    PGconn *conn = db_get_conn();
-    if (!conn || !owner_id) return -1;
+static DbStmt STMT_ROOMS_GET_OWNER = {
+    .name = "rooms_get_owner",
+    .sql = "SELECT owner_id FROM room WHERE room_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
 
-    const char *sql = "SELECT owner_id FROM room WHERE room_id = $1;";
-
-    char buf_room[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    const char *params[1] = { buf_room };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static int rooms_owner_done(PGresult *res, void *arg) {
+    int64_t *owner_id = arg;
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_ROOMS] get_owner error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
-        return -1;
-    }
-
-    if (PQntuples(res) == 0) {
-        PQclear(res);
+        fprintf(stderr, "[DAO_ROOMS] get_owner error: %s\n", PQresultErrorMessage(res));
         return -1;
     }
+    if (PQntuples(res) == 0) return -1;
 
     *owner_id = atoll(PQgetvalue(res, 0, 0));
-    PQclear(res);
     return 0;
 }
 
+int dao_rooms_get_owner(int64_t room_id, int64_t *owner_id) {
+    PGconn *conn = db_get_conn();
+    if (!conn || !owner_id) return -1;
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_GET_OWNER, &params);
+    int rc = rooms_owner_done(res, owner_id);
+    PQclear(res);
+    return rc;
+}
+
+int dao_rooms_queue_get_owner(DbBatch *b, int64_t room_id, int64_t *owner_id) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    return db_batch_add(b, &STMT_ROOMS_GET_OWNER, &params, rooms_owner_done, owner_id);
+}
+
+// Rooms with status WAITING, with owner username and member count
+static DbStmt STMT_ROOMS_LIST_WAITING = {
+    .name = "rooms_list_waiting",
+    .sql = "SELECT r.room_id, r.owner_id, u.username as owner_username, "
+           "       COUNT(rm.user_id) as member_count, r.max_number_players, "
+           "       r.created_at "
+           "FROM room r "
+           "JOIN users u ON r.owner_id = u.user_id "
+           "LEFT JOIN room_members rm ON r.room_id = rm.room_id "
+           "WHERE r.status = 'WAITING' "
+           "GROUP BY r.room_id, r.owner_id, u.username, r.max_number_players, r.created_at "
+           "ORDER BY r.created_at DESC "
+           "LIMIT 50;",
+    .nparams = 0
+};
+
 int dao_rooms_list_waiting(void **result_json) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    // Get rooms with status WAITING, include owner username and member count
-    const char *sql =
-        "SELECT r.room_id, r.owner_id, u.username as owner_username, "
-        "       COUNT(rm.user_id) as member_count, r.max_number_players, "
-        "       r.created_at "
-        "FROM room r "
-        "JOIN users u ON r.owner_id = u.user_id "
-        "LEFT JOIN room_members rm ON r.room_id = rm.room_id "
-        "WHERE r.status = 'WAITING' "
-        "GROUP BY r.room_id, r.owner_id, u.username, r.max_number_players, r.created_at "
-        "ORDER BY r.created_at DESC "
-        "LIMIT 50;";
-
-    PGresult *res = PQexecParams(conn, sql, 0, NULL, NULL, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_LIST_WAITING, NULL);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "[DAO_ROOMS] list_waiting error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -423,17 +526,22 @@ int dao_rooms_list_waiting(void **result_json) {
     return 0;
 }
 
+static DbStmt STMT_ROOMS_MARK_ELIMINATED = {
+    .name = "rooms_mark_eliminated",
+    .sql = "UPDATE room_members SET eliminated = true WHERE room_id = $1 AND user_id = $2;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_INT8 }
+};
+
 int dao_rooms_mark_eliminated(int64_t room_id, int64_t user_id) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
 
-    const char *sql = "UPDATE room_members SET eliminated = true WHERE room_id = $1 AND user_id = $2;";
-    char buf_room[32], buf_user[32];
-    snprintf(buf_room, sizeof(buf_room), "%ld", room_id);
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
-    const char *params[2] = { buf_room, buf_user };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_int8(&params, user_id);
 
-    PGresult *res = PQexecParams(conn, sql, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_ROOMS_MARK_ELIMINATED, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_ROOMS] mark_eliminated error: %s\n", PQerrorMessage(conn));
         PQclear(res);
@@ -442,4 +550,12 @@ int dao_rooms_mark_eliminated(int64_t room_id, int64_t user_id) {
 
     PQclear(res);
     return 0;
-}
\ No newline at end of file
+}
+
+int dao_rooms_queue_mark_eliminated(DbBatch *b, int64_t room_id, int64_t user_id) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, room_id);
+    db_param_int8(&params, user_id);
+    return db_batch_add(b, &STMT_ROOMS_MARK_ELIMINATED, &params, NULL, NULL);
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <time.h>
 #include "db.h"
+#include "db_stmt.h"
 #include <openssl/rand.h>
 #include "dao/dao_sessions.h"
 
@@ -32,20 +33,20 @@ static void gen_token(char *buf, size_t len) {
     buf[len - 1] = '\0';
 }
 
+static DbStmt STMT_SESSIONS_CREATE = {
+    .name = "sessions_create",
+    .sql = "INSERT INTO user_sessions (user_id, access_token, expires_at) "
+           "VALUES ($1, $2, NOW() + ($3 || ' seconds')::interval) "
+           "RETURNING id, user_id, access_token, EXTRACT(EPOCH FROM expires_at);",
+    .nparams = 3, .types = { DB_TYPE_INT8, DB_TYPE_ANY, DB_TYPE_ANY }
+};
+
 int dao_sessions_create(int64_t user_id, int ttl_seconds, UserSession *out_sess) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "INSERT INTO user_sessions (user_id, access_token, expires_at) "
-        "VALUES ($1, $2, NOW() + ($3 || ' seconds')::interval) "
-        "RETURNING id, user_id, access_token, EXTRACT(EPOCH FROM expires_at);";
-
-    char user_id_str[32], ttl_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%lld", (long long)user_id);
+    char ttl_str[32];
     snprintf(ttl_str, sizeof(ttl_str), "%d", ttl_seconds);
 
-    const char *params[3];
-
 
     // Try generating a token and inserting. On unique constraint violation (duplicate token)
     // retry a few times instead of failing immediately.
@@ -55,21 +56,13 @@ int dao_sessions_create(int64_t user_id, int ttl_seconds, UserSession *out_sess)
     for (try = 0; try < MAX_TRIES; ++try) {
         char token[65];
         gen_token(token, sizeof(token));
-        params[0] = user_id_str;
-        params[1] = token;
-        params[2] = ttl_str;
-
-        int paramLengthsLocal[3] = { (int)strlen(user_id_str), (int)strlen(token), (int)strlen(ttl_str) };
-        int paramFormatsLocal[3] = { 0, 0, 0 };
-
-        res = PQexecParams(db_conn,
-                           sql,
-                           3,
-                           NULL,
-                           params,
-                           paramLengthsLocal,
-                           paramFormatsLocal,
-                           0);
+        DbParams params;
+        db_params_init(&params);
+        db_param_int8(&params, user_id);
+        db_param_text(&params, token);
+        db_param_text(&params, ttl_str);
+
+        res = db_exec_stmt(db_get_conn(), &STMT_SESSIONS_CREATE, &params);
 
         if (PQresultStatus(res) == PGRES_TUPLES_OK) {
             // success
@@ -115,25 +108,21 @@ int dao_sessions_create(int64_t user_id, int ttl_seconds, UserSession *out_sess)
     return 0;
 }
 
+static DbStmt STMT_SESSIONS_FIND_BY_TOKEN = {
+    .name = "sessions_find_by_token",
+    .sql = "SELECT id, user_id, access_token, EXTRACT(EPOCH FROM expires_at) "
+           "FROM user_sessions WHERE access_token = $1;",
+    .nparams = 1
+};
+
 int dao_sessions_find_by_token(const char *token, UserSession *out_sess) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "SELECT id, user_id, access_token, EXTRACT(EPOCH FROM expires_at) "
-        "FROM user_sessions WHERE access_token = $1;";
-
-    const char *params[1] = { token };
-    int paramLengths[1]   = { (int)strlen(token) };
-    int paramFormats[1]   = { 0 };
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, token);
 
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 1,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0);
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_SESSIONS_FIND_BY_TOKEN, &params);
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         db_log_error(res, "dao_sessions_find_by_token failed");
@@ -157,30 +146,27 @@ int dao_sessions_find_by_token(const char *token, UserSession *out_sess) {
     return 0;
 }
 
+static DbStmt STMT_SESSIONS_TOUCH = {
+    .name = "sessions_touch",
+    .sql = "UPDATE user_sessions "
+           "SET last_heartbeat = NOW(), "
+           "    expires_at = NOW() + ($2 || ' seconds')::interval "
+           "WHERE access_token = $1;",
+    .nparams = 2
+};
+
 int dao_sessions_touch(const char *token, int ttl_seconds) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "UPDATE user_sessions "
-        "SET last_heartbeat = NOW(), "
-        "    expires_at = NOW() + ($2 || ' seconds')::interval "
-        "WHERE access_token = $1;";
-
     char ttl_str[32];
     snprintf(ttl_str, sizeof(ttl_str), "%d", ttl_seconds);
 
-    const char *params[2] = { token, ttl_str };
-    int paramLengths[2]   = { (int)strlen(token), (int)strlen(ttl_str) };
-    int paramFormats[2]   = { 0,0 };
-
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 2,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, token);
+    db_param_text(&params, ttl_str);
+
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_SESSIONS_TOUCH, &params);
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         db_log_error(res, "dao_sessions_touch failed");
@@ -3,40 +3,57 @@
 #include <string.h>
 #include <libpq-fe.h>
 #include "db.h"
+#include "db_async.h"
+#include "db_batch.h"
+#include "db_pool.h"
+#include "db_stmt.h"
 #include "dao/dao_stats.h"
 #include "utils/json.h"
 
-int dao_stats_get_profile(int64_t user_id, void **json_profile) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
+static DbStmt STMT_STATS_PROFILE = {
+    .name = "stats_profile",
+    .sql = "SELECT user_id, username, "
+           "       COALESCE(avatar_img, '') as avatar_img, "
+           "       quickmode_games, "
+           "       onevn_games, "
+           "       quickmode_wins, "
+           "       onevn_wins "
+           "FROM users "
+           "WHERE user_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
+static DbStmt STMT_STATS_LEADERBOARD = {
+    .name = "stats_leaderboard",
+    .sql = "SELECT user_id, username, "
+           "       (quickmode_wins + onevn_wins) AS total_wins "
+           "FROM users "
+           "WHERE (quickmode_wins + onevn_wins) >= 0 "
+           "ORDER BY total_wins DESC, username ASC "
+           "LIMIT $1;",
+    .nparams = 1
+};
+
+static DbStmt STMT_STATS_MATCH_HISTORY = {
+    .name = "stats_match_history",
+    .sql = "SELECT match_id, mode, score, is_win, total_correct, avg_answer_ms, played_at "
+           "FROM match_history "
+           "WHERE user_id = $1 "
+           "ORDER BY played_at DESC "
+           "LIMIT 50;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
 
-    const char *sql =
-        "SELECT user_id, username, "
-        "       COALESCE(avatar_img, '') as avatar_img, "
-        "       quickmode_games, "
-        "       onevn_games, "
-        "       quickmode_wins, "
-        "       onevn_wins "
-        "FROM users "
-        "WHERE user_id = $1;";
-
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
-
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static int build_profile_json(PGresult *res, char **json_profile) {
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_STATS] get_profile query error: %s\n", PQerrorMessage(conn));
-        fprintf(stderr, "[DAO_STATS] SQL: %s\n", sql);
-        fprintf(stderr, "[DAO_STATS] user_id param: %s\n", buf);
-        PQclear(res);
+        fprintf(stderr, "[DAO_STATS] get_profile query error: %s\n",
+                res ? PQresultErrorMessage(res) : "no result");
         return -1;
     }
 
     int row_count = PQntuples(res);
     if (row_count != 1) {
-        fprintf(stderr, "[DAO_STATS] get_profile: Expected 1 row, got %d rows for user_id: %ld\n", row_count, user_id);
-        PQclear(res);
+        fprintf(stderr, "[DAO_STATS] get_profile: Expected 1 row, got %d rows\n", row_count);
         return -1;
     }
 
@@ -56,43 +73,40 @@ int dao_stats_get_profile(int64_t user_id, void **json_profile) {
 
     int need = snprintf(NULL, 0, "{\"user_id\": %s, \"username\": \"%s\", \"avatar_img\": \"%s\", \"quickmode_games\": %s, \"onevn_games\": %s, \"quickmode_wins\": %s, \"onevn_wins\": %s}", uid, esc_name, esc_avatar, qm_games, ov_games, qm_wins, ov_wins) + 1;
     char *out = malloc((size_t)need);
-    if (!out) { free(esc_name); free(esc_avatar); PQclear(res); return -1; }
+    if (!out) { free(esc_name); free(esc_avatar); return -1; }
     snprintf(out, need, "{\"user_id\": %s, \"username\": \"%s\", \"avatar_img\": \"%s\", \"quickmode_games\": %s, \"onevn_games\": %s, \"quickmode_wins\": %s, \"onevn_wins\": %s}", uid, esc_name, esc_avatar, qm_games, ov_games, qm_wins, ov_wins);
 
     *json_profile = out;
     free(esc_name);
     free(esc_avatar);
-    PQclear(res);
     return 0;
 }
 
-int dao_stats_get_leaderboard(int limit, void **json_leaderboard) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
-
-    const char *sql =
-        "SELECT user_id, username, "
-        "       (quickmode_wins + onevn_wins) AS total_wins "
-        "FROM users "
-        "WHERE (quickmode_wins + onevn_wins) >= 0 "
-        "ORDER BY total_wins DESC, username ASC "
-        "LIMIT $1;";
+int dao_stats_get_profile(int64_t user_id, void **json_profile) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    return db_query_json(&STMT_STATS_PROFILE, &params, build_profile_json, (char **)json_profile);
+}
 
-    char buf[16];
-    snprintf(buf, sizeof(buf), "%d", limit);
-    const char *params[1] = { buf };
+int dao_stats_get_profile_async(int64_t user_id, db_json_cb cb, void *arg) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    return db_async_query_json(&STMT_STATS_PROFILE, &params, build_profile_json, cb, arg);
+}
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+static int build_leaderboard_json(PGresult *res, char **json_leaderboard) {
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_STATS] get_leaderboard error: %s\n", PQerrorMessage(conn));
-        PQclear(res);
+        fprintf(stderr, "[DAO_STATS] get_leaderboard error: %s\n",
+                res ? PQresultErrorMessage(res) : "no result");
         return -1;
     }
 
     int rows = PQntuples(res);
     size_t cap = 256; size_t used = 0;
     char *out = malloc(cap);
-    if (!out) { PQclear(res); return -1; }
+    if (!out) return -1;
     out[used++] = '[';
 
     for (int i = 0; i < rows; ++i) {
@@ -106,7 +120,7 @@ int dao_stats_get_leaderboard(int limit, void **json_leaderboard) {
         if (used + (size_t)need + 3 >= cap) {
             cap = (used + (size_t)need + 3) * 2;
             char *tmp = realloc(out, cap);
-            if (!tmp) { free(out); free(esc); PQclear(res); return -1; }
+            if (!tmp) { free(out); free(esc); return -1; }
             out = tmp;
         }
         if (i > 0) out[used++] = ',';
@@ -115,41 +129,71 @@ int dao_stats_get_leaderboard(int limit, void **json_leaderboard) {
     }
     if (used + 2 >= cap) {
         char *tmp = realloc(out, used + 2);
-        if (!tmp) { free(out); PQclear(res); return -1; }
+        if (!tmp) { free(out); return -1; }
         out = tmp; cap = used + 2;
     }
     out[used++] = ']'; out[used] = '\0';
     *json_leaderboard = out;
-    PQclear(res);
     return 0;
 }
 
-int dao_stats_get_match_history(int64_t user_id, void **json_history) {
-    PGconn *conn = db_get_conn();
-    if (!conn) return -1;
+int dao_stats_get_leaderboard(int limit, void **json_leaderboard) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", limit);
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, buf);
+    return db_query_json(&STMT_STATS_LEADERBOARD, &params, build_leaderboard_json, (char **)json_leaderboard);
+}
 
-    const char *sql =
-        "SELECT match_id, mode, score, is_win, total_correct, avg_answer_ms, played_at "
-        "FROM match_history "
-        "WHERE user_id = $1 "
-        "ORDER BY played_at DESC "
-        "LIMIT 50;";
+int dao_stats_get_leaderboard_async(int limit, db_json_cb cb, void *arg) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", limit);
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, buf);
+    return db_async_query_json(&STMT_STATS_LEADERBOARD, &params, build_leaderboard_json, cb, arg);
+}
 
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", user_id);
-    const char *params[1] = { buf };
+static DbStmt STMT_STATS_LOAD_WINS = {
+    .name = "stats_load_wins",
+    .sql = "SELECT user_id, username, (quickmode_wins + onevn_wins) "
+           "FROM users;",
+    .nparams = 0
+};
 
-    PGresult *res = PQexecParams(conn, sql, 1, NULL, params, NULL, NULL, 0);
+int dao_stats_load_wins(dao_stats_wins_fn fn, void *arg) {
+    PGconn *conn = db_get_conn();
+    if (!conn || !fn) return -1;
+
+    PGresult *res = db_exec_stmt(conn, &STMT_STATS_LOAD_WINS, NULL);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "[DAO_STATS] get_match_history error: %s\n", PQerrorMessage(conn));
+        fprintf(stderr, "[DAO_STATS] load_wins error: %s\n", PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
 
+    int rc = 0;
+    int rows = PQntuples(res);
+    for (int i = 0; i < rows && rc == 0; i++) {
+        rc = fn(atoll(PQgetvalue(res, i, 0)), PQgetvalue(res, i, 1),
+                atoi(PQgetvalue(res, i, 2)), arg);
+    }
+    PQclear(res);
+    return rc;
+}
+
+static int build_match_history_json(PGresult *res, char **json_history) {
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "[DAO_STATS] get_match_history error: %s\n",
+                res ? PQresultErrorMessage(res) : "no result");
+        return -1;
+    }
+
     int rows = PQntuples(res);
     size_t cap = 512; size_t used = 0;
     char *out = malloc(cap);
-    if (!out) { PQclear(res); return -1; }
+    if (!out) return -1;
     out[used++] = '[';
     for (int i = 0; i < rows; ++i) {
         const char *match_id = PQgetvalue(res, i, 0);
@@ -167,7 +211,7 @@ int dao_stats_get_match_history(int64_t user_id, void **json_history) {
         if (used + (size_t)need + 3 >= cap) {
             cap = (used + (size_t)need + 3) * 2;
             char *tmp = realloc(out, cap);
-            if (!tmp) { free(out); free(esc_mode); PQclear(res); return -1; }
+            if (!tmp) { free(out); free(esc_mode); return -1; }
             out = tmp;
         }
 
@@ -177,32 +221,43 @@ int dao_stats_get_match_history(int64_t user_id, void **json_history) {
     }
     if (used + 2 >= cap) {
         char *tmp = realloc(out, used + 2);
-        if (!tmp) { free(out); PQclear(res); return -1; }
+        if (!tmp) { free(out); return -1; }
         out = tmp; cap = used + 2;
     }
     out[used++] = ']'; out[used] = '\0';
     *json_history = out;
-    PQclear(res);
     return 0;
 }
 
+int dao_stats_get_match_history(int64_t user_id, void **json_history) {
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    return db_query_json(&STMT_STATS_MATCH_HISTORY, &params, build_match_history_json, (char **)json_history);
+}
+
+// Update quickmode stats directly in users table
+static DbStmt STMT_STATS_QUICKMODE_GAME = {
+    .name = "stats_quickmode_game",
+    .sql = "UPDATE users SET "
+           "quickmode_games = quickmode_games + 1, "
+           "quickmode_wins = quickmode_wins + $2 "
+           "WHERE user_id = $1;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
 int dao_stats_update_quickmode_game(int64_t user_id, int is_win) {
     PGconn *conn = db_get_conn();
     if (!conn) return -1;
     
-    // Update quickmode stats directly in users table
-    const char *sql_update =
-        "UPDATE users SET "
-        "quickmode_games = quickmode_games + 1, "
-        "quickmode_wins = quickmode_wins + $2 "
-        "WHERE user_id = $1;";
-    
-    char buf_user[32], buf_win[32];
-    snprintf(buf_user, sizeof(buf_user), "%ld", user_id);
+    char buf_win[16];
     snprintf(buf_win, sizeof(buf_win), "%d", is_win);
-    const char *params[2] = { buf_user, buf_win };
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+    db_param_text(&params, buf_win);
     
-    PGresult *res = PQexecParams(conn, sql_update, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec_stmt(conn, &STMT_STATS_QUICKMODE_GAME, &params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "[DAO_STATS] update_quickmode_game error for user %ld: %s\n", 
                 user_id, PQerrorMessage(conn));
@@ -213,37 +268,92 @@ int dao_stats_update_quickmode_game(int64_t user_id, int is_win) {
     return 0;
 }
 
-int dao_stats_update_onevn_game(int64_t winner_id, int64_t *player_ids, int *player_scores, int *player_eliminated, int player_count) {
-    PGconn *conn = db_get_conn();
-    if (!conn || !player_ids || !player_scores || !player_eliminated || player_count <= 0) return -1;
-    
-    // Update stats for all players
+// Increment onevn_games for all players (update directly in users table)
+static DbStmt STMT_STATS_ONEVN_GAME = {
+    .name = "stats_onevn_game",
+    .sql = "UPDATE users SET "
+           "onevn_games = onevn_games + 1, "
+           "onevn_wins = onevn_wins + $2 "
+           "WHERE user_id = $1;",
+    .nparams = 2, .types = { DB_TYPE_INT8, DB_TYPE_ANY }
+};
+
+int dao_stats_update_onevn_game(int64_t winner_id, const int64_t *player_ids, int player_count) {
+    if (!player_ids || player_count <= 0) return -1;
+
+    DbBatch batch;
+    if (db_batch_begin(&batch) != 0) return -1;
+    dao_stats_queue_onevn_game(&batch, winner_id, player_ids, player_count);
+    if (db_batch_run(&batch) != 0) {
+        fprintf(stderr, "[DAO_STATS] update_onevn_game error for %d players\n", player_count);
+        return -1;
+    }
+    return 0;
+}
+
+int dao_stats_queue_onevn_game(DbBatch *b, int64_t winner_id, const int64_t *player_ids, int player_count) {
+    // One UPDATE per player, all in the caller's round trip
     for (int i = 0; i < player_count; i++) {
         int64_t player_id = player_ids[i];
         int is_winner = (player_id == winner_id && winner_id > 0) ? 1 : 0;
-        
-        // Increment onevn_games for all players (update directly in users table)
-        const char *sql_update =
-            "UPDATE users SET "
-            "onevn_games = onevn_games + 1, "
-            "onevn_wins = onevn_wins + $2 "
-            "WHERE user_id = $1;";
-        
-        char buf_user[32], buf_winner[32];
-        snprintf(buf_user, sizeof(buf_user), "%ld", player_id);
+
+        char buf_winner[16];
         snprintf(buf_winner, sizeof(buf_winner), "%d", is_winner);
-        const char *params[2] = { buf_user, buf_winner };
-        
-        PGresult *res = PQexecParams(conn, sql_update, 2, NULL, params, NULL, NULL, 0);
-        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-            fprintf(stderr, "[DAO_STATS] update_onevn_game error for user %ld: %s\n", 
-                    player_id, PQerrorMessage(conn));
-            PQclear(res);
-            // Continue with other players
-            continue;
-        }
-        PQclear(res);
+        DbParams params;
+        db_params_init(&params);
+        db_param_int8(&params, player_id);
+        db_param_text(&params, buf_winner);
+
+        if (db_batch_add(b, &STMT_STATS_ONEVN_GAME, &params, NULL, NULL) != 0) return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int64_t user_id;
+    int is_win;
+} StatsWriteJob;
+
+static void stats_write_quickmode(void *arg) {
+    StatsWriteJob *job = arg;
+    dao_stats_update_quickmode_game(job->user_id, job->is_win);
+    free(job);
+}
+
+int dao_stats_update_quickmode_game_async(int64_t user_id, int is_win) {
+    StatsWriteJob *job = malloc(sizeof(StatsWriteJob));
+    if (!job) return dao_stats_update_quickmode_game(user_id, is_win);
+    job->user_id = user_id;
+    job->is_win = is_win;
+    if (db_pool_submit(stats_write_quickmode, NULL, job) != 0) {
+        free(job);
+        return dao_stats_update_quickmode_game(user_id, is_win);
     }
-    
     return 0;
-}
\ No newline at end of file
+}
+
+typedef struct {
+    int64_t winner_id;
+    int player_count;
+    int64_t player_ids[];
+} OneVNStatsJob;
+
+static void stats_write_onevn(void *arg) {
+    OneVNStatsJob *job = arg;
+    dao_stats_update_onevn_game(job->winner_id, job->player_ids, job->player_count);
+    free(job);
+}
+
+int dao_stats_update_onevn_game_async(int64_t winner_id, const int64_t *player_ids, int player_count) {
+    if (!player_ids || player_count <= 0) return -1;
+    OneVNStatsJob *job = malloc(sizeof(OneVNStatsJob) + (size_t)player_count * sizeof(int64_t));
+    if (!job) return dao_stats_update_onevn_game(winner_id, player_ids, player_count);
+    job->winner_id = winner_id;
+    job->player_count = player_count;
+    memcpy(job->player_ids, player_ids, (size_t)player_count * sizeof(int64_t));
+    if (db_pool_submit(stats_write_onevn, NULL, job) != 0) {
+        free(job);
+        return dao_stats_update_onevn_game(winner_id, player_ids, player_count);
+    }
+    return 0;
+}
@@ -4,17 +4,21 @@
 #include <string.h>
 #include <inttypes.h>
 #include "../include/db.h"
+#include "db_stmt.h"
 #include "dao/dao_users.h"
 #include "utils/crypto.h"
 #include "utils/json.h"
 
+static DbStmt STMT_USERS_CREATE = {
+    .name = "users_create",
+    .sql = "INSERT INTO users (username, password) "
+           "VALUES ($1, $2) RETURNING user_id;",
+    .nparams = 2
+};
+
 int dao_users_create(const char *username, const char *password, int64_t *out_user_id) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "INSERT INTO users (username, password) "
-        "VALUES ($1, $2) RETURNING user_id;";
-
     // Hash password before storing
     char hashed_password[128];
     if (util_password_hash(password, hashed_password, sizeof(hashed_password)) != 0) {
@@ -22,22 +26,16 @@ int dao_users_create(const char *username, const char *password, int64_t *out_us
         return -1;
     }
 
-    const char *params[2] = { username, hashed_password };
-    int paramLengths[2]   = { (int)strlen(username), (int)strlen(hashed_password) };
-    int paramFormats[2]   = { 0, 0 };
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
+    db_param_text(&params, hashed_password);
 
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 2,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0); // text
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_CREATE, &params);
 
     if (PQresultStatus(res) == PGRES_FATAL_ERROR) {
         // check trùng username (unique constraint)
-        const char *msg = PQerrorMessage(db_conn);
+        const char *msg = PQerrorMessage(db_get_conn());
         if (strstr(msg, "unique") && strstr(msg, "users_username_key")) {
             PQclear(res);
             return -2;
@@ -65,26 +63,22 @@ int dao_users_create(const char *username, const char *password, int64_t *out_us
     return 0;
 }
 
+static DbStmt STMT_USERS_FIND_BY_USERNAME = {
+    .name = "users_find_by_username",
+    .sql = "SELECT user_id, username, password, COALESCE(avatar_img,''), "
+           "       quickmode_games, quickmode_wins, onevn_games, onevn_wins "
+           "FROM users WHERE username = $1;",
+    .nparams = 1
+};
+
 int dao_users_find_by_username(const char *username, User *out_user) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "SELECT user_id, username, password, COALESCE(avatar_img,''), "
-        "       quickmode_games, quickmode_wins, onevn_games, onevn_wins "
-        "FROM users WHERE username = $1;";
-
-    const char *params[1] = { username };
-    int paramLengths[1]   = { (int)strlen(username) };
-    int paramFormats[1]   = { 0 };
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
 
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 1,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0);
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_FIND_BY_USERNAME, &params);
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         db_log_error(res, "dao_users_find_by_username failed");
@@ -109,28 +103,22 @@ int dao_users_find_by_username(const char *username, User *out_user) {
     return 0;
 }
 
+static DbStmt STMT_USERS_FIND_BY_ID = {
+    .name = "users_find_by_id",
+    .sql = "SELECT user_id, username, password, COALESCE(avatar_img,''), "
+           "       quickmode_games, quickmode_wins, onevn_games, onevn_wins "
+           "FROM users WHERE user_id = $1;",
+    .nparams = 1, .types = { DB_TYPE_INT8 }
+};
+
 int dao_users_find_by_id(int64_t user_id, User *out_user) {
     if (!db_is_ok()) return -1;
 
-    const char *sql =
-        "SELECT user_id, username, password, COALESCE(avatar_img,''), "
-        "       quickmode_games, quickmode_wins, onevn_games, onevn_wins "
-        "FROM users WHERE user_id = $1;";
-
-    char idbuf[32];
-    snprintf(idbuf, sizeof(idbuf), "%lld", (long long)user_id);
-    const char *params[1] = { idbuf };
-    int paramLengths[1] = { (int)strlen(idbuf) };
-    int paramFormats[1] = { 0 };
-
-    PGresult *res = PQexecParams(db_conn,
-                                 sql,
-                                 1,
-                                 NULL,
-                                 params,
-                                 paramLengths,
-                                 paramFormats,
-                                 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int8(&params, user_id);
+
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_FIND_BY_ID, &params);
 
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         db_log_error(res, "dao_users_find_by_id failed");
@@ -155,39 +143,88 @@ int dao_users_find_by_id(int64_t user_id, User *out_user) {
     return 0;
 }
 
-int dao_users_check_password(const char *username, const char *password, int64_t *out_user_id) {
+int dao_users_authenticate(const char *username, const char *password, User *out_user) {
     User u;
     if (dao_users_find_by_username(username, &u) != 0) return 0; // not found
 
+    int ok;
     // If stored password contains salt (format salt$hash) we verify with util_password_verify
     if (strchr(u.password, '$')) {
-        int ok = util_password_verify(password, u.password);
-        if (ok == 1) {
-            if (out_user_id) *out_user_id = u.user_id;
-            return 1;
-        }
-        return 0;
+        ok = util_password_verify(password, u.password) == 1;
+    } else {
+        // legacy plaintext
+        ok = strcmp(u.password, password) == 0;
+    }
+    if (!ok) return 0;
+
+    if (out_user) *out_user = u;
+    return 1;
+}
+
+int dao_users_check_password(const char *username, const char *password, int64_t *out_user_id) {
+    User u;
+    int rc = dao_users_authenticate(username, password, &u);
+    if (rc == 1 && out_user_id) *out_user_id = u.user_id;
+    return rc;
+}
+
+static DbStmt STMT_USERS_FIND_IDENTITIES = {
+    .name = "users_find_identities",
+    .sql = "SELECT user_id, username, COALESCE(avatar_img, '') "
+           "FROM users WHERE user_id = ANY($1::bigint[]);",
+    .nparams = 1
+};
+
+int dao_users_find_identities(const int64_t *user_ids, int count,
+                              dao_users_identity_fn fn, void *arg) {
+    if (!db_is_ok() || !fn || count < 0) return -1;
+    if (count == 0) return 0;
+
+    // Array literal: "{1,2,3}"
+    size_t cap = (size_t)count * 21 + 3;
+    char *ids = malloc(cap);
+    if (!ids) return -1;
+    size_t used = 0;
+    ids[used++] = '{';
+    for (int i = 0; i < count; i++) {
+        used += snprintf(ids + used, cap - used, "%s%" PRId64, i > 0 ? "," : "", user_ids[i]);
     }
+    snprintf(ids + used, cap - used, "}");
 
-    // legacy plaintext
-    if (strcmp(u.password, password) == 0) {
-        if (out_user_id) *out_user_id = u.user_id;
-        return 1;
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, ids);
+
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_FIND_IDENTITIES, &params);
+    free(ids);
+
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        db_log_error(res, "dao_users_find_identities failed");
+        return -1;
+    }
+
+    int rows = PQntuples(res);
+    for (int i = 0; i < rows; i++) {
+        fn(atoll(PQgetvalue(res, i, 0)), PQgetvalue(res, i, 1), PQgetvalue(res, i, 2), arg);
     }
+    PQclear(res);
     return 0;
 }
 
+static DbStmt STMT_USERS_SEARCH = {
+    .name = "users_search",
+    .sql = "SELECT user_id, username, COALESCE(avatar_img, '') as avatar_img "
+           "FROM users "
+           "WHERE username ILIKE $1 "
+           "ORDER BY username "
+           "LIMIT $2;",
+    .nparams = 2
+};
+
 int dao_users_search_by_username(const char *query, int limit, void **result_json) {
     if (!db_is_ok() || !query || !result_json) return -1;
     if (limit <= 0 || limit > 100) limit = 20;
     
-    const char *sql =
-        "SELECT user_id, username, COALESCE(avatar_img, '') as avatar_img "
-        "FROM users "
-        "WHERE username ILIKE $1 "
-        "ORDER BY username "
-        "LIMIT $2;";
-    
     // Build search pattern: %query%
     char pattern[256];
     snprintf(pattern, sizeof(pattern), "%%%s%%", query);
@@ -195,11 +232,12 @@ int dao_users_search_by_username(const char *query, int limit, void **result_jso
     char limit_buf[32];
     snprintf(limit_buf, sizeof(limit_buf), "%d", limit);
     
-    const char *params[2] = { pattern, limit_buf };
-    int paramLengths[2] = { (int)strlen(pattern), (int)strlen(limit_buf) };
-    int paramFormats[2] = { 0, 0 };
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, pattern);
+    db_param_text(&params, limit_buf);
     
-    PGresult *res = PQexecParams(db_conn, sql, 2, NULL, params, paramLengths, paramFormats, 0);
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_SEARCH, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         db_log_error(res, "dao_users_search_by_username failed");
@@ -254,18 +292,21 @@ int dao_users_search_by_username(const char *query, int limit, void **result_jso
     return 0;
 }
 
+static DbStmt STMT_USERS_UPDATE_AVATAR = {
+    .name = "users_update_avatar",
+    .sql = "UPDATE users SET avatar_img = $1 WHERE user_id = $2;",
+    .nparams = 2, .types = { DB_TYPE_ANY, DB_TYPE_INT8 }
+};
+
 int dao_users_update_avatar(int64_t user_id, const char *avatar_path) {
     if (!db_is_ok() || !avatar_path) return -1;
 
-    const char *sql = "UPDATE users SET avatar_img = $1 WHERE user_id = $2;";
-
-    char idbuf[32];
-    snprintf(idbuf, sizeof(idbuf), "%lld", (long long)user_id);
-    const char *params[2] = { avatar_path, idbuf };
-    int paramLengths[2] = { (int)strlen(avatar_path), (int)strlen(idbuf) };
-    int paramFormats[2] = { 0, 0 };
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, avatar_path);
+    db_param_int8(&params, user_id);
 
-    PGresult *res = PQexecParams(db_conn, sql, 2, NULL, params, paramLengths, paramFormats, 0);
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_UPDATE_AVATAR, &params);
 
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         db_log_error(res, "dao_users_update_avatar failed");
@@ -275,4 +316,41 @@ int dao_users_update_avatar(int64_t user_id, const char *avatar_path) {
 
     PQclear(res);
     return 0;
-}
\ No newline at end of file
+}
+
+static DbStmt STMT_USERS_UPDATE_CREDENTIALS = {
+    .name = "users_update_credentials",
+    .sql = "UPDATE users SET username = $1, password = $2 WHERE user_id = $3;",
+    .nparams = 3, .types = { DB_TYPE_ANY, DB_TYPE_ANY, DB_TYPE_INT8 }
+};
+
+int dao_users_update_credentials(int64_t user_id, const char *username, const char *password) {
+    if (!db_is_ok() || !username || !password) return -1;
+
+    char hashed_password[128];
+    if (util_password_hash(password, hashed_password, sizeof(hashed_password)) != 0) {
+        fprintf(stderr, "dao_users_update_credentials: failed to hash password\n");
+        return -1;
+    }
+
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
+    db_param_text(&params, hashed_password);
+    db_param_int8(&params, user_id);
+
+    PGresult *res = db_exec_stmt(db_get_conn(), &STMT_USERS_UPDATE_CREDENTIALS, &params);
+
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        const char *msg = PQerrorMessage(db_get_conn());
+        if (strstr(msg, "unique") && strstr(msg, "users_username_key")) {
+            PQclear(res);
+            return -2;
+        }
+        db_log_error(res, "dao_users_update_credentials failed");
+        return -1;
+    }
+
+    PQclear(res);
+    return 0;
+}
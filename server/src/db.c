@@ -1,19 +1,75 @@
 // server/src/db.c
 #include <stdio.h>
 #include "../include/db.h"
+#include "db_stmt.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 #include <libpq-fe.h>
 
+#define DB_BACKOFF_MIN_MS 100
+#define DB_BACKOFF_MAX_MS 5000
 
 PGconn *db_conn = NULL;
+static char *db_conninfo = NULL;
+
+// Connection bound to the calling thread (pool executors), see db_get_conn
+static __thread PGconn *tls_conn = NULL;
+static __thread int tls_conn_bound = 0;
+
+// Reconnect state of db_conn (same policy as the pool slots, see db_pool.c)
+static pthread_mutex_t db_conn_lock = PTHREAD_MUTEX_INITIALIZER;
+static int db_backoff_ms = DB_BACKOFF_MIN_MS;
+static int64_t db_retry_at_ms = 0;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Reset db_conn if it went bad, unless its backoff has not expired yet.
+// A reset session has lost its prepared statements: prepare them again.
+static void db_conn_check(void) {
+    pthread_mutex_lock(&db_conn_lock);
+    if (db_conn && PQstatus(db_conn) != CONNECTION_OK) {
+        int64_t now = now_ms();
+        if (now >= db_retry_at_ms) {
+            fprintf(stderr, "[DB] Connection lost, resetting\n");
+            PQreset(db_conn);
+            if (PQstatus(db_conn) == CONNECTION_OK) {
+                db_stmt_prepare_all(db_conn);
+                db_backoff_ms = DB_BACKOFF_MIN_MS;
+                db_retry_at_ms = 0;
+                printf("[DB] Reconnected OK\n");
+            } else {
+                fprintf(stderr, "[DB] Reset failed (retry in %d ms): %s\n",
+                        db_backoff_ms, PQerrorMessage(db_conn));
+                db_retry_at_ms = now + db_backoff_ms;
+                db_backoff_ms *= 2;
+                if (db_backoff_ms > DB_BACKOFF_MAX_MS) db_backoff_ms = DB_BACKOFF_MAX_MS;
+            }
+        }
+    }
+    pthread_mutex_unlock(&db_conn_lock);
+}
 
 int db_connect(const char *conninfo) {
+    // Kept so event loops can open their own connections (see db_async.h)
+    free(db_conninfo);
+    db_conninfo = conninfo ? strdup(conninfo) : NULL;
+
     db_conn = PQconnectdb(conninfo);
+    db_backoff_ms = DB_BACKOFF_MIN_MS;
+    db_retry_at_ms = 0;
     if (PQstatus(db_conn) != CONNECTION_OK) {
         fprintf(stderr, "[DB] Connection failed: %s\n",
                 PQerrorMessage(db_conn));
         return -1;
     }
+    db_stmt_prepare_all(db_conn);
     printf("[DB] Connected OK\n");
     return 0;
 }
@@ -27,19 +83,30 @@ void db_disconnect(void) {
 }
 
 int db_is_ok(void) {
-    if (!db_conn) return 0;
-    return PQstatus(db_conn) == CONNECTION_OK;
+    PGconn *conn = db_get_conn();
+    return conn && PQstatus(conn) == CONNECTION_OK;
 }
 
 void db_log_error(PGresult *res, const char *msg) {
-    fprintf(stderr, "[DB] %s: %s\n", msg, PQerrorMessage(db_conn));
+    fprintf(stderr, "[DB] %s: %s\n", msg, PQerrorMessage(db_get_conn()));
     if (res) PQclear(res);
 }
 
 PGconn *db_get_conn(void) {
+    if (tls_conn_bound) return tls_conn;
+    db_conn_check();
     return db_conn;
 }
 
+void db_bind_thread_conn(PGconn *conn) {
+    tls_conn = conn;
+    tls_conn_bound = 1;
+}
+
+const char *db_get_conninfo(void) {
+    return db_conninfo;
+}
+
 int db_init(void) {
     const char *conn = getenv("DB_CONN");
     if (!conn) {
@@ -0,0 +1,421 @@
+// server/src/db_async.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <libpq-fe.h>
+#include "db.h"
+#include "db_async.h"
+#include "db_stmt.h"
+#include "utils/log.h"
+
+typedef struct DbAsyncQuery {
+    struct DbAsyncQuery *next;
+    DbStmt *stmt;
+    const char **values;       // values/lengths/formats point into the
+    int *lengths;              // same allocation
+    int *formats;
+    db_async_cb cb;
+    void *arg;
+} DbAsyncQuery;
+
+// What the head query is waiting for
+enum {
+    DB_ASYNC_IDLE = 0,
+    DB_ASYNC_PREPARING,        // PQsendPrepare of its statement
+    DB_ASYNC_EXECUTING,        // PQsendQueryPrepared
+};
+
+struct DbAsync {
+    PGconn *conn;
+    char *conninfo;
+    int epoll_fd;
+    int sock;                  // socket registered in epoll_fd, -1 if none
+    int want_write;            // EPOLLOUT armed while libpq has unsent data
+    int busy;                  // DB_ASYNC_* state of the head query
+    int connecting;            // Non-blocking reconnect (PQconnectPoll) in progress
+    PGresult *result;          // result of the head query so far
+    DbAsyncQuery *head;
+    DbAsyncQuery *tail;
+    time_t last_connect;
+};
+
+typedef struct {
+    db_json_builder build;
+    db_json_cb cb;
+    void *arg;
+} JsonQuery;
+
+static __thread DbAsync *tls_current_db = NULL;
+
+static void db_async_watch(DbAsync *db) {
+    if (db->sock < 0) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (db->want_write ? EPOLLOUT : 0);
+    ev.data.ptr = db;
+    epoll_ctl(db->epoll_fd, EPOLL_CTL_MOD, db->sock, &ev);
+}
+
+static void db_async_unregister(DbAsync *db) {
+    if (db->sock >= 0) {
+        epoll_ctl(db->epoll_fd, EPOLL_CTL_DEL, db->sock, NULL);
+        db->sock = -1;
+    }
+    db->want_write = 0;
+}
+
+// Watch conn's current socket for events; it can change while connecting
+static int db_async_register(DbAsync *db, uint32_t events) {
+    int sock = PQsocket(db->conn);
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = db;
+    if (sock == db->sock) return epoll_ctl(db->epoll_fd, EPOLL_CTL_MOD, sock, &ev);
+    db_async_unregister(db);
+    if (sock < 0 || epoll_ctl(db->epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0) return -1;
+    db->sock = sock;
+    return 0;
+}
+
+// Blocking connect, only used at startup before the loop runs
+static int db_async_connect(DbAsync *db) {
+    db->last_connect = time(NULL);
+    if (db->conn) {
+        PQfinish(db->conn);
+        db->conn = NULL;
+    }
+
+    db->conn = PQconnectdb(db->conninfo);
+    if (PQstatus(db->conn) == CONNECTION_OK) {
+        // Still blocking here: prepare what earlier connections used
+        db_stmt_prepare_all(db->conn);
+    }
+    if (PQstatus(db->conn) != CONNECTION_OK || PQsetnonblocking(db->conn, 1) != 0) {
+        LOG_ERROR(LOG_CAT_DB, "async connection failed: %s", PQerrorMessage(db->conn));
+        PQfinish(db->conn);
+        db->conn = NULL;
+        return -1;
+    }
+
+    if (db_async_register(db, EPOLLIN) < 0) {
+        LOG_ERROR(LOG_CAT_DB, "epoll_ctl failed for async connection");
+        PQfinish(db->conn);
+        db->conn = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void db_async_connect_failed(DbAsync *db) {
+    LOG_ERROR(LOG_CAT_DB, "async reconnect failed: %s",
+              db->conn ? PQerrorMessage(db->conn) : "out of memory");
+    db_async_unregister(db);
+    if (db->conn) PQfinish(db->conn);
+    db->conn = NULL;
+    db->connecting = 0;
+}
+
+// Drive a reconnect one step, whenever its socket is ready
+static void db_async_connect_poll(DbAsync *db) {
+    switch (PQconnectPoll(db->conn)) {
+        case PGRES_POLLING_READING:
+            if (db_async_register(db, EPOLLIN) < 0) db_async_connect_failed(db);
+            break;
+        case PGRES_POLLING_WRITING:
+            if (db_async_register(db, EPOLLOUT) < 0) db_async_connect_failed(db);
+            break;
+        case PGRES_POLLING_OK:
+            // Statements get prepared again on first use (DB_ASYNC_PREPARING)
+            db->connecting = 0;
+            db->want_write = 0;
+            if (PQsetnonblocking(db->conn, 1) != 0 || db_async_register(db, EPOLLIN) < 0) {
+                db_async_connect_failed(db);
+                break;
+            }
+            LOG_INFO(LOG_CAT_DB, "async connection restored");
+            break;
+        default:
+            db_async_connect_failed(db);
+            break;
+    }
+}
+
+// Reconnect without blocking the loop: PQconnectStart, then
+// db_async_connect_poll from the loop's epoll until it is done
+static void db_async_start_connect(DbAsync *db) {
+    db->last_connect = time(NULL);
+    if (db->conn) {
+        db_async_unregister(db);
+        PQfinish(db->conn);
+    }
+    db->conn = PQconnectStart(db->conninfo);
+    if (!db->conn || PQstatus(db->conn) == CONNECTION_BAD) {
+        db_async_connect_failed(db);
+        return;
+    }
+    db->connecting = 1;
+    // libpq wants the socket writable before the first PQconnectPoll
+    if (db_async_register(db, EPOLLOUT) < 0) db_async_connect_failed(db);
+}
+
+DbAsync *db_async_new(const char *conninfo, int epoll_fd) {
+    if (!conninfo) return NULL;
+
+    DbAsync *db = calloc(1, sizeof(DbAsync));
+    if (!db) return NULL;
+    db->conninfo = strdup(conninfo);
+    db->epoll_fd = epoll_fd;
+    db->sock = -1;
+    if (!db->conninfo || db_async_connect(db) < 0) {
+        free(db->conninfo);
+        free(db);
+        return NULL;
+    }
+    return db;
+}
+
+// Complete the head query with res (may be NULL) and drop it from the queue
+static void db_async_complete_head(DbAsync *db, PGresult *res) {
+    DbAsyncQuery *q = db->head;
+    db->head = q->next;
+    if (!db->head) db->tail = NULL;
+    db->busy = DB_ASYNC_IDLE;
+
+    q->cb(res, q->arg);
+    if (res) PQclear(res);
+    free(q);
+}
+
+// Connection lost: fail everything queued so callers can answer their clients
+static void db_async_fail_all(DbAsync *db) {
+    LOG_ERROR(LOG_CAT_DB, "async connection lost: %s",
+              db->conn ? PQerrorMessage(db->conn) : "not connected");
+    db_async_unregister(db);
+    if (db->result) {
+        PQclear(db->result);
+        db->result = NULL;
+    }
+    if (db->conn) {
+        PQfinish(db->conn);
+        db->conn = NULL;
+    }
+    while (db->head) db_async_complete_head(db, NULL);
+}
+
+static void db_async_flush(DbAsync *db) {
+    int rc = PQflush(db->conn);
+    if (rc < 0) {
+        db_async_fail_all(db);
+        return;
+    }
+    int want_write = (rc == 1);
+    if (want_write != db->want_write) {
+        db->want_write = want_write;
+        db_async_watch(db);
+    }
+}
+
+// Send the next queued query if the connection is idle. A statement not
+// yet prepared on this connection is prepared first, as its own round trip.
+static void db_async_start_next(DbAsync *db) {
+    while (db->conn && !db->busy && db->head) {
+        DbAsyncQuery *q = db->head;
+        DbStmt *stmt = q->stmt;
+        int sent;
+        if (db_stmt_is_prepared(db->conn, stmt)) {
+            sent = PQsendQueryPrepared(db->conn, stmt->name, stmt->nparams,
+                                       q->values, q->lengths, q->formats, 0);
+            db->busy = DB_ASYNC_EXECUTING;
+        } else {
+            sent = PQsendPrepare(db->conn, stmt->name, stmt->sql, stmt->nparams, stmt->types);
+            db->busy = DB_ASYNC_PREPARING;
+        }
+        if (sent) {
+            db_async_flush(db);
+            return;
+        }
+        db->busy = DB_ASYNC_IDLE;
+        LOG_ERROR(LOG_CAT_DB, "sending %s failed: %s", stmt->name, PQerrorMessage(db->conn));
+        if (PQstatus(db->conn) == CONNECTION_BAD) {
+            db_async_fail_all(db);
+            return;
+        }
+        db_async_complete_head(db, NULL);
+    }
+}
+
+static int db_async_prepared_ok(const PGresult *res) {
+    if (PQresultStatus(res) == PGRES_COMMAND_OK) return 1;
+    // 42P05: the session already has it (prepared by an earlier attempt)
+    const char *code = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+    return code && strcmp(code, "42P05") == 0;
+}
+
+static void db_async_read(DbAsync *db) {
+    if (!PQconsumeInput(db->conn)) {
+        db_async_fail_all(db);
+        return;
+    }
+
+    while (db->conn && db->busy && !PQisBusy(db->conn)) {
+        PGresult *res = PQgetResult(db->conn);
+        if (res) {
+            // Keep the last result of the statement; NULL marks its end
+            if (db->result) PQclear(db->result);
+            db->result = res;
+            continue;
+        }
+        res = db->result;
+        db->result = NULL;
+        if (db->busy == DB_ASYNC_PREPARING && db_async_prepared_ok(res)) {
+            // Statement ready: now run the query itself
+            PQclear(res);
+            db_stmt_set_prepared(db->conn, db->head->stmt, 1);
+            db->busy = DB_ASYNC_IDLE;
+        } else {
+            db_async_complete_head(db, res);
+        }
+        db_async_start_next(db);
+    }
+
+    // Notices/notifications are not used; drop them so they do not pile up
+    PGnotify *n;
+    while (db->conn && (n = PQnotifies(db->conn)) != NULL) PQfreemem(n);
+}
+
+void db_async_handle_event(DbAsync *db, uint32_t events) {
+    if (!db || !db->conn) return;
+    if (db->connecting) {
+        db_async_connect_poll(db);
+        return;
+    }
+    if ((events & EPOLLOUT) && db->want_write) {
+        db_async_flush(db);
+        if (!db->conn) return;
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        db_async_read(db);
+    }
+}
+
+void db_async_free(DbAsync *db) {
+    if (!db) return;
+    db_async_unregister(db);
+    if (db->result) PQclear(db->result);
+    while (db->head) db_async_complete_head(db, NULL);
+    if (db->conn) PQfinish(db->conn);
+    free(db->conninfo);
+    free(db);
+}
+
+void db_async_set_current(DbAsync *db) {
+    tls_current_db = db;
+}
+
+DbAsync *db_async_get_current(void) {
+    return tls_current_db;
+}
+
+static void db_async_run_blocking(DbStmt *stmt, const DbParams *params,
+                                  db_async_cb cb, void *arg) {
+    PGresult *res = db_exec_stmt(db_get_conn(), stmt, params);
+    cb(res, arg);
+    if (res) PQclear(res);
+}
+
+int db_async_query(DbStmt *stmt, const DbParams *params, db_async_cb cb, void *arg) {
+    int nparams = params ? params->count : 0;
+    if (!stmt || !cb || nparams != stmt->nparams) return -1;
+
+    DbAsync *db = tls_current_db;
+    if (db && !db->conn && time(NULL) - db->last_connect >= 1) {
+        // Lost earlier: start reconnecting, at most once a second
+        db_async_start_connect(db);
+    }
+    if (!db || !db->conn || db->connecting) {
+        // No async connection (yet): blocking fallback
+        db_async_run_blocking(stmt, params, cb, arg);
+        return 0;
+    }
+
+    // One allocation for the node, the parameter arrays and their bytes
+    size_t size = sizeof(DbAsyncQuery) + (size_t)nparams * (sizeof(char *) + 2 * sizeof(int));
+    for (int i = 0; i < nparams; i++) {
+        if (!params->values[i]) continue;
+        size += params->formats[i] ? (size_t)params->lengths[i] : strlen(params->values[i]) + 1;
+    }
+    DbAsyncQuery *q = malloc(size);
+    if (!q) return -1;
+    q->next = NULL;
+    q->stmt = stmt;
+    q->values = (const char **)(q + 1);
+    q->lengths = (int *)(q->values + nparams);
+    q->formats = q->lengths + nparams;
+    q->cb = cb;
+    q->arg = arg;
+    char *data = (char *)(q->formats + nparams);
+    for (int i = 0; i < nparams; i++) {
+        q->lengths[i] = params->lengths[i];
+        q->formats[i] = params->formats[i];
+        if (!params->values[i]) {
+            q->values[i] = NULL;
+            continue;
+        }
+        size_t len = params->formats[i] ? (size_t)params->lengths[i] : strlen(params->values[i]) + 1;
+        memcpy(data, params->values[i], len);
+        q->values[i] = data;
+        data += len;
+    }
+
+    if (db->tail) db->tail->next = q;
+    else db->head = q;
+    db->tail = q;
+    db_async_start_next(db);
+    return 0;
+}
+
+static void json_query_done(PGresult *res, void *arg) {
+    JsonQuery *jq = arg;
+    char *json = NULL;
+    int rc = jq->build(res, &json);
+    if (rc != 0) {
+        free(json);
+        json = NULL;
+    }
+    jq->cb(rc == 0 ? 0 : -1, json, jq->arg);
+    free(jq);
+}
+
+int db_async_query_json(DbStmt *stmt, const DbParams *params,
+                        db_json_builder build, db_json_cb cb, void *arg) {
+    if (!build || !cb) return -1;
+    JsonQuery *jq = malloc(sizeof(JsonQuery));
+    if (!jq) return -1;
+    jq->build = build;
+    jq->cb = cb;
+    jq->arg = arg;
+    if (db_async_query(stmt, params, json_query_done, jq) != 0) {
+        free(jq);
+        return -1;
+    }
+    return 0;
+}
+
+int db_query_json(DbStmt *stmt, const DbParams *params,
+                  db_json_builder build, char **out_json) {
+    PGconn *conn = db_get_conn();
+    if (!conn) return -1;
+
+    PGresult *res = db_exec_stmt(conn, stmt, params);
+    char *json = NULL;
+    int rc = build(res, &json);
+    PQclear(res);
+    if (rc != 0) {
+        free(json);
+        return -1;
+    }
+    *out_json = json;
+    return 0;
+}
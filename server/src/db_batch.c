@@ -0,0 +1,154 @@
+// server/src/db_batch.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libpq-fe.h>
+#include "db.h"
+#include "db_batch.h"
+#include "utils/log.h"
+
+int db_batch_begin(DbBatch *b) {
+    memset(b, 0, sizeof(*b));
+    PGconn *conn = db_get_conn();
+    if (!conn || PQstatus(conn) != CONNECTION_OK) {
+        b->failed = 1;
+        return -1;
+    }
+    if (!PQenterPipelineMode(conn)) {
+        LOG_ERROR(LOG_CAT_DB, "enter pipeline mode failed: %s", PQerrorMessage(conn));
+        b->failed = 1;
+        return -1;
+    }
+    b->conn = conn;
+    return 0;
+}
+
+int db_batch_add(DbBatch *b, DbStmt *stmt, const DbParams *params,
+                 db_batch_fn done, void *arg) {
+    if (!b->conn || b->failed || !stmt) {
+        b->failed = 1;
+        return -1;
+    }
+    if (b->count == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 8;
+        DbBatchEntry *entries = realloc(b->entries, (size_t)cap * sizeof(DbBatchEntry));
+        if (!entries) {
+            b->failed = 1;
+            return -1;
+        }
+        b->entries = entries;
+        b->cap = cap;
+    }
+
+    DbBatchEntry *e = &b->entries[b->count];
+    e->stmt = stmt;
+    e->prepare = 0;
+    e->queued = 0;
+    e->done = done;
+    e->arg = arg;
+
+    if (!db_stmt_is_prepared(b->conn, stmt)) {
+        if (!PQsendPrepare(b->conn, stmt->name, stmt->sql, stmt->nparams, stmt->types)) {
+            goto send_failed;
+        }
+        // Later entries for the same statement reuse this prepare
+        db_stmt_set_prepared(b->conn, stmt, 1);
+        e->prepare = 1;
+    }
+    if (!PQsendQueryPrepared(b->conn, stmt->name, stmt->nparams,
+                             params ? params->values : NULL,
+                             params ? params->lengths : NULL,
+                             params ? params->formats : NULL, 0)) {
+        goto send_failed;
+    }
+    e->queued = 1;
+    b->count++;
+    return 0;
+
+send_failed:
+    LOG_ERROR(LOG_CAT_DB, "batch send %s failed: %s", stmt->name, PQerrorMessage(b->conn));
+    if (e->prepare) {
+        // The prepare is in the pipeline; keep the entry so its result is read
+        db_stmt_set_prepared(b->conn, stmt, 0);
+        b->count++;
+    }
+    b->failed = 1;
+    return -1;
+}
+
+// Next command's result, consuming the NULL that ends it
+static PGresult *batch_next_result(PGconn *conn) {
+    PGresult *res = PQgetResult(conn);
+    if (res) {
+        PGresult *extra;
+        while ((extra = PQgetResult(conn)) != NULL) PQclear(extra);
+    }
+    return res;
+}
+
+static int batch_result_ok(DbBatchEntry *e, PGresult *res) {
+    ExecStatusType st = PQresultStatus(res);
+    if (!res || st == PGRES_PIPELINE_ABORTED) return -1;   // an earlier statement failed
+    if (e->done) return e->done(res, e->arg);
+    if (st != PGRES_COMMAND_OK && st != PGRES_TUPLES_OK) {
+        LOG_ERROR(LOG_CAT_DB, "batch %s failed: %s", e->stmt->name, PQresultErrorMessage(res));
+        return -1;
+    }
+    return 0;
+}
+
+int db_batch_run(DbBatch *b) {
+    PGconn *conn = b->conn;
+    int rc = b->failed ? -1 : 0;
+    if (!conn) {
+        free(b->entries);
+        memset(b, 0, sizeof(*b));
+        return -1;
+    }
+
+    int synced = PQpipelineSync(conn);
+    if (!synced) {
+        LOG_ERROR(LOG_CAT_DB, "pipeline sync failed: %s", PQerrorMessage(conn));
+        rc = -1;
+    }
+
+    for (int i = 0; i < b->count; i++) {
+        DbBatchEntry *e = &b->entries[i];
+        PGresult *res;
+        if (e->prepare) {
+            res = batch_next_result(conn);
+            ExecStatusType st = PQresultStatus(res);
+            const char *code = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+            // 42P05: it was prepared on this session after all
+            if (st != PGRES_COMMAND_OK && !(code && strcmp(code, "42P05") == 0)) {
+                db_stmt_set_prepared(conn, e->stmt, 0);
+                if (res && st != PGRES_PIPELINE_ABORTED) {
+                    LOG_ERROR(LOG_CAT_DB, "batch prepare %s failed: %s", e->stmt->name,
+                              PQresultErrorMessage(res));
+                }
+                rc = -1;
+            }
+            PQclear(res);
+        }
+        if (!e->queued) continue;
+
+        res = batch_next_result(conn);
+        const char *code = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+        if (code && strcmp(code, "26000") == 0) {
+            // The session lost the statement: prepare it again next time
+            db_stmt_set_prepared(conn, e->stmt, 0);
+        }
+        if (batch_result_ok(e, res) != 0) rc = -1;
+        PQclear(res);
+    }
+
+    if (synced) PQclear(PQgetResult(conn));    // PGRES_PIPELINE_SYNC
+    if (!PQexitPipelineMode(conn)) {
+        LOG_ERROR(LOG_CAT_DB, "exit pipeline mode failed: %s", PQerrorMessage(conn));
+        rc = -1;
+    }
+
+    free(b->entries);
+    memset(b, 0, sizeof(*b));
+    return rc;
+}
@@ -0,0 +1,362 @@
+// server/src/db_pool.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <libpq-fe.h>
+#include "db.h"
+#include "db_pool.h"
+#include "db_stmt.h"
+#include "utils/log.h"
+
+#define DB_POOL_IDLE_CHECK_MS 30000    // ping connections idle longer than this
+#define DB_POOL_BACKOFF_MIN_MS 100
+#define DB_POOL_BACKOFF_MAX_MS 5000
+
+typedef struct {
+    PGconn *conn;              // NULL while down
+    int in_use;
+    int64_t last_used_ms;
+    int backoff_ms;            // delay before the next reconnect attempt
+    int64_t retry_at_ms;       // no reconnect before this time
+} DbPoolSlot;
+
+typedef struct DbJob {
+    struct DbJob *next;
+    db_job_fn run;
+    db_job_fn done;
+    void *arg;
+    void *loop;                // where done runs, NULL for the executor thread
+    int64_t key;               // jobs with the same key run in order, 0: none
+} DbJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t slot_free;  // a slot was released
+    pthread_cond_t job_ready;  // a job was queued or the pool is stopping
+    pthread_cond_t idle;       // queue empty and nothing running
+    char *conninfo;
+    DbPoolSlot slots[DB_POOL_MAX_SIZE];
+    int size;
+    pthread_t threads[DB_POOL_MAX_SIZE];
+    int thread_count;
+    DbJob *head;
+    DbJob *tail;
+    int running_jobs;
+    int64_t running_keys[DB_POOL_MAX_SIZE];  // key of each executor's job, 0 if none
+    int running;
+    int stop;
+} DbPool;
+
+static DbPool g_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .slot_free = PTHREAD_COND_INITIALIZER,
+    .job_ready = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static db_pool_loop_fn g_loop_current = NULL;
+static db_pool_post_fn g_loop_post = NULL;
+
+static void *executor_main(void *arg);
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void db_pool_set_loop_hooks(db_pool_loop_fn current, db_pool_post_fn post) {
+    g_loop_current = current;
+    g_loop_post = post;
+}
+
+// slot->conn is read by other threads looking for a free slot
+static void slot_set_conn(DbPoolSlot *slot, PGconn *conn) {
+    pthread_mutex_lock(&g_pool.lock);
+    slot->conn = conn;
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+static void slot_drop(DbPoolSlot *slot) {
+    PGconn *conn = slot->conn;
+    if (conn) {
+        slot_set_conn(slot, NULL);
+        PQfinish(conn);
+    }
+}
+
+// (Re)open a slot's connection, unless its backoff has not expired yet.
+// Runs without the pool lock: the slot is reserved by the caller.
+static int slot_connect(DbPoolSlot *slot, int64_t now) {
+    if (now < slot->retry_at_ms) return -1;
+
+    PGconn *conn = PQconnectdb(g_pool.conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) {
+        LOG_ERROR(LOG_CAT_DB, "pool connection failed (retry in %d ms): %s",
+                  slot->backoff_ms, PQerrorMessage(conn));
+        PQfinish(conn);
+        slot->retry_at_ms = now + slot->backoff_ms;
+        slot->backoff_ms *= 2;
+        if (slot->backoff_ms > DB_POOL_BACKOFF_MAX_MS) slot->backoff_ms = DB_POOL_BACKOFF_MAX_MS;
+        return -1;
+    }
+    db_stmt_prepare_all(conn);
+    slot_set_conn(slot, conn);
+    slot->backoff_ms = DB_POOL_BACKOFF_MIN_MS;
+    slot->retry_at_ms = 0;
+    slot->last_used_ms = now;
+    return 0;
+}
+
+// Make sure a reserved slot holds a usable connection
+static int slot_check(DbPoolSlot *slot) {
+    int64_t now = now_ms();
+
+    if (slot->conn && PQstatus(slot->conn) != CONNECTION_OK) {
+        LOG_WARN(LOG_CAT_DB, "pool connection lost, reconnecting");
+        slot_drop(slot);
+    } else if (slot->conn && now - slot->last_used_ms > DB_POOL_IDLE_CHECK_MS) {
+        // The server or a middlebox may have dropped an idle connection
+        PGresult *res = PQexec(slot->conn, "SELECT 1");
+        int ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+        PQclear(res);
+        if (!ok) {
+            LOG_WARN(LOG_CAT_DB, "pool health check failed: %s", PQerrorMessage(slot->conn));
+            slot_drop(slot);
+        }
+    }
+
+    if (!slot->conn) return slot_connect(slot, now);
+    return 0;
+}
+
+int db_pool_init(const char *conninfo, int size) {
+    if (!conninfo || g_pool.running) return -1;
+    if (size <= 0) size = DB_POOL_DEFAULT_SIZE;
+    if (size > DB_POOL_MAX_SIZE) size = DB_POOL_MAX_SIZE;
+
+    g_pool.conninfo = strdup(conninfo);
+    if (!g_pool.conninfo) return -1;
+    g_pool.size = size;
+    g_pool.stop = 0;
+    int64_t now = now_ms();
+    int connected = 0;
+    for (int i = 0; i < size; i++) {
+        DbPoolSlot *slot = &g_pool.slots[i];
+        memset(slot, 0, sizeof(*slot));
+        slot->backoff_ms = DB_POOL_BACKOFF_MIN_MS;
+        if (slot_connect(slot, now) == 0) connected++;
+    }
+    if (connected == 0) {
+        free(g_pool.conninfo);
+        g_pool.conninfo = NULL;
+        return -1;
+    }
+
+    g_pool.running = 1;
+    for (g_pool.thread_count = 0; g_pool.thread_count < size; g_pool.thread_count++) {
+        if (pthread_create(&g_pool.threads[g_pool.thread_count], NULL,
+                           executor_main, (void *)(intptr_t)g_pool.thread_count) != 0) {
+            break;
+        }
+    }
+    if (g_pool.thread_count == 0) {
+        g_pool.running = 0;
+        for (int i = 0; i < size; i++) slot_drop(&g_pool.slots[i]);
+        free(g_pool.conninfo);
+        g_pool.conninfo = NULL;
+        return -1;
+    }
+
+    LOG_INFO(LOG_CAT_DB, "connection pool ready: %d/%d connections, %d executor threads",
+             connected, size, g_pool.thread_count);
+    return 0;
+}
+
+PGconn *db_pool_acquire(void) {
+    pthread_mutex_lock(&g_pool.lock);
+    DbPoolSlot *slot = NULL;
+    while (g_pool.running && !slot) {
+        // Prefer an open connection over one that needs reconnecting
+        for (int i = 0; i < g_pool.size; i++) {
+            DbPoolSlot *s = &g_pool.slots[i];
+            if (s->in_use) continue;
+            if (s->conn) { slot = s; break; }
+            if (!slot) slot = s;
+        }
+        if (!slot) pthread_cond_wait(&g_pool.slot_free, &g_pool.lock);
+    }
+    if (slot) slot->in_use = 1;
+    pthread_mutex_unlock(&g_pool.lock);
+    if (!slot) return NULL;
+
+    if (slot_check(slot) < 0) {
+        pthread_mutex_lock(&g_pool.lock);
+        slot->in_use = 0;
+        pthread_cond_signal(&g_pool.slot_free);
+        pthread_mutex_unlock(&g_pool.lock);
+        return NULL;
+    }
+    return slot->conn;
+}
+
+void db_pool_release(PGconn *conn) {
+    if (!conn) return;
+
+    DbPoolSlot *slot = NULL;
+    pthread_mutex_lock(&g_pool.lock);
+    for (int i = 0; i < g_pool.size; i++) {
+        if (g_pool.slots[i].conn == conn) {
+            slot = &g_pool.slots[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    if (!slot) return;
+
+    // Never hand out a connection stuck inside a transaction
+    if (PQstatus(conn) == CONNECTION_OK && PQtransactionStatus(conn) != PQTRANS_IDLE) {
+        PQclear(PQexec(conn, "ROLLBACK"));
+    }
+    if (PQstatus(conn) != CONNECTION_OK) slot_drop(slot);
+    slot->last_used_ms = now_ms();
+
+    pthread_mutex_lock(&g_pool.lock);
+    slot->in_use = 0;
+    pthread_cond_signal(&g_pool.slot_free);
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+static void job_finish(DbJob *job) {
+    if (job->done) {
+        if (!job->loop || g_loop_post(job->loop, job->done, job->arg) != 0) {
+            job->done(job->arg);
+        }
+    }
+    free(job);
+}
+
+static int key_running(int64_t key) {
+    for (int i = 0; i < g_pool.thread_count; i++) {
+        if (g_pool.running_keys[i] == key) return 1;
+    }
+    return 0;
+}
+
+// First queued job that may run now: a keyed job waits while an earlier
+// job with its key is running. Called with the lock held.
+static DbJob *take_job(void) {
+    DbJob *prev = NULL;
+    for (DbJob *job = g_pool.head; job; prev = job, job = job->next) {
+        if (job->key != 0 && key_running(job->key)) continue;
+        if (prev) prev->next = job->next;
+        else g_pool.head = job->next;
+        if (g_pool.tail == job) g_pool.tail = prev;
+        return job;
+    }
+    return NULL;
+}
+
+static void *executor_main(void *arg) {
+    int self = (int)(intptr_t)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_pool.lock);
+        DbJob *job;
+        while (!(job = take_job()) && !(g_pool.stop && !g_pool.head)) {
+            pthread_cond_wait(&g_pool.job_ready, &g_pool.lock);
+        }
+        if (!job) {
+            pthread_mutex_unlock(&g_pool.lock);
+            break;
+        }
+        g_pool.running_keys[self] = job->key;
+        g_pool.running_jobs++;
+        pthread_mutex_unlock(&g_pool.lock);
+
+        // The DAO code reaches the borrowed connection through db_get_conn()
+        PGconn *conn = db_pool_acquire();
+        db_bind_thread_conn(conn);
+        job->run(job->arg);
+        db_bind_thread_conn(NULL);
+        db_pool_release(conn);
+
+        int64_t key = job->key;
+        job_finish(job);
+
+        pthread_mutex_lock(&g_pool.lock);
+        g_pool.running_keys[self] = 0;
+        // The next job with this key may be waiting for us
+        if (key != 0) pthread_cond_broadcast(&g_pool.job_ready);
+        g_pool.running_jobs--;
+        if (!g_pool.head && g_pool.running_jobs == 0) pthread_cond_broadcast(&g_pool.idle);
+        pthread_mutex_unlock(&g_pool.lock);
+    }
+    return NULL;
+}
+
+int db_pool_submit(db_job_fn run, db_job_fn done, void *arg) {
+    return db_pool_submit_keyed(0, run, done, arg);
+}
+
+int db_pool_submit_keyed(int64_t key, db_job_fn run, db_job_fn done, void *arg) {
+    if (!run) return -1;
+
+    if (!g_pool.running) {
+        run(arg);
+        if (done) done(arg);
+        return 0;
+    }
+
+    DbJob *job = malloc(sizeof(DbJob));
+    if (!job) return -1;
+    job->next = NULL;
+    job->run = run;
+    job->done = done;
+    job->arg = arg;
+    job->loop = (done && g_loop_current && g_loop_post) ? g_loop_current() : NULL;
+    job->key = key;
+
+    pthread_mutex_lock(&g_pool.lock);
+    if (g_pool.tail) g_pool.tail->next = job;
+    else g_pool.head = job;
+    g_pool.tail = job;
+    pthread_cond_signal(&g_pool.job_ready);
+    pthread_mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+void db_pool_wait_idle(void) {
+    pthread_mutex_lock(&g_pool.lock);
+    while (g_pool.running && (g_pool.head || g_pool.running_jobs > 0)) {
+        pthread_cond_wait(&g_pool.idle, &g_pool.lock);
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+void db_pool_shutdown(void) {
+    if (!g_pool.running) return;
+
+    // Executors exit once the queue is empty
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.stop = 1;
+    pthread_cond_broadcast(&g_pool.job_ready);
+    pthread_mutex_unlock(&g_pool.lock);
+    for (int i = 0; i < g_pool.thread_count; i++) {
+        pthread_join(g_pool.threads[i], NULL);
+    }
+
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.running = 0;
+    pthread_cond_broadcast(&g_pool.slot_free);
+    pthread_cond_broadcast(&g_pool.idle);
+    pthread_mutex_unlock(&g_pool.lock);
+
+    for (int i = 0; i < g_pool.size; i++) slot_drop(&g_pool.slots[i]);
+    g_pool.size = 0;
+    g_pool.thread_count = 0;
+    free(g_pool.conninfo);
+    g_pool.conninfo = NULL;
+}
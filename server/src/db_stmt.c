@@ -0,0 +1,189 @@
+// server/src/db_stmt.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <endian.h>
+#include <libpq-fe.h>
+#include <libpq-events.h>
+#include "db_stmt.h"
+#include "utils/log.h"
+
+// Statements seen so far, indexed by DbStmt.id - 1
+static pthread_mutex_t g_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static DbStmt *g_registry[DB_STMT_MAX];
+static int g_registry_count = 0;
+
+// Per-connection state, attached as libpq instance data
+typedef struct {
+    unsigned char prepared[DB_STMT_MAX];
+} ConnStmts;
+
+void db_params_init(DbParams *p) {
+    p->count = 0;
+}
+
+void db_param_text(DbParams *p, const char *value) {
+    if (p->count >= DB_STMT_MAX_PARAMS) return;
+    int i = p->count++;
+    p->values[i] = value;
+    p->lengths[i] = 0;
+    p->formats[i] = 0;
+}
+
+void db_param_int8(DbParams *p, int64_t value) {
+    if (p->count >= DB_STMT_MAX_PARAMS) return;
+    int i = p->count++;
+    uint64_t be = htobe64((uint64_t)value);
+    memcpy(p->bin[i], &be, sizeof(be));
+    p->values[i] = (const char *)p->bin[i];
+    p->lengths[i] = sizeof(be);
+    p->formats[i] = 1;
+}
+
+void db_param_bool(DbParams *p, int value) {
+    if (p->count >= DB_STMT_MAX_PARAMS) return;
+    int i = p->count++;
+    p->bin[i][0] = value ? 1 : 0;
+    p->values[i] = (const char *)p->bin[i];
+    p->lengths[i] = 1;
+    p->formats[i] = 1;
+}
+
+// Slot of stmt in the registry, registering it on first use (-1 if full)
+static int stmt_index(DbStmt *stmt) {
+    int id = __atomic_load_n(&stmt->id, __ATOMIC_ACQUIRE);
+    if (id) return id - 1;
+
+    pthread_mutex_lock(&g_registry_lock);
+    if (!stmt->id && g_registry_count < DB_STMT_MAX) {
+        g_registry[g_registry_count++] = stmt;
+        __atomic_store_n(&stmt->id, g_registry_count, __ATOMIC_RELEASE);
+    }
+    id = stmt->id;
+    pthread_mutex_unlock(&g_registry_lock);
+    if (!id) {
+        LOG_WARN(LOG_CAT_DB, "statement registry full, %s runs unprepared", stmt->name);
+    }
+    return id - 1;
+}
+
+static int stmt_event_proc(PGEventId evt, void *info, void *pass_through) {
+    (void)pass_through;
+    switch (evt) {
+        case PGEVT_REGISTER: {
+            PGEventRegister *e = info;
+            ConnStmts *s = calloc(1, sizeof(ConnStmts));
+            if (!s || !PQsetInstanceData(e->conn, stmt_event_proc, s)) {
+                free(s);
+                return 0;
+            }
+            break;
+        }
+        case PGEVT_CONNRESET: {
+            // The server forgot everything prepared on the old session
+            PGEventConnReset *e = info;
+            ConnStmts *s = PQinstanceData(e->conn, stmt_event_proc);
+            if (s) memset(s, 0, sizeof(*s));
+            break;
+        }
+        case PGEVT_CONNDESTROY: {
+            PGEventConnDestroy *e = info;
+            free(PQinstanceData(e->conn, stmt_event_proc));
+            break;
+        }
+        default:
+            break;
+    }
+    return 1;
+}
+
+static ConnStmts *conn_stmts(PGconn *conn) {
+    ConnStmts *s = PQinstanceData(conn, stmt_event_proc);
+    if (!s && PQregisterEventProc(conn, stmt_event_proc, "db_stmt", NULL)) {
+        s = PQinstanceData(conn, stmt_event_proc);
+    }
+    return s;
+}
+
+static int result_sqlstate_is(const PGresult *res, const char *state) {
+    const char *code = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+    return code && strcmp(code, state) == 0;
+}
+
+// PQprepare stmt on conn. Returns NULL on success, else the failed result.
+static PGresult *stmt_prepare(PGconn *conn, DbStmt *stmt, ConnStmts *s, int idx) {
+    PGresult *res = PQprepare(conn, stmt->name, stmt->sql, stmt->nparams, stmt->types);
+    // 42P05: already prepared on this session (e.g. by an earlier attempt)
+    if (PQresultStatus(res) != PGRES_COMMAND_OK && !result_sqlstate_is(res, "42P05")) {
+        return res;
+    }
+    PQclear(res);
+    s->prepared[idx] = 1;
+    return NULL;
+}
+
+PGresult *db_exec_stmt(PGconn *conn, DbStmt *stmt, const DbParams *params) {
+    if (!conn || !stmt) return NULL;
+
+    const char *const *values = params ? params->values : NULL;
+    const int *lengths = params ? params->lengths : NULL;
+    const int *formats = params ? params->formats : NULL;
+
+    int idx = stmt_index(stmt);
+    ConnStmts *s = idx >= 0 ? conn_stmts(conn) : NULL;
+    if (!s) {
+        return PQexecParams(conn, stmt->sql, stmt->nparams, stmt->types,
+                            values, lengths, formats, 0);
+    }
+
+    for (int attempt = 0; ; attempt++) {
+        if (!s->prepared[idx]) {
+            PGresult *err = stmt_prepare(conn, stmt, s, idx);
+            if (err) return err;
+        }
+        PGresult *res = PQexecPrepared(conn, stmt->name, stmt->nparams,
+                                       values, lengths, formats, 0);
+        // 26000: the session lost it (DISCARD ALL, pooler); prepare again once
+        if (attempt == 0 && result_sqlstate_is(res, "26000")) {
+            PQclear(res);
+            s->prepared[idx] = 0;
+            continue;
+        }
+        return res;
+    }
+}
+
+int db_stmt_is_prepared(PGconn *conn, DbStmt *stmt) {
+    int idx = stmt_index(stmt);
+    ConnStmts *s = (conn && idx >= 0) ? conn_stmts(conn) : NULL;
+    return s ? s->prepared[idx] : 0;
+}
+
+void db_stmt_set_prepared(PGconn *conn, DbStmt *stmt, int prepared) {
+    int idx = stmt_index(stmt);
+    ConnStmts *s = (conn && idx >= 0) ? conn_stmts(conn) : NULL;
+    if (s) s->prepared[idx] = prepared ? 1 : 0;
+}
+
+int db_stmt_prepare_all(PGconn *conn) {
+    ConnStmts *s = conn ? conn_stmts(conn) : NULL;
+    if (!s) return -1;
+
+    pthread_mutex_lock(&g_registry_lock);
+    int count = g_registry_count;
+    pthread_mutex_unlock(&g_registry_lock);
+
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        if (s->prepared[i]) continue;
+        PGresult *err = stmt_prepare(conn, g_registry[i], s, i);
+        if (err) {
+            LOG_ERROR(LOG_CAT_DB, "prepare %s failed: %s", g_registry[i]->name,
+                      PQresultErrorMessage(err));
+            PQclear(err);
+            rc = -1;
+        }
+    }
+    return rc;
+}
@@ -3,9 +3,17 @@
 #include <stdlib.h>
 #include <time.h>
 #include "db.h"
+#include "db_pool.h"
 #include "service/auth_service.h"
+#include "service/friend_graph.h"
+#include "service/leaderboard.h"
+#include "service/presence_service.h"
+#include "service/question_bank.h"
 #include "service/quickmode_service.h"
 #include "service/server.h"
+#include "service/user_directory.h"
+#include "service/client_session.h"
+#include "utils/log.h"
 #include <string.h>
 
 int main() {
@@ -30,7 +38,39 @@ int main() {
     if (server_mode && strcmp(server_mode, "1") == 0) {
         const char *port = getenv("SERVER_PORT");
         if (!port) port = "9000";
-        start_server(NULL, port);
+        // SERVER_WORKERS: number of event-loop threads (default: one per CPU)
+        const char *workers = getenv("SERVER_WORKERS");
+        // SERVER_OUTQ_HIGH_WATER: max bytes queued per slow client
+        const char *high_water = getenv("SERVER_OUTQ_HIGH_WATER");
+        if (high_water && atol(high_water) > 0) {
+            client_session_set_high_water((size_t)atol(high_water));
+        }
+        // LOG_LEVEL: e.g. "info" (default) or "warn,onevn=debug"
+        log_init(getenv("LOG_LEVEL"));
+        // DB_POOL_SIZE: connections/threads for background DAO jobs (default 4)
+        const char *pool_size = getenv("DB_POOL_SIZE");
+        if (db_pool_init(conn, pool_size ? atoi(pool_size) : 0) != 0) {
+            printf("DB pool unavailable, DAO jobs run inline.\n");
+        }
+        // Games draw their questions from memory; load them before serving
+        if (question_bank_load() != 0) {
+            printf("Question bank not loaded, retrying on first game.\n");
+        }
+        if (leaderboard_load() != 0) {
+            printf("Leaderboard not loaded, served from the database.\n");
+        }
+        if (question_bank_listen(conn) != 0) {
+            printf("Question listener not started, edits need a restart.\n");
+        }
+        start_server_workers(NULL, port, workers ? atoi(workers) : 0);
+        db_pool_shutdown();
+        question_bank_stop_listening();
+        question_bank_free();
+        user_directory_clear();
+        presence_clear();
+        leaderboard_free();
+        friend_graph_clear();
+        log_shutdown();
         db_disconnect();
         return 0;
     }
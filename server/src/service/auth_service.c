@@ -6,9 +6,13 @@
 #include "service/commands.h"
 #include "service/protocol.h"
 #include "service/friends_service.h"
+#include "service/friend_graph.h"
+#include "service/leaderboard.h"
 #include "service/session_manager.h"
 #include "service/quickmode_service.h"
+#include "service/user_directory.h"
 #include "utils/json.h"
+#include "utils/log.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -16,8 +20,22 @@
 
 #define SESSION_TTL_SECONDS 3600
 
+// Requests used to reach the DAO still JSON-escaped, so accounts created
+// back then store a username/password containing " or \ in escaped form
+static int needs_legacy_escape(const char *s) {
+    return strpbrk(s, "\"\\") != NULL;
+}
+
 AuthResult auth_signup(const char *username, const char *password) {
     int64_t user_id;
+    // Do not hand out a name an old account still holds in escaped form
+    if (needs_legacy_escape(username)) {
+        char *esc_username = util_json_escape(username);
+        User existing;
+        int taken = esc_username && dao_users_find_by_username(esc_username, &existing) == 0;
+        free(esc_username);
+        if (taken) return AUTH_ERR_EXIST;
+    }
     int rc = dao_users_create(username, password, &user_id);
     if (rc == -2) {
         return AUTH_ERR_EXIST;
@@ -25,108 +43,202 @@ AuthResult auth_signup(const char *username, const char *password) {
     if (rc != 0) {
         return AUTH_ERR_DB;
     }
-    printf("[AUTH] Signup OK: user_id=%lld\n", (long long)user_id);
+    leaderboard_put(user_id, username, 0);
+    LOG_INFO(LOG_CAT_AUTH, "Signup OK: user_id=%lld", (long long)user_id);
     return AUTH_OK;
 }
 
+// Retry a failed login with the escaped credentials an old account was
+// stored with. On success the account is moved to the decoded form so it
+// logs in normally from then on. Same return values as dao_users_authenticate.
+static int auth_login_legacy(const char *username, const char *password, User *user) {
+    char *esc_username = util_json_escape(username);
+    char *esc_password = util_json_escape(password);
+    int rc = (esc_username && esc_password)
+        ? dao_users_authenticate(esc_username, esc_password, user) : -1;
+
+    if (rc == 1) {
+        int up = dao_users_update_credentials(user->user_id, username, password);
+        if (up == 0) {
+            snprintf(user->username, sizeof(user->username), "%s", username);
+            LOG_INFO(LOG_CAT_AUTH, "Migrated escaped credentials: user_id=%lld",
+                     (long long)user->user_id);
+        } else {
+            // Keep the escaped row as it is: this fallback still accepts it
+            LOG_WARN(LOG_CAT_AUTH, "Could not migrate escaped credentials for user_id=%lld (%s)",
+                     (long long)user->user_id, up == -2 ? "username taken" : "db error");
+        }
+    }
+    free(esc_username);
+    free(esc_password);
+    return rc;
+}
+
 AuthResult auth_login(const char *username, const char *password,
                       UserSession *out_session) {
-    int64_t user_id = 0;
-    int rc = dao_users_check_password(username, password, &user_id);
+    User user;
+    int rc = dao_users_authenticate(username, password, &user);
+    if (rc == 0 && (needs_legacy_escape(username) || needs_legacy_escape(password))) {
+        rc = auth_login_legacy(username, password, &user);
+    }
     if (rc < 0) {
         return AUTH_ERR_DB;
     }
     if (rc == 0) {
         return AUTH_ERR_CRED;
     }
+    int64_t user_id = user.user_id;
+    user_directory_put(user_id, user.username, user.avatar_img);
 
     if (dao_sessions_create(user_id, SESSION_TTL_SECONDS, out_session) != 0) {
         return AUTH_ERR_DB;
     }
 
-    printf("[AUTH] Login OK: user_id=%lld, token=%s\n",
+    LOG_INFO(LOG_CAT_AUTH, "Login OK: user_id=%lld, token=%s",
            (long long)user_id, out_session->access_token);
     return AUTH_OK;
 }
 
+// Register and login do their DAO work (password hashing included) on the
+// DB pool; the client is answered from its own loop once that is done
+typedef struct {
+    SessionRef ref;
+    char *username;
+    char *password;
+    AuthResult result;
+    UserSession us;
+} AuthJob;
+
+static void auth_job_free(AuthJob *job) {
+    free(job->username);
+    free(job->password);
+    free(job);
+}
+
+static void register_run(void *arg) {
+    AuthJob *job = arg;
+    job->result = auth_signup(job->username, job->password);
+}
+
+static void register_done(void *arg) {
+    AuthJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (sess) {
+        if (job->result == AUTH_OK) protocol_send_simple_ok(sess, CMD_RES_REGISTER);
+        else if (job->result == AUTH_ERR_EXIST) protocol_send_error(sess, CMD_RES_REGISTER, "USERNAME_EXISTS");
+        else protocol_send_error(sess, CMD_RES_REGISTER, "REGISTER_FAILED");
+    }
+    auth_job_free(job);
+}
+
+static void login_run(void *arg) {
+    AuthJob *job = arg;
+    job->result = auth_login(job->username, job->password, &job->us);
+    // Friends are read once here; presence updates use the graph
+    if (job->result == AUTH_OK) friend_graph_load(job->us.user_id);
+}
+
+// Attach a successful login to its connection (runs under the service lock)
+static void login_complete(ClientSession *sess, const UserSession *us) {
+    // SINGLE-SESSION: Invalidate old sessions for this user
+    SessionManager *mgr = session_manager_get_global();
+    if (mgr) {
+        // Find old sessions (excluding current session)
+        ClientSession *old_sess = session_manager_get_by_user_id(us->user_id);
+        if (old_sess && old_sess != sess) {
+            LOG_INFO(LOG_CAT_AUTH, "Invalidating old session for user_id=%lld (fd=%d)",
+                   (long long)us->user_id, old_sess->socket_fd);
+            
+            // Cleanup game sessions (QuickMode)
+            quickmode_cleanup_user(us->user_id);
+            
+            // Notify old client about logout (try to send, but don't fail if socket is closed)
+            protocol_send_response(old_sess, CMD_RES_LOGOUT,
+                "{\"reason\":\"NEW_LOGIN_DETECTED\"}", 35);
+            
+            // Detach the old connection from the user so its disconnect
+            // does not report the user offline, then let its owning
+            // event loop shut it down (after the LOGOUT frame).
+            session_manager_bind_user(old_sess, 0);
+            old_sess->access_token[0] = '\0';
+            session_manager_set_room(old_sess, 0);
+            client_session_close(old_sess);
+        }
+    }
+    
+    // attach to session
+    session_manager_bind_user(sess, us->user_id);
+    strncpy(sess->access_token, us->access_token, sizeof(sess->access_token)-1);
+    
+    // Update status to ONLINE
+    session_manager_update_status(us->user_id, USER_STATUS_ONLINE, 0);
+
+    // reply with token and user_id
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), 
+        "{\"token\": \"%s\", \"user_id\": %lld}", 
+        us->access_token, (long long)us->user_id);
+    protocol_send_response(sess, CMD_RES_LOGIN, buf, (uint32_t)n);
+    
+    // Notify friends that this user is now online
+    // Note: This must be called AFTER setting sess->user_id and sending response
+    // to ensure session is properly registered
+    LOG_DEBUG(LOG_CAT_AUTH, "Notifying friends that user_id=%lld is now online", 
+           (long long)us->user_id);
+    friends_notify_status_change(us->user_id, "online", 0);
+}
+
+static void login_done(void *arg) {
+    AuthJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        // Gone before the login finished: drop the friends loaded for it
+        if (job->result == AUTH_OK && !session_manager_get_by_user_id(job->us.user_id)) {
+            friend_graph_forget(job->us.user_id);
+        }
+    } else if (job->result == AUTH_OK) {
+        login_complete(sess, &job->us);
+    } else {
+        protocol_send_error(sess, CMD_RES_LOGIN, "LOGIN_FAILED");
+    }
+    auth_job_free(job);
+}
+
+// Queue register/login for the DB pool; answers err_code if that fails
+static void auth_submit(ClientSession *sess, const char *payload, uint16_t res_cmd,
+                        void (*run)(void *arg), void (*done)(void *arg), const char *err_code) {
+    JsonObject req;
+    util_json_parse(payload, &req);
+    AuthJob *job = calloc(1, sizeof(AuthJob));
+    if (!job) {
+        protocol_send_error(sess, res_cmd, err_code);
+        return;
+    }
+    job->username = util_json_obj_string(&req, "username");
+    job->password = util_json_obj_string(&req, "password");
+    if (!job->username || !job->password) {
+        protocol_send_error(sess, res_cmd, "INVALID_PAYLOAD");
+        auth_job_free(job);
+        return;
+    }
+    session_ref_init(&job->ref, sess);
+    if (session_manager_submit_db(sess, run, done, job) != 0) {
+        protocol_send_error(sess, res_cmd, err_code);
+        auth_job_free(job);
+    }
+}
+
 // Very small dispatcher implementation.
 void auth_dispatch(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
     (void)payload_len;
     switch (cmd) {
-        case CMD_REQ_REGISTER: {
-            char *username = util_json_get_string(payload, "username");
-            char *password = util_json_get_string(payload, "password");
-            if (!username || !password) {
-                protocol_send_error(sess, CMD_RES_REGISTER, "INVALID_PAYLOAD");
-            } else {
-                AuthResult r = auth_signup(username, password);
-                if (r == AUTH_OK) protocol_send_simple_ok(sess, CMD_RES_REGISTER);
-                else if (r == AUTH_ERR_EXIST) protocol_send_error(sess, CMD_RES_REGISTER, "USERNAME_EXISTS");
-                else protocol_send_error(sess, CMD_RES_REGISTER, "REGISTER_FAILED");
-            }
-            free(username); free(password);
-        } break;
+        case CMD_REQ_REGISTER:
+            auth_submit(sess, payload, CMD_RES_REGISTER, register_run, register_done, "REGISTER_FAILED");
+            break;
 
-        case CMD_REQ_LOGIN: {
-            char *username = util_json_get_string(payload, "username");
-            char *password = util_json_get_string(payload, "password");
-            if (!username || !password) {
-                protocol_send_error(sess, CMD_RES_LOGIN, "INVALID_PAYLOAD");
-            } else {
-                UserSession us;
-                AuthResult r = auth_login(username, password, &us);
-                if (r == AUTH_OK) {
-                    // SINGLE-SESSION: Invalidate old sessions for this user
-                    SessionManager *mgr = session_manager_get_global();
-                    if (mgr) {
-                        // Find old sessions (excluding current session)
-                        ClientSession *old_sess = session_manager_get_by_user_id(us.user_id);
-                        if (old_sess && old_sess != sess) {
-                            printf("[AUTH] Invalidating old session for user_id=%lld (fd=%d)\n",
-                                   (long long)us.user_id, old_sess->socket_fd);
-                            fflush(stdout);
-                            
-                            // Cleanup game sessions (QuickMode)
-                            quickmode_cleanup_user(us.user_id);
-                            
-                            // Notify old client about logout (try to send, but don't fail if socket is closed)
-                            protocol_send_response(old_sess, CMD_RES_LOGOUT,
-                                "{\"reason\":\"NEW_LOGIN_DETECTED\"}", 35);
-                            
-                            // Close old session's socket
-                            // This will trigger disconnect in server loop, which will cleanup the session
-                            shutdown(old_sess->socket_fd, SHUT_RDWR);
-                            close(old_sess->socket_fd);
-                        }
-                    }
-                    
-                    // attach to session
-                    sess->user_id = us.user_id;
-                    strncpy(sess->access_token, us.access_token, sizeof(sess->access_token)-1);
-                    
-                    // Update status to ONLINE
-                    session_manager_update_status(us.user_id, USER_STATUS_ONLINE, 0);
-                    
-                    // reply with token and user_id
-                    char buf[256];
-                    int n = snprintf(buf, sizeof(buf), 
-                        "{\"token\": \"%s\", \"user_id\": %lld}", 
-                        us.access_token, (long long)us.user_id);
-                    protocol_send_response(sess, CMD_RES_LOGIN, buf, (uint32_t)n);
-                    
-                    // Notify friends that this user is now online
-                    // Note: This must be called AFTER setting sess->user_id and sending response
-                    // to ensure session is properly registered
-                    printf("[AUTH] Notifying friends that user_id=%lld is now online\n", 
-                           (long long)us.user_id);
-                    fflush(stdout);
-                    friends_notify_status_change(us.user_id, "online", 0);
-                } else {
-                    protocol_send_error(sess, CMD_RES_LOGIN, "LOGIN_FAILED");
-                }
-            }
-            free(username); free(password);
-        } break;
+        case CMD_REQ_LOGIN:
+            auth_submit(sess, payload, CMD_RES_LOGIN, login_run, login_done, "LOGIN_FAILED");
+            break;
 
         case CMD_REQ_LOGOUT: {
             if (sess && sess->user_id > 0) {
@@ -140,17 +252,17 @@ void auth_dispatch(ClientSession *sess, uint16_t cmd, const char *payload, uint3
                 
                 // Notify friends that user is offline
                 friends_notify_status_change(user_id, "offline", 0);
+                friend_graph_forget(user_id);
                 
                 // Clear session data
-                sess->user_id = 0;
+                session_manager_bind_user(sess, 0);
                 sess->access_token[0] = '\0';
-                sess->room_id = 0;
+                session_manager_set_room(sess, 0);
                 
                 // Send logout success response
                 protocol_send_simple_ok(sess, CMD_RES_LOGOUT);
                 
-                printf("[AUTH] User %lld logged out\n", (long long)user_id);
-                fflush(stdout);
+                LOG_INFO(LOG_CAT_AUTH, "User %lld logged out", (long long)user_id);
             } else {
                 protocol_send_error(sess, CMD_RES_LOGOUT, "NOT_LOGGED_IN");
             }
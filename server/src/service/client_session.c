@@ -3,11 +3,26 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include "service/client_session.h"
 #include "service/protocol.h"
+#include "service/session_manager.h"
+#include "utils/log.h"
+
+static size_t g_out_high_water = OUTQ_DEFAULT_HIGH_WATER;
+
+void client_session_set_high_water(size_t bytes) {
+    if (bytes > 0) g_out_high_water = bytes;
+}
+
+size_t client_session_get_high_water(void) {
+    return g_out_high_water;
+}
 
 ClientSession *client_session_new(int socket_fd) {
     ClientSession *s = calloc(1, sizeof(ClientSession));
@@ -18,88 +33,381 @@ ClientSession *client_session_new(int socket_fd) {
     s->status = USER_STATUS_ONLINE;  // Initialize status
     s->access_token[0] = '\0';
     s->read_buffer_len = 0;
-    s->expected_len = 0;
-    s->pending_cmd = 0;
+    s->out_head = NULL;
+    s->out_tail = NULL;
+    s->out_bytes = 0;
     return s;
 }
 
+SharedFrame *shared_frame_new(const void *data, uint32_t len) {
+    SharedFrame *f = malloc(sizeof(SharedFrame) + len);
+    if (!f) return NULL;
+    f->refcount = 1;
+    f->len = len;
+    if (len && data) memcpy(f->data, data, len);
+    return f;
+}
+
+SharedFrame *shared_frame_ref(SharedFrame *frame) {
+    if (frame) __atomic_add_fetch(&frame->refcount, 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+void shared_frame_unref(SharedFrame *frame) {
+    if (frame && __atomic_sub_fetch(&frame->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(frame);
+    }
+}
+
+static size_t chunk_len(const OutChunk *c) {
+    return c->hdr_len + (c->frame ? c->frame->len : 0);
+}
+
+static void chunk_free(OutChunk *c) {
+    shared_frame_unref(c->frame);
+    free(c);
+}
+
+static void out_queue_clear(ClientSession *sess) {
+    OutChunk *c = sess->out_head;
+    while (c) {
+        OutChunk *next = c->next;
+        chunk_free(c);
+        c = next;
+    }
+    sess->out_head = NULL;
+    sess->out_tail = NULL;
+    sess->out_bytes = 0;
+}
+
 void client_session_free(ClientSession *sess) {
     if (!sess) return;
     // If we had ownership of the socket we could close it here;
     // keep it simple: do not close socket here (caller may manage it).
+    out_queue_clear(sess);
     free(sess);
 }
 
-ssize_t client_session_send(ClientSession *sess, const void *buf, size_t len) {
-    if (!sess || !buf) return -1;
-    if (sess->socket_fd >= 0) {
-        ssize_t n = send(sess->socket_fd, buf, len, 0);
-        return n;
+// Tell the owning epoll whether we are waiting for the socket to drain
+static void set_epollout(ClientSession *sess, int enable) {
+    if (!sess->owner || sess->out_armed == enable) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET | (enable ? EPOLLOUT : 0);
+    ev.data.ptr = sess;
+    if (epoll_ctl(sess->owner->epoll_fd, EPOLL_CTL_MOD, sess->socket_fd, &ev) == 0) {
+        sess->out_armed = enable;
     }
-    // If no socket is present (e.g. unit tests), fall back to stdout
-    size_t written = fwrite(buf, 1, len, stdout);
-    fflush(stdout);
-    return (ssize_t)written;
 }
 
-int client_session_read_packet(ClientSession *sess, uint16_t *cmd, char **payload, uint32_t *payload_len) {
-	if (!sess || sess->socket_fd < 0) return -1;
+// Give up on a client: drop its queue and let the read path disconnect it
+static void mark_closing(ClientSession *sess, const char *reason) {
+    if (sess->closing) return;
+    sess->closing = 1;
+    LOG_WARN(LOG_CAT_SESSION, "closing fd=%d user_id=%lld: %s (queued=%zu)",
+            sess->socket_fd, (long long)sess->user_id, reason, sess->out_bytes);
+    out_queue_clear(sess);
+    shutdown(sess->socket_fd, SHUT_RDWR);
+}
 
-	// Read available data into buffer
-	ssize_t n = recv(sess->socket_fd, 
-	                 sess->read_buffer + sess->read_buffer_len,
-	                 READ_BUFFER_SIZE - sess->read_buffer_len, 0);
+// Drop queued low-priority frames that have not started going out.
+static void drop_low_priority(ClientSession *sess) {
+    OutChunk **pp = &sess->out_head;
+    OutChunk *prev = NULL;
+    while (*pp) {
+        OutChunk *c = *pp;
+        if (c->priority == SEND_PRIORITY_LOW && c->off == 0) {
+            *pp = c->next;
+            sess->out_bytes -= chunk_len(c);
+            sess->dropped_frames++;
+            chunk_free(c);
+        } else {
+            prev = c;
+            pp = &c->next;
+        }
+    }
+    sess->out_tail = prev;
+}
 
-	if (n <= 0) {
-		// Connection closed or error
+// Gather write (writev semantics, via sendmsg for MSG_NOSIGNAL)
+static ssize_t write_iov(int fd, struct iovec *iov, int iovcnt) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)iovcnt;
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+// Append the unsent part of a chunk (starting at off) to iov
+static int chunk_iov(const OutChunk *c, size_t off, struct iovec *iov, int max) {
+    int cnt = 0;
+    if (off < c->hdr_len && cnt < max) {
+        iov[cnt].iov_base = (void *)(c->hdr + off);
+        iov[cnt].iov_len = c->hdr_len - off;
+        cnt++;
+        off = c->hdr_len;
+    }
+    if (c->frame && off < chunk_len(c) && cnt < max) {
+        iov[cnt].iov_base = c->frame->data + (off - c->hdr_len);
+        iov[cnt].iov_len = chunk_len(c) - off;
+        cnt++;
+    }
+    return cnt;
+}
+
+int client_session_flush(ClientSession *sess) {
+    if (!sess || sess->socket_fd < 0) return -1;
+    if (sess->closing) return -1;
+
+    while (sess->out_head) {
+        // Gather as many queued chunks as fit into one write
+        struct iovec iov[OUT_IOV_MAX];
+        int cnt = 0;
+        for (OutChunk *c = sess->out_head; c && cnt <= OUT_IOV_MAX - 2; c = c->next) {
+            cnt += chunk_iov(c, c->off, iov + cnt, OUT_IOV_MAX - cnt);
+        }
+
+        ssize_t n = write_iov(sess->socket_fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Kernel buffer full: wait for EPOLLOUT
+                set_epollout(sess, 1);
+                return 0;
+            }
+            mark_closing(sess, strerror(errno));
+            return -1;
+        }
+
+        // Retire fully written chunks
+        size_t written = (size_t)n;
+        sess->out_bytes -= written;
+        while (written > 0 && sess->out_head) {
+            OutChunk *c = sess->out_head;
+            size_t rem = chunk_len(c) - c->off;
+            if (written < rem) {
+                c->off += written;
+                break;
+            }
+            written -= rem;
+            sess->out_head = c->next;
+            chunk_free(c);
+        }
+        if (!sess->out_head) sess->out_tail = NULL;
+    }
+
+    set_epollout(sess, 0);
+    if (sess->close_pending) shutdown(sess->socket_fd, SHUT_RDWR);
+    return 0;
+}
+
+// Sessions owned by another event loop are written by that loop. The owner
+// itself must also go through its mailbox while frames posted there for
+// this connection are still undelivered, or it would overtake them.
+static int must_post(const ClientSession *sess) {
+    if (!sess->owner) return 0;
+    if (sess->owner != session_manager_get_current()) return 1;
+    return !sess->owner->draining &&
+           __atomic_load_n(&sess->mailbox_pending, __ATOMIC_RELAXED) > 0;
+}
+
+ssize_t client_session_sendv(ClientSession *sess, const void *hdr, size_t hdr_len,
+                             const char *payload, size_t payload_len,
+                             SharedFrame *frame, int priority) {
+    if (!sess || hdr_len > OUT_HEADER_MAX) return -1;
+    if (!payload) payload_len = 0;
+    size_t len = hdr_len + payload_len;
+
+    if (must_post(sess)) {
+        SharedFrame *ref = frame ? shared_frame_ref(frame)
+                                 : (payload_len ? shared_frame_new(payload, (uint32_t)payload_len) : NULL);
+        if (payload_len && !ref) return -1;
+        if (session_manager_post_send(sess->owner, sess, hdr, hdr_len, ref, priority, 0) < 0) {
+            shared_frame_unref(ref);
+            return -1;
+        }
+        return (ssize_t)len;
+    }
+    if (sess->socket_fd < 0) {
+        // If no socket is present (e.g. unit tests), fall back to stdout
+        if (hdr_len) fwrite(hdr, 1, hdr_len, stdout);
+        if (payload_len) fwrite(payload, 1, payload_len, stdout);
+        fflush(stdout);
+        return (ssize_t)len;
+    }
+    if (sess->closing) return -1;
+    if (len == 0) return 0;
+
+    // Backpressure: the client is not keeping up with what we send it
+    if (sess->out_bytes + len > g_out_high_water) {
+        drop_low_priority(sess);
+        if (priority == SEND_PRIORITY_LOW) {
+            sess->dropped_frames++;
+            return 0;
+        }
+        if (sess->out_bytes + len > g_out_high_water) {
+            mark_closing(sess, "outbound queue over high-water mark");
+            return -1;
+        }
+    }
+
+    size_t off = 0;
+    if (!sess->out_head) {
+        // Nothing queued: write header and payload straight to the socket
+        struct iovec iov[2];
+        int cnt = 0;
+        if (hdr_len) {
+            iov[cnt].iov_base = (void *)hdr;
+            iov[cnt].iov_len = hdr_len;
+            cnt++;
+        }
+        if (payload_len) {
+            iov[cnt].iov_base = (void *)payload;
+            iov[cnt].iov_len = payload_len;
+            cnt++;
+        }
+        ssize_t n = write_iov(sess->socket_fd, iov, cnt);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                mark_closing(sess, strerror(errno));
+                return -1;
+            }
+            n = 0;
+        }
+        off = (size_t)n;
+        if (off == len) return (ssize_t)len;
+    }
+
+    // Queue whatever the kernel did not take; the payload is shared, not copied
+    OutChunk *c = malloc(sizeof(OutChunk));
+    SharedFrame *ref = NULL;
+    if (c && payload_len) {
+        ref = frame ? shared_frame_ref(frame) : shared_frame_new(payload, (uint32_t)payload_len);
+    }
+    if (!c || (payload_len && !ref)) {
+        free(c);
+        mark_closing(sess, "out of memory");
+        return -1;
+    }
+    c->next = NULL;
+    c->frame = ref;
+    if (hdr_len) memcpy(c->hdr, hdr, hdr_len);
+    c->hdr_len = (uint8_t)hdr_len;
+    c->off = off;
+    // A partially written frame must complete, whatever its priority
+    c->priority = off > 0 ? SEND_PRIORITY_NORMAL : priority;
+    if (sess->out_tail) {
+        sess->out_tail->next = c;
+    } else {
+        sess->out_head = c;
+    }
+    sess->out_tail = c;
+    sess->out_bytes += len - off;
+
+    set_epollout(sess, 1);
+    return (ssize_t)len;
+}
+
+ssize_t client_session_send_priority(ClientSession *sess, const void *buf, size_t len, int priority) {
+    if (!buf) return -1;
+    return client_session_sendv(sess, NULL, 0, buf, len, NULL, priority);
+}
+
+ssize_t client_session_send(ClientSession *sess, const void *buf, size_t len) {
+    return client_session_send_priority(sess, buf, len, SEND_PRIORITY_NORMAL);
+}
+
+void client_session_close(ClientSession *sess) {
+    if (!sess || sess->socket_fd < 0) return;
+    if (must_post(sess)) {
+        session_manager_post_send(sess->owner, sess, NULL, 0, NULL, SEND_PRIORITY_NORMAL, 1);
+        return;
+    }
+    // Never close() here: the owning loop still has the fd registered.
+    // shutdown() makes the next read fail and takes the disconnect path.
+    if (sess->out_head) {
+        sess->close_pending = 1;  // flush finishes the queue first
+        return;
+    }
+    shutdown(sess->socket_fd, SHUT_RDWR);
+}
+
+// Decode one complete frame at offset off of the buffer, without copying.
+// Returns the frame size in bytes, 0 if incomplete, -1 if invalid.
+static ssize_t decode_frame(ClientSession *sess, size_t off, ClientFrame *frame) {
+	size_t avail = sess->read_buffer_len - off;
+	if (avail < sizeof(PacketHeader)) return 0;
+
+	PacketHeader hdr;
+	memcpy(&hdr, sess->read_buffer + off, sizeof(hdr));
+	uint32_t plen = ntohl(hdr.length);
+	if (plen > READ_BUFFER_SIZE - sizeof(PacketHeader)) {
+		// Packet too large
 		return -1;
 	}
+	size_t total = sizeof(PacketHeader) + plen;
+	if (avail < total) return 0;
 
-	sess->read_buffer_len += n;
+	frame->cmd = ntohs(hdr.cmd);
+	frame->payload_len = plen;
+	frame->payload = plen > 0 ? sess->read_buffer + off + sizeof(PacketHeader) : NULL;
+	frame->end = off + total;
+	return (ssize_t)total;
+}
 
-	// If we haven't read the header yet, try to read it
-	if (sess->expected_len == 0) {
-		if (sess->read_buffer_len < sizeof(PacketHeader)) {
-			// Need more data for header
-			return 0;
-		}
+ClientReadStatus client_session_read_frames(ClientSession *sess, ClientFrame *frames,
+                                            int max_frames, int *nframes) {
+	*nframes = 0;
+	if (!sess || sess->socket_fd < 0) return CLIENT_READ_CLOSED;
 
-		// Parse header
-		PacketHeader *hdr = (PacketHeader *)sess->read_buffer;
-		sess->pending_cmd = ntohs(hdr->cmd);
-		sess->expected_len = sizeof(PacketHeader) + ntohl(hdr->length);
+	// Frames handed out by the previous call have been dispatched by now
+	if (sess->read_consumed > 0) {
+		memmove(sess->read_buffer, sess->read_buffer + sess->read_consumed,
+		        sess->read_buffer_len - sess->read_consumed);
+		sess->read_buffer_len -= sess->read_consumed;
+		sess->read_consumed = 0;
+	}
 
-		if (sess->expected_len > READ_BUFFER_SIZE) {
-			// Packet too large
-			return -1;
+	// Read available data into buffer
+	ClientReadStatus status = CLIENT_READ_DRAINED;
+	while (sess->read_buffer_len < READ_BUFFER_SIZE) {
+		ssize_t n = recv(sess->socket_fd,
+		                 sess->read_buffer + sess->read_buffer_len,
+		                 READ_BUFFER_SIZE - sess->read_buffer_len, 0);
+		if (n > 0) {
+			sess->read_buffer_len += (size_t)n;
+			continue;
 		}
-	}
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
 
-	// Check if we have complete packet
-	if (sess->read_buffer_len < sess->expected_len) {
-		// Need more data
-		return 0;
+		// Connection closed or error
+		status = CLIENT_READ_CLOSED;
+		break;
 	}
-
-	// Complete packet received
-	PacketHeader *hdr = (PacketHeader *)sess->read_buffer;
-	*cmd = sess->pending_cmd;
-	uint32_t plen = ntohl(hdr->length);
-	*payload_len = plen;
-
-	if (plen > 0) {
-		*payload = malloc(plen + 1);
-		if (!*payload) return -1;
-		memcpy(*payload, sess->read_buffer + sizeof(PacketHeader), plen);
-		(*payload)[plen] = '\0';
-	} else {
-		*payload = NULL;
+	// A full buffer means the socket may still hold data
+	if (status == CLIENT_READ_DRAINED && sess->read_buffer_len == READ_BUFFER_SIZE) {
+		status = CLIENT_READ_MORE;
 	}
 
-	// Reset for next packet
-	sess->read_buffer_len = 0;
-	sess->expected_len = 0;
-	sess->pending_cmd = 0;
+	// Decode every complete frame in place
+	size_t off = 0;
+	while (*nframes < max_frames) {
+		ssize_t used = decode_frame(sess, off, &frames[*nframes]);
+		if (used < 0) {
+			status = CLIENT_READ_CLOSED;
+			break;
+		}
+		if (used == 0) break;
+		off += (size_t)used;
+		(*nframes)++;
+	}
+	sess->read_consumed = off;
 
-	return 1;
+	if (status == CLIENT_READ_DRAINED && *nframes == max_frames) {
+		status = CLIENT_READ_MORE;
+	}
+	return status;
 }
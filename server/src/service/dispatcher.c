@@ -12,13 +12,346 @@
 #include "service/protocol.h"
 #include "service/session_manager.h"
 #include "utils/json.h"
+#include "utils/log.h"
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+// Room requests do their DAO work on the DB pool (see
+// session_manager_submit_db); room state and broadcasts are applied in done,
+// back on the client's loop under the service lock.
+typedef enum { ROOM_LEAVE_ELIMINATED, ROOM_LEAVE_CLOSED, ROOM_LEAVE_LEFT } RoomLeaveKind;
 
+typedef struct {
+    SessionRef ref;
+    int64_t user_id;
+    int64_t room_id;
+    int easy_count, medium_count, hard_count;
+    // Results
+    int rc;
+    int members_rc;
+    void *json;                 // members (create/join/leave) or rooms (list)
+    RoomLeaveKind leave;
+} RoomJob;
 
+static RoomJob *room_job_new(ClientSession *sess) {
+    RoomJob *job = calloc(1, sizeof(RoomJob));
+    if (!job) return NULL;
+    session_ref_init(&job->ref, sess);
+    job->user_id = sess->user_id;
+    job->rc = -1;
+    job->members_rc = -1;
+    return job;
+}
+
+static void room_job_free(RoomJob *job) {
+    free(job->json);
+    free(job);
+}
+
+static void room_submit(ClientSession *sess, RoomJob *job,
+                        void (*run)(void *arg), void (*done)(void *arg),
+                        uint16_t res_cmd, const char *err_code) {
+    if (!job) {
+        protocol_send_error(sess, res_cmd, err_code);
+        return;
+    }
+    if (session_manager_submit_db(sess, run, done, job) != 0) {
+        room_job_free(job);
+        protocol_send_error(sess, res_cmd, err_code);
+    }
+}
+
+static void create_room_run(void *arg) {
+    RoomJob *job = arg;
+    job->rc = dao_rooms_create_with_config(job->user_id, job->easy_count, job->medium_count,
+                                           job->hard_count, &job->room_id);
+    // Get room members and send back with members list
+    if (job->rc == 0) job->members_rc = dao_rooms_get_members(job->room_id, &job->json);
+}
+
+static void create_room_done(void *arg) {
+    RoomJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        room_job_free(job);
+        return;
+    }
+    if (job->rc == 0) {
+        // Set room_id in session
+        session_manager_set_room(sess, job->room_id);
+        
+        if (job->members_rc == 0) {
+            char buf[2048];
+            snprintf(buf, sizeof(buf), "{\"room_id\": %ld, \"members\": %s}", 
+                    job->room_id, (char*)job->json);
+            protocol_send_response(sess, CMD_RES_CREATE_ROOM, buf, strlen(buf));
+        } else {
+            // Fallback
+            char buf[128];
+            snprintf(buf, sizeof(buf), "{\"room_id\": %ld}", job->room_id);
+            protocol_send_response(sess, CMD_RES_CREATE_ROOM, buf, strlen(buf));
+        }
+    } else {
+        protocol_send_error(sess, CMD_RES_CREATE_ROOM, "CREATE_ROOM_FAILED");
+    }
+    room_job_free(job);
+}
+
+static void join_room_run(void *arg) {
+    RoomJob *job = arg;
+    job->rc = dao_rooms_join(job->room_id, job->user_id, 0);
+    // Get room members and send back
+    if (job->rc == 0) job->members_rc = dao_rooms_get_members(job->room_id, &job->json);
+}
+
+static void join_room_done(void *arg) {
+    RoomJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    long long room_id = (long long)job->room_id;
+    if (!sess) {
+        room_job_free(job);
+        return;
+    }
+    if (job->rc == 0) {
+        // Set room_id in session
+        session_manager_set_room(sess, (int64_t)room_id);
+        
+        // Update status to IN_WAITING_ROOM
+        session_manager_update_status(job->user_id, USER_STATUS_IN_WAITING_ROOM, (int64_t)room_id);
+        friends_notify_status_change(job->user_id, "in_waiting_room", (int64_t)room_id);
+        
+        if (job->members_rc == 0) {
+            char response_buf[2048];
+            snprintf(response_buf, sizeof(response_buf), 
+                "{\"room_id\": %lld, \"members\": %s}", 
+                room_id, (char*)job->json);
+            protocol_send_response(sess, CMD_RES_JOIN_ROOM, response_buf, strlen(response_buf));
+            
+            // Broadcast room update to all members in the room
+            char notify_buf[2048];
+            snprintf(notify_buf, sizeof(notify_buf), 
+                "{\"members\": %s}", (char*)job->json);
+            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
+                                              notify_buf, strlen(notify_buf));
+        } else {
+            // Fallback if can't get members
+            char response_buf[128];
+            snprintf(response_buf, sizeof(response_buf), 
+                "{\"room_id\": %lld, \"status\": \"success\"}", room_id);
+            protocol_send_response(sess, CMD_RES_JOIN_ROOM, response_buf, strlen(response_buf));
+        }
+    } else {
+        protocol_send_error(sess, CMD_RES_JOIN_ROOM, "JOIN_ROOM_FAILED");
+    }
+    room_job_free(job);
+}
+
+static void leave_room_run(void *arg) {
+    RoomJob *job = arg;
+    int64_t room_id = job->room_id;
+
+    // Check room status and owner (one round trip)
+    room_status_t room_status = ROOM_STATUS_WAITING;
+    int64_t owner_id = 0;
+    DbBatch batch;
+    if (db_batch_begin(&batch) == 0) {
+        dao_rooms_queue_get_status(&batch, room_id, &room_status);
+        dao_rooms_queue_get_owner(&batch, room_id, &owner_id);
+    }
+    int has_status = (db_batch_run(&batch) == 0);
+    int is_owner = has_status && owner_id == job->user_id;
+    
+    LOG_DEBUG(LOG_CAT_DISPATCHER, "Room status: has_status=%d, status=%d", has_status, room_status);
+    
+    // During game (IN_PROGRESS or STARTING): treat everyone equally - just eliminate
+    if (has_status && (room_status == ROOM_STATUS_IN_PROGRESS || room_status == ROOM_STATUS_STARTING)) {
+        // Mark in database for persistence, fetching the
+        // updated members list in the same round trip
+        job->leave = ROOM_LEAVE_ELIMINATED;
+        if (db_batch_begin(&batch) == 0) {
+            dao_rooms_queue_mark_eliminated(&batch, room_id, job->user_id);
+            dao_rooms_queue_get_members(&batch, room_id, &job->json);
+        }
+        job->members_rc = db_batch_run(&batch);
+        job->rc = 0;
+    }
+    // Before game starts (WAITING): owner leaving = delete room
+    else if (is_owner && has_status && room_status == ROOM_STATUS_WAITING) {
+        job->leave = ROOM_LEAVE_CLOSED;
+        job->rc = dao_rooms_delete(room_id);
+    }
+    // Regular member leaving before game starts: leave and fetch the
+    // remaining members in one round trip
+    else {
+        job->leave = ROOM_LEAVE_LEFT;
+        if (db_batch_begin(&batch) == 0) {
+            dao_rooms_queue_leave(&batch, room_id, job->user_id);
+            dao_rooms_queue_get_members(&batch, room_id, &job->json);
+        }
+        job->rc = db_batch_run(&batch);
+        job->members_rc = job->rc;
+    }
+}
+
+static void leave_room_done(void *arg) {
+    RoomJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    long long room_id = (long long)job->room_id;
+    int64_t user_id = job->user_id;
+
+    if (job->leave == ROOM_LEAVE_ELIMINATED) {
+        LOG_DEBUG(LOG_CAT_DISPATCHER, "Player user_id=%ld leaving room_id=%lld during game", 
+               (long)user_id, room_id);
+        
+        // Mark player as eliminated in game state (in-memory)
+        // This ensures leaderboard will show correct eliminated status
+        int eliminated_result = onevn_eliminate_player_by_room(room_id, user_id);
+        LOG_DEBUG(LOG_CAT_DISPATCHER, "onevn_eliminate_player_by_room returned: %d", eliminated_result);
+        
+        if (sess) {
+            // Remove session from room so broadcast won't send to this player anymore
+            session_manager_set_room(sess, 0);
+            
+            // Update status back to ONLINE and notify friends
+            session_manager_update_status(user_id, USER_STATUS_ONLINE, 0);
+            session_broadcast_friend_status(user_id);
+            
+            char response_buf[128];
+            snprintf(response_buf, sizeof(response_buf), 
+                "{\"room_id\": %lld, \"status\": \"eliminated\"}", room_id);
+            protocol_send_response(sess, CMD_RES_LEAVE_ROOM, response_buf, strlen(response_buf));
+        }
+        
+        // Broadcast elimination notification 
+        char elim_buf[128];
+        snprintf(elim_buf, sizeof(elim_buf), 
+            "{\"user_id\": %lld, \"round\": 0}", (long long)user_id);
+        session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ELIMINATION, 
+                                          elim_buf, strlen(elim_buf));
+        
+        // Broadcast updated members list with eliminated status
+        if (job->members_rc == 0) {
+            char notify_buf[2048];
+            snprintf(notify_buf, sizeof(notify_buf), 
+                "{\"members\": %s}", (char*)job->json);
+            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
+                                              notify_buf, strlen(notify_buf));
+            LOG_DEBUG(LOG_CAT_DISPATCHER, "Broadcast ROOM_UPDATE with members: %s", (char*)job->json);
+        }
+    } else if (job->rc != 0) {
+        if (sess) {
+            protocol_send_error(sess, CMD_RES_LEAVE_ROOM,
+                job->leave == ROOM_LEAVE_CLOSED ? "DELETE_ROOM_FAILED" : "LEAVE_ROOM_FAILED");
+        }
+    } else {
+        if (sess) {
+            // Update status back to ONLINE and notify friends
+            session_manager_update_status(user_id, USER_STATUS_ONLINE, 0);
+            session_broadcast_friend_status(user_id);
+            
+            char response_buf[128];
+            snprintf(response_buf, sizeof(response_buf), 
+                "{\"room_id\": %lld, \"status\": \"%s\"}", room_id,
+                job->leave == ROOM_LEAVE_CLOSED ? "room_closed" : "left");
+            protocol_send_response(sess, CMD_RES_LEAVE_ROOM, response_buf, strlen(response_buf));
+        }
+        
+        if (job->leave == ROOM_LEAVE_CLOSED) {
+            // Notify all remaining members in room that it was closed
+            char notify_buf[256];
+            snprintf(notify_buf, sizeof(notify_buf), 
+                "{\"room_id\": %lld, \"reason\": \"owner_left\"}", room_id);
+            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_CLOSED, 
+                                              notify_buf, strlen(notify_buf));
+        } else {
+            // Notify other members about the departure
+            char notify_buf[2048];
+            snprintf(notify_buf, sizeof(notify_buf), 
+                "{\"members\": %s}", (char*)job->json);
+            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
+                                              notify_buf, strlen(notify_buf));
+        }
+    }
+    room_job_free(job);
+}
+
+static void list_rooms_run(void *arg) {
+    RoomJob *job = arg;
+    job->rc = dao_rooms_list_waiting(&job->json);
+}
+
+static void list_rooms_done(void *arg) {
+    RoomJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (sess) {
+        if (job->rc == 0) {
+            const char *json_str = (const char *)job->json;
+            protocol_send_response(sess, CMD_RES_LIST_ROOMS, json_str, strlen(json_str));
+        } else {
+            protocol_send_error(sess, CMD_RES_LIST_ROOMS, "LIST_ROOMS_FAILED");
+        }
+    }
+    room_job_free(job);
+}
+
+static void room_dispatch(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
+    switch (cmd) {
+        case CMD_REQ_CREATE_ROOM: {
+            RoomJob *job = room_job_new(sess);
+            if (job) {
+                // Parse question config from payload
+                job->easy_count = 5; job->medium_count = 5; job->hard_count = 5;  // defaults
+                JsonObject req;
+                util_json_parse(payload, &req);
+                util_json_obj_int(&req, "easy_count", &job->easy_count);
+                util_json_obj_int(&req, "medium_count", &job->medium_count);
+                util_json_obj_int(&req, "hard_count", &job->hard_count);
+            }
+            room_submit(sess, job, create_room_run, create_room_done,
+                        CMD_RES_CREATE_ROOM, "CREATE_ROOM_FAILED");
+        } break;
+        case CMD_REQ_JOIN_ROOM: {
+            long long room_id = 0; // parse
+            JsonObject req;
+            util_json_parse(payload, &req);
+            util_json_obj_int64(&req, "room_id", &room_id);
+            RoomJob *job = room_job_new(sess);
+            if (job) job->room_id = (int64_t)room_id;
+            room_submit(sess, job, join_room_run, join_room_done,
+                        CMD_RES_JOIN_ROOM, "JOIN_ROOM_FAILED");
+        } break;
+        case CMD_REQ_LEAVE_ROOM: {
+            long long room_id = 0; // parse
+            JsonObject req;
+            util_json_parse(payload, &req);
+            util_json_obj_int64(&req, "room_id", &room_id);
+            
+            LOG_DEBUG(LOG_CAT_DISPATCHER, "CMD_REQ_LEAVE_ROOM: user_id=%ld, room_id=%lld", 
+                   (long)sess->user_id, (long long)room_id);
+            
+            RoomJob *job = room_job_new(sess);
+            if (job) job->room_id = (int64_t)room_id;
+            room_submit(sess, job, leave_room_run, leave_room_done,
+                        CMD_RES_LEAVE_ROOM, "LEAVE_ROOM_FAILED");
+        } break;
+        case CMD_REQ_LIST_ROOMS:
+            room_submit(sess, room_job_new(sess), list_rooms_run, list_rooms_done,
+                        CMD_RES_LIST_ROOMS, "LIST_ROOMS_FAILED");
+            break;
+        case CMD_REQ_START_GAME: {
+            // Start 1vN game - handled by onevn_service
+            onevn_dispatch(sess, cmd, payload, payload_len);
+        } break;
+        case CMD_REQ_INVITE_FRIEND:
+        case CMD_REQ_RESPOND_INVITE:
+            friends_dispatch(sess, cmd, payload, payload_len);
+            break;
+        default:
+            protocol_send_error(sess, cmd, "UNKNOWN_ROOM_CMD");
+    }
+}
 
 void dispatcher_handle_packet(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
     uint8_t major = (cmd & 0xFF00) >> 8;
@@ -38,213 +371,7 @@ void dispatcher_handle_packet(ClientSession *sess, uint16_t cmd, const char *pay
             break;
 
         case 0x04: // Room
-            switch (cmd) {
-                case CMD_REQ_CREATE_ROOM: {
-                    // Parse question config from payload
-                    int easy_count = 5, medium_count = 5, hard_count = 5;  // defaults
-                    util_json_get_int(payload, "easy_count", &easy_count);
-                    util_json_get_int(payload, "medium_count", &medium_count);
-                    util_json_get_int(payload, "hard_count", &hard_count);
-                    
-                    int64_t room_id;
-                    if (dao_rooms_create_with_config(sess->user_id, easy_count, medium_count, hard_count, &room_id) == 0) {
-                        // Set room_id in session
-                        session_manager_set_room(sess, room_id);
-                        
-                        // Get room members and send back with members list
-                        void *members_json = NULL;
-                        if (dao_rooms_get_members(room_id, &members_json) == 0) {
-                            char buf[2048];
-                            snprintf(buf, sizeof(buf), "{\"room_id\": %ld, \"members\": %s}", 
-                                    room_id, (char*)members_json);
-                            protocol_send_response(sess, CMD_RES_CREATE_ROOM, buf, strlen(buf));
-                            free(members_json);
-                        } else {
-                            // Fallback
-                            char buf[128];
-                            snprintf(buf, sizeof(buf), "{\"room_id\": %ld}", room_id);
-                            protocol_send_response(sess, CMD_RES_CREATE_ROOM, buf, strlen(buf));
-                        }
-                    } else {
-                        protocol_send_error(sess, CMD_RES_CREATE_ROOM, "CREATE_ROOM_FAILED");
-                    }
-                } break;
-                case CMD_REQ_JOIN_ROOM: {
-                    long long room_id = 0; // parse
-                    util_json_get_int64(payload, "room_id", &room_id);
-                    if (dao_rooms_join(room_id, sess->user_id, 0) == 0) {
-                        // Set room_id in session
-                        session_manager_set_room(sess, (int64_t)room_id);
-                        
-                        // Update status to IN_WAITING_ROOM
-                        session_manager_update_status(sess->user_id, USER_STATUS_IN_WAITING_ROOM, (int64_t)room_id);
-                        friends_notify_status_change(sess->user_id, "in_waiting_room", (int64_t)room_id);
-                        
-                        // Get room members and send back
-                        void *members_json = NULL;
-                        if (dao_rooms_get_members(room_id, &members_json) == 0) {
-                            char response_buf[2048];
-                            snprintf(response_buf, sizeof(response_buf), 
-                                "{\"room_id\": %lld, \"members\": %s}", 
-                                room_id, (char*)members_json);
-                            protocol_send_response(sess, CMD_RES_JOIN_ROOM, response_buf, strlen(response_buf));
-                            
-                            // Broadcast room update to all members in the room
-                            char notify_buf[2048];
-                            snprintf(notify_buf, sizeof(notify_buf), 
-                                "{\"members\": %s}", (char*)members_json);
-                            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
-                                                              notify_buf, strlen(notify_buf));
-                            
-                            free(members_json);
-                        } else {
-                            // Fallback if can't get members
-                            char response_buf[128];
-                            snprintf(response_buf, sizeof(response_buf), 
-                                "{\"room_id\": %lld, \"status\": \"success\"}", room_id);
-                            protocol_send_response(sess, CMD_RES_JOIN_ROOM, response_buf, strlen(response_buf));
-                        }
-                    } else {
-                        protocol_send_error(sess, CMD_RES_JOIN_ROOM, "JOIN_ROOM_FAILED");
-                    }
-                } break;
-                case CMD_REQ_LEAVE_ROOM: {
-                    long long room_id = 0; // parse
-                    util_json_get_int64(payload, "room_id", &room_id);
-                    
-                    printf("[DISPATCHER] CMD_REQ_LEAVE_ROOM: user_id=%ld, room_id=%lld\n", 
-                           (long)sess->user_id, (long long)room_id);
-                    fflush(stdout);
-                    
-                    // Check room status
-                    room_status_t room_status;
-                    int has_status = (dao_rooms_get_status(room_id, &room_status) == 0);
-                    
-                    printf("[DISPATCHER] Room status: has_status=%d, status=%d\n", has_status, room_status);
-                    fflush(stdout);
-                    
-                    // Check if user is the room owner
-                    int64_t owner_id = 0;
-                    int is_owner = (dao_rooms_get_owner(room_id, &owner_id) == 0 && owner_id == sess->user_id);
-                    
-                    // During game (IN_PROGRESS or STARTING): treat everyone equally - just eliminate
-                    if (has_status && (room_status == ROOM_STATUS_IN_PROGRESS || room_status == ROOM_STATUS_STARTING)) {
-                        printf("[DISPATCHER] Player user_id=%ld leaving room_id=%lld during game\n", 
-                               (long)sess->user_id, (long long)room_id);
-                        fflush(stdout);
-                        
-                        // Mark player as eliminated in game state (in-memory)
-                        // This ensures leaderboard will show correct eliminated status
-                        int eliminated_result = onevn_eliminate_player_by_room(room_id, sess->user_id);
-                        printf("[DISPATCHER] onevn_eliminate_player_by_room returned: %d\n", eliminated_result);
-                        fflush(stdout);
-                        
-                        // Also mark in database for persistence
-                        dao_rooms_mark_eliminated(room_id, sess->user_id);
-                        
-                        // Remove session from room so broadcast won't send to this player anymore
-                        session_manager_set_room(sess, 0);
-                        
-                        // Update status back to ONLINE and notify friends
-                        session_manager_update_status(sess->user_id, USER_STATUS_ONLINE, 0);
-                        session_broadcast_friend_status(sess->user_id);
-                        
-                        char response_buf[128];
-                        snprintf(response_buf, sizeof(response_buf), 
-                            "{\"room_id\": %lld, \"status\": \"eliminated\"}", room_id);
-                        protocol_send_response(sess, CMD_RES_LEAVE_ROOM, response_buf, strlen(response_buf));
-                        
-                        // Broadcast elimination notification 
-                        char elim_buf[128];
-                        snprintf(elim_buf, sizeof(elim_buf), 
-                            "{\"user_id\": %lld, \"round\": 0}", sess->user_id);
-                        session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ELIMINATION, 
-                                                          elim_buf, strlen(elim_buf));
-                        
-                        // Get and broadcast updated members list with eliminated status
-                        void *members_json = NULL;
-                        if (dao_rooms_get_members(room_id, &members_json) == 0) {
-                            char notify_buf[2048];
-                            snprintf(notify_buf, sizeof(notify_buf), 
-                                "{\"members\": %s}", (char*)members_json);
-                            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
-                                                              notify_buf, strlen(notify_buf));
-                            printf("[DISPATCHER] Broadcast ROOM_UPDATE with members: %s\n", (char*)members_json);
-                            fflush(stdout);
-                            free(members_json);
-                        }
-                    }
-                    // Before game starts (WAITING): owner leaving = delete room
-                    else if (is_owner && has_status && room_status == ROOM_STATUS_WAITING) {
-                        // Owner leaving before game starts → Delete entire room
-                        if (dao_rooms_delete(room_id) == 0) {
-                            // Update status back to ONLINE and notify friends
-                            session_manager_update_status(sess->user_id, USER_STATUS_ONLINE, 0);
-                            session_broadcast_friend_status(sess->user_id);
-                            
-                            char response_buf[128];
-                            snprintf(response_buf, sizeof(response_buf), 
-                                "{\"room_id\": %lld, \"status\": \"room_closed\"}", room_id);
-                            protocol_send_response(sess, CMD_RES_LEAVE_ROOM, response_buf, strlen(response_buf));
-                            
-                            // Notify all remaining members in room that it was closed
-                            char notify_buf[256];
-                            snprintf(notify_buf, sizeof(notify_buf), 
-                                "{\"room_id\": %lld, \"reason\": \"owner_left\"}", room_id);
-                            session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_CLOSED, 
-                                                              notify_buf, strlen(notify_buf));
-                        } else {
-                            protocol_send_error(sess, CMD_RES_LEAVE_ROOM, "DELETE_ROOM_FAILED");
-                        }
-                    }
-                    // Regular member leaving before game starts
-                    else {
-                        if (dao_rooms_leave(room_id, sess->user_id) == 0) {
-                            // Update status back to ONLINE and notify friends
-                            session_manager_update_status(sess->user_id, USER_STATUS_ONLINE, 0);
-                            session_broadcast_friend_status(sess->user_id);
-                            
-                            char response_buf[128];
-                            snprintf(response_buf, sizeof(response_buf), 
-                                "{\"room_id\": %lld, \"status\": \"left\"}", room_id);
-                            protocol_send_response(sess, CMD_RES_LEAVE_ROOM, response_buf, strlen(response_buf));
-                            
-                            // Notify other members about the departure
-                            void *members_json = NULL;
-                            if (dao_rooms_get_members(room_id, &members_json) == 0) {
-                                char notify_buf[2048];
-                                snprintf(notify_buf, sizeof(notify_buf), 
-                                    "{\"members\": %s}", (char*)members_json);
-                                session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_UPDATE, 
-                                                                  notify_buf, strlen(notify_buf));
-                                free(members_json);
-                            }
-                        } else {
-                            protocol_send_error(sess, CMD_RES_LEAVE_ROOM, "LEAVE_ROOM_FAILED");
-                        }
-                    }
-                } break;
-                case CMD_REQ_LIST_ROOMS: {
-                    void *rooms_json = NULL;
-                    if (dao_rooms_list_waiting(&rooms_json) == 0) {
-                        const char *json_str = (const char *)rooms_json;
-                        protocol_send_response(sess, CMD_RES_LIST_ROOMS, json_str, strlen(json_str));
-                        free(rooms_json);
-                    } else {
-                        protocol_send_error(sess, CMD_RES_LIST_ROOMS, "LIST_ROOMS_FAILED");
-                    }
-                } break;
-                case CMD_REQ_START_GAME: {
-                    // Start 1vN game - handled by onevn_service
-                    onevn_dispatch(sess, cmd, payload, payload_len);
-                } break;
-                case CMD_REQ_INVITE_FRIEND:
-                case CMD_REQ_RESPOND_INVITE:
-                    friends_dispatch(sess, cmd, payload, payload_len);
-                    break;
-                default:
-                    protocol_send_error(sess, cmd, "UNKNOWN_ROOM_CMD");
-            }
+            room_dispatch(sess, cmd, payload, payload_len);
             break;
 
         case 0x05: // Basic Mode – Quickmode
@@ -283,3 +410,27 @@ void dispatcher_handle_packet(ClientSession *sess, uint16_t cmd, const char *pay
             protocol_send_error(sess, cmd, "UNKNOWN_CMD");
     }
 }
+
+void dispatcher_handle_batch(ClientSession *sess, ClientFrame *frames, int nframes) {
+    for (int i = 0; i < nframes; i++) {
+        // A handler may have closed the connection (e.g. slow consumer)
+        if (sess->closing) break;
+
+        // Payloads are views into the read buffer. NUL-terminate in place for
+        // the JSON helpers; the byte we overwrite belongs to the next frame
+        // (or the spare byte at the end of the buffer) and is put back after.
+        char *end = frames[i].payload ? frames[i].payload + frames[i].payload_len : NULL;
+        char saved = end ? *end : '\0';
+        if (end) *end = '\0';
+        dispatcher_handle_packet(sess, frames[i].cmd, frames[i].payload, frames[i].payload_len);
+        if (end) *end = saved;
+
+        // The request waits for the database: the frames after it stay in
+        // the read buffer until it has been answered
+        if (sess->db_wait > 0) {
+            sess->read_consumed = frames[i].end;
+            sess->db_paused = 1;
+            break;
+        }
+    }
+}
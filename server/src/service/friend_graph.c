@@ -0,0 +1,167 @@
+// server/src/service/friend_graph.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "service/friend_graph.h"
+#include "dao/dao_friends.h"
+#include "utils/idmap.h"
+#include "utils/log.h"
+
+typedef struct {
+    int64_t *ids;
+    int count;
+    int cap;
+} FriendSet;
+
+static struct {
+    pthread_mutex_t lock;
+    IdMap users;                // online user_id -> FriendSet
+    int initialized;
+} g_graph = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void set_free(FriendSet *set) {
+    if (!set) return;
+    free(set->ids);
+    free(set);
+}
+
+static int set_index(const FriendSet *set, int64_t id) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->ids[i] == id) return i;
+    }
+    return -1;
+}
+
+static void set_add(FriendSet *set, int64_t id) {
+    if (set_index(set, id) >= 0) return;
+    if (set->count == set->cap) {
+        int cap = set->cap ? set->cap * 2 : 8;
+        int64_t *ids = realloc(set->ids, sizeof(int64_t) * (size_t)cap);
+        if (!ids) return;
+        set->ids = ids;
+        set->cap = cap;
+    }
+    set->ids[set->count++] = id;
+}
+
+static void set_remove(FriendSet *set, int64_t id) {
+    int i = set_index(set, id);
+    if (i < 0) return;
+    set->ids[i] = set->ids[--set->count];
+}
+
+static int graph_ensure_init_locked(void) {
+    if (g_graph.initialized) return 0;
+    if (idmap_init(&g_graph.users, 1024) != 0) return -1;
+    g_graph.initialized = 1;
+    return 0;
+}
+
+int friend_graph_load(int64_t user_id) {
+    if (user_id <= 0) return -1;
+
+    // Query outside the lock
+    int64_t *ids = NULL;
+    int count = 0;
+    int rc = dao_friends_list_ids(user_id, &ids, &count);
+    if (rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "Loading friends of user_id=%lld failed", (long long)user_id);
+        ids = NULL;
+        count = 0;
+    }
+
+    FriendSet *set = calloc(1, sizeof(FriendSet));
+    if (!set) {
+        free(ids);
+        return -1;
+    }
+    set->ids = ids;
+    set->count = count;
+    set->cap = count;
+
+    pthread_mutex_lock(&g_graph.lock);
+    if (graph_ensure_init_locked() != 0) {
+        pthread_mutex_unlock(&g_graph.lock);
+        set_free(set);
+        return -1;
+    }
+    FriendSet *old = idmap_remove(&g_graph.users, user_id);
+    if (idmap_put(&g_graph.users, user_id, set) != 0) {
+        set_free(set);
+        rc = -1;
+    }
+    pthread_mutex_unlock(&g_graph.lock);
+
+    set_free(old);
+    return rc;
+}
+
+void friend_graph_forget(int64_t user_id) {
+    pthread_mutex_lock(&g_graph.lock);
+    FriendSet *set = g_graph.initialized ? idmap_remove(&g_graph.users, user_id) : NULL;
+    pthread_mutex_unlock(&g_graph.lock);
+    set_free(set);
+}
+
+void friend_graph_add_edge(int64_t a, int64_t b) {
+    pthread_mutex_lock(&g_graph.lock);
+    if (g_graph.initialized) {
+        FriendSet *sa = idmap_get(&g_graph.users, a);
+        FriendSet *sb = idmap_get(&g_graph.users, b);
+        if (sa) set_add(sa, b);
+        if (sb) set_add(sb, a);
+    }
+    pthread_mutex_unlock(&g_graph.lock);
+}
+
+void friend_graph_remove_edge(int64_t a, int64_t b) {
+    pthread_mutex_lock(&g_graph.lock);
+    if (g_graph.initialized) {
+        FriendSet *sa = idmap_get(&g_graph.users, a);
+        FriendSet *sb = idmap_get(&g_graph.users, b);
+        if (sa) set_remove(sa, b);
+        if (sb) set_remove(sb, a);
+    }
+    pthread_mutex_unlock(&g_graph.lock);
+}
+
+int friend_graph_online_friends(int64_t user_id, int64_t **out_ids) {
+    if (!out_ids) return -1;
+    *out_ids = NULL;
+
+    pthread_mutex_lock(&g_graph.lock);
+    FriendSet *set = g_graph.initialized ? idmap_get(&g_graph.users, user_id) : NULL;
+    if (!set) {
+        pthread_mutex_unlock(&g_graph.lock);
+        return -1;
+    }
+
+    int n = 0;
+    int64_t *ids = set->count > 0 ? malloc(sizeof(int64_t) * (size_t)set->count) : NULL;
+    if (ids) {
+        for (int i = 0; i < set->count; i++) {
+            if (idmap_get(&g_graph.users, set->ids[i])) ids[n++] = set->ids[i];
+        }
+    }
+    pthread_mutex_unlock(&g_graph.lock);
+
+    if (n == 0) {
+        free(ids);
+        ids = NULL;
+    }
+    *out_ids = ids;
+    return n;
+}
+
+void friend_graph_clear(void) {
+    pthread_mutex_lock(&g_graph.lock);
+    if (g_graph.initialized) {
+        for (size_t i = 0; i < g_graph.users.capacity; i++) {
+            set_free(g_graph.users.entries[i].value);
+        }
+        idmap_free(&g_graph.users);
+        g_graph.initialized = 0;
+    }
+    pthread_mutex_unlock(&g_graph.lock);
+}
@@ -7,11 +7,16 @@
 #include "service/commands.h"
 #include "service/protocol.h"
 #include "service/session_manager.h"
+#include "service/friend_graph.h"
+#include "service/presence_service.h"
+#include "service/user_directory.h"
 #include "dao/dao_friends.h"
 #include "dao/dao_users.h"
 #include "dao/dao_rooms.h"
 #include "dao/dao_chat.h"
 #include "utils/json.h"
+#include "utils/log.h"
+#include "utils/strbuf.h"
 
 #define ROOM_CHAT_MAX_LENGTH 200
 #define ROOM_CHAT_RATE_LIMIT 5
@@ -84,63 +89,100 @@ const char *friends_get_user_status(int64_t user_id) {
     return "online";
 }
 
-// Helper: Broadcast friend status change to all friends of a user
-static void broadcast_status_to_friends(int64_t user_id, const char *status, int64_t room_id) {
-    printf("[FRIENDS] === broadcast_status_to_friends ===\n");
-    printf("[FRIENDS] user_id=%lld, status=%s, room_id=%lld\n", 
+// Notify friends when a user's status changes
+void friends_notify_status_change(int64_t user_id, const char *status, int64_t room_id) {
+    LOG_DEBUG(LOG_CAT_FRIENDS, "user_id=%lld, status=%s, room_id=%lld",
            (long long)user_id, status, (long long)room_id);
-    fflush(stdout);
-    
-    void *friends_json = NULL;
-    if (dao_friends_list(user_id, &friends_json) != 0) {
-        printf("[FRIENDS] No friends found or error getting friends list\n");
-        fflush(stdout);
-        return; // No friends or error
+    presence_publish(user_id, status, room_id);
+}
+
+// A friends/chat request whose DAO work runs on the DB pool (see
+// session_manager_submit_db): the handler validates and fills the inputs,
+// run queries without the service lock, done answers from the client's loop.
+#define FRIENDS_NAME_MAX 256
+
+typedef struct {
+    SessionRef ref;
+    int64_t user_id;           // requesting user
+    int64_t peer_id;           // friend / target user
+    int64_t room_id;
+    int limit;
+    bool flag;                 // accept / conversation fetch
+    char *text;                // search query or message
+    // Results
+    int rc;
+    bool are_friends;
+    int64_t owner_id;
+    room_status_t room_status;
+    void *json;
+    int64_t *ids;
+    int count;
+    char (*names)[FRIENDS_NAME_MAX];    // escaped usernames of ids ("" if unknown)
+    int name_rc;
+    char username[FRIENDS_NAME_MAX];    // requester's escaped username
+} FriendsJob;
+
+static FriendsJob *friends_job_new(ClientSession *sess) {
+    FriendsJob *job = calloc(1, sizeof(FriendsJob));
+    if (!job) return NULL;
+    session_ref_init(&job->ref, sess);
+    job->user_id = sess->user_id;
+    job->rc = -1;
+    job->name_rc = -1;
+    return job;
+}
+
+static void friends_job_free(FriendsJob *job) {
+    free(job->text);
+    free(job->json);
+    free(job->ids);
+    free(job->names);
+    free(job);
+}
+
+// Hand job to the DB pool, or answer res_cmd with err_code if that fails
+static void friends_submit(ClientSession *sess, FriendsJob *job,
+                           void (*run)(void *arg), void (*done)(void *arg),
+                           uint16_t res_cmd, const char *err_code) {
+    if (!job) {
+        protocol_send_error(sess, res_cmd, err_code);
+        return;
     }
-    
-    printf("[FRIENDS] Friends JSON: %s\n", (char *)friends_json);
-    fflush(stdout);
-    
-    // Parse friends list
-    int64_t friend_ids[256];
-    int count = util_json_parse_user_id_array((const char *)friends_json, friend_ids, 256);
-    free(friends_json);
-    
-    printf("[FRIENDS] Parsed %d friends\n", count);
-    fflush(stdout);
-    
-    // Build status notification JSON
-    char status_json[512];
-    snprintf(status_json, sizeof(status_json),
-        "{\"user_id\": %ld, \"status\": \"%s\", \"room_id\": %ld}",
-        user_id, status, room_id);
-    
-    printf("[FRIENDS] Status JSON: %s\n", status_json);
-    fflush(stdout);
-    
-    // Send to each friend
-    for (int i = 0; i < count; i++) {
-        printf("[FRIENDS] Sending notification to friend_id=%lld\n", (long long)friend_ids[i]);
-        fflush(stdout);
-        int sent = session_manager_send_to_user(friend_ids[i], CMD_NOTIFY_FRIEND_STATUS,
-            status_json, (uint32_t)strlen(status_json));
-        printf("[FRIENDS] Notification sent to friend_id=%lld: %d\n", 
-               (long long)friend_ids[i], sent);
-        fflush(stdout);
+    if (session_manager_submit_db(sess, run, done, job) != 0) {
+        friends_job_free(job);
+        protocol_send_error(sess, res_cmd, err_code);
     }
-    
-    printf("[FRIENDS] Finished broadcasting status to friends\n");
-    fflush(stdout);
 }
 
-// Notify friends when a user's status changes
-void friends_notify_status_change(int64_t user_id, const char *status, int64_t room_id) {
-    broadcast_status_to_friends(user_id, status, room_id);
+// done side of read-only requests: send the DAO's JSON (or empty_json)
+static void friends_reply_json(FriendsJob *job, uint16_t res_cmd, const char *err_code,
+                               const char *empty_json) {
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (sess) {
+        if (job->rc != 0) {
+            protocol_send_error(sess, res_cmd, err_code);
+        } else {
+            const char *json = job->json ? (const char *)job->json : empty_json;
+            protocol_send_response(sess, res_cmd, json, (uint32_t)strlen(json));
+        }
+    }
+    friends_job_free(job);
 }
 
 // Handle search user
+static void search_user_run(void *arg) {
+    FriendsJob *job = arg;
+    job->rc = dao_users_search_by_username(job->text, job->limit, &job->json);
+}
+
+static void search_user_done(void *arg) {
+    friends_reply_json(arg, CMD_RES_SEARCH_USER, "SEARCH_FAILED", "[]");
+}
+
 static void handle_search_user(ClientSession *sess, const char *payload) {
-    char *query = util_json_get_string(payload, "query");
+    JsonObject req;
+    util_json_parse(payload, &req);
+    char *query = util_json_obj_string(&req, "query");
     if (!query) {
         protocol_send_error(sess, CMD_RES_SEARCH_USER, "MISSING_QUERY");
         return;
@@ -148,49 +190,48 @@ static void handle_search_user(ClientSession *sess, const char *payload) {
     
     int limit = 20;
     long long limit_val_ll = 0;
-    if (util_json_get_int64(payload, "limit", &limit_val_ll) && limit_val_ll > 0) {
+    if (util_json_obj_int64(&req, "limit", &limit_val_ll) && limit_val_ll > 0) {
         limit = (int)limit_val_ll;
         if (limit > 100) limit = 100; // Cap at 100
     }
     
-    void *result_json = NULL;
-    if (dao_users_search_by_username(query, limit, &result_json) != 0) {
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->text = query;
+        job->limit = limit;
+    } else {
         free(query);
-        protocol_send_error(sess, CMD_RES_SEARCH_USER, "SEARCH_FAILED");
-        return;
     }
-    
-    // Free query after use
-    free(query);
-    
-    const char *json_str = (const char *)result_json;
-    protocol_send_response(sess, CMD_RES_SEARCH_USER, json_str, strlen(json_str));
-    free(result_json);
+    friends_submit(sess, job, search_user_run, search_user_done,
+                   CMD_RES_SEARCH_USER, "SEARCH_FAILED");
 }
 
 // Handle get friend info with online status
-static void handle_get_friend_info(ClientSession *sess, const char *payload) {
-    long long friend_id_ll = 0;
-    if (!util_json_get_int64(payload, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
-        protocol_send_error(sess, CMD_RES_GET_FRIEND_INFO, "INVALID_FRIEND_ID");
+static void get_friend_info_run(void *arg) {
+    FriendsJob *job = arg;
+    job->rc = dao_friends_get_info(job->user_id, job->peer_id, &job->json);
+}
+
+static void get_friend_info_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        friends_job_free(job);
         return;
     }
-    int64_t friend_id = (int64_t)friend_id_ll;
-    
-    // Get friend info from DB
-    void *info_json = NULL;
-    if (dao_friends_get_info(sess->user_id, friend_id, &info_json) != 0) {
+    if (job->rc != 0 || !job->json) {
         protocol_send_error(sess, CMD_RES_GET_FRIEND_INFO, "USER_NOT_FOUND");
+        friends_job_free(job);
         return;
     }
     
     // Parse the JSON to add online status
-    char *info_str = (char *)info_json;
+    char *info_str = (char *)job->json;
     size_t info_len = strlen(info_str);
     
     // Check online status
-    const char *status = friends_get_user_status(friend_id);
-    ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
+    const char *status = friends_get_user_status(job->peer_id);
+    ClientSession *friend_sess = session_manager_get_by_user_id(job->peer_id);
     int64_t room_id = friend_sess ? friend_sess->room_id : 0;
     
     // Build enhanced JSON with online status
@@ -204,13 +245,63 @@ static void handle_get_friend_info(ClientSession *sess, const char *payload) {
         info_str, status, room_id);
     
     protocol_send_response(sess, CMD_RES_GET_FRIEND_INFO, enhanced_json, strlen(enhanced_json));
-    free(info_json);
+    friends_job_free(job);
+}
+
+static void handle_get_friend_info(ClientSession *sess, const char *payload) {
+    long long friend_id_ll = 0;
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
+        protocol_send_error(sess, CMD_RES_GET_FRIEND_INFO, "INVALID_FRIEND_ID");
+        return;
+    }
+    
+    // Get friend info from DB
+    FriendsJob *job = friends_job_new(sess);
+    if (job) job->peer_id = (int64_t)friend_id_ll;
+    friends_submit(sess, job, get_friend_info_run, get_friend_info_done,
+                   CMD_RES_GET_FRIEND_INFO, "USER_NOT_FOUND");
 }
 
 // Handle remove friend request
+static void remove_friend_run(void *arg) {
+    FriendsJob *job = arg;
+    // Remove friend relationship (both directions)
+    job->rc = dao_friends_remove(job->user_id, job->peer_id);
+    if (job->rc == 0) friend_graph_remove_edge(job->user_id, job->peer_id);
+}
+
+static void remove_friend_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (job->rc != 0) {
+        if (sess) protocol_send_error(sess, CMD_RES_REMOVE_FRIEND, "REMOVE_FRIEND_FAILED");
+        friends_job_free(job);
+        return;
+    }
+    
+    // Notify the removed friend if online
+    ClientSession *friend_sess = session_manager_get_by_user_id(job->peer_id);
+    if (friend_sess) {
+        // Notify friend that they were removed
+        char notify_json[256];
+        snprintf(notify_json, sizeof(notify_json),
+            "{\"user_id\": %lld, \"status\": \"removed\"}",
+            (long long)job->user_id);
+        session_manager_send_to_user(job->peer_id, CMD_NOTIFY_FRIEND_STATUS,
+            notify_json, (uint32_t)strlen(notify_json));
+    }
+    
+    if (sess) protocol_send_simple_ok(sess, CMD_RES_REMOVE_FRIEND);
+    friends_job_free(job);
+}
+
 static void handle_remove_friend(ClientSession *sess, const char *payload) {
     long long friend_id_ll = 0;
-    if (!util_json_get_int64(payload, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
         protocol_send_error(sess, CMD_RES_REMOVE_FRIEND, "INVALID_FRIEND_ID");
         return;
     }
@@ -222,31 +313,53 @@ static void handle_remove_friend(ClientSession *sess, const char *payload) {
         return;
     }
     
-    // Remove friend relationship (both directions)
-    if (dao_friends_remove(sess->user_id, friend_id) != 0) {
-        protocol_send_error(sess, CMD_RES_REMOVE_FRIEND, "REMOVE_FRIEND_FAILED");
+    FriendsJob *job = friends_job_new(sess);
+    if (job) job->peer_id = friend_id;
+    friends_submit(sess, job, remove_friend_run, remove_friend_done,
+                   CMD_RES_REMOVE_FRIEND, "REMOVE_FRIEND_FAILED");
+}
+
+// Handle add friend request
+static void add_friend_run(void *arg) {
+    FriendsJob *job = arg;
+    // Send friend request
+    job->rc = dao_friends_send_request(job->user_id, job->peer_id);
+    if (job->rc == 0) {
+        job->name_rc = user_directory_username_json(job->user_id, job->username, sizeof(job->username));
+    }
+}
+
+static void add_friend_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (job->rc != 0) {
+        if (sess) protocol_send_error(sess, CMD_RES_ADD_FRIEND, "ADD_FRIEND_FAILED");
+        friends_job_free(job);
         return;
     }
     
-    // Notify the removed friend if online
-    ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
-    if (friend_sess) {
-        // Notify friend that they were removed
-        char notify_json[256];
+    // Send notification to friend if online
+    ClientSession *friend_sess = session_manager_get_by_user_id(job->peer_id);
+    if (friend_sess && job->name_rc == 0) {
+        char notify_json[512];
         snprintf(notify_json, sizeof(notify_json),
-            "{\"user_id\": %lld, \"status\": \"removed\"}",
-            (long long)sess->user_id);
-        session_manager_send_to_user(friend_id, CMD_NOTIFY_FRIEND_STATUS,
+            "{\"from_user_id\": %lld, \"from_username\": \"%s\"}",
+            (long long)job->user_id, job->username);
+        
+        session_manager_send_to_user(job->peer_id, CMD_NOTIFY_FRIEND_REQ,
             notify_json, (uint32_t)strlen(notify_json));
     }
     
-    protocol_send_simple_ok(sess, CMD_RES_REMOVE_FRIEND);
+    // Send success response
+    if (sess) protocol_send_simple_ok(sess, CMD_RES_ADD_FRIEND);
+    friends_job_free(job);
 }
 
-// Handle add friend request
 static void handle_add_friend(ClientSession *sess, const char *payload) {
     long long friend_id_ll = 0;
-    if (!util_json_get_int64(payload, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
         protocol_send_error(sess, CMD_RES_ADD_FRIEND, "INVALID_FRIEND_ID");
         return;
     }
@@ -258,185 +371,146 @@ static void handle_add_friend(ClientSession *sess, const char *payload) {
         return;
     }
     
-    // Send friend request
-    if (dao_friends_send_request(sess->user_id, friend_id) != 0) {
-        protocol_send_error(sess, CMD_RES_ADD_FRIEND, "ADD_FRIEND_FAILED");
+    FriendsJob *job = friends_job_new(sess);
+    if (job) job->peer_id = friend_id;
+    friends_submit(sess, job, add_friend_run, add_friend_done,
+                   CMD_RES_ADD_FRIEND, "ADD_FRIEND_FAILED");
+}
+
+// Handle list friends
+static void list_friends_run(void *arg) {
+    FriendsJob *job = arg;
+    job->rc = dao_friends_list_ids(job->user_id, &job->ids, &job->count);
+    if (job->rc != 0 || job->count == 0) return;
+
+    // Usernames not cached yet are loaded with one query
+    user_directory_prefetch(job->ids, job->count);
+    job->names = malloc(sizeof(*job->names) * (size_t)job->count);
+    if (!job->names) {
+        job->rc = -1;
         return;
     }
-    
-    // Send notification to friend if online
-    ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
-    if (friend_sess) {
-        User sender;
-        if (dao_users_find_by_id(sess->user_id, &sender) == 0) {
-            char notify_json[512];
-            char *esc_username = util_json_escape(sender.username);
-            if (!esc_username) esc_username = strdup("");
-            
-            snprintf(notify_json, sizeof(notify_json),
-                "{\"from_user_id\": %lld, \"from_username\": \"%s\"}",
-                (long long)sess->user_id, esc_username);
-            
-            session_manager_send_to_user(friend_id, CMD_NOTIFY_FRIEND_REQ,
-                notify_json, (uint32_t)strlen(notify_json));
-            
-            free(esc_username);
+    for (int i = 0; i < job->count; i++) {
+        if (user_directory_username_json(job->ids[i], job->names[i], sizeof(job->names[i])) != 0) {
+            job->names[i][0] = '\0';
         }
     }
-    
-    // Send success response
-    protocol_send_simple_ok(sess, CMD_RES_ADD_FRIEND);
 }
 
-// Handle list friends
-static void handle_list_friends(ClientSession *sess) {
-    void *result_json = NULL;
-    if (dao_friends_list(sess->user_id, &result_json) != 0) {
-        protocol_send_error(sess, CMD_RES_LIST_FRIENDS, "LIST_FRIENDS_FAILED");
+static void list_friends_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        friends_job_free(job);
         return;
     }
-    
-    // Parse the JSON array and add online status for each friend
-    char *json_str = (char *)result_json;
-    size_t json_len = strlen(json_str);
-    
-    // Check if it's an array
-    if (json_str[0] != '[') {
-        // Not an array, send as-is
-        protocol_send_response(sess, CMD_RES_LIST_FRIENDS, json_str, json_len);
-        free(result_json);
+    if (job->rc != 0) {
+        protocol_send_error(sess, CMD_RES_LIST_FRIENDS, "LIST_FRIENDS_FAILED");
+        friends_job_free(job);
         return;
     }
-    
-    // Simple approach: parse JSON string manually to extract user_id and username,
-    // then rebuild with online_status
-    // Format: [{"user_id": X, "username": "Y", "status": "Z"}, ...]
-    
-    // Extract friend IDs first
-    int64_t friend_ids[256];
-    int count = util_json_parse_user_id_array(json_str, friend_ids, 256);
-    
-    if (count > 0) {
-        // Build enhanced JSON with online status
-        size_t cap = json_len + count * 150; // Extra space for online_status and room_id fields
-        size_t used = 0;
-        char *enhanced = malloc(cap);
-        if (!enhanced) {
-            free(result_json);
-            protocol_send_error(sess, CMD_RES_LIST_FRIENDS, "MEMORY_ERROR");
-            return;
-        }
-        
-        used += snprintf(enhanced + used, cap - used, "[");
-        
-        // Parse original JSON to get usernames
-        // Simple parsing: find each object and extract username
-        int processed = 0;
-        
-        for (int i = 0; i < count && processed < count; i++) {
-            int64_t friend_id = friend_ids[i];
-            const char *status = friends_get_user_status(friend_id);
-            ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
-            int64_t room_id = friend_sess ? friend_sess->room_id : 0;
-            
-            // Get friend username from database
-            User friend_user;
-            if (dao_users_find_by_id(friend_id, &friend_user) != 0) {
-                continue; // Skip if user not found
-            }
-            
-            char *esc_username = util_json_escape(friend_user.username);
-            if (!esc_username) esc_username = strdup("");
-            
-            if (processed > 0) used += snprintf(enhanced + used, cap - used, ",");
-            used += snprintf(enhanced + used, cap - used,
-                "{\"user_id\": %ld, \"username\": \"%s\", \"status\": \"ACCEPTED\", \"online_status\": \"%s\", \"room_id\": %ld}",
-                friend_id, esc_username, status, room_id);
-            
-            free(esc_username);
-            processed++;
-        }
-        
-        used += snprintf(enhanced + used, cap - used, "]");
-        
-        protocol_send_response(sess, CMD_RES_LIST_FRIENDS, enhanced, used);
-        free(enhanced);
+
+    // Format: [{"user_id": X, "username": "Y", "status": "ACCEPTED",
+    //           "online_status": "Z", "room_id": R}, ...]
+    StrBuf out = STRBUF_INIT;
+    strbuf_appends(&out, "[");
+    int processed = 0;
+    for (int i = 0; i < job->count; i++) {
+        int64_t friend_id = job->ids[i];
+        if (job->names[i][0] == '\0') continue; // Skip if user not found
+
+        const char *status = friends_get_user_status(friend_id);
+        ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
+        int64_t room_id = friend_sess ? friend_sess->room_id : 0;
+
+        if (processed > 0) strbuf_appends(&out, ",");
+        strbuf_appendf(&out,
+            "{\"user_id\": %ld, \"username\": \"%s\", \"status\": \"ACCEPTED\", \"online_status\": \"%s\", \"room_id\": %ld}",
+            friend_id, job->names[i], status, room_id);
+        processed++;
+    }
+    strbuf_appends(&out, "]");
+
+    if (out.failed) {
+        protocol_send_error(sess, CMD_RES_LIST_FRIENDS, "MEMORY_ERROR");
     } else {
-        // No friends or parse failed, send original
-        protocol_send_response(sess, CMD_RES_LIST_FRIENDS, json_str, json_len);
+        protocol_send_response(sess, CMD_RES_LIST_FRIENDS, out.data, out.len);
     }
-    
-    free(result_json);
+    strbuf_free(&out);
+    friends_job_free(job);
+}
+
+static void handle_list_friends(ClientSession *sess) {
+    friends_submit(sess, friends_job_new(sess), list_friends_run, list_friends_done,
+                   CMD_RES_LIST_FRIENDS, "LIST_FRIENDS_FAILED");
 }
 
 // Handle get pending friend requests
+static void get_pending_run(void *arg) {
+    FriendsJob *job = arg;
+    job->rc = dao_friends_get_pending_requests(job->user_id, &job->json);
+}
+
+static void get_pending_done(void *arg) {
+    friends_reply_json(arg, CMD_RES_GET_PENDING_REQ, "GET_PENDING_FAILED", "[]");
+}
+
 static void handle_get_pending_requests(ClientSession *sess) {
-    void *result_json = NULL;
-    if (dao_friends_get_pending_requests(sess->user_id, &result_json) != 0) {
-        protocol_send_error(sess, CMD_RES_GET_PENDING_REQ, "GET_PENDING_FAILED");
-        return;
-    }
-    
-    const char *json_str = (const char *)result_json;
-    protocol_send_response(sess, CMD_RES_GET_PENDING_REQ, json_str, strlen(json_str));
-    free(result_json);
+    friends_submit(sess, friends_job_new(sess), get_pending_run, get_pending_done,
+                   CMD_RES_GET_PENDING_REQ, "GET_PENDING_FAILED");
 }
 
 // Handle respond to friend request (accept/reject)
-static void handle_respond_friend(ClientSession *sess, const char *payload) {
-    long long from_user_id_ll = 0;
-    bool accept = false;
-    
-    if (!util_json_get_int64(payload, "from_user_id", &from_user_id_ll) || from_user_id_ll <= 0) {
-        protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "INVALID_FROM_USER_ID");
-        return;
-    }
-    int64_t from_user_id = (int64_t)from_user_id_ll;
-    
-    // Get accept flag (true = accept, false = reject)
-    char *accept_str = util_json_get_string(payload, "accept");
-    if (!accept_str) {
-        protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "MISSING_ACCEPT_FLAG");
-        return;
-    }
-    accept = (strcmp(accept_str, "true") == 0 || strcmp(accept_str, "1") == 0);
-    free(accept_str);
-    
+static void respond_friend_run(void *arg) {
+    FriendsJob *job = arg;
+    int64_t from_user_id = job->peer_id;
+
     // Respond to friend request
-    if (dao_friends_respond_request(from_user_id, sess->user_id, accept) != 0) {
-        protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "RESPOND_FAILED");
+    job->rc = dao_friends_respond_request(from_user_id, job->user_id, job->flag);
+    if (job->rc != 0 || !job->flag) return;
+
+    // If accepted, create reverse relationship
+    if (dao_friends_send_request(job->user_id, from_user_id) != 0) {
+        // If reverse relationship creation fails, still return success
+        // (the main relationship is already accepted)
+        LOG_WARN(LOG_CAT_FRIENDS, "Failed to create reverse relationship");
+    }
+    // Update the reverse relationship to ACCEPTED
+    dao_friends_update_status(job->user_id, from_user_id, FRIEND_STATUS_ACCEPTED);
+    friend_graph_add_edge(job->user_id, from_user_id);
+}
+
+static void respond_friend_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    int64_t user_id = job->user_id;
+    int64_t from_user_id = job->peer_id;
+    if (job->rc != 0) {
+        if (sess) protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "RESPOND_FAILED");
+        friends_job_free(job);
         return;
     }
     
-    // If accepted, create reverse relationship and notify both users
-    if (accept) {
-        if (dao_friends_send_request(sess->user_id, from_user_id) != 0) {
-            // If reverse relationship creation fails, still return success
-            // (the main relationship is already accepted)
-            fprintf(stderr, "[FRIENDS] Warning: Failed to create reverse relationship\n");
-        }
-        // Update the reverse relationship to ACCEPTED
-        dao_friends_update_status(sess->user_id, from_user_id, FRIEND_STATUS_ACCEPTED);
-        
+    // If accepted, notify both users
+    if (job->flag) {
         // Notify the sender (A) that their request was accepted
         // This will trigger A's client to refresh friends list
         ClientSession *sender_sess = session_manager_get_by_user_id(from_user_id);
         
         // Get B's status (the one who accepted)
-        const char *status_b = friends_get_user_status(sess->user_id);
-        int64_t room_id_b = sess->room_id;
+        const char *status_b = friends_get_user_status(user_id);
+        int64_t room_id_b = sess ? sess->room_id : 0;
         
         char notify_json_a[512];
         snprintf(notify_json_a, sizeof(notify_json_a),
             "{\"user_id\": %lld, \"status\": \"%s\", \"room_id\": %ld}",
-            (long long)sess->user_id, status_b, room_id_b);
+            (long long)user_id, status_b, room_id_b);
         
         session_manager_send_to_user(from_user_id, CMD_NOTIFY_FRIEND_STATUS,
             notify_json_a, (uint32_t)strlen(notify_json_a));
         
-        printf("[FRIENDS] Sent CMD_NOTIFY_FRIEND_STATUS to user %lld (sender) about user %lld (accepter)\n",
-               (long long)from_user_id, (long long)sess->user_id);
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_FRIENDS, "Sent CMD_NOTIFY_FRIEND_STATUS to user %lld (sender) about user %lld (accepter)",
+               (long long)from_user_id, (long long)user_id);
         
         // Also notify B about A's status (optional, but good for consistency)
         const char *status_a = friends_get_user_status(from_user_id);
@@ -450,123 +524,170 @@ static void handle_respond_friend(ClientSession *sess, const char *payload) {
             "{\"user_id\": %lld, \"status\": \"%s\", \"room_id\": %ld}",
             (long long)from_user_id, status_a, room_id_a);
         
-        session_manager_send_to_user(sess->user_id, CMD_NOTIFY_FRIEND_STATUS,
+        session_manager_send_to_user(user_id, CMD_NOTIFY_FRIEND_STATUS,
             notify_json_b, (uint32_t)strlen(notify_json_b));
         
-        printf("[FRIENDS] Sent CMD_NOTIFY_FRIEND_STATUS to user %lld (accepter) about user %lld (sender)\n",
-               (long long)sess->user_id, (long long)from_user_id);
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_FRIENDS, "Sent CMD_NOTIFY_FRIEND_STATUS to user %lld (accepter) about user %lld (sender)",
+               (long long)user_id, (long long)from_user_id);
     }
     
-    protocol_send_simple_ok(sess, CMD_RES_RESPOND_FRIEND);
+    if (sess) protocol_send_simple_ok(sess, CMD_RES_RESPOND_FRIEND);
+    friends_job_free(job);
 }
 
-// Handle invite friend to room
-static void handle_invite_friend(ClientSession *sess, const char *payload) {
-    printf("[FRIENDS] === handle_invite_friend ===\n");
-    printf("[FRIENDS] Inviter user_id=%lld, payload=%s\n", (long long)sess->user_id, payload);
-    fflush(stdout);
-    
-    long long friend_id_ll = 0;
-    long long room_id_ll = 0;
+static void handle_respond_friend(ClientSession *sess, const char *payload) {
+    long long from_user_id_ll = 0;
+    bool accept = false;
     
-    if (!util_json_get_int64(payload, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
-        printf("[FRIENDS] ERROR: Invalid friend_id\n");
-        fflush(stdout);
-        protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "INVALID_FRIEND_ID");
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "from_user_id", &from_user_id_ll) || from_user_id_ll <= 0) {
+        protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "INVALID_FROM_USER_ID");
         return;
     }
-    int64_t friend_id = (int64_t)friend_id_ll;
     
-    // Get room_id from session or payload
-    int64_t room_id = 0;
-    if (util_json_get_int64(payload, "room_id", &room_id_ll) && room_id_ll > 0) {
-        room_id = (int64_t)room_id_ll;
-    } else if (sess->room_id > 0) {
-        room_id = sess->room_id;
-    } else {
-        printf("[FRIENDS] ERROR: Not in room\n");
-        fflush(stdout);
-        protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "NOT_IN_ROOM");
+    // Get accept flag (true = accept, false = reject)
+    char *accept_str = util_json_obj_string(&req, "accept");
+    if (!accept_str) {
+        protocol_send_error(sess, CMD_RES_RESPOND_FRIEND, "MISSING_ACCEPT_FLAG");
         return;
     }
+    accept = (strcmp(accept_str, "true") == 0 || strcmp(accept_str, "1") == 0);
+    free(accept_str);
     
-    printf("[FRIENDS] room_id=%lld, friend_id=%lld\n", (long long)room_id, (long long)friend_id);
-    fflush(stdout);
-    
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->peer_id = (int64_t)from_user_id_ll;
+        job->flag = accept;
+    }
+    friends_submit(sess, job, respond_friend_run, respond_friend_done,
+                   CMD_RES_RESPOND_FRIEND, "RESPOND_FAILED");
+}
+
+// Handle invite friend to room
+static void invite_friend_run(void *arg) {
+    FriendsJob *job = arg;
     // Check if they are friends
-    bool are_friends = false;
-    if (dao_friends_are_friends(sess->user_id, friend_id, &are_friends) != 0 || !are_friends) {
-        printf("[FRIENDS] ERROR: Not friends\n");
-        fflush(stdout);
+    if (dao_friends_are_friends(job->user_id, job->peer_id, &job->are_friends) != 0) {
+        job->are_friends = false;
+    }
+    if (!job->are_friends) return;
+
+    // Room and sender username
+    job->rc = dao_rooms_get_owner(job->room_id, &job->owner_id);
+    job->name_rc = user_directory_username_json(job->user_id, job->username, sizeof(job->username));
+}
+
+static void invite_friend_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        friends_job_free(job);
+        return;
+    }
+    int64_t friend_id = job->peer_id;
+
+    if (!job->are_friends) {
+        LOG_WARN(LOG_CAT_FRIENDS, "Not friends");
         protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "NOT_FRIENDS");
+        friends_job_free(job);
         return;
     }
     
-    printf("[FRIENDS] Friendship verified\n");
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Friendship verified");
     
     // Check if friend is online
     ClientSession *friend_sess = session_manager_get_by_user_id(friend_id);
     if (!friend_sess) {
-        printf("[FRIENDS] ERROR: Friend offline (user_id=%lld)\n", (long long)friend_id);
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_FRIENDS, "Friend offline (user_id=%lld)", (long long)friend_id);
         protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "FRIEND_OFFLINE");
+        friends_job_free(job);
         return;
     }
     
-    printf("[FRIENDS] Friend is online, socket_fd=%d\n", friend_sess->socket_fd);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Friend is online, socket_fd=%d", friend_sess->socket_fd);
     
     // Get room info
-    int64_t owner_id = 0;
-    if (dao_rooms_get_owner(room_id, &owner_id) != 0) {
-        printf("[FRIENDS] ERROR: Room not found\n");
-        fflush(stdout);
+    if (job->rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "Room not found");
         protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "ROOM_NOT_FOUND");
+        friends_job_free(job);
         return;
     }
     
     // Get sender username
-    User sender;
-    if (dao_users_find_by_id(sess->user_id, &sender) != 0) {
-        printf("[FRIENDS] ERROR: User not found\n");
-        fflush(stdout);
+    if (job->name_rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "User not found");
         protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "USER_NOT_FOUND");
+        friends_job_free(job);
         return;
     }
     
     // Send invite notification to friend
     char invite_json[512];
-    char *esc_username = util_json_escape(sender.username);
-    if (!esc_username) esc_username = strdup("");
-    
     snprintf(invite_json, sizeof(invite_json),
         "{\"from_user_id\": %ld, \"from_username\": \"%s\", \"room_id\": %ld}",
-        sess->user_id, esc_username, room_id);
+        job->user_id, job->username, job->room_id);
     
-    printf("[FRIENDS] Sending notification to friend_id=%lld: %s\n", (long long)friend_id, invite_json);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Sending notification to friend_id=%lld: %s", (long long)friend_id, invite_json);
     
     session_manager_send_to_user(friend_id, CMD_NOTIFY_ROOM_INVITE,
         invite_json, (uint32_t)strlen(invite_json));
     
-    printf("[FRIENDS] Notification sent\n");
-    fflush(stdout);
-    
-    free(esc_username);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Notification sent");
     
     // Send success response to sender
     protocol_send_simple_ok(sess, CMD_RES_INVITE_FRIEND);
-    printf("[FRIENDS] Success response sent to inviter\n");
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Success response sent to inviter");
+    friends_job_free(job);
+}
+
+static void handle_invite_friend(ClientSession *sess, const char *payload) {
+    LOG_DEBUG(LOG_CAT_FRIENDS, "=== handle_invite_friend ===");
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Inviter user_id=%lld, payload=%s", (long long)sess->user_id, payload);
+    
+    long long friend_id_ll = 0;
+    long long room_id_ll = 0;
+    
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "friend_id", &friend_id_ll) || friend_id_ll <= 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "Invalid friend_id");
+        protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "INVALID_FRIEND_ID");
+        return;
+    }
+    int64_t friend_id = (int64_t)friend_id_ll;
+    
+    // Get room_id from session or payload
+    int64_t room_id = 0;
+    if (util_json_obj_int64(&req, "room_id", &room_id_ll) && room_id_ll > 0) {
+        room_id = (int64_t)room_id_ll;
+    } else if (sess->room_id > 0) {
+        room_id = sess->room_id;
+    } else {
+        LOG_WARN(LOG_CAT_FRIENDS, "Not in room");
+        protocol_send_error(sess, CMD_RES_INVITE_FRIEND, "NOT_IN_ROOM");
+        return;
+    }
+    
+    LOG_DEBUG(LOG_CAT_FRIENDS, "room_id=%lld, friend_id=%lld", (long long)room_id, (long long)friend_id);
+    
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->peer_id = friend_id;
+        job->room_id = room_id;
+    }
+    friends_submit(sess, job, invite_friend_run, invite_friend_done,
+                   CMD_RES_INVITE_FRIEND, "NOT_FRIENDS");
 }
 
 // Handle respond to room invite
 static void handle_respond_to_invite(ClientSession *sess, const char *payload) {
     long long room_id_ll = 0;
     
-    if (!util_json_get_int64(payload, "room_id", &room_id_ll) || room_id_ll <= 0) {
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "room_id", &room_id_ll) || room_id_ll <= 0) {
         protocol_send_error(sess, CMD_RES_RESPOND_INVITE, "INVALID_ROOM_ID");
         return;
     }
@@ -574,7 +695,7 @@ static void handle_respond_to_invite(ClientSession *sess, const char *payload) {
     
     // Get accept flag (default to true if not specified)
     long long accept_ll = 1;
-    util_json_get_int64(payload, "accept", &accept_ll);
+    util_json_obj_int64(&req, "accept", &accept_ll);
     bool accept = (accept_ll != 0);
     
     char response[256];
@@ -594,120 +715,185 @@ static void handle_respond_to_invite(ClientSession *sess, const char *payload) {
 }
 
 // Handle send DM
+static void send_dm_run(void *arg) {
+    FriendsJob *job = arg;
+    // Check if they are friends (optional, can be removed if DMs are open)
+    dao_friends_are_friends(job->user_id, job->peer_id, &job->are_friends);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "are_friends=%d", job->are_friends);
+    // For now, we allow DMs even if not friends
+    
+    // Get sender info
+    job->name_rc = user_directory_username_json(job->user_id, job->username, sizeof(job->username));
+    if (job->name_rc != 0) return;
+    
+    // Save message to database
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Saving message to database...");
+    job->rc = dao_chat_send_dm(job->user_id, job->peer_id, job->text);
+}
+
+static void send_dm_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    int64_t user_id = job->user_id;
+    int64_t to_user_id = job->peer_id;
+    
+    if (job->name_rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "SENDER_NOT_FOUND: user_id=%lld", (long long)user_id);
+        if (sess) protocol_send_error(sess, CMD_RES_SEND_DM, "SENDER_NOT_FOUND");
+        friends_job_free(job);
+        return;
+    }
+    LOG_DEBUG(LOG_CAT_FRIENDS, "sender username=%s", job->username);
+    
+    if (job->rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "SAVE_MESSAGE_FAILED");
+        if (sess) protocol_send_error(sess, CMD_RES_SEND_DM, "SAVE_MESSAGE_FAILED");
+        friends_job_free(job);
+        return;
+    }
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Message saved to database successfully");
+    
+    // Build DM notification JSON
+    char *esc_message = util_json_escape(job->text);
+    if (!esc_message) esc_message = strdup("");
+    
+    long timestamp = (long)time(NULL);
+    char dm_json[2048];
+    snprintf(dm_json, sizeof(dm_json),
+        "{\"from_user_id\": %lld, \"from_username\": \"%s\", \"message\": \"%s\", \"timestamp\": %ld}",
+        (long long)user_id, job->username, esc_message, timestamp);
+    
+    LOG_DEBUG(LOG_CAT_FRIENDS, "DM JSON: %s", dm_json);
+    
+    // Try to send to receiver if online
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Sending notification to receiver (user_id=%lld)...", (long long)to_user_id);
+    int sent = session_manager_send_to_user(to_user_id, CMD_NOTIFY_DM,
+        dm_json, (uint32_t)strlen(dm_json));
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Notification sent to receiver: %d", sent);
+    
+    // Also send notification back to sender (echo) so they see their own message confirmed
+    // This is especially useful if the receiver is offline
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Sending echo to sender (user_id=%lld)...", (long long)user_id);
+    session_manager_send_to_user(user_id, CMD_NOTIFY_DM,
+        dm_json, (uint32_t)strlen(dm_json));
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Echo sent to sender");
+    
+    // Always return success if saved to DB, even if user is offline
+    if (sess) protocol_send_simple_ok(sess, CMD_RES_SEND_DM);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Success response sent");
+    
+    free(esc_message);
+    friends_job_free(job);
+}
+
 static void handle_send_dm(ClientSession *sess, const char *payload) {
-    printf("[FRIENDS] === handle_send_dm ===\n");
-    printf("[FRIENDS] sender user_id=%lld\n", (long long)sess->user_id);
-    printf("[FRIENDS] payload=%s\n", payload ? payload : "(null)");
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "=== handle_send_dm ===");
+    LOG_DEBUG(LOG_CAT_FRIENDS, "sender user_id=%lld", (long long)sess->user_id);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "payload=%s", payload ? payload : "(null)");
     
     long long to_user_id_ll = 0;
     
-    if (!util_json_get_int64(payload, "to_user_id", &to_user_id_ll) || to_user_id_ll <= 0) {
-        printf("[FRIENDS] ERROR: INVALID_TO_USER_ID\n");
-        fflush(stdout);
+    JsonObject req;
+    util_json_parse(payload, &req);
+    if (!util_json_obj_int64(&req, "to_user_id", &to_user_id_ll) || to_user_id_ll <= 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "INVALID_TO_USER_ID");
         protocol_send_error(sess, CMD_RES_SEND_DM, "INVALID_TO_USER_ID");
         return;
     }
     int64_t to_user_id = (int64_t)to_user_id_ll;
-    printf("[FRIENDS] to_user_id=%lld\n", (long long)to_user_id);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_FRIENDS, "to_user_id=%lld", (long long)to_user_id);
     
-    char *message = util_json_get_string(payload, "message");
+    char *message = util_json_obj_string(&req, "message");
     if (!message) {
-        printf("[FRIENDS] ERROR: MISSING_MESSAGE\n");
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_FRIENDS, "MISSING_MESSAGE");
         protocol_send_error(sess, CMD_RES_SEND_DM, "MISSING_MESSAGE");
         return;
     }
-    printf("[FRIENDS] message=%s\n", message);
-    fflush(stdout);
-    
-    // Check if they are friends (optional, can be removed if DMs are open)
-    bool are_friends = false;
-    dao_friends_are_friends(sess->user_id, to_user_id, &are_friends);
-    printf("[FRIENDS] are_friends=%d\n", are_friends);
-    // For now, we allow DMs even if not friends
+    LOG_DEBUG(LOG_CAT_FRIENDS, "message=%s", message);
     
     // Check if user is logged in
     if (sess->user_id <= 0) {
-        printf("[FRIENDS] ERROR: NOT_LOGGED_IN\n");
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_FRIENDS, "NOT_LOGGED_IN");
         protocol_send_error(sess, CMD_RES_SEND_DM, "NOT_LOGGED_IN");
         free(message);
         return;
     }
     
-    // Get sender info
-    User sender;
-    if (dao_users_find_by_id(sess->user_id, &sender) != 0) {
-        fprintf(stderr, "[FRIENDS] SENDER_NOT_FOUND: user_id=%lld\n", (long long)sess->user_id);
-        protocol_send_error(sess, CMD_RES_SEND_DM, "SENDER_NOT_FOUND");
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->peer_id = to_user_id;
+        job->text = message;
+    } else {
         free(message);
+    }
+    friends_submit(sess, job, send_dm_run, send_dm_done,
+                   CMD_RES_SEND_DM, "SAVE_MESSAGE_FAILED");
+}
+
+// Handle send room chat
+static void room_chat_run(void *arg) {
+    FriendsJob *job = arg;
+    // Only allow chat when room is waiting
+    job->rc = dao_rooms_get_status(job->room_id, &job->room_status);
+    if (job->rc != 0 || job->room_status != ROOM_STATUS_WAITING) return;
+
+    // Get sender info
+    job->name_rc = user_directory_username_json(job->user_id, job->username, sizeof(job->username));
+}
+
+static void room_chat_done(void *arg) {
+    FriendsJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+    if (!sess) {
+        friends_job_free(job);
         return;
     }
-    printf("[FRIENDS] sender username=%s\n", sender.username);
-    fflush(stdout);
-    
-    // Build DM notification JSON
-    char *esc_username = util_json_escape(sender.username);
-    char *esc_message = util_json_escape(message);
-    if (!esc_username) esc_username = strdup("");
-    if (!esc_message) esc_message = strdup("");
-    
-    // Save message to database
-    printf("[FRIENDS] Saving message to database...\n");
-    fflush(stdout);
-    if (dao_chat_send_dm(sess->user_id, to_user_id, message) != 0) {
-        printf("[FRIENDS] ERROR: SAVE_MESSAGE_FAILED\n");
-        fflush(stdout);
-        free(esc_username);
-        free(esc_message);
-        free(message);
-        protocol_send_error(sess, CMD_RES_SEND_DM, "SAVE_MESSAGE_FAILED");
+    int64_t room_id = job->room_id;
+
+    if (job->rc != 0 || job->room_status != ROOM_STATUS_WAITING) {
+        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "ROOM_NOT_WAITING");
+        friends_job_free(job);
+        return;
+    }
+
+    // Rate limit per user per room
+    if (!room_chat_rate_allow(job->user_id, room_id)) {
+        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "RATE_LIMITED");
+        friends_job_free(job);
         return;
     }
-    printf("[FRIENDS] Message saved to database successfully\n");
-    fflush(stdout);
     
-    long timestamp = (long)time(NULL);
-    char dm_json[2048];
-    snprintf(dm_json, sizeof(dm_json),
-        "{\"from_user_id\": %lld, \"from_username\": \"%s\", \"message\": \"%s\", \"timestamp\": %ld}",
-        (long long)sess->user_id, esc_username, esc_message, timestamp);
+    if (job->name_rc != 0) {
+        LOG_WARN(LOG_CAT_FRIENDS, "SENDER_NOT_FOUND: user_id=%lld", (long long)job->user_id);
+        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "SENDER_NOT_FOUND");
+        friends_job_free(job);
+        return;
+    }
     
-    printf("[FRIENDS] DM JSON: %s\n", dm_json);
-    fflush(stdout);
+    // Build room chat message JSON
+    char *esc_message = util_json_escape(job->text);
+    if (!esc_message) esc_message = strdup("");
     
-    // Try to send to receiver if online
-    printf("[FRIENDS] Sending notification to receiver (user_id=%lld)...\n", (long long)to_user_id);
-    fflush(stdout);
-    int sent = session_manager_send_to_user(to_user_id, CMD_NOTIFY_DM,
-        dm_json, (uint32_t)strlen(dm_json));
-    printf("[FRIENDS] Notification sent to receiver: %d\n", sent);
-    fflush(stdout);
+    char chat_json[2048];
+    snprintf(chat_json, sizeof(chat_json),
+        "{\"user_id\": %lld, \"username\": \"%s\", \"message\": \"%s\", \"timestamp\": %ld}",
+        (long long)job->user_id, job->username, esc_message, (long)time(NULL));
     
-    // Also send notification back to sender (echo) so they see their own message confirmed
-    // This is especially useful if the receiver is offline
-    printf("[FRIENDS] Sending echo to sender (user_id=%lld)...\n", (long long)sess->user_id);
-    fflush(stdout);
-    session_manager_send_to_user(sess->user_id, CMD_NOTIFY_DM,
-        dm_json, (uint32_t)strlen(dm_json));
-    printf("[FRIENDS] Echo sent to sender\n");
-    fflush(stdout);
+    // Broadcast to all room members
+    (void)session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_CHAT,
+        chat_json, (uint32_t)strlen(chat_json));
     
-    // Always return success if saved to DB, even if user is offline
-    protocol_send_simple_ok(sess, CMD_RES_SEND_DM);
-    printf("[FRIENDS] Success response sent\n");
-    fflush(stdout);
+    // Return success after broadcasting
+    protocol_send_simple_ok(sess, CMD_RES_SEND_ROOM_CHAT);
     
-    free(esc_username);
     free(esc_message);
-    free(message);
+    friends_job_free(job);
 }
 
-// Handle send room chat
 static void handle_send_room_chat(ClientSession *sess, const char *payload) {
-    char *message = util_json_get_string(payload, "message");
+    JsonObject req;
+    util_json_parse(payload, &req);
+    char *message = util_json_obj_string(&req, "message");
     if (!message) {
         protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "MISSING_MESSAGE");
         return;
@@ -723,7 +909,7 @@ static void handle_send_room_chat(ClientSession *sess, const char *payload) {
     // Get room_id from session or payload
     int64_t room_id = 0;
     long long room_id_ll = 0;
-    if (util_json_get_int64(payload, "room_id", &room_id_ll) && room_id_ll > 0) {
+    if (util_json_obj_int64(&req, "room_id", &room_id_ll) && room_id_ll > 0) {
         room_id = (int64_t)room_id_ll;
     } else if (sess->room_id > 0) {
         room_id = sess->room_id;
@@ -747,84 +933,50 @@ static void handle_send_room_chat(ClientSession *sess, const char *payload) {
         return;
     }
 
-    // Only allow chat when room is waiting
-    room_status_t status = ROOM_STATUS_WAITING;
-    if (dao_rooms_get_status(room_id, &status) != 0 || status != ROOM_STATUS_WAITING) {
-        free(message);
-        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "ROOM_NOT_WAITING");
-        return;
-    }
-
-    // Rate limit per user per room
-    if (!room_chat_rate_allow(sess->user_id, room_id)) {
-        free(message);
-        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "RATE_LIMITED");
-        return;
-    }
-    
-    // Get sender info
-    User sender;
-    if (dao_users_find_by_id(sess->user_id, &sender) != 0) {
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->room_id = room_id;
+        job->text = message;
+    } else {
         free(message);
-        fprintf(stderr, "[FRIENDS] SENDER_NOT_FOUND: user_id=%lld\n", (long long)sess->user_id);
-        protocol_send_error(sess, CMD_RES_SEND_ROOM_CHAT, "SENDER_NOT_FOUND");
-        return;
     }
-    
-    // Build room chat message JSON
-    char *esc_username = util_json_escape(sender.username);
-    char *esc_message = util_json_escape(message);
-    if (!esc_username) esc_username = strdup("");
-    if (!esc_message) esc_message = strdup("");
-    
-    char chat_json[2048];
-    snprintf(chat_json, sizeof(chat_json),
-        "{\"user_id\": %lld, \"username\": \"%s\", \"message\": \"%s\", \"timestamp\": %ld}",
-        (long long)sess->user_id, esc_username, esc_message, (long)time(NULL));
-    
-    // Broadcast to all room members
-    (void)session_manager_broadcast_to_room(room_id, CMD_NOTIFY_ROOM_CHAT,
-        chat_json, (uint32_t)strlen(chat_json));
-    
-    // Return success after broadcasting
-    protocol_send_simple_ok(sess, CMD_RES_SEND_ROOM_CHAT);
-    
-    free(esc_username);
-    free(esc_message);
-    free(message);
+    friends_submit(sess, job, room_chat_run, room_chat_done,
+                   CMD_RES_SEND_ROOM_CHAT, "ROOM_NOT_WAITING");
 }
 
 // Handle fetch offline messages
-static void handle_fetch_offline(ClientSession *sess, const char *payload) {
-    void *json_result = NULL;
-    
-    // Try to get friend_id from payload (optional - for conversation fetch)
-    long long friend_id_ll = 0;
-    bool has_friend_id = util_json_get_int64(payload, "friend_id", &friend_id_ll);
-    
-    if (has_friend_id && friend_id_ll > 0) {
+static void fetch_offline_run(void *arg) {
+    FriendsJob *job = arg;
+    if (job->flag) {
         // Fetch conversation between user and friend (both sent and received messages)
-        int64_t friend_id = (int64_t)friend_id_ll;
-        if (dao_chat_fetch_conversation(sess->user_id, friend_id, &json_result) != 0) {
-            protocol_send_error(sess, CMD_RES_FETCH_OFFLINE, "FETCH_CONVERSATION_FAILED");
-            return;
-        }
+        job->rc = dao_chat_fetch_conversation(job->user_id, job->peer_id, &job->json);
     } else {
         // Fallback: fetch all offline messages (old behavior)
-        if (dao_chat_fetch_offline(sess->user_id, &json_result) != 0) {
-            protocol_send_error(sess, CMD_RES_FETCH_OFFLINE, "FETCH_OFFLINE_FAILED");
-            return;
-        }
+        job->rc = dao_chat_fetch_offline(job->user_id, &job->json);
     }
-    
-    if (json_result) {
-        char *json_str = (char *)json_result;
-        protocol_send_response(sess, CMD_RES_FETCH_OFFLINE, json_str, (uint32_t)strlen(json_str));
-        free(json_result);
-    } else {
-        // No messages
-        protocol_send_response(sess, CMD_RES_FETCH_OFFLINE, "[]", 2);
+}
+
+static void fetch_offline_done(void *arg) {
+    FriendsJob *job = arg;
+    // No messages: empty list
+    friends_reply_json(job, CMD_RES_FETCH_OFFLINE,
+                       job->flag ? "FETCH_CONVERSATION_FAILED" : "FETCH_OFFLINE_FAILED", "[]");
+}
+
+static void handle_fetch_offline(ClientSession *sess, const char *payload) {
+    // Try to get friend_id from payload (optional - for conversation fetch)
+    long long friend_id_ll = 0;
+    JsonObject req;
+    util_json_parse(payload, &req);
+    bool has_friend_id = util_json_obj_int64(&req, "friend_id", &friend_id_ll);
+    
+    FriendsJob *job = friends_job_new(sess);
+    if (job) {
+        job->flag = has_friend_id && friend_id_ll > 0;
+        job->peer_id = (int64_t)friend_id_ll;
     }
+    friends_submit(sess, job, fetch_offline_run, fetch_offline_done,
+                   CMD_RES_FETCH_OFFLINE, "FETCH_OFFLINE_FAILED");
 }
 
 // Main dispatch function
@@ -0,0 +1,363 @@
+// server/src/service/leaderboard.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "service/leaderboard.h"
+#include "dao/dao_stats.h"
+#include "utils/idmap.h"
+#include "utils/json.h"
+#include "utils/log.h"
+#include "utils/strbuf.h"
+
+#define LB_MAX_LEVEL 24         // p = 1/4: plenty for millions of users
+
+typedef struct LbNode LbNode;
+
+typedef struct {
+    LbNode *next;
+    int span;                   // entries skipped by following next (to the end if NULL)
+} LbLink;
+
+struct LbNode {
+    int64_t user_id;
+    int total_wins;
+    char *username;
+    char *username_json;        // escaped
+    int level;
+    LbLink links[];
+};
+
+typedef struct {
+    LbNode *head;
+    int level;
+    int length;
+    IdMap by_user;              // user_id -> LbNode
+    uint64_t rng;               // for node levels
+} SkipList;
+
+static struct {
+    pthread_mutex_t lock;
+    SkipList list;
+    int initialized;
+    int loaded;
+} g_lb = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// ---- skip list ---------------------------------------------------------------
+
+static LbNode *node_new(int level, int64_t user_id, const char *username, int total_wins) {
+    LbNode *n = calloc(1, sizeof(LbNode) + sizeof(LbLink) * (size_t)level);
+    if (!n) return NULL;
+    n->level = level;
+    n->user_id = user_id;
+    n->total_wins = total_wins;
+    if (username) {
+        n->username = strdup(username);
+        n->username_json = util_json_escape(username);
+        if (!n->username || !n->username_json) {
+            free(n->username);
+            free(n->username_json);
+            free(n);
+            return NULL;
+        }
+    }
+    return n;
+}
+
+static void node_free(LbNode *n) {
+    free(n->username);
+    free(n->username_json);
+    free(n);
+}
+
+static int list_init(SkipList *l) {
+    l->head = node_new(LB_MAX_LEVEL, 0, NULL, 0);
+    if (!l->head) return -1;
+    if (idmap_init(&l->by_user, 1024) != 0) {
+        free(l->head);
+        l->head = NULL;
+        return -1;
+    }
+    l->level = 1;
+    l->length = 0;
+    l->rng = ((uint64_t)time(NULL) * 0x9E3779B97F4A7C15ULL) | 1;
+    return 0;
+}
+
+static void list_destroy(SkipList *l) {
+    if (!l->head) return;
+    LbNode *n = l->head->links[0].next;
+    while (n) {
+        LbNode *next = n->links[0].next;
+        node_free(n);
+        n = next;
+    }
+    free(l->head);
+    l->head = NULL;
+    idmap_free(&l->by_user);
+}
+
+// Leaderboard order: more wins first, then username, then user_id
+static int ranks_before(const LbNode *a, const LbNode *b) {
+    if (a->total_wins != b->total_wins) return a->total_wins > b->total_wins;
+    int c = strcmp(a->username, b->username);
+    if (c != 0) return c < 0;
+    return a->user_id < b->user_id;
+}
+
+static int random_level(SkipList *l) {
+    int level = 1;
+    while (level < LB_MAX_LEVEL) {
+        // xorshift64*, one more level with probability 1/4
+        l->rng ^= l->rng >> 12;
+        l->rng ^= l->rng << 25;
+        l->rng ^= l->rng >> 27;
+        if (((l->rng * 0x2545F4914F6CDD1DULL) >> 62) != 0) break;
+        level++;
+    }
+    return level;
+}
+
+static void list_link(SkipList *l, LbNode *node) {
+    LbNode *update[LB_MAX_LEVEL];
+    int rank[LB_MAX_LEVEL];
+
+    LbNode *x = l->head;
+    for (int i = l->level - 1; i >= 0; i--) {
+        rank[i] = (i == l->level - 1) ? 0 : rank[i + 1];
+        while (x->links[i].next && ranks_before(x->links[i].next, node)) {
+            rank[i] += x->links[i].span;
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    if (node->level > l->level) {
+        for (int i = l->level; i < node->level; i++) {
+            rank[i] = 0;
+            update[i] = l->head;
+            update[i]->links[i].span = l->length;
+        }
+        l->level = node->level;
+    }
+
+    for (int i = 0; i < node->level; i++) {
+        node->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = node;
+        node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = node->level; i < l->level; i++) {
+        update[i]->links[i].span++;
+    }
+    l->length++;
+}
+
+static void list_unlink(SkipList *l, LbNode *node) {
+    LbNode *update[LB_MAX_LEVEL];
+
+    LbNode *x = l->head;
+    for (int i = l->level - 1; i >= 0; i--) {
+        while (x->links[i].next && ranks_before(x->links[i].next, node)) {
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    for (int i = 0; i < l->level; i++) {
+        if (update[i]->links[i].next == node) {
+            update[i]->links[i].span += node->links[i].span - 1;
+            update[i]->links[i].next = node->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (l->level > 1 && !l->head->links[l->level - 1].next) {
+        l->level--;
+    }
+    l->length--;
+}
+
+static int list_put(SkipList *l, int64_t user_id, const char *username, int total_wins) {
+    LbNode *old = idmap_get(&l->by_user, user_id);
+    if (old) {
+        list_unlink(l, old);
+        idmap_remove(&l->by_user, user_id);
+    }
+
+    LbNode *node = node_new(random_level(l), user_id, username, total_wins);
+    if (!node || idmap_put(&l->by_user, user_id, node) != 0) {
+        if (node) node_free(node);
+        if (old) node_free(old);
+        return -1;
+    }
+    list_link(l, node);
+    if (old) node_free(old);
+    return 0;
+}
+
+static int list_rank(const SkipList *l, const LbNode *node) {
+    int rank = 0;
+    const LbNode *x = l->head;
+    for (int i = l->level - 1; i >= 0; i--) {
+        while (x->links[i].next &&
+               (x->links[i].next == node || ranks_before(x->links[i].next, node))) {
+            rank += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (x == node) return rank;
+    }
+    return 0;
+}
+
+// Entry at 1-based rank, or NULL
+static LbNode *list_at(const SkipList *l, int rank) {
+    if (rank < 1 || rank > l->length) return NULL;
+    int traversed = 0;
+    LbNode *x = l->head;
+    for (int i = l->level - 1; i >= 0; i--) {
+        while (x->links[i].next && traversed + x->links[i].span <= rank) {
+            traversed += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (traversed == rank) return x;
+    }
+    return NULL;
+}
+
+static int lb_ensure_init_locked(void) {
+    if (g_lb.initialized) return 0;
+    if (list_init(&g_lb.list) != 0) return -1;
+    g_lb.initialized = 1;
+    return 0;
+}
+
+// ---- public API ----------------------------------------------------------------
+
+static int load_row(int64_t user_id, const char *username, int total_wins, void *arg) {
+    return list_put((SkipList *)arg, user_id, username, total_wins);
+}
+
+int leaderboard_load(void) {
+    // Build the new list without the lock, then swap it in
+    SkipList fresh;
+    if (list_init(&fresh) != 0) return -1;
+    if (dao_stats_load_wins(load_row, &fresh) != 0) {
+        list_destroy(&fresh);
+        LOG_ERROR(LOG_CAT_STATS, "Leaderboard load failed");
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_lb.lock);
+    SkipList old = g_lb.list;
+    int had_old = g_lb.initialized;
+    g_lb.list = fresh;
+    g_lb.initialized = 1;
+    g_lb.loaded = 1;
+    pthread_mutex_unlock(&g_lb.lock);
+
+    if (had_old) list_destroy(&old);
+    LOG_INFO(LOG_CAT_STATS, "Leaderboard loaded: %d users", fresh.length);
+    return 0;
+}
+
+int leaderboard_is_loaded(void) {
+    pthread_mutex_lock(&g_lb.lock);
+    int loaded = g_lb.loaded;
+    pthread_mutex_unlock(&g_lb.lock);
+    return loaded;
+}
+
+int leaderboard_put(int64_t user_id, const char *username, int total_wins) {
+    if (user_id <= 0 || !username) return -1;
+    pthread_mutex_lock(&g_lb.lock);
+    int rc = lb_ensure_init_locked();
+    if (rc == 0) rc = list_put(&g_lb.list, user_id, username, total_wins);
+    pthread_mutex_unlock(&g_lb.lock);
+    return rc;
+}
+
+void leaderboard_add_wins(int64_t user_id, int delta) {
+    if (delta == 0) return;
+    pthread_mutex_lock(&g_lb.lock);
+    LbNode *node = g_lb.initialized ? idmap_get(&g_lb.list.by_user, user_id) : NULL;
+    if (node) {
+        // Same node, new position
+        list_unlink(&g_lb.list, node);
+        node->total_wins += delta;
+        list_link(&g_lb.list, node);
+    }
+    pthread_mutex_unlock(&g_lb.lock);
+}
+
+int leaderboard_rank(int64_t user_id, int *out_wins) {
+    pthread_mutex_lock(&g_lb.lock);
+    LbNode *node = g_lb.initialized ? idmap_get(&g_lb.list.by_user, user_id) : NULL;
+    int rank = node ? list_rank(&g_lb.list, node) : 0;
+    if (node && out_wins) *out_wins = node->total_wins;
+    pthread_mutex_unlock(&g_lb.lock);
+    return rank;
+}
+
+int leaderboard_size(void) {
+    pthread_mutex_lock(&g_lb.lock);
+    int n = g_lb.initialized ? g_lb.list.length : 0;
+    pthread_mutex_unlock(&g_lb.lock);
+    return n;
+}
+
+// ---- JSON ------------------------------------------------------------------------
+
+// Entries from rank `first` on, at most count of them
+static void json_entries(StrBuf *j, LbNode *node, int first, int count) {
+    strbuf_appends(j, "[");
+    for (int i = 0; node && i < count; i++, node = node->links[0].next) {
+        strbuf_appendf(j, "%s{\"rank\": %d, \"user_id\": %lld, \"username\": \"%s\", \"total_wins\": %d}",
+                       i > 0 ? "," : "", first + i, (long long)node->user_id,
+                       node->username_json, node->total_wins);
+    }
+    strbuf_appends(j, "]");
+}
+
+char *leaderboard_json(int64_t user_id, int limit, int around) {
+    if (limit <= 0) limit = LEADERBOARD_DEFAULT_LIMIT;
+    if (limit > LEADERBOARD_MAX_LIMIT) limit = LEADERBOARD_MAX_LIMIT;
+    if (around < 0) around = 0;
+    if (around > LEADERBOARD_MAX_AROUND) around = LEADERBOARD_MAX_AROUND;
+
+    StrBuf j = STRBUF_INIT;
+
+    pthread_mutex_lock(&g_lb.lock);
+    if (lb_ensure_init_locked() != 0) {
+        pthread_mutex_unlock(&g_lb.lock);
+        return NULL;
+    }
+    SkipList *l = &g_lb.list;
+
+    strbuf_appends(&j, "{\"leaderboard\": ");
+    json_entries(&j, l->head->links[0].next, 1, limit);
+
+    LbNode *me = user_id > 0 ? idmap_get(&l->by_user, user_id) : NULL;
+    if (me) {
+        int rank = list_rank(l, me);
+        int first = rank - around > 1 ? rank - around : 1;
+        strbuf_appendf(&j, ", \"my_rank\": %d, \"my_total_wins\": %d, \"around\": ",
+                       rank, me->total_wins);
+        json_entries(&j, list_at(l, first), first, rank - first + around + 1);
+    }
+    strbuf_appends(&j, "}");
+    pthread_mutex_unlock(&g_lb.lock);
+
+    return strbuf_detach(&j);
+}
+
+void leaderboard_free(void) {
+    pthread_mutex_lock(&g_lb.lock);
+    if (g_lb.initialized) {
+        list_destroy(&g_lb.list);
+        g_lb.initialized = 0;
+    }
+    g_lb.loaded = 0;
+    pthread_mutex_unlock(&g_lb.lock);
+}
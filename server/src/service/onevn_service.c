@@ -2,7 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <time.h>
 #include "service/onevn_service.h"
 #include "service/commands.h"
 #include "service/protocol.h"
@@ -10,10 +12,25 @@
 #include "service/session_manager.h"
 #include "dao/dao_rooms.h"
 #include "dao/dao_onevn.h"
-#include "dao/dao_question.h"
 #include "dao/dao_stats.h"
+#include "service/leaderboard.h"
+#include "service/question_bank.h"
+#include "utils/idmap.h"
 #include "utils/json.h"
 #include "utils/timer.h"
+#include "utils/log.h"
+#include "utils/strbuf.h"
+
+// One player's in-game record. Everything an answer touches sits together
+// (32 bytes), instead of one entry in each of several parallel arrays.
+typedef struct {
+    int64_t user_id;
+    int score;
+    int consecutive_correct;
+    int answered_round;  // Round the player last answered (-1: none yet)
+    int eliminated;
+    int rank;            // Index in ranking
+} OneVNPlayer;
 
 // Game state structure (in-memory, per session)
 typedef struct OneVNGameState {
@@ -28,19 +45,30 @@ typedef struct OneVNGameState {
     int medium_done;
     int hard_done;
     char current_difficulty[16];
-    Question current_question;
-    int64_t *player_ids;
+    Question *current_question;  // Points into questions
+    OneVNPlayer *players;
     int player_count;
-    int *player_scores;
-    int *player_consecutive_correct;
-    int *player_eliminated;
-    int64_t *player_answered_round;  // Track which round each player last answered
+    IdMap player_slots;  // user_id -> index in players + 1
+    int active_count;    // Players not eliminated
+    int answered_count;  // Active players who answered the current round
+    // Player slots by score, best first (ties: lower slot first). Kept
+    // sorted as scores change, so no sort is needed to serialize it.
+    int *ranking;
+    // Serialized ranking, rebuilt only when leaderboard_dirty
+    StrBuf leaderboard;
+    int leaderboard_dirty;
+    StrBuf frame;  // Scratch buffer for leaderboard and game over frames
     int timer_id;  // Timer ID for current round
-    int64_t current_round_id;  // Database round_id for current round (for replay)
-    // Track used question IDs to prevent duplicates
-    int64_t *used_question_ids;
-    int used_question_count;
-    int used_question_capacity;
+    int recorded_round;  // Round being recorded in the database for replay (0: none)
+    // Answers of the current round, written to the database once it ends
+    OneVNAnswer *round_answers;
+    int round_answer_count;
+    // The game's questions, drawn from the bank at start (no duplicates):
+    // EASY, then MEDIUM, then HARD, the order select_next_difficulty uses
+    Question **questions;
+    // Allocated lengths of the arrays above, kept when the state is pooled
+    int player_capacity;
+    int question_capacity;
 } OneVNGameState;
 
 // Forward declarations
@@ -49,10 +77,16 @@ static void end_game(OneVNGameState *state, int64_t winner_id);
 static void round_timeout_callback(int64_t context_id, void *user_data);
 static void delayed_question_callback(int64_t context_id, void *user_data);
 
-// Global game states (in production, use hash table or better structure)
-#define MAX_GAMES 100
-static OneVNGameState *game_states[MAX_GAMES];
-static int game_count = 0;
+// Running games, indexed by session_id and by room_id. Like the rest of the
+// game state they are only touched under session_manager_lock().
+static IdMap games_by_session;
+static IdMap games_by_room;
+static int games_initialized = 0;
+
+// States of finished games, kept with their arrays for the next game
+#define GAME_POOL_MAX 32
+static OneVNGameState *game_pool[GAME_POOL_MAX];
+static int game_pool_count = 0;
 static void round_timeout_callback(int64_t context_id, void *user_data);
 
 // Helper: Calculate score for a question
@@ -83,41 +117,163 @@ static int calculate_score(const char *difficulty, double time_left_percent, int
 
 // Helper: Get game state by session_id
 static OneVNGameState *get_game_state(int64_t session_id) {
-    for (int i = 0; i < game_count; i++) {
-        if (game_states[i] && game_states[i]->session_id == session_id) {
-            return game_states[i];
-        }
-    }
-    return NULL;
+    return games_initialized ? idmap_get(&games_by_session, session_id) : NULL;
 }
 
 // Helper: Get game state by room_id
 static OneVNGameState *get_game_state_by_room(int64_t room_id) {
-    for (int i = 0; i < game_count; i++) {
-        if (game_states[i] && game_states[i]->room_id == room_id) {
-            return game_states[i];
+    return games_initialized ? idmap_get(&games_by_room, room_id) : NULL;
+}
+
+// Helper: Add a started game to the registry (0 on success)
+static int register_game(OneVNGameState *state) {
+    if (!games_initialized) {
+        if (idmap_init(&games_by_session, 64) != 0) return -1;
+        if (idmap_init(&games_by_room, 64) != 0) {
+            idmap_free(&games_by_session);
+            return -1;
         }
+        games_initialized = 1;
     }
-    return NULL;
+    if (idmap_put(&games_by_session, state->session_id, state) != 0) return -1;
+    if (idmap_put(&games_by_room, state->room_id, state) != 0) {
+        idmap_remove(&games_by_session, state->session_id);
+        return -1;
+    }
+    return 0;
 }
 
-// Helper: Free game state
-static void free_game_state(OneVNGameState *state) {
+static void unregister_game(OneVNGameState *state) {
+    if (!games_initialized) return;
+    if (idmap_get(&games_by_session, state->session_id) == state) {
+        idmap_remove(&games_by_session, state->session_id);
+    }
+    if (idmap_get(&games_by_room, state->room_id) == state) {
+        idmap_remove(&games_by_room, state->room_id);
+    }
+}
+
+// Helper: Free game state and its arrays
+static void destroy_game_state(OneVNGameState *state) {
     if (!state) return;
-    if (state->player_ids) free(state->player_ids);
-    if (state->player_scores) free(state->player_scores);
-    if (state->player_consecutive_correct) free(state->player_consecutive_correct);
-    if (state->player_eliminated) free(state->player_eliminated);
-    if (state->player_answered_round) free(state->player_answered_round);
-    if (state->used_question_ids) free(state->used_question_ids);
+    if (state->players) free(state->players);
+    if (state->questions) free(state->questions);
+    if (state->round_answers) free(state->round_answers);
+    if (state->ranking) free(state->ranking);
+    idmap_free(&state->player_slots);
+    strbuf_free(&state->leaderboard);
+    strbuf_free(&state->frame);
     free(state);
 }
 
+// Helper: Take a state from the pool (or allocate one) with room for
+// player_count players and question_count questions, everything zeroed
+static OneVNGameState *alloc_game_state(int player_count, int question_count) {
+    OneVNGameState *state = game_pool_count > 0 ? game_pool[--game_pool_count]
+                                                : calloc(1, sizeof(OneVNGameState));
+    if (!state) return NULL;
+
+    // Keep the arrays across the reset
+    OneVNGameState arrays = *state;
+    memset(state, 0, sizeof(*state));
+    state->players = arrays.players;
+    state->round_answers = arrays.round_answers;
+    state->ranking = arrays.ranking;
+    state->questions = arrays.questions;
+    state->player_slots = arrays.player_slots;
+    state->leaderboard = arrays.leaderboard;
+    state->frame = arrays.frame;
+    strbuf_reset(&state->leaderboard);
+    strbuf_reset(&state->frame);
+    state->player_capacity = arrays.player_capacity;
+    state->question_capacity = arrays.question_capacity;
+
+    if (state->player_capacity < player_count) {
+        free(state->players);
+        free(state->round_answers);
+        free(state->ranking);
+        state->players = malloc(sizeof(OneVNPlayer) * player_count);
+        state->round_answers = malloc(sizeof(OneVNAnswer) * player_count);
+        state->ranking = malloc(sizeof(int) * player_count);
+        state->player_capacity = player_count;
+    }
+    if (state->question_capacity < question_count) {
+        free(state->questions);
+        state->questions = malloc(sizeof(Question *) * question_count);
+        state->question_capacity = state->questions ? question_count : 0;
+    }
+    if (state->player_slots.entries) {
+        idmap_clear(&state->player_slots);
+    } else if (idmap_init(&state->player_slots, (size_t)player_count * 2) != 0) {
+        destroy_game_state(state);
+        return NULL;
+    }
+
+    if (!state->players || !state->questions || !state->round_answers || !state->ranking) {
+        destroy_game_state(state);
+        return NULL;
+    }
+
+    memset(state->players, 0, sizeof(OneVNPlayer) * player_count);
+    memset(state->round_answers, 0, sizeof(OneVNAnswer) * player_count);
+    memset(state->questions, 0, sizeof(Question *) * question_count);
+    return state;
+}
+
+// Helper: Find a player by user_id in O(1)
+static OneVNPlayer *find_player(OneVNGameState *state, int64_t user_id) {
+    void *slot = idmap_get(&state->player_slots, user_id);
+    return slot ? &state->players[(intptr_t)slot - 1] : NULL;
+}
+
+// Helper: Every active player answered the current round
+static int round_complete(const OneVNGameState *state) {
+    return state->active_count > 0 && state->answered_count >= state->active_count;
+}
+
+// Helper: Count an active player's answer (or timeout) for the current round
+static void mark_answered(OneVNGameState *state, OneVNPlayer *p) {
+    p->answered_round = state->current_round;
+    state->answered_count++;
+}
+
+// Helper: Move a player up the ranking after their score went up
+static void ranking_raise(OneVNGameState *state, OneVNPlayer *p) {
+    int slot = (int)(p - state->players);
+    int pos = p->rank;
+    while (pos > 0) {
+        OneVNPlayer *ahead = &state->players[state->ranking[pos - 1]];
+        int before = ahead->score < p->score ||
+                     (ahead->score == p->score && state->ranking[pos - 1] > slot);
+        if (!before) break;
+        state->ranking[pos] = state->ranking[pos - 1];
+        ahead->rank = pos;
+        pos--;
+    }
+    state->ranking[pos] = slot;
+    p->rank = pos;
+    state->leaderboard_dirty = 1;
+}
+
+// Helper: Give back a game's questions and keep its state for reuse
+static void free_game_state(OneVNGameState *state) {
+    if (!state) return;
+    if (state->questions) {
+        for (int i = 0; i < state->total_rounds; i++) question_release(state->questions[i]);
+    }
+    if (game_pool_count < GAME_POOL_MAX) {
+        game_pool[game_pool_count++] = state;
+    } else {
+        destroy_game_state(state);
+    }
+}
+
 // Helper: Initialize game state
 static OneVNGameState *init_game_state(int64_t session_id, int64_t room_id, 
                                        int easy_count, int medium_count, int hard_count,
                                        int64_t *player_ids, int player_count) {
-    OneVNGameState *state = calloc(1, sizeof(OneVNGameState));
+    int question_count = easy_count + medium_count + hard_count;
+    OneVNGameState *state = alloc_game_state(player_count, question_count > 0 ? question_count : 1);
     if (!state) return NULL;
 
     state->session_id = session_id;
@@ -133,33 +289,39 @@ static OneVNGameState *init_game_state(int64_t session_id, int64_t room_id,
     state->player_count = player_count;
     state->current_round = 0;  // Will be incremented when first question is sent
 
-    state->player_ids = malloc(sizeof(int64_t) * player_count);
-    state->player_scores = calloc(player_count, sizeof(int));
-    state->player_consecutive_correct = calloc(player_count, sizeof(int));
-    state->player_eliminated = calloc(player_count, sizeof(int));
-    state->player_answered_round = calloc(player_count, sizeof(int64_t));
     state->timer_id = -1;
-    state->current_round_id = -1;  // No round created yet
-    
-    // Initialize duplicate question tracking
-    state->used_question_capacity = state->total_rounds + 10;  // Extra capacity
-    state->used_question_ids = calloc(state->used_question_capacity, sizeof(int64_t));
-    state->used_question_count = 0;
-
-    if (!state->player_ids || !state->player_scores || 
-        !state->player_consecutive_correct || !state->player_eliminated ||
-        !state->player_answered_round || !state->used_question_ids) {
-        free_game_state(state);
-        return NULL;
-    }
+    state->recorded_round = 0;  // No round created yet
 
     for (int i = 0; i < player_count; i++) {
-        state->player_ids[i] = player_ids[i];
-        state->player_scores[i] = 0;
-        state->player_consecutive_correct[i] = 0;
-        state->player_eliminated[i] = 0;
-        state->player_answered_round[i] = -1;
+        OneVNPlayer *p = &state->players[i];
+        p->user_id = player_ids[i];
+        p->answered_round = -1;
+        p->rank = i;
+        state->ranking[i] = i;
+        // A listed twice user keeps the first slot
+        if (!idmap_get(&state->player_slots, p->user_id) &&
+            idmap_put(&state->player_slots, p->user_id, (void *)(intptr_t)(i + 1)) != 0) {
+            free_game_state(state);
+            return NULL;
+        }
     }
+    state->active_count = player_count;
+    state->leaderboard_dirty = 1;
+
+    // The whole deck in one call, shared with quick mode. A difficulty with
+    // fewer questions than configured gets fewer rounds.
+    int dealt = question_bank_deal(&state->easy_count, &state->medium_count,
+                                   &state->hard_count, state->questions);
+    if (dealt < state->total_rounds) {
+        LOG_WARN(LOG_CAT_ONEVN, "Only %d of %d questions available (easy=%d medium=%d hard=%d)",
+                 dealt < 0 ? 0 : dealt, state->total_rounds,
+                 state->easy_count, state->medium_count, state->hard_count);
+    }
+    if (dealt < 0) {
+        state->easy_count = state->medium_count = state->hard_count = 0;
+        dealt = 0;
+    }
+    state->total_rounds = dealt;
 
     return state;
 }
@@ -183,121 +345,138 @@ static const char *select_next_difficulty(OneVNGameState *state) {
     }
 }
 
-// Helper: Build leaderboard JSON
-static char *build_leaderboard_json(OneVNGameState *state) {
-    // Create array of players sorted by score
-    int *indices = malloc(sizeof(int) * state->player_count);
-    if (!indices) return NULL;
+// Helper: Leaderboard JSON array in ranking order, serialized again only
+// if a score or elimination changed since the last call. Owned by the
+// state; NULL if out of memory.
+static const char *leaderboard_snapshot(OneVNGameState *state) {
+    if (!state->leaderboard_dirty && state->leaderboard.data) return state->leaderboard.data;
 
+    StrBuf *sb = &state->leaderboard;
+    strbuf_reset(sb);
+    strbuf_appends(sb, "[");
     for (int i = 0; i < state->player_count; i++) {
-        indices[i] = i;
+        const OneVNPlayer *p = &state->players[state->ranking[i]];
+        strbuf_appendf(sb, "%s{\"rank\":%d,\"user_id\":%ld,\"score\":%d,\"eliminated\":%s}",
+                       i > 0 ? "," : "", i + 1, p->user_id, p->score,
+                       p->eliminated ? "true" : "false");
     }
+    strbuf_appends(sb, "]");
+    if (sb->failed) return NULL;
 
-    // Sort by score (descending)
-    for (int i = 0; i < state->player_count - 1; i++) {
-        for (int j = i + 1; j < state->player_count; j++) {
-            if (state->player_scores[indices[i]] < state->player_scores[indices[j]]) {
-                int tmp = indices[i];
-                indices[i] = indices[j];
-                indices[j] = tmp;
-            }
-        }
-    }
-
-    size_t cap = 512;
-    size_t used = 0;
-    char *json = malloc(cap);
-    if (!json) { free(indices); return NULL; }
-    used += snprintf(json + used, cap - used, "[");
-
-    for (int i = 0; i < state->player_count; i++) {
-        int idx = indices[i];
-        int rank = i + 1;
-        const char *eliminated_str = state->player_eliminated[idx] ? "true" : "false";
-        int need = snprintf(NULL, 0, 
-            "{\"rank\":%d,\"user_id\":%ld,\"score\":%d,\"eliminated\":%s}",
-            rank, state->player_ids[idx], state->player_scores[idx], eliminated_str);
-        
-        if (used + (size_t)need + 3 >= cap) {
-            cap = (used + (size_t)need + 3) * 2;
-            char *tmp = realloc(json, cap);
-            if (!tmp) { free(json); free(indices); return NULL; }
-            json = tmp;
-        }
-
-        if (i > 0) used += snprintf(json + used, cap - used, ",");
-        used += snprintf(json + used, cap - used,
-            "{\"rank\":%d,\"user_id\":%ld,\"score\":%d,\"eliminated\":%s}",
-            rank, state->player_ids[idx], state->player_scores[idx], eliminated_str);
-    }
+    state->leaderboard_dirty = 0;
+    return sb->data;
+}
 
-    used += snprintf(json + used, cap - used, "]");
-    free(indices);
-    return json;
+// Helper: Send the leaderboard to the room between rounds
+static void broadcast_leaderboard(OneVNGameState *state, const char *leaderboard) {
+    if (!leaderboard) return;
+    StrBuf *frame = &state->frame;
+    strbuf_reset(frame);
+    strbuf_appendf(frame, "{\"leaderboard\": %s}", leaderboard);
+    if (frame->failed) return;
+    session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_ROOM_UPDATE,
+                                      frame->data, (uint32_t)frame->len);
 }
 
 // Helper: Check game end conditions
 static int check_game_end(OneVNGameState *state, int64_t *winner_id) {
     // All questions done -> highest score wins (no elimination, all players finish)
     if (state->current_round >= state->total_rounds) {
-        int max_score = -1;
-        int winner_idx = -1;
-        for (int i = 0; i < state->player_count; i++) {
-            if (state->player_scores[i] > max_score) {
-                max_score = state->player_scores[i];
-                winner_idx = i;
-            }
-        }
-        if (winner_idx >= 0) {
-            *winner_id = state->player_ids[winner_idx];
-        } else {
-            *winner_id = 0;
-        }
+        *winner_id = state->player_count > 0 ? state->players[state->ranking[0]].user_id : 0;
         return 1;
     }
 
     return 0;
 }
 
-// Start 1vN game
-static void handle_start_game(ClientSession *sess, const char *payload, uint32_t payload_len) {
-    (void)payload_len;
-    
-    long long room_id_ll = 0;
-    util_json_get_int64(payload, "room_id", &room_id_ll);
-    int64_t room_id = (int64_t)room_id_ll;
-    if (room_id == 0) {
-        protocol_send_error(sess, CMD_RES_START_GAME, "INVALID_ROOM_ID");
-        return;
+// Helper: Record an answer in the current round's journal (no DB access)
+static void journal_answer(OneVNGameState *state, int64_t user_id, char answer,
+                           int is_correct, int score_gained, double time_left) {
+    if (state->recorded_round <= 0) return;  // round not in database, nothing to replay
+    if (state->round_answer_count >= state->player_count) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    OneVNAnswer *a = &state->round_answers[state->round_answer_count++];
+    a->user_id = user_id;
+    a->answer = answer;
+    a->is_correct = is_correct;
+    a->score_gained = score_gained;
+    a->time_left = time_left;
+    a->answered_at = (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Helper: Write the finished round (answers, ended_at, players JSONB) in the
+// background; answer responses never wait for the database
+static void flush_round(OneVNGameState *state, const char *leaderboard) {
+    if (state->recorded_round <= 0 && !leaderboard) return;
+    if (dao_onevn_save_round_async(state->session_id, state->recorded_round,
+                                   state->round_answers, state->round_answer_count,
+                                   leaderboard) != 0) {
+        LOG_WARN(LOG_CAT_ONEVN, "Failed to save round %d for replay", state->current_round);
     }
+    state->recorded_round = 0;
+    state->round_answer_count = 0;
+}
+
+// Start 1vN game: the room checks, the session row and the room status are
+// written on the DB pool; the game itself is set up back on the owner's loop
+typedef struct {
+    SessionRef ref;
+    int64_t user_id;
+    int64_t room_id;
+    // Results
+    const char *error;         // error code, NULL on success
+    int64_t *player_ids;
+    int member_count;
+    int easy_count, medium_count, hard_count;
+    int64_t session_id;
+} StartGameJob;
+
+static void start_game_job_free(StartGameJob *job) {
+    free(job->player_ids);
+    free(job);
+}
+
+static void start_game_run(void *arg) {
+    StartGameJob *job = arg;
+    int64_t room_id = job->room_id;
 
     // Check if user is owner
     int64_t owner_id = 0;
-    if (dao_rooms_get_owner(room_id, &owner_id) != 0 || owner_id != sess->user_id) {
-        protocol_send_error(sess, CMD_RES_START_GAME, "NOT_OWNER");
+    if (dao_rooms_get_owner(room_id, &owner_id) != 0 || owner_id != job->user_id) {
+        job->error = "NOT_OWNER";
         return;
     }
 
     // Get room members
     void *members_json = NULL;
     if (dao_rooms_get_members(room_id, &members_json) != 0) {
-        protocol_send_error(sess, CMD_RES_START_GAME, "GET_MEMBERS_FAILED");
+        job->error = "GET_MEMBERS_FAILED";
         return;
     }
 
-    // Parse members JSON to get actual member list using improved parser
-    int64_t player_ids_temp[32];
-    int member_count = util_json_parse_user_id_array((const char *)members_json, player_ids_temp, 32);
+    // Parse members JSON to get actual member list, sized from the JSON
+    // (one "user_id" per member) so large rooms are not cut off
+    int max_members = 0;
+    for (const char *p = members_json; (p = strstr(p, "\"user_id\"")) != NULL; p++) max_members++;
+    job->player_ids = malloc(sizeof(int64_t) * (max_members > 0 ? max_members : 1));
+    if (!job->player_ids) {
+        free(members_json);
+        job->error = "MEMORY_ERROR";
+        return;
+    }
+    int member_count = util_json_parse_user_id_array((const char *)members_json, job->player_ids, max_members);
+    job->member_count = member_count;
     
     // Debug: Print to both stderr and include in error message
-    printf("[ONEVN] Room %lld has %d members. Members JSON: %s\n", 
+    LOG_DEBUG(LOG_CAT_ONEVN, "Room %lld has %d members. Members JSON: %s", 
            (long long)room_id, member_count, (const char *)members_json);
-    fflush(stdout);
 
     // Get room config
     int easy_count = 0, medium_count = 0, hard_count = 0;
     if (dao_rooms_get_config(room_id, &easy_count, &medium_count, &hard_count) != 0) {
-        printf("[ONEVN] WARNING: Could not get room config, using defaults (5,5,5)\n");
+        LOG_WARN(LOG_CAT_ONEVN, "Could not get room config, using defaults (5,5,5)");
         easy_count = 5;
         medium_count = 5;
         hard_count = 5;
@@ -305,88 +484,79 @@ static void handle_start_game(ClientSession *sess, const char *payload, uint32_t
     
     // If config is all zeros, use defaults and update database
     if (easy_count == 0 && medium_count == 0 && hard_count == 0) {
-        printf("[ONEVN] WARNING: Room config is (0,0,0), updating to defaults (5,5,5)\n");
+        LOG_WARN(LOG_CAT_ONEVN, "Room config is (0,0,0), updating to defaults (5,5,5)");
         easy_count = 5;
         medium_count = 5;
         hard_count = 5;
         // Update room with default config in database
         dao_rooms_update_config(room_id, easy_count, medium_count, hard_count);
     }
+    job->easy_count = easy_count;
+    job->medium_count = medium_count;
+    job->hard_count = hard_count;
     
-    printf("[ONEVN] Room %lld config: easy=%d, medium=%d, hard=%d (total=%d)\n",
+    LOG_DEBUG(LOG_CAT_ONEVN, "Room %lld config: easy=%d, medium=%d, hard=%d (total=%d)",
            (long long)room_id, easy_count, medium_count, hard_count,
            easy_count + medium_count + hard_count);
-    fflush(stdout);
 
     // Check minimum 2 players
     if (member_count < 2) {
-        printf("[ONEVN] ERROR: NOT_ENOUGH_PLAYERS: member_count=%d, members_json=%s\n",
+        LOG_WARN(LOG_CAT_ONEVN, "NOT_ENOUGH_PLAYERS: member_count=%d, members_json=%s",
                member_count, (const char *)members_json);
-        fflush(stdout);
         free(members_json);
-        protocol_send_error(sess, CMD_RES_START_GAME, "NOT_ENOUGH_PLAYERS");
+        job->error = "NOT_ENOUGH_PLAYERS";
         return;
     }
+    free(members_json);
 
     // Create 1vN session
-    int64_t session_id = 0;
-    if (dao_onevn_create_session(room_id, &session_id) != 0) {
-        free(members_json);
-        protocol_send_error(sess, CMD_RES_START_GAME, "CREATE_SESSION_FAILED");
+    if (dao_onevn_create_session(room_id, &job->session_id) != 0) {
+        job->error = "CREATE_SESSION_FAILED";
         return;
     }
 
     // Update room status
     dao_rooms_update_status(room_id, ROOM_STATUS_IN_PROGRESS);
+}
 
-    // Copy player IDs
-    int64_t *player_ids = malloc(sizeof(int64_t) * member_count);
-    if (!player_ids) {
-        free(members_json);
-        protocol_send_error(sess, CMD_RES_START_GAME, "MEMORY_ERROR");
+static void start_game_done(void *arg) {
+    StartGameJob *job = arg;
+    // The owner may be gone by now; a created session is started anyway so
+    // the other players are not left in an IN_PROGRESS room
+    ClientSession *sess = session_ref_get(&job->ref);
+    int64_t room_id = job->room_id;
+    int64_t session_id = job->session_id;
+    int64_t *player_ids = job->player_ids;
+    int idx = job->member_count;
+
+    if (job->error) {
+        if (sess) protocol_send_error(sess, CMD_RES_START_GAME, job->error);
+        start_game_job_free(job);
         return;
     }
-    
-    for (int i = 0; i < member_count; i++) {
-        player_ids[i] = player_ids_temp[i];
-    }
-    
-    int idx = member_count;
 
     OneVNGameState *state = init_game_state(session_id, room_id, 
-                                            easy_count, medium_count, hard_count,
+                                            job->easy_count, job->medium_count, job->hard_count,
                                             player_ids, idx);
     if (!state) {
-        free(player_ids);
-        free(members_json);
-        protocol_send_error(sess, CMD_RES_START_GAME, "INIT_GAME_FAILED");
+        if (sess) protocol_send_error(sess, CMD_RES_START_GAME, "INIT_GAME_FAILED");
+        start_game_job_free(job);
         return;
     }
 
     // Store game state
-    if (game_count < MAX_GAMES) {
-        game_states[game_count++] = state;
-    } else {
+    if (register_game(state) != 0) {
         free_game_state(state);
-        free(player_ids);
-        free(members_json);
-        protocol_send_error(sess, CMD_RES_START_GAME, "MAX_GAMES_REACHED");
+        if (sess) protocol_send_error(sess, CMD_RES_START_GAME, "MEMORY_ERROR");
+        start_game_job_free(job);
         return;
     }
 
-    // Initialize players JSONB in database
-    size_t players_init_cap = 512;
-    char *players_init = malloc(players_init_cap);
+    // Initialize players JSONB in database (everyone at 0, any room size),
+    // queued ahead of the session's round writes
+    const char *players_init = leaderboard_snapshot(state);
     if (players_init) {
-        int used = snprintf(players_init, players_init_cap, "[");
-        for (int i = 0; i < idx; i++) {
-            if (i > 0) used += snprintf(players_init + used, players_init_cap - used, ",");
-            used += snprintf(players_init + used, players_init_cap - used,
-                "{\"user_id\":%ld,\"score\":0,\"eliminated\":false}", player_ids[i]);
-        }
-        snprintf(players_init + used, players_init_cap - used, "]");
-        dao_onevn_update_players(session_id, players_init);
-        free(players_init);
+        dao_onevn_save_round_async(session_id, 0, NULL, 0, players_init);
     }
 
     // Update sessions' room_id BEFORE broadcasting (important!)
@@ -394,13 +564,11 @@ static void handle_start_game(ClientSession *sess, const char *payload, uint32_t
         ClientSession *player_sess = session_manager_get_by_user_id(player_ids[i]);
         if (player_sess) {
             session_manager_set_room(player_sess, room_id);
-            printf("[ONEVN] Set room_id=%lld for user_id=%lld\n",
+            LOG_DEBUG(LOG_CAT_ONEVN, "Set room_id=%lld for user_id=%lld",
                    (long long)room_id, (long long)player_ids[i]);
-            fflush(stdout);
         } else {
-            printf("[ONEVN] WARNING: Could not find session for user_id=%lld\n",
+            LOG_WARN(LOG_CAT_ONEVN, "Could not find session for user_id=%lld",
                    (long long)player_ids[i]);
-            fflush(stdout);
         }
     }
     
@@ -412,14 +580,40 @@ static void handle_start_game(ClientSession *sess, const char *payload, uint32_t
     session_manager_broadcast_to_room(room_id, CMD_NOTIFY_GAME_START_1VN, response, strlen(response));
     
     // Also send response to owner
-    protocol_send_response(sess, CMD_RES_START_GAME, response, strlen(response));
+    if (sess) protocol_send_response(sess, CMD_RES_START_GAME, response, strlen(response));
     
     // Send first question after a short delay (in production, use async)
     // For now, we'll send it immediately
     send_next_question(state);
 
-    free(player_ids);
-    free(members_json);
+    start_game_job_free(job);
+}
+
+static void handle_start_game(ClientSession *sess, const char *payload, uint32_t payload_len) {
+    (void)payload_len;
+    
+    long long room_id_ll = 0;
+    JsonObject req;
+    util_json_parse(payload, &req);
+    util_json_obj_int64(&req, "room_id", &room_id_ll);
+    int64_t room_id = (int64_t)room_id_ll;
+    if (room_id == 0) {
+        protocol_send_error(sess, CMD_RES_START_GAME, "INVALID_ROOM_ID");
+        return;
+    }
+
+    StartGameJob *job = calloc(1, sizeof(StartGameJob));
+    if (!job) {
+        protocol_send_error(sess, CMD_RES_START_GAME, "MEMORY_ERROR");
+        return;
+    }
+    session_ref_init(&job->ref, sess);
+    job->user_id = sess->user_id;
+    job->room_id = room_id;
+    if (session_manager_submit_db(sess, start_game_run, start_game_done, job) != 0) {
+        start_game_job_free(job);
+        protocol_send_error(sess, CMD_RES_START_GAME, "MEMORY_ERROR");
+    }
 }
 
 // Submit answer in 1vN mode
@@ -431,15 +625,22 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
     char answer[2] = {0};
     double time_left = 0.0;
 
-    util_json_get_int64(payload, "session_id", &session_id_ll);
-    util_json_get_int64(payload, "round", &round_ll);
+    JsonObject req;
+    util_json_parse(payload, &req);
+    util_json_obj_int64(&req, "session_id", &session_id_ll);
+    util_json_obj_int64(&req, "round", &round_ll);
     int64_t session_id = (int64_t)session_id_ll;
     int64_t round = (int64_t)round_ll;
-    char *answer_str = util_json_get_string(payload, "answer");
-    util_json_get_double(payload, "time_left", &time_left);
+    char *answer_str = util_json_obj_string(&req, "answer");
+    util_json_obj_double(&req, "time_left", &time_left);
 
-    if (answer_str && strlen(answer_str) > 0) {
+    // Only A-D count as an answer; anything else is recorded as no answer
+    // (wrong, NULL in the replay)
+    if (answer_str && strlen(answer_str) == 1 && answer_str[0] >= 'A' && answer_str[0] <= 'D') {
         answer[0] = answer_str[0];
+    } else {
+        LOG_WARN(LOG_CAT_ONEVN, "Invalid answer from user_id=%lld, counted as wrong",
+                 (long long)sess->user_id);
     }
     if (answer_str) free(answer_str);
 
@@ -449,43 +650,35 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
         return;
     }
 
-    // Find player index
-    int player_idx = -1;
-    for (int i = 0; i < state->player_count; i++) {
-        if (state->player_ids[i] == sess->user_id) {
-            player_idx = i;
-            break;
-        }
-    }
-
-    if (player_idx < 0) {
+    OneVNPlayer *player = find_player(state, sess->user_id);
+    if (!player) {
         protocol_send_error(sess, CMD_RES_SUBMIT_ANSWER_1VN, "NOT_IN_GAME");
         return;
     }
 
     // Check if already eliminated
-    if (state->player_eliminated[player_idx]) {
+    if (player->eliminated) {
         protocol_send_error(sess, CMD_RES_SUBMIT_ANSWER_1VN, "ALREADY_ELIMINATED");
         return;
     }
 
     // Validate round matches current round - use server's current_round as source of truth
     if (round != state->current_round) {
-        printf("[ONEVN] WARNING: Round mismatch - client sent round=%ld, server current_round=%d, using server round\n",
+        LOG_WARN(LOG_CAT_ONEVN, "Round mismatch - client sent round=%ld, server current_round=%d, using server round",
                (long)round, state->current_round);
-        fflush(stdout);
     }
     // Always use server's current_round to ensure consistency
     int64_t server_round = state->current_round;
     
     // Check if already answered this round
-    if (state->player_answered_round[player_idx] == server_round) {
+    if (player->answered_round == server_round) {
         protocol_send_error(sess, CMD_RES_SUBMIT_ANSWER_1VN, "ALREADY_ANSWERED");
         return;
     }
 
     // Check answer
-    int is_correct = (answer[0] == state->current_question.correct_op[0]);
+    int is_correct = state->current_question &&
+                     answer[0] == state->current_question->correct_op[0];
     
     if (is_correct) {
         // Calculate score
@@ -494,17 +687,18 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
         if (time_percent > 100) time_percent = 100;
 
         int score = calculate_score(state->current_difficulty, time_percent, 
-                                   state->player_consecutive_correct[player_idx]);
-        state->player_scores[player_idx] += score;
-        state->player_consecutive_correct[player_idx]++;
+                                   player->consecutive_correct);
+        player->score += score;
+        player->consecutive_correct++;
+        ranking_raise(state, player);
     } else {
         // Wrong answer -> no points, reset consecutive correct
         // No elimination - players continue playing
-        state->player_consecutive_correct[player_idx] = 0;
+        player->consecutive_correct = 0;
     }
 
     // Use server's current_round, not round from request
-    state->player_answered_round[player_idx] = server_round;
+    mark_answered(state, player);
 
     // Save player answer to database for replay
     int score_gained = 0;
@@ -513,23 +707,9 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
         if (time_percent < 0) time_percent = 0;
         if (time_percent > 100) time_percent = 100;
         score_gained = calculate_score(state->current_difficulty, time_percent, 
-                                      state->player_consecutive_correct[player_idx] - 1);
-    }
-    if (state->current_round_id > 0) {
-        if (dao_onevn_save_player_answer(state->current_round_id, sess->user_id, answer[0],
-                                         is_correct, score_gained, time_left) != 0) {
-            printf("[ONEVN] WARNING: Failed to save player answer for replay\n");
-            fflush(stdout);
-        }
-    }
-
-    // Update database
-    char *leaderboard = build_leaderboard_json(state);
-    if (leaderboard) {
-        // Update players JSONB (simplified)
-        dao_onevn_update_players(session_id, leaderboard);
-        free(leaderboard);
+                                      player->consecutive_correct - 1);
     }
+    journal_answer(state, sess->user_id, answer[0], is_correct, score_gained, time_left);
 
     // Send response
     char response[512];
@@ -537,77 +717,37 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
         "{\"correct\":%s,\"score\":%d,\"total_score\":%d,\"eliminated\":false}",
         is_correct ? "true" : "false",
         is_correct ? calculate_score(state->current_difficulty, (time_left / 15.0) * 100.0, 
-                                    state->player_consecutive_correct[player_idx] - 1) : 0,
-        state->player_scores[player_idx]);
+                                    player->consecutive_correct - 1) : 0,
+        player->score);
     protocol_send_response(sess, CMD_RES_SUBMIT_ANSWER_1VN, response, strlen(response));
     
-    // Check if all non-eliminated players have answered
-    // Skip eliminated players when checking if we should move to next question
-    int all_answered = 1;
-    int active_players = 0;  // Count of non-eliminated players
-    printf("[ONEVN] ========== Checking if all ACTIVE players answered round %d ==========\n", state->current_round);
-    printf("[ONEVN] Player who just answered: user_id=%ld, player_idx=%d\n", 
-           (long)sess->user_id, player_idx);
-    for (int i = 0; i < state->player_count; i++) {
-        printf("[ONEVN] DEBUG: Checking player[%d], eliminated=%d\n", i, state->player_eliminated[i]);
-        // Skip eliminated players
-        if (state->player_eliminated[i]) {
-            printf("[ONEVN]   Player[%d] user_id=%ld: ELIMINATED (skipped)\n",
-                   i, (long)state->player_ids[i]);
-            continue;
-        }
-        
-        active_players++;
-        int has_answered = (state->player_answered_round[i] == state->current_round);
-        printf("[ONEVN]   Player[%d] user_id=%ld: answered_round=%ld, current_round=%d, has_answered=%s\n",
-               i, (long)state->player_ids[i], (long)state->player_answered_round[i], 
-               state->current_round, has_answered ? "YES" : "NO");
-        if (!has_answered) {
-            all_answered = 0;
-        }
-    }
-    printf("[ONEVN] ========== Active players: %d, All answered: %s ==========\n", 
-           active_players, all_answered ? "YES" : "NO");
-    fflush(stdout);
+    // Round over once every non-eliminated player answered (counters, no scan)
+    LOG_DEBUG(LOG_CAT_ONEVN, "Round %d: %d of %d active players answered",
+           state->current_round, state->answered_count, state->active_count);
     
-    // If all non-eliminated players answered (or no active players left), end round and send next question
-    if (all_answered && active_players > 0) {
-        printf("[ONEVN] ========== ALL ACTIVE PLAYERS ANSWERED - Scheduling next question in 2 seconds ==========\n");
-        fflush(stdout);
+    // If all non-eliminated players answered, end round and send next question
+    if (round_complete(state)) {
+        LOG_DEBUG(LOG_CAT_ONEVN, "========== ALL ACTIVE PLAYERS ANSWERED - Scheduling next question in 2 seconds ==========");
         // Cancel timer
         if (state->timer_id >= 0) {
             game_timer_cancel(state->timer_id);
             state->timer_id = -1;
         }
         
-        // End current round in database
-        if (state->current_round_id > 0) {
-            if (dao_onevn_end_round(state->current_round_id) != 0) {
-                printf("[ONEVN] WARNING: Failed to end round in database\n");
-                fflush(stdout);
-            }
-            state->current_round_id = -1;
-        }
+        // End current round in database (answers, scores) in the background
+        const char *leaderboard = leaderboard_snapshot(state);
+        flush_round(state, leaderboard);
         
         // IMPORTANT: Broadcast leaderboard FIRST before sending next question
         // This ensures clients see the results before the next question arrives
-        char *leaderboard = build_leaderboard_json(state);
-        if (leaderboard) {
-            char leaderboard_notify[2048];
-            snprintf(leaderboard_notify, sizeof(leaderboard_notify),
-                "{\"leaderboard\": %s}", leaderboard);
-            session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_ROOM_UPDATE,
-                                             leaderboard_notify, strlen(leaderboard_notify));
-            free(leaderboard);
-        }
+        broadcast_leaderboard(state, leaderboard);
         
         // Schedule next question after 3 seconds delay
         // This ensures the last player to answer has at least 2 seconds to see their score notification
         // All players will receive the next question at the same time (3 seconds after all answered)
         state->timer_id = game_timer_create(3, state->session_id, delayed_question_callback, state);
         if (state->timer_id < 0) {
-            printf("[ONEVN] ERROR: Failed to create delay timer, sending question immediately\n");
-            fflush(stdout);
+            LOG_WARN(LOG_CAT_ONEVN, "Failed to create delay timer, sending question immediately");
             int64_t winner_id = 0;
             if (check_game_end(state, &winner_id)) {
                 end_game(state, winner_id);
@@ -616,8 +756,7 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
             }
         }
     } else {
-        printf("[ONEVN] Not all players answered yet, waiting for more answers...\n");
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Not all players answered yet, waiting for more answers...");
     }
 }
 
@@ -625,27 +764,23 @@ static void handle_submit_answer_1vn(ClientSession *sess, const char *payload, u
 static void delayed_question_callback(int64_t context_id, void *user_data) {
     OneVNGameState *state = (OneVNGameState *)user_data;
     if (!state || state->session_id != context_id) {
-        printf("[ONEVN] WARNING: Delayed question callback called with invalid state or context_id mismatch\n");
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_ONEVN, "Delayed question callback called with invalid state or context_id mismatch");
         return;
     }
     
     // Clear timer_id
     state->timer_id = -1;
     
-    printf("[ONEVN] ========== DELAYED QUESTION CALLBACK - Sending next question after 3 seconds ==========\n");
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "========== DELAYED QUESTION CALLBACK - Sending next question after 3 seconds ==========");
     
     // Check if game should end
     int64_t winner_id = 0;
     if (check_game_end(state, &winner_id)) {
-        printf("[ONEVN] Game should end, winner_id=%ld\n", (long)winner_id);
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Game should end, winner_id=%ld", (long)winner_id);
         end_game(state, winner_id);
     } else {
         // Send next question after 3 seconds delay
-        printf("[ONEVN] Sending next question after 3 seconds delay...\n");
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Sending next question after 3 seconds delay...");
         send_next_question(state);
     }
 }
@@ -654,16 +789,14 @@ static void delayed_question_callback(int64_t context_id, void *user_data) {
 static void round_timeout_callback(int64_t context_id, void *user_data) {
     OneVNGameState *state = (OneVNGameState *)user_data;
     if (!state || state->session_id != context_id) {
-        printf("[ONEVN] WARNING: Timeout callback called with invalid state or context_id mismatch\n");
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_ONEVN, "Timeout callback called with invalid state or context_id mismatch");
         return;
     }
     
     // CRITICAL: Cancel timer immediately to prevent callback from being called again
     // Also check if timer is still valid (might have been cancelled already)
     if (state->timer_id < 0) {
-        printf("[ONEVN] WARNING: Timeout callback called but timer_id is already invalid (round might have ended)\n");
-        fflush(stdout);
+        LOG_WARN(LOG_CAT_ONEVN, "Timeout callback called but timer_id is already invalid (round might have ended)");
         return;
     }
     
@@ -672,105 +805,67 @@ static void round_timeout_callback(int64_t context_id, void *user_data) {
     state->timer_id = -1;  // Mark as invalid before processing
     game_timer_cancel(saved_timer_id);
     
-    printf("[ONEVN] ========== TIMEOUT CALLBACK TRIGGERED for round %d ==========\n", state->current_round);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "========== TIMEOUT CALLBACK TRIGGERED for round %d ==========", state->current_round);
     
     // Check if all active (non-eliminated) players have already answered (race condition: all answered just before timeout)
-    int all_answered = 1;
-    int active_players = 0;
-    for (int i = 0; i < state->player_count; i++) {
-        // Skip eliminated players
-        if (state->player_eliminated[i]) {
-            continue;
-        }
-        active_players++;
-        if (state->player_answered_round[i] != state->current_round) {
-            all_answered = 0;
-            break;
-        }
-    }
-    
-    if (all_answered && active_players > 0) {
-        printf("[ONEVN] WARNING: Timeout callback called but all active players already answered (race condition)\n");
-        printf("[ONEVN] Round already ended, ignoring timeout callback\n");
-        fflush(stdout);
+    if (round_complete(state)) {
+        LOG_WARN(LOG_CAT_ONEVN, "Timeout callback called but all active players already answered (race condition)");
+        LOG_DEBUG(LOG_CAT_ONEVN, "Round already ended, ignoring timeout callback");
         return;
     }
     
     // Mark all non-eliminated players who haven't answered as no points (but not eliminated)
     // Also send timeout notification to each non-eliminated player who didn't answer
     for (int i = 0; i < state->player_count; i++) {
+        OneVNPlayer *p = &state->players[i];
         // Skip eliminated players - they don't get timeout notifications
-        if (state->player_eliminated[i]) {
+        if (p->eliminated) {
             continue;
         }
         
-        if (state->player_answered_round[i] != state->current_round) {
+        if (p->answered_round != state->current_round) {
             // Timeout - no points for this round, reset consecutive correct
-            state->player_consecutive_correct[i] = 0;
+            p->consecutive_correct = 0;
             // Mark as answered to prevent double processing
-            state->player_answered_round[i] = state->current_round;
+            mark_answered(state, p);
             
             // Send timeout notification to this player
-            ClientSession *player_sess = session_manager_get_by_user_id(state->player_ids[i]);
+            ClientSession *player_sess = session_manager_get_by_user_id(p->user_id);
             if (player_sess) {
                 char timeout_response[512];
                 snprintf(timeout_response, sizeof(timeout_response),
                     "{\"correct\":false,\"score\":0,\"total_score\":%d,\"eliminated\":false,\"timeout\":true}",
-                    state->player_scores[i]);
+                    p->score);
                 protocol_send_response(player_sess, CMD_RES_SUBMIT_ANSWER_1VN, 
                                       timeout_response, strlen(timeout_response));
-                printf("[ONEVN] Sent timeout notification to user_id=%ld (player_idx=%d)\n",
-                       (long)state->player_ids[i], i);
-                fflush(stdout);
+                LOG_DEBUG(LOG_CAT_ONEVN, "Sent timeout notification to user_id=%ld (player_idx=%d)",
+                       (long)p->user_id, i);
             } else {
-                printf("[ONEVN] WARNING: Could not find session for user_id=%ld (player_idx=%d) to send timeout notification\n",
-                       (long)state->player_ids[i], i);
-                fflush(stdout);
+                LOG_WARN(LOG_CAT_ONEVN, "Could not find session for user_id=%ld (player_idx=%d) to send timeout notification",
+                       (long)p->user_id, i);
             }
         }
     }
     
-    // End current round in database
-    if (state->current_round_id > 0) {
-        if (dao_onevn_end_round(state->current_round_id) != 0) {
-            printf("[ONEVN] WARNING: Failed to end round in database\n");
-            fflush(stdout);
-        }
-        state->current_round_id = -1;
-    }
-    
-    // Update database with current scores
-    char *leaderboard = build_leaderboard_json(state);
-    if (leaderboard) {
-        dao_onevn_update_players(state->session_id, leaderboard);
-    }
+    // End current round in database with current scores, in the background
+    const char *leaderboard = leaderboard_snapshot(state);
+    flush_round(state, leaderboard);
     
     // IMPORTANT: Broadcast leaderboard FIRST before sending next question
-    if (leaderboard) {
-        char leaderboard_notify[2048];
-        snprintf(leaderboard_notify, sizeof(leaderboard_notify),
-            "{\"leaderboard\": %s}", leaderboard);
-        session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_ROOM_UPDATE,
-                                         leaderboard_notify, strlen(leaderboard_notify));
-        free(leaderboard);
-    }
+    broadcast_leaderboard(state, leaderboard);
     
     // End round and check game end
     int64_t winner_id = 0;
     if (check_game_end(state, &winner_id)) {
-        printf("[ONEVN] Game should end after timeout, winner_id=%ld\n", (long)winner_id);
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Game should end after timeout, winner_id=%ld", (long)winner_id);
         end_game(state, winner_id);
     } else {
         // Schedule next question after 3 seconds delay (same as when all answered)
         // This ensures all players have time to see their score notification (2 seconds minimum)
-        printf("[ONEVN] Scheduling next question after 3 seconds delay (timeout)...\n");
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Scheduling next question after 3 seconds delay (timeout)...");
         state->timer_id = game_timer_create(3, state->session_id, delayed_question_callback, state);
         if (state->timer_id < 0) {
-            printf("[ONEVN] ERROR: Failed to create delay timer, sending question immediately\n");
-            fflush(stdout);
+            LOG_WARN(LOG_CAT_ONEVN, "Failed to create delay timer, sending question immediately");
             send_next_question(state);
         }
     }
@@ -778,14 +873,12 @@ static void round_timeout_callback(int64_t context_id, void *user_data) {
 
 // Get next question (called by server after round ends)
 static void send_next_question(OneVNGameState *state) {
-    printf("[ONEVN] send_next_question called: current_round=%d, total_rounds=%d\n",
+    LOG_DEBUG(LOG_CAT_ONEVN, "send_next_question called: current_round=%d, total_rounds=%d",
            state->current_round, state->total_rounds);
-    fflush(stdout);
     
     if (state->current_round >= state->total_rounds) {
         // Game over - check winner
-        printf("[ONEVN] Game over: current_round >= total_rounds\n");
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "Game over: current_round >= total_rounds");
         int64_t winner_id = 0;
         check_game_end(state, &winner_id);
         end_game(state, winner_id);
@@ -795,8 +888,7 @@ static void send_next_question(OneVNGameState *state) {
     const char *difficulty = select_next_difficulty(state);
     if (!difficulty) {
         // No more questions
-        printf("[ONEVN] No more questions available\n");
-        fflush(stdout);
+        LOG_DEBUG(LOG_CAT_ONEVN, "No more questions available");
         int64_t winner_id = 0;
         check_game_end(state, &winner_id);
         end_game(state, winner_id);
@@ -806,82 +898,23 @@ static void send_next_question(OneVNGameState *state) {
     strncpy(state->current_difficulty, difficulty, 15);
     state->current_round++;
 
-    // Get random question (avoid duplicates)
-    printf("[ONEVN] Getting random question for difficulty: %s\n", difficulty);
-    fflush(stdout);
-    
-    int retries = 0;
-    const int MAX_RETRIES = 100;
-    int success = 0;
-    
-    while (retries < MAX_RETRIES) {
-        if (dao_question_get_random(difficulty, &state->current_question) != 0) {
-            // Failed to get question - end game
-            printf("[ONEVN] ERROR: Failed to get random question for difficulty %s\n", difficulty);
-            fflush(stdout);
-            int64_t winner_id = 0;
-            check_game_end(state, &winner_id);
-            end_game(state, winner_id);
-            return;
-        }
-        
-        // Check if this question ID was already used
-        int is_duplicate = 0;
-        for (int i = 0; i < state->used_question_count; i++) {
-            if (state->used_question_ids[i] == state->current_question.question_id) {
-                is_duplicate = 1;
-                break;
-            }
-        }
-        
-        if (!is_duplicate) {
-            // Add to used list
-            if (state->used_question_count >= state->used_question_capacity) {
-                // Expand capacity
-                state->used_question_capacity *= 2;
-                int64_t *new_list = realloc(state->used_question_ids, 
-                                           state->used_question_capacity * sizeof(int64_t));
-                if (new_list) {
-                    state->used_question_ids = new_list;
-                } else {
-                    // Memory error, but continue with current question
-                    printf("[ONEVN] WARNING: Failed to expand used_question_ids list\n");
-                    fflush(stdout);
-                }
-            }
-            state->used_question_ids[state->used_question_count++] = state->current_question.question_id;
-            success = 1;
-            break;
-        }
-        
-        retries++;
-    }
-    
-    if (!success) {
-        printf("[ONEVN] ERROR: Failed to get unique question after %d retries\n", MAX_RETRIES);
-        fflush(stdout);
-        int64_t winner_id = 0;
-        check_game_end(state, &winner_id);
-        end_game(state, winner_id);
-        return;
-    }
+    // Rounds take the drawn questions in order
+    state->current_question = state->questions[state->current_round - 1];
     
-    printf("[ONEVN] Got question ID: %ld, content: %s\n", 
-           state->current_question.question_id,
-           state->current_question.content ? state->current_question.content : "(null)");
-    fflush(stdout);
-
-    // Create round in database for replay
-    int64_t round_id = 0;
-    if (dao_onevn_create_round(state->session_id, state->current_round, 
-                               state->current_question.question_id, difficulty, &round_id) != 0) {
-        printf("[ONEVN] WARNING: Failed to create round in database for replay\n");
-        fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "Got question ID: %ld, content: %s", 
+           state->current_question->question_id,
+           state->current_question->content ? state->current_question->content : "(null)");
+
+    // Create round in database for replay (in the background, ahead of the
+    // round's answers)
+    if (dao_onevn_create_round_async(state->session_id, state->current_round,
+                                     state->current_question->question_id, difficulty) != 0) {
+        LOG_WARN(LOG_CAT_ONEVN, "Failed to create round in database for replay");
         // Continue anyway - replay won't have this round but game can continue
     } else {
-        state->current_round_id = round_id;
-        printf("[ONEVN] Created round_id=%ld for round %d\n", round_id, state->current_round);
-        fflush(stdout);
+        state->recorded_round = state->current_round;
+        LOG_DEBUG(LOG_CAT_ONEVN, "Creating round %d of session %ld",
+                  state->current_round, state->session_id);
     }
 
     // Update counters
@@ -893,18 +926,16 @@ static void send_next_question(OneVNGameState *state) {
         state->hard_done++;
     }
 
-    // Reset answered round for all players
-    for (int i = 0; i < state->player_count; i++) {
-        state->player_answered_round[i] = -1;
-    }
+    // New round: answered_round of every player is now behind current_round
+    state->answered_count = 0;
 
     // Build question JSON
     char question_json[2048];
-    char *esc_content = util_json_escape(state->current_question.content);
-    char *esc_a = util_json_escape(state->current_question.op_a);
-    char *esc_b = util_json_escape(state->current_question.op_b);
-    char *esc_c = util_json_escape(state->current_question.op_c);
-    char *esc_d = util_json_escape(state->current_question.op_d);
+    char *esc_content = util_json_escape(state->current_question->content);
+    char *esc_a = util_json_escape(state->current_question->op_a);
+    char *esc_b = util_json_escape(state->current_question->op_b);
+    char *esc_c = util_json_escape(state->current_question->op_c);
+    char *esc_d = util_json_escape(state->current_question->op_d);
 
     snprintf(question_json, sizeof(question_json),
         "{\"round\":%d,\"total_rounds\":%d,\"difficulty\":\"%s\","
@@ -912,7 +943,7 @@ static void send_next_question(OneVNGameState *state) {
         "\"options\":{\"A\":\"%s\",\"B\":\"%s\",\"C\":\"%s\",\"D\":\"%s\"},"
         "\"time_limit\":15}",
         state->current_round, state->total_rounds, difficulty,
-        state->current_question.question_id,
+        state->current_question->question_id,
         esc_content ? esc_content : "",
         esc_a ? esc_a : "", esc_b ? esc_b : "", esc_c ? esc_c : "", esc_d ? esc_d : "");
 
@@ -923,14 +954,12 @@ static void send_next_question(OneVNGameState *state) {
     if (esc_d) free(esc_d);
 
     // Broadcast to all players in room
-    printf("[ONEVN] Broadcasting question round %d to room %lld (total players: %d)\n",
+    LOG_DEBUG(LOG_CAT_ONEVN, "Broadcasting question round %d to room %lld (total players: %d)",
            state->current_round, (long long)state->room_id, state->player_count);
-    printf("[ONEVN] Question JSON: %s\n", question_json);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "Question JSON: %s", question_json);
     int broadcast_count = session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_QUESTION_1VN, 
                                       question_json, strlen(question_json));
-    printf("[ONEVN] Question broadcast sent to %d sessions\n", broadcast_count);
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "Question broadcast sent to %d sessions", broadcast_count);
     
     // Start timer for 15 seconds
     if (state->timer_id >= 0) {
@@ -938,8 +967,7 @@ static void send_next_question(OneVNGameState *state) {
     }
     state->timer_id = game_timer_create(15, state->session_id, round_timeout_callback, state);
     
-    printf("[ONEVN] Question sent successfully, timer started\n");
-    fflush(stdout);
+    LOG_DEBUG(LOG_CAT_ONEVN, "Question sent successfully, timer started");
 }
 
 // End game and send final results
@@ -952,40 +980,55 @@ static void end_game(OneVNGameState *state, int64_t winner_id) {
         state->timer_id = -1;
     }
     
-    // End session in database
-    dao_onevn_end_session(state->session_id, winner_id);
-    dao_rooms_update_status(state->room_id, ROOM_STATUS_FINISHED);
-
     // Build final leaderboard
-    char *final_leaderboard = build_leaderboard_json(state);
-    char final_response[2048];
-    snprintf(final_response, sizeof(final_response),
-        "{\"winner_id\":%ld,\"leaderboard\":%s}",
-        winner_id, final_leaderboard ? final_leaderboard : "[]");
+    const char *final_leaderboard = leaderboard_snapshot(state);
+
+    // A round still open is written like the others, in the background
+    // (its players are left out: the final standings follow)
+    if (state->recorded_round > 0) {
+        if (dao_onevn_save_round_async(state->session_id, state->recorded_round,
+                                       state->round_answers, state->round_answer_count,
+                                       NULL) != 0) {
+            LOG_WARN(LOG_CAT_ONEVN, "Failed to save round %d for replay", state->current_round);
+        }
+    }
+
+    // Final scores, end the session and close the room in one small round
+    // trip of their own, so nothing else can roll the room back to
+    // IN_PROGRESS. It is queued behind the session's round writes, which
+    // cannot overwrite the final players once the session is closed.
+    if (dao_onevn_finish_session_async(state->session_id, state->room_id, winner_id,
+                                       final_leaderboard) != 0) {
+        LOG_ERROR(LOG_CAT_ONEVN, "Saving results of session %lld failed",
+                  (long long)state->session_id);
+    }
+
+    // Every player's stats on a DB pool thread, however many players
+    int64_t *player_ids = malloc(sizeof(int64_t) * state->player_count);
+    if (player_ids) {
+        for (int i = 0; i < state->player_count; i++) player_ids[i] = state->players[i].user_id;
+        dao_stats_update_onevn_game_async(winner_id, player_ids, state->player_count);
+        free(player_ids);
+    }
+    if (winner_id > 0) leaderboard_add_wins(winner_id, 1);
+
+    state->recorded_round = 0;
+    state->round_answer_count = 0;
+
+    StrBuf *final_response = &state->frame;
+    strbuf_reset(final_response);
+    strbuf_appendf(final_response, "{\"winner_id\":%ld,\"leaderboard\":%s}",
+                   winner_id, final_leaderboard ? final_leaderboard : "[]");
     
     // Broadcast final results to all players
-    session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_GAME_OVER_1VN,
-                                     final_response, strlen(final_response));
-    
-    if (final_leaderboard) free(final_leaderboard);
-
-    // Update stats for all players
-    dao_stats_update_onevn_game(winner_id, state->player_ids, state->player_scores,
-                                state->player_eliminated, state->player_count);
+    if (!final_response->failed) {
+        session_manager_broadcast_to_room(state->room_id, CMD_NOTIFY_GAME_OVER_1VN,
+                                          final_response->data, (uint32_t)final_response->len);
+    }
 
     // Remove game state
-    for (int i = 0; i < game_count; i++) {
-        if (game_states[i] == state) {
-            free_game_state(state);
-            game_states[i] = NULL;
-            // Shift remaining games
-            for (int j = i; j < game_count - 1; j++) {
-                game_states[j] = game_states[j + 1];
-            }
-            game_count--;
-            break;
-        }
-    }
+    unregister_game(state);
+    free_game_state(state);
 }
 
 // Main dispatcher
@@ -1012,30 +1055,26 @@ int onevn_eliminate_player_by_room(int64_t room_id, int64_t user_id) {
     // Find game state by room_id
     OneVNGameState *state = get_game_state_by_room(room_id);
     if (!state) {
-        printf("[ONEVN] onevn_eliminate_player_by_room: game state not found for room_id=%ld\n", (long)room_id);
+        LOG_DEBUG(LOG_CAT_ONEVN, "onevn_eliminate_player_by_room: game state not found for room_id=%ld", (long)room_id);
         return -1;
     }
 
-    // Find player index
-    int player_idx = -1;
-    for (int i = 0; i < state->player_count; i++) {
-        if (state->player_ids[i] == user_id) {
-            player_idx = i;
-            break;
-        }
-    }
-
-    if (player_idx < 0) {
-        printf("[ONEVN] onevn_eliminate_player_by_room: player_id=%ld not found in game\n", (long)user_id);
+    OneVNPlayer *player = find_player(state, user_id);
+    if (!player) {
+        LOG_DEBUG(LOG_CAT_ONEVN, "onevn_eliminate_player_by_room: player_id=%ld not found in game", (long)user_id);
         return -1;
     }
 
     // Mark player as eliminated in game state (this is the critical fix!)
-    // This ensures build_leaderboard_json() will mark them as eliminated
-    state->player_eliminated[player_idx] = 1;
-    printf("[ONEVN] Marked player[%d] user_id=%ld as eliminated in game state\n", player_idx, (long)user_id);
-    printf("[ONEVN] DEBUG: player_eliminated[%d] = %d\n", player_idx, state->player_eliminated[player_idx]);
-    fflush(stdout);
+    // This ensures the leaderboard will mark them as eliminated
+    if (!player->eliminated) {
+        player->eliminated = 1;
+        state->leaderboard_dirty = 1;
+        state->active_count--;
+        if (player->answered_round == state->current_round) state->answered_count--;
+    }
+    LOG_DEBUG(LOG_CAT_ONEVN, "Marked user_id=%ld as eliminated in game state (%d active)",
+              (long)user_id, state->active_count);
 
     return 0;
 }
\ No newline at end of file
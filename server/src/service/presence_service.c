@@ -0,0 +1,206 @@
+// server/src/service/presence_service.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "service/presence_service.h"
+#include "service/friend_graph.h"
+#include "service/commands.h"
+#include "service/session_manager.h"
+#include "utils/idmap.h"
+#include "utils/log.h"
+#include "utils/timer.h"
+
+// Last state of one user inside the current window
+typedef struct {
+    int64_t user_id;
+    char status[24];
+    int64_t room_id;
+    int64_t *recipients;        // online friends when last published
+    int recipient_count;
+} PresenceChange;
+
+// Updates one recipient gets from a flush, as indexes into the window
+typedef struct {
+    int *changes;
+    int count;
+    int cap;
+} RecipientBatch;
+
+static PresenceChange **g_pending = NULL;
+static int g_pending_count = 0;
+static int g_pending_cap = 0;
+static IdMap g_pending_by_user;          // user_id -> PresenceChange
+static int g_initialized = 0;
+static int g_flush_timer = 0;            // > 0 while a flush is scheduled
+
+static void change_free(PresenceChange *c) {
+    if (!c) return;
+    free(c->recipients);
+    free(c);
+}
+
+static void flush_timer_callback(int64_t context_id, void *user_data) {
+    (void)context_id;
+    (void)user_data;
+    g_flush_timer = 0;
+    presence_flush();
+}
+
+void presence_publish(int64_t user_id, const char *status, int64_t room_id) {
+    if (user_id <= 0 || !status) return;
+    if (!g_initialized) {
+        if (idmap_init(&g_pending_by_user, 64) != 0) return;
+        g_initialized = 1;
+    }
+
+    // Recipients are read now: an offline user's friends are forgotten next
+    int64_t *recipients = NULL;
+    int count = friend_graph_online_friends(user_id, &recipients);
+    if (count < 0) count = 0;
+
+    PresenceChange *c = idmap_get(&g_pending_by_user, user_id);
+    if (!c) {
+        if (g_pending_count == g_pending_cap) {
+            int cap = g_pending_cap ? g_pending_cap * 2 : 32;
+            PresenceChange **p = realloc(g_pending, sizeof(PresenceChange *) * (size_t)cap);
+            if (!p) { free(recipients); return; }
+            g_pending = p;
+            g_pending_cap = cap;
+        }
+        c = calloc(1, sizeof(PresenceChange));
+        if (!c || idmap_put(&g_pending_by_user, user_id, c) != 0) {
+            free(c);
+            free(recipients);
+            return;
+        }
+        c->user_id = user_id;
+        g_pending[g_pending_count++] = c;
+    } else {
+        LOG_DEBUG(LOG_CAT_FRIENDS, "Coalescing status of user %lld: %s -> %s",
+                  (long long)user_id, c->status, status);
+    }
+
+    snprintf(c->status, sizeof(c->status), "%s", status);
+    c->room_id = room_id;
+    free(c->recipients);
+    c->recipients = recipients;
+    c->recipient_count = count;
+
+    if (g_flush_timer <= 0) {
+        g_flush_timer = game_timer_create_ms(PRESENCE_COALESCE_MS, 0, flush_timer_callback, NULL);
+        if (g_flush_timer <= 0) {
+            // No timer: do not hold the update back
+            g_flush_timer = 0;
+            presence_flush();
+        }
+    }
+}
+
+static RecipientBatch *batch_for(IdMap *batches, int64_t recipient) {
+    RecipientBatch *b = idmap_get(batches, recipient);
+    if (b) return b;
+    b = calloc(1, sizeof(RecipientBatch));
+    if (!b || idmap_put(batches, recipient, b) != 0) {
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+static void batch_add(RecipientBatch *b, int change) {
+    if (b->count == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 4;
+        int *p = realloc(b->changes, sizeof(int) * (size_t)cap);
+        if (!p) return;
+        b->changes = p;
+        b->cap = cap;
+    }
+    b->changes[b->count++] = change;
+}
+
+static void send_batch(int64_t recipient, const RecipientBatch *b, char (*objects)[128]) {
+    if (b->count == 1) {
+        const char *json = objects[b->changes[0]];
+        session_manager_send_to_user(recipient, CMD_NOTIFY_FRIEND_STATUS, json, (uint32_t)strlen(json));
+        return;
+    }
+
+    size_t cap = 16 + (size_t)b->count * 130;
+    char *json = malloc(cap);
+    if (!json) return;
+    size_t used = (size_t)snprintf(json, cap, "{\"updates\": [");
+    for (int i = 0; i < b->count; i++) {
+        used += (size_t)snprintf(json + used, cap - used, "%s%s", i > 0 ? "," : "", objects[b->changes[i]]);
+    }
+    used += (size_t)snprintf(json + used, cap - used, "]}");
+    session_manager_send_to_user(recipient, CMD_NOTIFY_FRIEND_STATUS, json, (uint32_t)used);
+    free(json);
+}
+
+void presence_flush(void) {
+    if (g_flush_timer > 0) {
+        game_timer_cancel(g_flush_timer);
+        g_flush_timer = 0;
+    }
+    if (g_pending_count == 0) return;
+
+    // Take the window; publishing from here on starts a new one
+    PresenceChange **changes = g_pending;
+    int count = g_pending_count;
+    g_pending = NULL;
+    g_pending_count = 0;
+    g_pending_cap = 0;
+    idmap_clear(&g_pending_by_user);
+
+    char (*objects)[128] = malloc(sizeof(*objects) * (size_t)count);
+    IdMap batches;
+    if (!objects || idmap_init(&batches, 64) != 0) {
+        free(objects);
+        for (int i = 0; i < count; i++) change_free(changes[i]);
+        free(changes);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        PresenceChange *c = changes[i];
+        snprintf(objects[i], sizeof(objects[i]),
+            "{\"user_id\": %lld, \"status\": \"%s\", \"room_id\": %lld}",
+            (long long)c->user_id, c->status, (long long)c->room_id);
+        for (int r = 0; r < c->recipient_count; r++) {
+            RecipientBatch *b = batch_for(&batches, c->recipients[r]);
+            if (b) batch_add(b, i);
+        }
+    }
+
+    int frames = 0;
+    for (size_t i = 0; i < batches.capacity; i++) {
+        RecipientBatch *b = batches.entries[i].value;
+        if (!b) continue;
+        send_batch(batches.entries[i].key, b, objects);
+        frames++;
+        free(b->changes);
+        free(b);
+    }
+    LOG_DEBUG(LOG_CAT_FRIENDS, "Presence flush: %d changes, %d frames", count, frames);
+
+    idmap_free(&batches);
+    free(objects);
+    for (int i = 0; i < count; i++) change_free(changes[i]);
+    free(changes);
+}
+
+void presence_clear(void) {
+    if (g_flush_timer > 0) {
+        game_timer_cancel(g_flush_timer);
+        g_flush_timer = 0;
+    }
+    for (int i = 0; i < g_pending_count; i++) change_free(g_pending[i]);
+    free(g_pending);
+    g_pending = NULL;
+    g_pending_count = 0;
+    g_pending_cap = 0;
+    if (g_initialized) {
+        idmap_free(&g_pending_by_user);
+        g_initialized = 0;
+    }
+}
@@ -6,30 +6,60 @@
 #include <arpa/inet.h>
 #include "service/protocol.h"
 #include "service/client_session.h"
+#include "service/commands.h"
+#include "utils/log.h"
+
+// Frames a slow client can miss without breaking its state: they are dropped
+// first when its outbound queue is over the high-water mark.
+static int protocol_cmd_priority(uint16_t cmd) {
+	switch (cmd) {
+		case CMD_NOTIFY_USER_STATUS:
+		case CMD_NOTIFY_FRIEND_STATUS:
+		case CMD_NOTIFY_ROOM_CHAT:
+			return SEND_PRIORITY_LOW;
+		default:
+			return SEND_PRIORITY_NORMAL;
+	}
+}
+
+static void protocol_build_header(ClientSession *sess, uint16_t cmd, uint32_t len, PacketHeader *hdr) {
+	hdr->cmd = htons(cmd);
+	hdr->user_id = htons((uint16_t)(sess->user_id & 0xFFFF));
+	hdr->length = htonl(len);
+}
 
 void protocol_send_response(ClientSession *sess, uint16_t cmd, const char *json, uint32_t len) {
 	if (!sess) {
 		// no session: just log
-		fprintf(stderr, "[PROTOCOL] no session, cmd=0x%04x\n", cmd);
+		LOG_WARN(LOG_CAT_PROTOCOL, "no session, cmd=0x%04x", cmd);
 		return;
 	}
-
-	size_t hdr_sz = sizeof(PacketHeader);
-	size_t total = hdr_sz + (size_t)len;
-	char *buf = malloc(total);
-	if (!buf) return;
+	if (!json) len = 0;
 
 	PacketHeader hdr;
-	hdr.cmd = htons(cmd);
-	hdr.user_id = htons((uint16_t)(sess->user_id & 0xFFFF));
-	hdr.length = htonl(len);
+	protocol_build_header(sess, cmd, len, &hdr);
+
+	// send via session: header and payload go out in one gather write,
+	// the payload is only copied if it has to be queued
+	client_session_sendv(sess, &hdr, sizeof(hdr), json, len, NULL, protocol_cmd_priority(cmd));
+}
 
-	memcpy(buf, &hdr, hdr_sz);
-	if (len && json) memcpy(buf + hdr_sz, json, len);
+SharedFrame *protocol_frame_new(const char *json, uint32_t len) {
+	if (!json || len == 0) return NULL;
+	return shared_frame_new(json, len);
+}
 
-	// send via session
-	client_session_send(sess, buf, total);
-	free(buf);
+void protocol_send_frame(ClientSession *sess, uint16_t cmd, SharedFrame *frame) {
+	if (!sess) {
+		LOG_WARN(LOG_CAT_PROTOCOL, "no session, cmd=0x%04x", cmd);
+		return;
+	}
+	uint32_t len = frame ? frame->len : 0;
+
+	PacketHeader hdr;
+	protocol_build_header(sess, cmd, len, &hdr);
+	client_session_sendv(sess, &hdr, sizeof(hdr), frame ? frame->data : NULL, len,
+	                     frame, protocol_cmd_priority(cmd));
 }
 
 void protocol_send_error(ClientSession *sess, uint16_t cmd, const char *error_msg) {
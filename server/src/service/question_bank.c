@@ -0,0 +1,492 @@
+// server/src/service/question_bank.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libpq-fe.h>
+#include "db.h"
+#include "service/question_bank.h"
+#include "utils/log.h"
+
+#define QB_DIFFICULTIES 3
+#define QB_INTERN_BUCKETS 4096     // power of two
+#define QB_CHANNEL "question_changed"  // see the trigger in db.sql
+#define QB_LISTEN_POLL_MS 1000         // how often the listener checks for shutdown
+#define QB_LISTEN_BACKOFF_MIN_MS 1000
+#define QB_LISTEN_BACKOFF_MAX_MS 30000
+
+static const char *const qb_difficulty_names[QB_DIFFICULTIES] = { "EASY", "MEDIUM", "HARD" };
+
+// ---------------------------------------------------------------------------
+// String interning: one refcounted copy per distinct text
+// ---------------------------------------------------------------------------
+
+typedef struct InternStr {
+    struct InternStr *next;
+    uint32_t hash;
+    int refs;
+    char s[];
+} InternStr;
+
+static pthread_mutex_t g_intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static InternStr *g_intern[QB_INTERN_BUCKETS];
+
+// FNV-1a
+static uint32_t intern_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const char *intern_get(const char *s) {
+    uint32_t h = intern_hash(s);
+    InternStr **bucket = &g_intern[h & (QB_INTERN_BUCKETS - 1)];
+
+    pthread_mutex_lock(&g_intern_lock);
+    for (InternStr *e = *bucket; e; e = e->next) {
+        if (e->hash == h && strcmp(e->s, s) == 0) {
+            e->refs++;
+            pthread_mutex_unlock(&g_intern_lock);
+            return e->s;
+        }
+    }
+    size_t len = strlen(s);
+    InternStr *e = malloc(sizeof(InternStr) + len + 1);
+    if (e) {
+        e->hash = h;
+        e->refs = 1;
+        memcpy(e->s, s, len + 1);
+        e->next = *bucket;
+        *bucket = e;
+    }
+    pthread_mutex_unlock(&g_intern_lock);
+    return e ? e->s : NULL;
+}
+
+static void intern_put(const char *s) {
+    if (!s) return;
+    InternStr *e = (InternStr *)(s - offsetof(InternStr, s));
+
+    pthread_mutex_lock(&g_intern_lock);
+    if (--e->refs == 0) {
+        InternStr **p = &g_intern[e->hash & (QB_INTERN_BUCKETS - 1)];
+        while (*p != e) p = &(*p)->next;
+        *p = e->next;
+        free(e);
+    }
+    pthread_mutex_unlock(&g_intern_lock);
+}
+
+// ---------------------------------------------------------------------------
+// Questions
+// ---------------------------------------------------------------------------
+
+static void question_destroy(Question *q) {
+    intern_put(q->content);
+    intern_put(q->op_a);
+    intern_put(q->op_b);
+    intern_put(q->op_c);
+    intern_put(q->op_d);
+    free(q);
+}
+
+void question_retain(Question *q) {
+    if (q) __atomic_add_fetch(&q->refs, 1, __ATOMIC_RELAXED);
+}
+
+void question_release(Question *q) {
+    if (q && __atomic_sub_fetch(&q->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        question_destroy(q);
+    }
+}
+
+static int difficulty_index(const char *difficulty) {
+    if (!difficulty) return -1;
+    for (int i = 0; i < QB_DIFFICULTIES; i++) {
+        if (strcmp(difficulty, qb_difficulty_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int valid_option(const char *s) {
+    return s && s[0] != '\0';
+}
+
+// Rows the games could not show are left out of the pools
+static int question_is_valid(const Question *q) {
+    char c = q->correct_op[0];
+    return q->question_id > 0 &&
+           valid_option(q->content) &&
+           valid_option(q->op_a) && valid_option(q->op_b) &&
+           valid_option(q->op_c) && valid_option(q->op_d) &&
+           ((c >= 'A' && c <= 'D') || (c >= 'a' && c <= 'd'));
+}
+
+// ---------------------------------------------------------------------------
+// Pools
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    Question **items;
+    int count;
+    int cap;
+} QuestionPool;
+
+typedef struct {
+    pthread_mutex_t lock;
+    QuestionPool pools[QB_DIFFICULTIES];
+    int loaded;
+    uint64_t rng;              // xorshift64* state, guarded by lock
+} QuestionBank;
+
+static QuestionBank g_bank = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t bank_random(void) {
+    uint64_t x = g_bank.rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    g_bank.rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static void pool_clear(QuestionPool *pool) {
+    for (int i = 0; i < pool->count; i++) question_release(pool->items[i]);
+    free(pool->items);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static int pool_push(QuestionPool *pool, Question *q) {
+    if (pool->count == pool->cap) {
+        int cap = pool->cap ? pool->cap * 2 : 64;
+        Question **items = realloc(pool->items, (size_t)cap * sizeof(Question *));
+        if (!items) return -1;
+        pool->items = items;
+        pool->cap = cap;
+    }
+    pool->items[pool->count++] = q;
+    return 0;
+}
+
+// Shared copy of a database row, with one reference for the caller
+static Question *question_new(const Question *row) {
+    Question *q = calloc(1, sizeof(Question));
+    if (!q) return NULL;
+    q->question_id = row->question_id;
+    memcpy(q->difficulty, row->difficulty, sizeof(q->difficulty));
+    memcpy(q->correct_op, row->correct_op, sizeof(q->correct_op));
+    q->refs = 1;
+    q->content = intern_get(row->content);
+    q->op_a = intern_get(row->op_a);
+    q->op_b = intern_get(row->op_b);
+    q->op_c = intern_get(row->op_c);
+    q->op_d = intern_get(row->op_d);
+    if (!q->content || !q->op_a || !q->op_b || !q->op_c || !q->op_d) {
+        question_destroy(q);
+        return NULL;
+    }
+    return q;
+}
+
+static int load_row(const Question *row, void *arg) {
+    QuestionPool *pools = arg;
+    int d = difficulty_index(row->difficulty);
+    if (d < 0 || !question_is_valid(row)) {
+        LOG_WARN(LOG_CAT_DB, "question %lld skipped: invalid data", (long long)row->question_id);
+        return 0;
+    }
+
+    Question *q = question_new(row);   // its reference goes to the pool
+    if (!q) return -1;
+    if (pool_push(&pools[d], q) != 0) {
+        question_release(q);
+        return -1;
+    }
+    return 0;
+}
+
+int question_bank_load(void) {
+    QuestionPool fresh[QB_DIFFICULTIES];
+    memset(fresh, 0, sizeof(fresh));
+
+    if (dao_question_load_all(load_row, fresh) != 0) {
+        for (int i = 0; i < QB_DIFFICULTIES; i++) pool_clear(&fresh[i]);
+        LOG_ERROR(LOG_CAT_DB, "loading the question bank failed");
+        return -1;
+    }
+
+    QuestionPool old[QB_DIFFICULTIES];
+    pthread_mutex_lock(&g_bank.lock);
+    memcpy(old, g_bank.pools, sizeof(old));
+    memcpy(g_bank.pools, fresh, sizeof(fresh));
+    if (!g_bank.rng) g_bank.rng = (((uint64_t)time(NULL) << 20) ^ (uint64_t)(uintptr_t)&g_bank) | 1;
+    g_bank.loaded = 1;
+    pthread_mutex_unlock(&g_bank.lock);
+
+    // Questions still used by a game survive until it releases them
+    for (int i = 0; i < QB_DIFFICULTIES; i++) pool_clear(&old[i]);
+
+    LOG_INFO(LOG_CAT_DB, "question bank loaded: %d easy, %d medium, %d hard",
+             fresh[0].count, fresh[1].count, fresh[2].count);
+    return 0;
+}
+
+int question_bank_count(const char *difficulty) {
+    int d = difficulty_index(difficulty);
+    if (d < 0) return 0;
+    pthread_mutex_lock(&g_bank.lock);
+    int count = g_bank.pools[d].count;
+    pthread_mutex_unlock(&g_bank.lock);
+    return count;
+}
+
+static int bank_ensure_loaded(void) {
+    pthread_mutex_lock(&g_bank.lock);
+    int loaded = g_bank.loaded;
+    pthread_mutex_unlock(&g_bank.lock);
+    return loaded ? 0 : question_bank_load();
+}
+
+// Partial Fisher-Yates: the first count slots become a uniform random
+// sample. The pool stays a permutation, so later draws are uniform too.
+// Called with the bank lock held.
+static int draw_locked(int d, Question **out, int count) {
+    QuestionPool *pool = &g_bank.pools[d];
+    if (count > pool->count) count = pool->count;
+    for (int i = 0; i < count; i++) {
+        int j = i + (int)(bank_random() % (uint64_t)(pool->count - i));
+        Question *tmp = pool->items[i];
+        pool->items[i] = pool->items[j];
+        pool->items[j] = tmp;
+        out[i] = pool->items[i];
+        question_retain(out[i]);
+    }
+    return count;
+}
+
+int question_bank_draw(const char *difficulty, Question **out, int count) {
+    int d = difficulty_index(difficulty);
+    if (d < 0 || !out || count < 0) return -1;
+    if (bank_ensure_loaded() != 0) return -1;
+
+    pthread_mutex_lock(&g_bank.lock);
+    count = draw_locked(d, out, count);
+    pthread_mutex_unlock(&g_bank.lock);
+    return count;
+}
+
+int question_bank_deal(int *easy, int *medium, int *hard, Question **out) {
+    int *counts[QB_DIFFICULTIES] = { easy, medium, hard };
+    for (int d = 0; d < QB_DIFFICULTIES; d++) {
+        if (!counts[d] || *counts[d] < 0) return -1;
+    }
+    if (!out || bank_ensure_loaded() != 0) return -1;
+
+    int dealt = 0;
+    pthread_mutex_lock(&g_bank.lock);
+    for (int d = 0; d < QB_DIFFICULTIES; d++) {
+        *counts[d] = draw_locked(d, out + dealt, *counts[d]);
+        dealt += *counts[d];
+    }
+    pthread_mutex_unlock(&g_bank.lock);
+    return dealt;
+}
+
+// Take question_id out of whichever pool holds it (NULL if none). The
+// pool's reference goes to the caller. Called with the bank lock held.
+static Question *bank_take_locked(int64_t question_id) {
+    for (int d = 0; d < QB_DIFFICULTIES; d++) {
+        QuestionPool *pool = &g_bank.pools[d];
+        for (int i = 0; i < pool->count; i++) {
+            Question *q = pool->items[i];
+            if (q->question_id == question_id) {
+                pool->items[i] = pool->items[--pool->count];
+                return q;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int fetch_row(const Question *row, void *arg) {
+    Question **out = arg;
+    int d = difficulty_index(row->difficulty);
+    if (d < 0 || !question_is_valid(row)) {
+        LOG_WARN(LOG_CAT_DB, "question %lld left out: invalid data", (long long)row->question_id);
+        return 0;
+    }
+    *out = question_new(row);
+    return *out ? 0 : -1;
+}
+
+// Copy-on-write: a changed question is a new object. Games keep the
+// snapshot they drew; only later draws see the edit.
+static int bank_refresh(int64_t question_id) {
+    Question *fresh = NULL;
+    if (dao_question_get_by_id(question_id, fetch_row, &fresh) != 0) return -1;
+
+    pthread_mutex_lock(&g_bank.lock);
+    Question *old = bank_take_locked(question_id);
+    int rc = 0;
+    if (fresh) {
+        rc = pool_push(&g_bank.pools[difficulty_index(fresh->difficulty)], fresh);
+    }
+    pthread_mutex_unlock(&g_bank.lock);
+
+    if (rc != 0) question_release(fresh);
+    question_release(old);
+    return rc;
+}
+
+int question_bank_apply(const char *payload) {
+    if (!payload) return -1;
+
+    pthread_mutex_lock(&g_bank.lock);
+    int loaded = g_bank.loaded;
+    pthread_mutex_unlock(&g_bank.lock);
+    // Nothing cached yet: the first draw loads the current table anyway
+    if (!loaded) return 0;
+
+    if (strcmp(payload, "TRUNCATE") == 0) return question_bank_load();
+
+    const char *sep = strchr(payload, ':');
+    int64_t question_id = sep ? atoll(sep + 1) : 0;
+    if (question_id <= 0) {
+        LOG_WARN(LOG_CAT_DB, "question bank: bad notification '%s'", payload);
+        return -1;
+    }
+
+    if (strncmp(payload, "DELETE:", 7) == 0) {
+        pthread_mutex_lock(&g_bank.lock);
+        Question *old = bank_take_locked(question_id);
+        pthread_mutex_unlock(&g_bank.lock);
+        question_release(old);
+        return 0;
+    }
+    // INSERT / UPDATE: read the row as it is now
+    return bank_refresh(question_id);
+}
+
+// ---------------------------------------------------------------------------
+// LISTEN thread
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    pthread_t thread;
+    int running;
+    int stop;                  // atomic
+    char *conninfo;
+} QuestionListener;
+
+static QuestionListener g_listener;
+
+static int listener_stopping(void) {
+    return __atomic_load_n(&g_listener.stop, __ATOMIC_ACQUIRE);
+}
+
+// Wait for the socket (or at most QB_LISTEN_POLL_MS). Returns -1 when the
+// connection is lost, 0 otherwise.
+static int listener_wait(PGconn *conn) {
+    struct pollfd pfd = { .fd = PQsocket(conn), .events = POLLIN };
+    if (pfd.fd < 0) return -1;
+    int n = poll(&pfd, 1, QB_LISTEN_POLL_MS);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    if (n > 0 && !PQconsumeInput(conn)) return -1;
+    return 0;
+}
+
+static void *listener_main(void *arg) {
+    (void)arg;
+    int backoff_ms = QB_LISTEN_BACKOFF_MIN_MS;
+    int caught_up = 1;         // question_bank_load ran right before we started
+
+    while (!listener_stopping()) {
+        PGconn *conn = PQconnectdb(g_listener.conninfo);
+        PGresult *res = NULL;
+        if (PQstatus(conn) == CONNECTION_OK) {
+            res = PQexec(conn, "LISTEN " QB_CHANNEL);
+        }
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            LOG_WARN(LOG_CAT_DB, "question listener: %s (retry in %d ms)",
+                     PQerrorMessage(conn), backoff_ms);
+            PQclear(res);
+            PQfinish(conn);
+            for (int waited = 0; waited < backoff_ms && !listener_stopping();
+                 waited += QB_LISTEN_POLL_MS) {
+                usleep(QB_LISTEN_POLL_MS * 1000);
+            }
+            backoff_ms *= 2;
+            if (backoff_ms > QB_LISTEN_BACKOFF_MAX_MS) backoff_ms = QB_LISTEN_BACKOFF_MAX_MS;
+            caught_up = 0;
+            continue;
+        }
+        PQclear(res);
+        backoff_ms = QB_LISTEN_BACKOFF_MIN_MS;
+
+        // The bank's DAO reads go through this thread's own connection
+        db_bind_thread_conn(conn);
+        // Edits made while nobody was listening never arrive: reload
+        if (!caught_up) question_bank_load();
+        caught_up = 1;
+        LOG_INFO(LOG_CAT_DB, "question listener: listening on %s", QB_CHANNEL);
+
+        while (!listener_stopping()) {
+            if (listener_wait(conn) != 0) {
+                LOG_WARN(LOG_CAT_DB, "question listener: connection lost: %s", PQerrorMessage(conn));
+                caught_up = 0;
+                break;
+            }
+            PGnotify *n;
+            while ((n = PQnotifies(conn)) != NULL) {
+                question_bank_apply(n->extra);
+                PQfreemem(n);
+            }
+        }
+        db_bind_thread_conn(NULL);
+        PQfinish(conn);
+    }
+    return NULL;
+}
+
+int question_bank_listen(const char *conninfo) {
+    if (!conninfo || g_listener.running) return -1;
+    g_listener.conninfo = strdup(conninfo);
+    if (!g_listener.conninfo) return -1;
+    __atomic_store_n(&g_listener.stop, 0, __ATOMIC_RELEASE);
+    if (pthread_create(&g_listener.thread, NULL, listener_main, NULL) != 0) {
+        free(g_listener.conninfo);
+        g_listener.conninfo = NULL;
+        return -1;
+    }
+    g_listener.running = 1;
+    return 0;
+}
+
+void question_bank_stop_listening(void) {
+    if (!g_listener.running) return;
+    __atomic_store_n(&g_listener.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(g_listener.thread, NULL);
+    g_listener.running = 0;
+    free(g_listener.conninfo);
+    g_listener.conninfo = NULL;
+}
+
+void question_bank_free(void) {
+    QuestionPool old[QB_DIFFICULTIES];
+    pthread_mutex_lock(&g_bank.lock);
+    memcpy(old, g_bank.pools, sizeof(old));
+    memset(g_bank.pools, 0, sizeof(g_bank.pools));
+    g_bank.loaded = 0;
+    pthread_mutex_unlock(&g_bank.lock);
+
+    for (int i = 0; i < QB_DIFFICULTIES; i++) pool_clear(&old[i]);
+}
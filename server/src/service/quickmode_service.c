@@ -4,13 +4,15 @@
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
-#include "dao/dao_question.h"
 #include "dao/dao_stats.h"
 #include "service/quickmode_service.h"
 #include "service/commands.h"
 #include "service/protocol.h"
 #include "service/client_session.h"
+#include "service/leaderboard.h"
+#include "service/question_bank.h"
 #include "utils/json.h"
+#include "utils/log.h"
 
 // Quickmode không lưu vào DB, chỉ lưu trong memory
 // Chơi xong là xong, không update stats
@@ -68,6 +70,9 @@ static void quickmode_session_free(QuickModeSession *sess) {
 		}
 	}
 
+	for (int i = 0; i < 15; i++) {
+		question_release(sess->questions[i]);
+	}
 	free(sess);
 }
 
@@ -93,164 +98,21 @@ static QuickModeSession *quickmode_session_find_by_id(int64_t session_id) {
 // QUESTION LOADING
 // ============================================================
 
-// Helper function to check if question_id is already in the loaded_ids array
-static int is_question_duplicate(int64_t question_id, const int64_t *loaded_ids, int loaded_count) {
-	for (int j = 0; j < loaded_count; j++) {
-		if (loaded_ids[j] == question_id) {
-			return 1;
-		}
-	}
-	return 0;
-}
-
-// Helper function to validate question data
-static int is_question_valid(const Question *q) {
-	if (!q) return 0;
-	
-	// Check question_id
-	if (q->question_id <= 0) {
-		fprintf(stderr, "[QM] Invalid question_id: %lld\n", q->question_id);
-		return 0;
-	}
-	
-	// Check content
-	if (!q->content || strlen(q->content) == 0) {
-		fprintf(stderr, "[QM] Empty question content for question_id %lld\n", q->question_id);
-		return 0;
-	}
-	
-	// Check all options
-	if (!q->op_a || strlen(q->op_a) == 0 ||
-	    !q->op_b || strlen(q->op_b) == 0 ||
-	    !q->op_c || strlen(q->op_c) == 0 ||
-	    !q->op_d || strlen(q->op_d) == 0) {
-		fprintf(stderr, "[QM] Empty option(s) for question_id %lld\n", q->question_id);
-		return 0;
-	}
-	
-	// Check correct_op
-	if (!q->correct_op || (q->correct_op[0] != 'A' && q->correct_op[0] != 'B' && 
-	                       q->correct_op[0] != 'C' && q->correct_op[0] != 'D' &&
-	                       q->correct_op[0] != 'a' && q->correct_op[0] != 'b' &&
-	                       q->correct_op[0] != 'c' && q->correct_op[0] != 'd')) {
-		fprintf(stderr, "[QM] Invalid correct_op: %c (0x%02x) for question_id %lld\n",
-			q->correct_op[0], (unsigned char)q->correct_op[0], q->question_id);
-		return 0;
-	}
-	
-	return 1;
-}
-
+// 5 EASY, 5 MEDIUM, 5 HARD dealt by the in-memory bank in one call:
+// already validated and distinct, so there is nothing to retry
 static int quickmode_load_questions(QuickModeSession *sess) {
 	if (!sess) return -1;
 
-	// Array to track loaded question IDs to prevent duplicates
-	int64_t loaded_ids[15];
-	int loaded_count = 0;
-
-	// Load 5 EASY questions
-	for (int i = 0; i < 5; i++) {
-		int retries = 0;
-		const int MAX_RETRIES = 100;
-		int success = 0;
-
-		while (retries < MAX_RETRIES) {
-			if (dao_question_get_random("EASY", &sess->questions[i]) != 0) {
-				fprintf(stderr, "[QM] Failed to load EASY question %d\n", i);
-				return -1;
-			}
-
-			// Validate question data
-			if (!is_question_valid(&sess->questions[i])) {
-				fprintf(stderr, "[QM] Invalid EASY question %d data, retrying...\n", i);
-				retries++;
-				continue;
-			}
-
-			// Check for duplicate
-			if (!is_question_duplicate(sess->questions[i].question_id, loaded_ids, loaded_count)) {
-				loaded_ids[loaded_count++] = sess->questions[i].question_id;
-				success = 1;
-				break;
-			}
-
-			retries++;
-		}
-
-		if (!success) {
-			fprintf(stderr, "[QM] Failed to load unique EASY question %d after %d retries\n", i, MAX_RETRIES);
-			return -1;
-		}
-	}
-
-	// Load 5 MEDIUM questions
-	for (int i = 0; i < 5; i++) {
-		int retries = 0;
-		const int MAX_RETRIES = 100;
-		int success = 0;
-
-		while (retries < MAX_RETRIES) {
-			if (dao_question_get_random("MEDIUM", &sess->questions[i + 5]) != 0) {
-				fprintf(stderr, "[QM] Failed to load MEDIUM question %d\n", i);
-				return -1;
-			}
-
-			// Validate question data
-			if (!is_question_valid(&sess->questions[i + 5])) {
-				fprintf(stderr, "[QM] Invalid MEDIUM question %d data, retrying...\n", i);
-				retries++;
-				continue;
-			}
-
-			// Check for duplicate
-			if (!is_question_duplicate(sess->questions[i + 5].question_id, loaded_ids, loaded_count)) {
-				loaded_ids[loaded_count++] = sess->questions[i + 5].question_id;
-				success = 1;
-				break;
-			}
-
-			retries++;
-		}
-
-		if (!success) {
-			fprintf(stderr, "[QM] Failed to load unique MEDIUM question %d after %d retries\n", i, MAX_RETRIES);
-			return -1;
-		}
-	}
-
-	// Load 5 HARD questions
-	for (int i = 0; i < 5; i++) {
-		int retries = 0;
-		const int MAX_RETRIES = 100;
-		int success = 0;
-
-		while (retries < MAX_RETRIES) {
-			if (dao_question_get_random("HARD", &sess->questions[i + 10]) != 0) {
-				fprintf(stderr, "[QM] Failed to load HARD question %d\n", i);
-				return -1;
-			}
-
-			// Validate question data
-			if (!is_question_valid(&sess->questions[i + 10])) {
-				fprintf(stderr, "[QM] Invalid HARD question %d data, retrying...\n", i);
-				retries++;
-				continue;
-			}
-
-			// Check for duplicate
-			if (!is_question_duplicate(sess->questions[i + 10].question_id, loaded_ids, loaded_count)) {
-				loaded_ids[loaded_count++] = sess->questions[i + 10].question_id;
-				success = 1;
-				break;
-			}
-
-			retries++;
-		}
-
-		if (!success) {
-			fprintf(stderr, "[QM] Failed to load unique HARD question %d after %d retries\n", i, MAX_RETRIES);
-			return -1;
+	int easy = 5, medium = 5, hard = 5;
+	int dealt = question_bank_deal(&easy, &medium, &hard, sess->questions);
+	if (dealt != 15) {
+		LOG_ERROR(LOG_CAT_QUICKMODE, "Not enough questions (easy=%d medium=%d hard=%d)",
+			easy, medium, hard);
+		for (int i = 0; i < dealt; i++) {
+			question_release(sess->questions[i]);
+			sess->questions[i] = NULL;
 		}
+		return -1;
 	}
 
 	return 0;
@@ -312,8 +174,10 @@ static void quickmode_handle_get_question(ClientSession *sess, const char *paylo
 	long long session_id = 0;
 	int round = 0;
 	long long round_ll = 0;
-	util_json_get_int64(payload, "session_id", &session_id);
-	util_json_get_int64(payload, "round", &round_ll);
+	JsonObject req;
+	util_json_parse(payload, &req);
+	util_json_obj_int64(&req, "session_id", &session_id);
+	util_json_obj_int64(&req, "round", &round_ll);
 	round = (int)round_ll;
 
 	if (session_id == 0 || round < 1 || round > 15) {
@@ -335,17 +199,17 @@ static void quickmode_handle_get_question(ClientSession *sess, const char *paylo
 	}
 
 	// Get question
-	Question *q = &qm_sess->questions[round - 1];
+	Question *q = qm_sess->questions[round - 1];
 	
 	// Validate question data
 	if (q->question_id <= 0) {
-		fprintf(stderr, "[QM] Invalid question_id: %lld for round %d\n", q->question_id, round);
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid question_id: %lld for round %d", q->question_id, round);
 		protocol_send_error(sess, CMD_NOTIFY_QUESTION, "INVALID_QUESTION_DATA");
 		return;
 	}
 	
 	if (!q->content || strlen(q->content) == 0) {
-		fprintf(stderr, "[QM] Empty question content for round %d, question_id %lld\n", round, q->question_id);
+		LOG_WARN(LOG_CAT_QUICKMODE, "Empty question content for round %d, question_id %lld", round, q->question_id);
 		protocol_send_error(sess, CMD_NOTIFY_QUESTION, "INVALID_QUESTION_DATA");
 		return;
 	}
@@ -354,7 +218,7 @@ static void quickmode_handle_get_question(ClientSession *sess, const char *paylo
 	    !q->op_b || strlen(q->op_b) == 0 ||
 	    !q->op_c || strlen(q->op_c) == 0 ||
 	    !q->op_d || strlen(q->op_d) == 0) {
-		fprintf(stderr, "[QM] Empty option(s) for round %d, question_id %lld\n", round, q->question_id);
+		LOG_WARN(LOG_CAT_QUICKMODE, "Empty option(s) for round %d, question_id %lld", round, q->question_id);
 		protocol_send_error(sess, CMD_NOTIFY_QUESTION, "INVALID_QUESTION_DATA");
 		return;
 	}
@@ -363,7 +227,7 @@ static void quickmode_handle_get_question(ClientSession *sess, const char *paylo
 	                       q->correct_op[0] != 'C' && q->correct_op[0] != 'D' &&
 	                       q->correct_op[0] != 'a' && q->correct_op[0] != 'b' &&
 	                       q->correct_op[0] != 'c' && q->correct_op[0] != 'd')) {
-		fprintf(stderr, "[QM] Invalid correct_op: %c (0x%02x) for round %d, question_id %lld\n",
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid correct_op: %c (0x%02x) for round %d, question_id %lld",
 			q->correct_op[0], (unsigned char)q->correct_op[0], round, q->question_id);
 		protocol_send_error(sess, CMD_NOTIFY_QUESTION, "INVALID_QUESTION_DATA");
 		return;
@@ -431,10 +295,12 @@ static void quickmode_handle_submit_answer(ClientSession *sess, const char *payl
 	long long session_id = 0;
 	int round = 0;
 	long long round_ll = 0;
-	char *answer_str = util_json_get_string(payload, "answer");
+	JsonObject req;
+	util_json_parse(payload, &req);
+	char *answer_str = util_json_obj_string(&req, "answer");
 
-	util_json_get_int64(payload, "session_id", &session_id);
-	util_json_get_int64(payload, "round", &round_ll);
+	util_json_obj_int64(&req, "session_id", &session_id);
+	util_json_obj_int64(&req, "round", &round_ll);
 	round = (int)round_ll;
 
 	if (session_id == 0 || round < 1 || round > 15 || !answer_str || strlen(answer_str) != 1) {
@@ -465,7 +331,7 @@ static void quickmode_handle_submit_answer(ClientSession *sess, const char *payl
 	}
 
 	// Get question
-	Question *q = &qm_sess->questions[round - 1];
+	Question *q = qm_sess->questions[round - 1];
 	int is_correct = (answer == q->correct_op[0]) ? 1 : 0;
 
 	// Save answer
@@ -532,8 +398,10 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	long long session_id = 0;
 	int round = 0;
 	long long round_ll = 0;
-	util_json_get_int64(payload, "session_id", &session_id);
-	util_json_get_int64(payload, "round", &round_ll);
+	JsonObject req;
+	util_json_parse(payload, &req);
+	util_json_obj_int64(&req, "session_id", &session_id);
+	util_json_obj_int64(&req, "round", &round_ll);
 	round = (int)round_ll;
 
 	if (session_id == 0 || round < 1 || round > 15) {
@@ -561,7 +429,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	}
 
 	// Get question
-	Question *q = &qm_sess->questions[round - 1];
+	Question *q = qm_sess->questions[round - 1];
 	char correct_op = q->correct_op[0];
 	
 	// Normalize correct_op to uppercase and validate
@@ -569,7 +437,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 		correct_op = correct_op - 'a' + 'A';
 	}
 	if (correct_op < 'A' || correct_op > 'D') {
-		fprintf(stderr, "[QM] Invalid correct_op: %c (0x%02x) for round %d, question_id %lld\n", 
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid correct_op: %c (0x%02x) for round %d, question_id %lld", 
 			correct_op, (unsigned char)correct_op, round, q->question_id);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INVALID_QUESTION_DATA");
 		return;
@@ -586,7 +454,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	for (char opt = 'A'; opt <= 'D'; opt++) {
 		if (opt != correct_op) {
 			if (wrong_count >= 3) {
-				fprintf(stderr, "[QM] Error: wrong_count overflow for round %d\n", round);
+				LOG_ERROR(LOG_CAT_QUICKMODE, "wrong_count overflow for round %d", round);
 				protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 				return;
 			}
@@ -597,7 +465,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 
 	// Validate wrong_count
 	if (wrong_count != 3) {
-		fprintf(stderr, "[QM] Invalid wrong_count: %d (expected 3) for round %d, correct_op=%c (0x%02x)\n", 
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid wrong_count: %d (expected 3) for round %d, correct_op=%c (0x%02x)", 
 			wrong_count, round, correct_op, (unsigned char)correct_op);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 		return;
@@ -606,7 +474,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	// Validate wrong_options array before use
 	for (int i = 0; i < 3; i++) {
 		if (wrong_options[i] < 'A' || wrong_options[i] > 'D') {
-			fprintf(stderr, "[QM] Invalid wrong_options[%d]: %c (0x%02x) for round %d, correct_op=%c\n",
+			LOG_WARN(LOG_CAT_QUICKMODE, "Invalid wrong_options[%d]: %c (0x%02x) for round %d, correct_op=%c",
 				i, wrong_options[i], (unsigned char)wrong_options[i], round, correct_op);
 			protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 			return;
@@ -624,7 +492,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	}
 	
 	if (random_idx < 0 || random_idx >= wrong_count) {
-		fprintf(stderr, "[QM] Invalid random_idx: %d (wrong_count=%d) for round %d, time=%ld, session_id=%lld\n", 
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid random_idx: %d (wrong_count=%d) for round %d, time=%ld, session_id=%lld", 
 			random_idx, wrong_count, round, (long)now, (long long)qm_sess->session_id);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 		return;
@@ -634,7 +502,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	
 	// Validate keep_wrong immediately after assignment
 	if (keep_wrong < 'A' || keep_wrong > 'D') {
-		fprintf(stderr, "[QM] Invalid keep_wrong after assignment: %c (0x%02x) for round %d\n"
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid keep_wrong after assignment: %c (0x%02x) for round %d\n"
 			"  correct_op=%c (0x%02x)\n"
 			"  wrong_options=[%c (0x%02x), %c (0x%02x), %c (0x%02x)]\n"
 			"  random_idx=%d, wrong_count=%d\n",
@@ -655,7 +523,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	
 	// Final validation
 	if (keep_wrong < 'A' || keep_wrong > 'D') {
-		fprintf(stderr, "[QM] Invalid keep_wrong after normalize: %c (0x%02x) for round %d\n", 
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid keep_wrong after normalize: %c (0x%02x) for round %d", 
 			keep_wrong, (unsigned char)keep_wrong, round);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 		return;
@@ -672,7 +540,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	for (char opt = 'A'; opt <= 'D'; opt++) {
 		if (opt != correct_op && opt != keep_wrong) {
 			if (removed_idx >= 2) {
-				fprintf(stderr, "[QM] Error: removed_idx overflow for round %d\n", round);
+				LOG_ERROR(LOG_CAT_QUICKMODE, "removed_idx overflow for round %d", round);
 				protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 				return;
 			}
@@ -682,7 +550,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	
 	// Validate removed array is complete
 	if (removed_idx != 2) {
-		fprintf(stderr, "[QM] Invalid removed_idx: %d (expected 2) for round %d\n", removed_idx, round);
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid removed_idx: %d (expected 2) for round %d", removed_idx, round);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 		return;
 	}
@@ -692,7 +560,7 @@ static void quickmode_handle_use_lifeline(ClientSession *sess, const char *paylo
 	    remaining[1] < 'A' || remaining[1] > 'D' ||
 	    removed[0] < 'A' || removed[0] > 'D' ||
 	    removed[1] < 'A' || removed[1] > 'D') {
-		fprintf(stderr, "[QM] Invalid option values: remaining=[%c,%c] removed=[%c,%c] for round %d\n",
+		LOG_WARN(LOG_CAT_QUICKMODE, "Invalid option values: remaining=[%c,%c] removed=[%c,%c] for round %d",
 			remaining[0], remaining[1], removed[0], removed[1], round);
 		protocol_send_error(sess, CMD_RES_USE_LIFELINE, "INTERNAL_ERROR");
 		return;
@@ -747,7 +615,8 @@ static void quickmode_handle_game_over(QuickModeSession *sess) {
 	protocol_send_response(sess->client_session, CMD_NOTIFY_GAME_OVER, json, strlen(json));
 
 	// Update stats in database
-	dao_stats_update_quickmode_game(sess->user_id, won);
+	dao_stats_update_quickmode_game_async(sess->user_id, won);
+	if (won) leaderboard_add_wins(sess->user_id, 1);
 
 	// Cleanup
 	quickmode_session_free(sess);
@@ -805,21 +674,22 @@ void quickmode_dispatch(ClientSession *sess, uint16_t cmd, const char *payload,
 
 int qm_debug_start(int64_t user_id) {
 	(void)user_id;
-	Question q;
-	if (dao_question_get_random("EASY", &q) != 0) {
-		fprintf(stderr, "[QM] get_random question failed\n");
+	Question *q = NULL;
+	if (question_bank_draw("EASY", &q, 1) != 1) {
+		LOG_ERROR(LOG_CAT_QUICKMODE, "get_random question failed");
 		return -1;
 	}
 
 	printf("=== QUICKMODE DEBUG ===\n");
 	printf("User: %" PRId64 "\n", user_id);
-	printf("Question %" PRId64 "\n", q.question_id);
-	printf("Q: %s\n", q.content);
-	printf("A: %s\n", q.op_a);
-	printf("B: %s\n", q.op_b);
-	printf("C: %s\n", q.op_c);
-	printf("D: %s\n", q.op_d);
-	printf("Correct: %s\n", q.correct_op);
-
+	printf("Question %" PRId64 "\n", q->question_id);
+	printf("Q: %s\n", q->content);
+	printf("A: %s\n", q->op_a);
+	printf("B: %s\n", q->op_b);
+	printf("C: %s\n", q->op_c);
+	printf("D: %s\n", q->op_d);
+	printf("Correct: %s\n", q->correct_op);
+
+	question_release(q);
 	return 0;
 }
@@ -1,10 +1,20 @@
 // Multi-client TCP server using epoll
+//
+// The server runs a pool of event-loop threads (multi-reactor). Every worker
+// owns a SessionManager with its own epoll instance and its own SO_REUSEPORT
+// listening socket, so the kernel spreads new connections across workers and
+// accept/recv/send run in parallel. Service handlers share in-memory game
+// state, so they run under session_manager_lock(), but never across a DB
+// round trip: their queries run on the DB pool (session_manager_submit_db)
+// and the results come back through the worker's mailbox, like sends to a
+// session owned by another worker (see session_manager_post_send).
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/types.h>
@@ -12,6 +22,9 @@
 #include <sys/epoll.h>
 #include <fcntl.h>
 
+#include "db.h"
+#include "db_async.h"
+#include "db_pool.h"
 #include "service/server.h"
 #include "service/client_session.h"
 #include "service/session_manager.h"
@@ -19,14 +32,20 @@
 #include "service/protocol.h"
 #include "service/quickmode_service.h"
 #include "service/friends_service.h"
+#include "service/friend_graph.h"
 #include "utils/timer.h"
+#include "utils/log.h"
 
-static volatile int running = 1;
+static volatile sig_atomic_t running = 1;
 
-static void handle_sigint(int signum) {
-	(void)signum;
-	running = 0;
-}
+typedef struct ServerWorker {
+	int id;
+	pthread_t thread;
+	int listen_fd;
+	int timer_fd;              // game timer timerfd, only on worker 0
+	SessionManager *mgr;
+	DbAsync *db;               // this loop's non-blocking DB connection (may be NULL)
+} ServerWorker;
 
 static int set_nonblocking(int fd) {
 	int flags = fcntl(fd, F_GETFL, 0);
@@ -34,7 +53,9 @@ static int set_nonblocking(int fd) {
 	return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
-int start_server(const char *bind_addr, const char *portstr) {
+// Create a non-blocking listening socket. With SO_REUSEPORT every worker
+// binds its own socket to the same address and the kernel balances accepts.
+static int create_listener(const char *bind_addr, const char *portstr) {
 	struct addrinfo hints, *res, *rp;
 	int sockfd = -1;
 
@@ -55,6 +76,12 @@ int start_server(const char *bind_addr, const char *portstr) {
 
 		int opt = 1;
 		setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+		if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+			fprintf(stderr, "SO_REUSEPORT failed: %s\n", strerror(errno));
+			close(sockfd);
+			sockfd = -1;
+			continue;
+		}
 
 		if (bind(sockfd, rp->ai_addr, rp->ai_addrlen) == 0) break;
 		close(sockfd);
@@ -74,140 +101,344 @@ int start_server(const char *bind_addr, const char *portstr) {
 		return -1;
 	}
 
-	if (listen(sockfd, 16) != 0) {
+	if (listen(sockfd, 128) != 0) {
 		fprintf(stderr, "listen failed: %s\n", strerror(errno));
 		close(sockfd);
 		return -1;
 	}
 
-	signal(SIGINT, handle_sigint);
+	return sockfd;
+}
 
-	// Create session manager
-	SessionManager *mgr = session_manager_new(MAX_SESSIONS);
-	if (!mgr) {
-		fprintf(stderr, "Failed to create session manager\n");
-		close(sockfd);
-		return -1;
+static void accept_clients(ServerWorker *w) {
+	// Accept all pending connections (edge-triggered)
+	while (1) {
+		struct sockaddr_storage cli_addr;
+		socklen_t cli_len = sizeof(cli_addr);
+		int client_fd = accept(w->listen_fd, (struct sockaddr *)&cli_addr, &cli_len);
+
+		if (client_fd < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				// No more connections
+				break;
+			}
+			if (errno == EINTR) continue;
+			LOG_ERROR(LOG_CAT_SERVER, "accept failed: %s", strerror(errno));
+			break;
+		}
+
+		// Set non-blocking
+		if (set_nonblocking(client_fd) < 0) {
+			close(client_fd);
+			continue;
+		}
+
+		// Create session
+		ClientSession *sess = client_session_new(client_fd);
+		if (!sess) {
+			close(client_fd);
+			continue;
+		}
+
+		// Add to this worker's session manager
+		session_manager_lock();
+		int rc = session_manager_add(w->mgr, sess);
+		session_manager_unlock();
+		if (rc < 0) {
+			LOG_WARN(LOG_CAT_SERVER, "Failed to add session (fd=%d)", client_fd);
+			close(client_fd);
+			client_session_free(sess);
+			continue;
+		}
+
+		LOG_INFO(LOG_CAT_SERVER, "New client connected (fd=%d, worker=%d, total=%d)",
+		         client_fd, w->id, session_manager_count(w->mgr));
 	}
+}
 
-	// Set global session manager (important for session_manager_get_by_user_id)
-	session_manager_set_global(mgr);
+static void handle_disconnect(ServerWorker *w, ClientSession *sess) {
+	int fd = sess->socket_fd;
+	LOG_INFO(LOG_CAT_SERVER, "Client disconnected (fd=%d, worker=%d)", fd, w->id);
+
+	session_manager_lock();
+	// Notify friends that user is offline (before removing session)
+	if (sess->user_id > 0) {
+		friends_notify_status_change(sess->user_id, "offline", 0);
+		friend_graph_forget(sess->user_id);
+		// Cleanup quickmode session if exists
+		quickmode_cleanup_user(sess->user_id);
+	}
+	session_manager_remove(w->mgr, fd);
+	session_manager_unlock();
 
-	// Add server socket to epoll
-	struct epoll_event ev;
-	ev.events = EPOLLIN | EPOLLET;
-	ev.data.fd = sockfd;
-	if (epoll_ctl(session_manager_get_epoll_fd(mgr), EPOLL_CTL_ADD, sockfd, &ev) < 0) {
-		fprintf(stderr, "epoll_ctl failed: %s\n", strerror(errno));
-		session_manager_free(mgr);
-		close(sockfd);
-		return -1;
+	close(fd);
+}
+
+static void handle_client_event(ServerWorker *w, ClientSession *sess, uint32_t events) {
+	// Socket drained: push out whatever is still queued for this client
+	if (events & EPOLLOUT) {
+		client_session_flush(sess);
 	}
+	if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+
+	// Drain the socket (edge-triggered) and dispatch every complete frame
+	ClientFrame frames[MAX_FRAMES_PER_BATCH];
+	ClientReadStatus status;
+	do {
+		// A request is waiting for the database: the rest is read and
+		// dispatched once it has completed (session_manager_pop_resumed)
+		if (sess->db_paused) return;
+
+		int nframes = 0;
+		status = client_session_read_frames(sess, frames, MAX_FRAMES_PER_BATCH, &nframes);
+
+		if (nframes > 0) {
+			session_manager_lock();
+			dispatcher_handle_batch(sess, frames, nframes);
+			session_manager_unlock();
+		}
+	} while (status == CLIENT_READ_MORE);
 
-	printf("Server listening on %s:%s (epoll-based, multi-client)\n", 
-	       bind_addr ? bind_addr : "0.0.0.0", portstr);
+	if (status == CLIENT_READ_CLOSED) {
+		// Error or disconnect
+		handle_disconnect(w, sess);
+	}
+}
+
+static void run_game_timers(ServerWorker *w) {
+	uint64_t expirations;
+	while (read(w->timer_fd, &expirations, sizeof(expirations)) > 0) {
+	}
+
+	session_manager_lock();
+	game_timer_check_and_run();
+	session_manager_unlock();
+}
+
+static void *worker_main(void *arg) {
+	ServerWorker *w = (ServerWorker *)arg;
+	SessionManager *mgr = w->mgr;
+	session_manager_set_current(mgr);
+	db_async_set_current(w->db);
 
 	struct epoll_event events[MAX_EPOLL_EVENTS];
 
 	while (running) {
-		// Check and run expired game timers (for 1vN mode timeout handling)
-		game_timer_check_and_run();
-		
-		int nfds = epoll_wait(session_manager_get_epoll_fd(mgr), events, MAX_EPOLL_EVENTS, 100);
-		
+		// Sleep until I/O, a mailbox wakeup or (worker 0) the next timer deadline
+		int nfds = epoll_wait(session_manager_get_epoll_fd(mgr), events, MAX_EPOLL_EVENTS, -1);
+
 		if (nfds < 0) {
 			if (errno == EINTR) continue;
-			fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+			LOG_ERROR(LOG_CAT_SERVER, "epoll_wait failed (worker=%d): %s", w->id, strerror(errno));
 			break;
 		}
 
 		for (int i = 0; i < nfds; i++) {
-			int fd = events[i].data.fd;
-
-			// New connection
-			if (fd == sockfd) {
-				// Accept all pending connections (edge-triggered)
-				while (1) {
-					struct sockaddr_storage cli_addr;
-					socklen_t cli_len = sizeof(cli_addr);
-					int client_fd = accept(sockfd, (struct sockaddr *)&cli_addr, &cli_len);
-					
-					if (client_fd < 0) {
-						if (errno == EAGAIN || errno == EWOULDBLOCK) {
-							// No more connections
-							break;
-						}
-						fprintf(stderr, "accept failed: %s\n", strerror(errno));
-						break;
-					}
-
-					// Set non-blocking
-					if (set_nonblocking(client_fd) < 0) {
-						close(client_fd);
-						continue;
-					}
-
-					// Create session
-					ClientSession *sess = client_session_new(client_fd);
-					if (!sess) {
-						close(client_fd);
-						continue;
-					}
-
-					// Add to session manager
-					if (session_manager_add(mgr, sess) < 0) {
-						fprintf(stderr, "Failed to add session\n");
-						close(client_fd);
-						client_session_free(sess);
-						continue;
-					}
-
-					printf("New client connected (fd=%d, total=%d)\n", 
-					       client_fd, session_manager_count(mgr));
-				}
-			} else {
-				// Data from client - get session from epoll_event.data.ptr
-				ClientSession *sess = (ClientSession *)events[i].data.ptr;
-				if (!sess) continue;
-
-				// Read packet (handles partial reads)
-				uint16_t cmd;
-				char *payload = NULL;
-				uint32_t payload_len = 0;
-
-				int result = client_session_read_packet(sess, &cmd, &payload, &payload_len);
-
-				if (result < 0) {
-					// Error or disconnect
-					printf("Client disconnected (fd=%d)\n", fd);
-					// Notify friends that user is offline (before removing session)
-					if (sess && sess->user_id > 0) {
-						// Import friends_service to notify friends
-						extern void friends_notify_status_change(int64_t user_id, const char *status, int64_t room_id);
-						friends_notify_status_change(sess->user_id, "offline", 0);
-						// Cleanup quickmode session if exists
-						quickmode_cleanup_user(sess->user_id);
-					}
-					session_manager_remove(mgr, fd);
-					continue;
-				}
-
-				if (result == 0) {
-					// Partial packet, wait for more data
-					continue;
-				}
-
-				// Complete packet received
-				dispatcher_handle_packet(sess, cmd, payload, payload_len);
-
-				if (payload) free(payload);
+			void *ptr = events[i].data.ptr;
+
+			if (ptr == &w->listen_fd) {
+				// New connection
+				accept_clients(w);
+			} else if (ptr == &mgr->wake_fd) {
+				// Sends posted by other workers
+				session_manager_drain_mailbox(mgr);
+			} else if (ptr == &w->timer_fd) {
+				// Game timers due (for 1vN mode timeout handling)
+				run_game_timers(w);
+			} else if (w->db && ptr == (void *)w->db) {
+				// Query results: continuations resume the waiting handlers
+				session_manager_lock();
+				db_async_handle_event(w->db, events[i].events);
+				session_manager_unlock();
+			} else if (ptr) {
+				// Data from client - session pointer stored in epoll_event.data.ptr
+				handle_client_event(w, (ClientSession *)ptr, events[i].events);
 			}
 		}
+
+		// Connections whose DB requests completed: carry on with their frames
+		ClientSession *resumed;
+		while ((resumed = session_manager_pop_resumed(mgr)) != NULL) {
+			handle_client_event(w, resumed, EPOLLIN);
+		}
 	}
 
-	printf("Shutting down server...\n");
-	session_manager_free(mgr);
-	close(sockfd);
+	return NULL;
+}
+
+static int worker_init(ServerWorker *w, int id, const char *bind_addr, const char *portstr) {
+	w->id = id;
+	w->listen_fd = -1;
+	w->timer_fd = -1;
+	w->db = NULL;
+
+	w->mgr = session_manager_new(MAX_SESSIONS);
+	if (!w->mgr) {
+		fprintf(stderr, "Failed to create session manager\n");
+		return -1;
+	}
+	w->mgr->worker_id = id;
+
+	w->listen_fd = create_listener(bind_addr, portstr);
+	if (w->listen_fd < 0) {
+		session_manager_free(w->mgr);
+		w->mgr = NULL;
+		return -1;
+	}
+
+	// Listener, mailbox and timer are told apart from sessions by their data.ptr
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = &w->listen_fd;
+	if (epoll_ctl(session_manager_get_epoll_fd(w->mgr), EPOLL_CTL_ADD, w->listen_fd, &ev) < 0) {
+		fprintf(stderr, "epoll_ctl failed: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = &w->mgr->wake_fd;
+	if (epoll_ctl(session_manager_get_epoll_fd(w->mgr), EPOLL_CTL_ADD, w->mgr->wake_fd, &ev) < 0) {
+		fprintf(stderr, "epoll_ctl failed: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	// Worker 0 drives the game timers
+	if (id == 0) {
+		w->timer_fd = game_timer_get_fd();
+		if (w->timer_fd < 0) {
+			fprintf(stderr, "timerfd_create failed: %s\n", strerror(errno));
+			goto fail;
+		}
+		ev.events = EPOLLIN;
+		ev.data.ptr = &w->timer_fd;
+		if (epoll_ctl(session_manager_get_epoll_fd(w->mgr), EPOLL_CTL_ADD, w->timer_fd, &ev) < 0) {
+			fprintf(stderr, "epoll_ctl failed: %s\n", strerror(errno));
+			goto fail;
+		}
+	}
+
+	// Per-loop DB connection; without it queries fall back to the shared
+	// blocking connection
+	if (db_get_conninfo()) {
+		w->db = db_async_new(db_get_conninfo(), session_manager_get_epoll_fd(w->mgr));
+		if (!w->db) {
+			LOG_WARN(LOG_CAT_SERVER, "worker %d: no async DB connection, using the blocking one", id);
+		}
+	}
+
+	// Make sessions of this worker visible to user/room lookups
+	if (session_manager_register(w->mgr) < 0) {
+		fprintf(stderr, "Failed to register session manager\n");
+		goto fail;
+	}
 	return 0;
+
+fail:
+	db_async_free(w->db);
+	w->db = NULL;
+	close(w->listen_fd);
+	w->listen_fd = -1;
+	session_manager_free(w->mgr);
+	w->mgr = NULL;
+	return -1;
+}
+
+// DB pool completions go back to the loop that submitted the job
+static void *pool_current_loop(void) {
+	return session_manager_get_current();
 }
 
+static int pool_post_to_loop(void *loop, db_job_fn fn, void *arg) {
+	return session_manager_post_call((SessionManager *)loop, fn, arg);
+}
+
+static int default_worker_count(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1) n = 1;
+	if (n > MAX_SERVER_WORKERS) n = MAX_SERVER_WORKERS;
+	return (int)n;
+}
+
+int start_server_workers(const char *bind_addr, const char *portstr, int worker_count) {
+	if (worker_count <= 0) worker_count = default_worker_count();
+	if (worker_count > MAX_SERVER_WORKERS) worker_count = MAX_SERVER_WORKERS;
+
+	ServerWorker *workers = calloc(worker_count, sizeof(ServerWorker));
+	if (!workers) return -1;
+	db_pool_set_loop_hooks(pool_current_loop, pool_post_to_loop);
+
+	int ready = 0;
+	for (; ready < worker_count; ready++) {
+		if (worker_init(&workers[ready], ready, bind_addr, portstr) < 0) break;
+	}
+	if (ready < worker_count) {
+		for (int i = 0; i < ready; i++) {
+			db_async_free(workers[i].db);
+			close(workers[i].listen_fd);
+			session_manager_free(workers[i].mgr);
+		}
+		session_manager_unregister_all();
+		free(workers);
+		return -1;
+	}
+
+	// Workers inherit this mask; only the main thread handles SIGINT/SIGTERM
+	sigset_t sigs;
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	signal(SIGPIPE, SIG_IGN);  // sends use MSG_NOSIGNAL, this covers the rest
+
+	int started = 0;
+	for (; started < worker_count; started++) {
+		if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+			fprintf(stderr, "Failed to start worker %d\n", started);
+			running = 0;
+			break;
+		}
+	}
+
+	if (running) {
+		printf("Server listening on %s:%s (epoll-based, %d worker threads)\n",
+		       bind_addr ? bind_addr : "0.0.0.0", portstr, worker_count);
+		int sig = 0;
+		sigwait(&sigs, &sig);
+		running = 0;
+	}
+
+	printf("Shutting down server...\n");
+	for (int i = 0; i < started; i++) {
+		session_manager_wake(workers[i].mgr);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	// Let DB pool jobs finish and deliver their completions while the
+	// sessions they answer still exist
+	db_pool_wait_idle();
+	for (int i = 0; i < worker_count; i++) {
+		session_manager_drain_mailbox(workers[i].mgr);
+	}
+
+	session_manager_lock();
+	for (int i = 0; i < worker_count; i++) {
+		// Pending queries complete with an error before sessions go away
+		db_async_free(workers[i].db);
+	}
+	session_manager_unlock();
+
+	session_manager_unregister_all();
+	for (int i = 0; i < worker_count; i++) {
+		session_manager_free(workers[i].mgr);
+		close(workers[i].listen_fd);
+	}
+	free(workers);
+	pthread_sigmask(SIG_UNBLOCK, &sigs, NULL);
+	return (started == worker_count) ? 0 : -1;
+}
+
+int start_server(const char *bind_addr, const char *portstr) {
+	return start_server_workers(bind_addr, portstr, 0);
+}
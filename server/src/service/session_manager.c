@@ -2,14 +2,39 @@
 #include "service/session_manager.h"
 #include "service/protocol.h"
 #include "service/commands.h"
+#include "service/presence_service.h"
+#include "db_pool.h"
+#include "utils/log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+
+// Every event-loop thread registers its manager here so that user and room
+// lookups see sessions regardless of which loop accepted them.
+static SessionManager *g_managers[MAX_SERVER_WORKERS];
+static int g_manager_count = 0;
+
+// Manager whose event loop runs on the calling thread
+static __thread SessionManager *tls_current_manager = NULL;
+
+// Serializes service handlers and timers on the shared in-memory state
+// (game state, session directory). Handlers never hold it across a
+// blocking database call: that work runs on the DB pool.
+static pthread_mutex_t g_service_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Logged-in users across all managers: user_id -> session
+static IdMap g_by_user_id;
+
+// Room membership across all managers: room_id -> first session of the
+// room's intrusive list (ClientSession.room_prev/room_next)
+static IdMap g_rooms;
 
 SessionManager *session_manager_new(int max_sessions) {
 	SessionManager *mgr = calloc(1, sizeof(SessionManager));
@@ -17,31 +42,65 @@ SessionManager *session_manager_new(int max_sessions) {
 
 	mgr->max_sessions = max_sessions;
 	mgr->sessions = calloc(max_sessions, sizeof(ClientSession*));
+	mgr->free_slots = malloc(max_sessions * sizeof(int));
 	
-	if (!mgr->sessions) {
+	if (!mgr->sessions || !mgr->free_slots || idmap_init(&mgr->by_fd, max_sessions) < 0) {
 		free(mgr->sessions);
+		free(mgr->free_slots);
 		free(mgr);
 		return NULL;
 	}
 
+	// Lowest slot on top of the stack
+	for (int i = 0; i < max_sessions; i++) {
+		mgr->free_slots[i] = max_sessions - 1 - i;
+	}
+	mgr->free_count = max_sessions;
+
 	// Create epoll instance
 	mgr->epoll_fd = epoll_create1(0);
 	if (mgr->epoll_fd < 0) {
+		idmap_free(&mgr->by_fd);
 		free(mgr->sessions);
+		free(mgr->free_slots);
 		free(mgr);
 		return NULL;
 	}
 
+	// Mailbox for sends coming from other event-loop threads
+	mgr->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mgr->wake_fd < 0) {
+		close(mgr->epoll_fd);
+		idmap_free(&mgr->by_fd);
+		free(mgr->sessions);
+		free(mgr->free_slots);
+		free(mgr);
+		return NULL;
+	}
+	pthread_mutex_init(&mgr->mailbox_lock, NULL);
+	mgr->mailbox_head = NULL;
+	mgr->mailbox_tail = NULL;
+	mgr->next_conn_id = 1;
+
 	mgr->session_count = 0;
 	return mgr;
 }
 
+// Drop the user_id index entry if it still points at this session
+static void unbind_user(ClientSession *sess) {
+	if (sess->user_id > 0 && idmap_get(&g_by_user_id, sess->user_id) == sess) {
+		idmap_remove(&g_by_user_id, sess->user_id);
+	}
+}
+
 void session_manager_free(SessionManager *mgr) {
 	if (!mgr) return;
 
 	// Close all sessions
 	for (int i = 0; i < mgr->max_sessions; i++) {
 		if (mgr->sessions[i]) {
+			unbind_user(mgr->sessions[i]);
+			session_manager_set_room(mgr->sessions[i], 0);
 			if (mgr->sessions[i]->socket_fd >= 0) {
 				close(mgr->sessions[i]->socket_fd);
 			}
@@ -53,24 +112,28 @@ void session_manager_free(SessionManager *mgr) {
 		close(mgr->epoll_fd);
 	}
 
+	// Drop undelivered mailbox items (calls are drained before shutdown)
+	MailboxItem *item = mgr->mailbox_head;
+	while (item) {
+		MailboxItem *next = item->next;
+		shared_frame_unref(item->frame);
+		free(item);
+		item = next;
+	}
+	if (mgr->wake_fd >= 0) {
+		close(mgr->wake_fd);
+	}
+	pthread_mutex_destroy(&mgr->mailbox_lock);
+
+	idmap_free(&mgr->by_fd);
+	free(mgr->free_slots);
 	free(mgr->sessions);
 	free(mgr);
 }
 
 int session_manager_add(SessionManager *mgr, ClientSession *sess) {
 	if (!mgr || !sess || sess->socket_fd < 0) return -1;
-	if (mgr->session_count >= mgr->max_sessions) return -1;
-
-	// Find free slot
-	int index = -1;
-	for (int i = 0; i < mgr->max_sessions; i++) {
-		if (mgr->sessions[i] == NULL) {
-			index = i;
-			break;
-		}
-	}
-
-	if (index < 0) return -1;
+	if (mgr->free_count == 0) return -1;
 
 	// Add to epoll - store session pointer in epoll_event.data.ptr
 	struct epoll_event ev;
@@ -80,80 +143,69 @@ int session_manager_add(SessionManager *mgr, ClientSession *sess) {
 	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, sess->socket_fd, &ev) < 0) {
 		return -1;
 	}
+	if (idmap_put(&mgr->by_fd, sess->socket_fd, sess) < 0) {
+		epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, sess->socket_fd, NULL);
+		return -1;
+	}
 
 	// Store session
+	int index = mgr->free_slots[--mgr->free_count];
+	sess->owner = mgr;
+	sess->conn_id = mgr->next_conn_id++;
+	sess->slot = index;
 	mgr->sessions[index] = sess;
 	mgr->session_count++;
 
 	return 0;
 }
 
-int session_manager_remove(SessionManager *mgr, int socket_fd) {
-	if (!mgr || socket_fd < 0) return -1;
+// Unregister and free a session owned by mgr
+static void remove_session(SessionManager *mgr, ClientSession *sess) {
+	// Remove from epoll
+	epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, sess->socket_fd, NULL);
 
-	// Find session by socket_fd
-	ClientSession *sess = NULL;
-	int index = -1;
-	for (int i = 0; i < mgr->max_sessions; i++) {
-		if (mgr->sessions[i] && mgr->sessions[i]->socket_fd == socket_fd) {
-			sess = mgr->sessions[i];
-			index = i;
-			break;
-		}
+	if (sess->resume_queued) {
+		ClientSession **pp = &mgr->resume_head;
+		while (*pp && *pp != sess) pp = &(*pp)->resume_next;
+		if (*pp) *pp = sess->resume_next;
 	}
 
-	if (!sess || index < 0) return -1;
-
-	// Remove from epoll
-	epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, socket_fd, NULL);
+	idmap_remove(&mgr->by_fd, sess->socket_fd);
+	unbind_user(sess);
+	session_manager_set_room(sess, 0);
+	mgr->sessions[sess->slot] = NULL;
+	mgr->free_slots[mgr->free_count++] = sess->slot;
+	mgr->session_count--;
 
 	// Free session
 	client_session_free(sess);
-	mgr->sessions[index] = NULL;
-	mgr->session_count--;
+}
 
+int session_manager_remove(SessionManager *mgr, int socket_fd) {
+	if (!mgr || socket_fd < 0) return -1;
+
+	ClientSession *sess = idmap_get(&mgr->by_fd, socket_fd);
+	if (!sess) return -1;
+
+	remove_session(mgr, sess);
 	return 0;
 }
 
 int session_manager_remove_by_user_id(SessionManager *mgr, int64_t user_id, ClientSession *exclude_sess) {
 	if (!mgr || user_id <= 0) return -1;
 
-	int removed_count = 0;
-	
-	// Find and remove all sessions with this user_id (except exclude_sess)
-	for (int i = 0; i < mgr->max_sessions; i++) {
-		if (mgr->sessions[i] && 
-		    mgr->sessions[i]->user_id == user_id &&
-		    mgr->sessions[i] != exclude_sess) {
-			
-			ClientSession *sess = mgr->sessions[i];
-			int socket_fd = sess->socket_fd;
-			
-			// Remove from epoll
-			epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, socket_fd, NULL);
-			
-			// Free session
-			client_session_free(sess);
-			mgr->sessions[i] = NULL;
-			mgr->session_count--;
-			removed_count++;
-		}
-	}
+	// A user is bound to at most one session; older connections are
+	// detached (user_id = 0) when the user logs in again.
+	ClientSession *sess = idmap_get(&g_by_user_id, user_id);
+	if (!sess || sess == exclude_sess || sess->owner != mgr) return 0;
 
-	return removed_count;
+	remove_session(mgr, sess);
+	return 1;
 }
 
 ClientSession *session_manager_get_by_fd(SessionManager *mgr, int socket_fd) {
 	if (!mgr || socket_fd < 0) return NULL;
-
-	// Find session by socket_fd
-	for (int i = 0; i < mgr->max_sessions; i++) {
-		if (mgr->sessions[i] && mgr->sessions[i]->socket_fd == socket_fd) {
-			return mgr->sessions[i];
-		}
-	}
-
-	return NULL;
+	return idmap_get(&mgr->by_fd, socket_fd);
 }
 
 int session_manager_epoll_add(SessionManager *mgr, int fd, uint32_t events) {
@@ -194,47 +246,286 @@ static SessionManager *g_session_manager = NULL;
 
 void session_manager_set_global(SessionManager *mgr) {
 	g_session_manager = mgr;
+	if (mgr) session_manager_register(mgr);
 }
 
 SessionManager *session_manager_get_global(void) {
+	if (tls_current_manager) return tls_current_manager;
 	return g_session_manager;
 }
 
-void session_manager_set_room(ClientSession *sess, int64_t room_id) {
-	if (sess) {
-		sess->room_id = room_id;
+int session_manager_register(SessionManager *mgr) {
+	if (!mgr) return -1;
+	session_manager_lock();
+	for (int i = 0; i < g_manager_count; i++) {
+		if (g_managers[i] == mgr) {
+			session_manager_unlock();
+			return 0;
+		}
+	}
+	if (g_manager_count >= MAX_SERVER_WORKERS) {
+		session_manager_unlock();
+		return -1;
 	}
+	g_managers[g_manager_count++] = mgr;
+	if (!g_session_manager) g_session_manager = mgr;
+	session_manager_unlock();
+	return 0;
 }
 
-ClientSession *session_manager_get_by_user_id(int64_t user_id) {
-	if (!g_session_manager || user_id <= 0) {
-		printf("[SESSION_MGR] get_by_user_id: g_session_manager=%p, user_id=%lld\n",
-		       (void*)g_session_manager, (long long)user_id);
-		fflush(stdout);
-		return NULL;
+void session_manager_unregister_all(void) {
+	session_manager_lock();
+	g_manager_count = 0;
+	g_session_manager = NULL;
+	session_manager_unlock();
+}
+
+void session_manager_set_current(SessionManager *mgr) {
+	tls_current_manager = mgr;
+}
+
+SessionManager *session_manager_get_current(void) {
+	return tls_current_manager;
+}
+
+void session_manager_lock(void) {
+	pthread_mutex_lock(&g_service_lock);
+}
+
+void session_manager_unlock(void) {
+	pthread_mutex_unlock(&g_service_lock);
+}
+
+void session_manager_wake(SessionManager *mgr) {
+	if (!mgr || mgr->wake_fd < 0) return;
+	uint64_t one = 1;
+	ssize_t n = write(mgr->wake_fd, &one, sizeof(one));
+	(void)n;  // EAGAIN means the counter is already non-zero
+}
+
+static void mailbox_push(SessionManager *mgr, MailboxItem *item) {
+	pthread_mutex_lock(&mgr->mailbox_lock);
+	int was_empty = (mgr->mailbox_head == NULL);
+	if (mgr->mailbox_tail) {
+		mgr->mailbox_tail->next = item;
+	} else {
+		mgr->mailbox_head = item;
 	}
-	
-	printf("[SESSION_MGR] Searching for user_id=%lld in %d sessions\n",
-	       (long long)user_id, g_session_manager->max_sessions);
-	fflush(stdout);
-	
-	for (int i = 0; i < g_session_manager->max_sessions; i++) {
-		if (g_session_manager->sessions[i]) {
-			printf("[SESSION_MGR] session[%d]: user_id=%lld, room_id=%lld\n",
-			       i, (long long)g_session_manager->sessions[i]->user_id,
-			       (long long)g_session_manager->sessions[i]->room_id);
-			fflush(stdout);
-			if (g_session_manager->sessions[i]->user_id == user_id) {
-				printf("[SESSION_MGR] Found session for user_id=%lld\n", (long long)user_id);
-				fflush(stdout);
-				return g_session_manager->sessions[i];
+	mgr->mailbox_tail = item;
+	pthread_mutex_unlock(&mgr->mailbox_lock);
+
+	// One wakeup per batch is enough, the owner drains the whole list
+	if (was_empty) session_manager_wake(mgr);
+}
+
+int session_manager_post_send(SessionManager *mgr, ClientSession *sess,
+                              const void *hdr, size_t hdr_len, SharedFrame *frame,
+                              int priority, int close_after) {
+	if (!mgr || !sess || sess->socket_fd < 0 || hdr_len > OUT_HEADER_MAX) return -1;
+
+	MailboxItem *item = malloc(sizeof(MailboxItem));
+	if (!item) return -1;
+	item->next = NULL;
+	item->call = NULL;
+	item->call_arg = NULL;
+	item->socket_fd = sess->socket_fd;
+	item->conn_id = sess->conn_id;
+	item->priority = priority;
+	item->close_after = close_after;
+	if (hdr_len) memcpy(item->hdr, hdr, hdr_len);
+	item->hdr_len = (uint8_t)hdr_len;
+	item->frame = frame;
+
+	// Until the owner delivers this, its own writes to sess queue behind it
+	__atomic_add_fetch(&sess->mailbox_pending, 1, __ATOMIC_RELAXED);
+	mailbox_push(mgr, item);
+	return 0;
+}
+
+int session_manager_post_call(SessionManager *mgr, void (*fn)(void *arg), void *arg) {
+	if (!mgr || !fn) return -1;
+
+	MailboxItem *item = calloc(1, sizeof(MailboxItem));
+	if (!item) return -1;
+	item->call = fn;
+	item->call_arg = arg;
+	item->socket_fd = -1;
+
+	mailbox_push(mgr, item);
+	return 0;
+}
+
+ClientSession *session_manager_find_conn(SessionManager *mgr, int socket_fd, uint64_t conn_id) {
+	ClientSession *sess = session_manager_get_by_fd(mgr, socket_fd);
+	// The fd may have been closed and reused by a newer connection
+	return (sess && sess->conn_id == conn_id) ? sess : NULL;
+}
+
+void session_ref_init(SessionRef *ref, ClientSession *sess) {
+	ref->mgr = sess->owner;
+	ref->sess = sess;
+	ref->socket_fd = sess->socket_fd;
+	ref->conn_id = sess->conn_id;
+}
+
+ClientSession *session_ref_get(const SessionRef *ref) {
+	if (!ref->mgr) return ref->sess;
+	return session_manager_find_conn(ref->mgr, ref->socket_fd, ref->conn_id);
+}
+
+// A handler's DB job, with the connection it holds back
+typedef struct {
+	SessionRef ref;
+	void (*run)(void *arg);
+	void (*done)(void *arg);
+	void *arg;
+} DbCall;
+
+static void db_call_run(void *arg) {
+	DbCall *call = arg;
+	call->run(call->arg);
+}
+
+static void db_call_done(void *arg) {
+	DbCall *call = arg;
+	if (call->done) call->done(call->arg);
+
+	// Last job done: let the owner dispatch the frames that waited for it
+	ClientSession *sess = session_ref_get(&call->ref);
+	if (sess && --sess->db_wait == 0 && sess->db_paused && sess->owner) {
+		sess->db_paused = 0;
+		sess->resume_queued = 1;
+		sess->resume_next = sess->owner->resume_head;
+		sess->owner->resume_head = sess;
+	}
+	free(call);
+}
+
+int session_manager_submit_db(ClientSession *sess, void (*run)(void *arg),
+                              void (*done)(void *arg), void *arg) {
+	if (!sess || !run) return -1;
+	DbCall *call = malloc(sizeof(DbCall));
+	if (!call) return -1;
+	session_ref_init(&call->ref, sess);
+	call->run = run;
+	call->done = done;
+	call->arg = arg;
+
+	// Negative keys never collide with the session_id keys of game writes
+	int64_t key = 0;
+	if (sess->owner) {
+		key = -(int64_t)(((uint64_t)(sess->owner->worker_id + 1) << 40) |
+		                 (sess->conn_id & ((1ULL << 40) - 1)));
+	}
+	sess->db_wait++;
+	if (db_pool_submit_keyed(key, db_call_run, db_call_done, call) != 0) {
+		sess->db_wait--;
+		free(call);
+		return -1;
+	}
+	return 0;
+}
+
+ClientSession *session_manager_pop_resumed(SessionManager *mgr) {
+	if (!mgr || !mgr->resume_head) return NULL;
+	ClientSession *sess = mgr->resume_head;
+	mgr->resume_head = sess->resume_next;
+	sess->resume_next = NULL;
+	sess->resume_queued = 0;
+	return sess;
+}
+
+void session_manager_drain_mailbox(SessionManager *mgr) {
+	if (!mgr) return;
+
+	uint64_t counter;
+	while (read(mgr->wake_fd, &counter, sizeof(counter)) > 0) {
+		// reset eventfd counter
+	}
+
+	pthread_mutex_lock(&mgr->mailbox_lock);
+	MailboxItem *item = mgr->mailbox_head;
+	mgr->mailbox_head = NULL;
+	mgr->mailbox_tail = NULL;
+	pthread_mutex_unlock(&mgr->mailbox_lock);
+
+	while (item) {
+		MailboxItem *next = item->next;
+		if (item->call) {
+			session_manager_lock();
+			item->call(item->call_arg);
+			session_manager_unlock();
+			free(item);
+			item = next;
+			continue;
+		}
+		ClientSession *sess = session_manager_find_conn(mgr, item->socket_fd, item->conn_id);
+		if (sess) {
+			// Delivered in posting order, ahead of later items for sess
+			__atomic_sub_fetch(&sess->mailbox_pending, 1, __ATOMIC_RELAXED);
+			mgr->draining = 1;
+			if (item->hdr_len || item->frame) {
+				client_session_sendv(sess, item->hdr, item->hdr_len,
+				                     item->frame ? item->frame->data : NULL,
+				                     item->frame ? item->frame->len : 0,
+				                     item->frame, item->priority);
 			}
+			if (item->close_after) {
+				client_session_close(sess);
+			}
+			mgr->draining = 0;
 		}
+		shared_frame_unref(item->frame);
+		free(item);
+		item = next;
+	}
+}
+
+static void room_unlink(ClientSession *sess) {
+	if (sess->room_prev) {
+		sess->room_prev->room_next = sess->room_next;
+	} else if (sess->room_next) {
+		idmap_put(&g_rooms, sess->room_id, sess->room_next);
+	} else {
+		idmap_remove(&g_rooms, sess->room_id);
+	}
+	if (sess->room_next) {
+		sess->room_next->room_prev = sess->room_prev;
+	}
+	sess->room_prev = NULL;
+	sess->room_next = NULL;
+}
+
+static void room_link(ClientSession *sess) {
+	ClientSession *head = idmap_get(&g_rooms, sess->room_id);
+	sess->room_prev = NULL;
+	sess->room_next = head;
+	if (head) head->room_prev = sess;
+	idmap_put(&g_rooms, sess->room_id, sess);
+}
+
+void session_manager_set_room(ClientSession *sess, int64_t room_id) {
+	if (!sess || sess->room_id == room_id) return;
+
+	// Only sessions owned by an event loop are indexed
+	if (sess->owner && sess->room_id > 0) room_unlink(sess);
+	sess->room_id = room_id;
+	if (sess->owner && room_id > 0) room_link(sess);
+}
+
+ClientSession *session_manager_get_by_user_id(int64_t user_id) {
+	if (user_id <= 0) return NULL;
+	return idmap_get(&g_by_user_id, user_id);
+}
+
+void session_manager_bind_user(ClientSession *sess, int64_t user_id) {
+	if (!sess) return;
+	unbind_user(sess);
+	sess->user_id = user_id;
+	// Sessions outside a manager (tests, debug helpers) are not indexed
+	if (user_id > 0 && sess->owner) {
+		idmap_put(&g_by_user_id, user_id, sess);
 	}
-	
-	printf("[SESSION_MGR] Not found session for user_id=%lld\n", (long long)user_id);
-	fflush(stdout);
-	return NULL;
 }
 
 int session_manager_send_to_user(int64_t user_id, uint16_t cmd, const char *json, uint32_t json_len) {
@@ -247,30 +538,26 @@ int session_manager_send_to_user(int64_t user_id, uint16_t cmd, const char *json
 }
 
 int session_manager_broadcast_to_room(int64_t room_id, uint16_t cmd, const char *json, uint32_t json_len) {
-	if (!g_session_manager || room_id <= 0) {
-		printf("[SESSION_MGR] broadcast_to_room: invalid params (room_id=%lld)\n", (long long)room_id);
-		fflush(stdout);
+	if (room_id <= 0) {
+		LOG_WARN(LOG_CAT_SESSION, "broadcast_to_room: invalid params (room_id=%lld)", (long long)room_id);
 		return 0;
 	}
 	
+	ClientSession *head = idmap_get(&g_rooms, room_id);
+	if (!head) return 0;
+
+	// Encode the payload once, every member queues a reference to it
+	SharedFrame *frame = protocol_frame_new(json, json_len);
+	if (!frame && json_len > 0) return 0;
+
 	int count = 0;
-	int total_sessions = 0;
-	for (int i = 0; i < g_session_manager->max_sessions; i++) {
-		if (g_session_manager->sessions[i]) {
-			total_sessions++;
-			if (g_session_manager->sessions[i]->room_id == room_id) {
-				printf("[SESSION_MGR] Broadcasting to session[%d]: user_id=%d, room_id=%lld\n",
-				       i, g_session_manager->sessions[i]->user_id, 
-				       (long long)g_session_manager->sessions[i]->room_id);
-				fflush(stdout);
-				protocol_send_response(g_session_manager->sessions[i], cmd, json, json_len);
-				count++;
-			}
-		}
+	for (ClientSession *sess = head; sess; sess = sess->room_next) {
+		protocol_send_frame(sess, cmd, frame);
+		count++;
 	}
-	printf("[SESSION_MGR] broadcast_to_room(room_id=%lld, cmd=0x%04x): sent to %d/%d sessions\n",
-	       (long long)room_id, cmd, count, total_sessions);
-	fflush(stdout);
+	shared_frame_unref(frame);
+	LOG_DEBUG(LOG_CAT_SESSION, "broadcast_to_room(room_id=%lld, cmd=0x%04x): sent to %d sessions",
+	       (long long)room_id, cmd, count);
 	return count;
 }
 
@@ -321,41 +608,27 @@ void session_manager_update_status(int64_t user_id, int status, int64_t room_id)
 	
 	sess->status = (UserStatus)status;
 	if (room_id > 0) {
-		sess->room_id = room_id;
+		session_manager_set_room(sess, room_id);
 	} else if (status == USER_STATUS_ONLINE) {
-		sess->room_id = 0;  // Clear room when back to online
+		session_manager_set_room(sess, 0);  // Clear room when back to online
 	}
 	
-	printf("[SESSION_MGR] Updated user %lld status to %d, room_id=%lld\n",
+	LOG_DEBUG(LOG_CAT_SESSION, "Updated user %lld status to %d, room_id=%lld",
 	       (long long)user_id, status, (long long)sess->room_id);
-	fflush(stdout);
 }
 
 // Broadcast friend status update
 void session_broadcast_friend_status(int64_t user_id) {
-	if (!g_session_manager) return;
+	if (g_manager_count == 0) return;
 	
 	// Get user's current status
 	const char *status_str = session_get_status_string(user_id);
 	ClientSession *user_sess = session_manager_get_by_user_id(user_id);
 	int64_t room_id = user_sess ? user_sess->room_id : 0;
 	
-	// Build JSON notification
-	char json[256];
-	snprintf(json, sizeof(json),
-		"{\"user_id\": %lld, \"status\": \"%s\", \"room_id\": %lld}",
-		(long long)user_id, status_str, (long long)room_id);
-	
-	printf("[SESSION_MGR] Broadcasting friend status for user %lld: %s\n",
+	LOG_DEBUG(LOG_CAT_SESSION, "Broadcasting friend status for user %lld: %s",
 	       (long long)user_id, status_str);
-	fflush(stdout);
 	
-	// Send to all online users (simplified - in production, filter by friends)
-	// TODO: Query dao_friends to get actual friends list
-	for (int i = 0; i < g_session_manager->max_sessions; i++) {
-		ClientSession *sess = g_session_manager->sessions[i];
-		if (sess && sess->user_id > 0 && sess->user_id != user_id) {
-			session_manager_send_to_user(sess->user_id, 0x0208, json, (uint32_t)strlen(json));
-		}
-	}
+	// Online friends only, coalesced and batched per recipient
+	presence_publish(user_id, status_str, room_id);
 }
\ No newline at end of file
@@ -4,11 +4,103 @@
 #include "service/client_session.h"
 #include "service/commands.h"
 #include "service/protocol.h"
+#include "service/session_manager.h"
 #include "dao/dao_stats.h"
 #include "dao/dao_users.h"
 #include "dao/dao_onevn.h"
 #include "service/stats_service.h"
+#include "service/leaderboard.h"
+#include "service/user_directory.h"
 #include "utils/json.h"
+#include "utils/log.h"
+#include "utils/strbuf.h"
+
+// Where to answer once an async DAO read completes
+typedef struct {
+    SessionRef ref;
+    uint16_t res_cmd;
+    const char *error_code;
+
+    // DB pool reads only
+    int (*read)(int64_t id, void **json);
+    int64_t id;
+    int rc;
+    char *json;
+} StatsReply;
+
+static StatsReply *stats_reply_new(ClientSession *sess, uint16_t res_cmd, const char *error_code) {
+    StatsReply *reply = malloc(sizeof(StatsReply));
+    if (!reply) return NULL;
+    session_ref_init(&reply->ref, sess);
+    reply->res_cmd = res_cmd;
+    reply->error_code = error_code;
+    reply->read = NULL;
+    reply->id = 0;
+    reply->rc = -1;
+    reply->json = NULL;
+    return reply;
+}
+
+// db_json_cb: runs on the session's event loop under the service lock
+static void stats_reply_json(int rc, char *json, void *arg) {
+    StatsReply *reply = arg;
+    ClientSession *sess = session_ref_get(&reply->ref);
+
+    if (sess) {
+        if (rc == 0 && json) {
+            protocol_send_response(sess, reply->res_cmd, json, strlen(json));
+        } else {
+            protocol_send_error(sess, reply->res_cmd, reply->error_code);
+        }
+    }
+    free(json);
+    free(reply);
+}
+
+// Start an async read; answers with error_code right away if it cannot start
+typedef int (*stats_async_read)(int64_t id, db_json_cb cb, void *arg);
+
+static void stats_read_async(ClientSession *sess, stats_async_read start, int64_t id,
+                             uint16_t res_cmd, const char *error_code) {
+    StatsReply *reply = stats_reply_new(sess, res_cmd, error_code);
+    if (!reply || start(id, stats_reply_json, reply) != 0) {
+        free(reply);
+        protocol_send_error(sess, res_cmd, error_code);
+    }
+}
+
+// db_job_fn pair for reads that run on the DB pool: the blocking DAO call
+// runs on an executor thread, the answer goes out from the client's loop
+static void stats_pool_read(void *arg) {
+    StatsReply *reply = arg;
+    reply->rc = reply->read(reply->id, (void **)&reply->json);
+}
+
+static void stats_pool_reply(void *arg) {
+    StatsReply *reply = arg;
+    stats_reply_json(reply->rc, reply->rc == 0 ? reply->json : NULL, reply);
+}
+
+// Heavy reads (history lists, replays) go to the pool so they neither wait
+// behind nor delay the quick lookups on the loop's own connection
+static void stats_read_pool(ClientSession *sess, int (*read)(int64_t id, void **json), int64_t id,
+                            uint16_t res_cmd, const char *error_code) {
+    StatsReply *reply = stats_reply_new(sess, res_cmd, error_code);
+    if (!reply) {
+        protocol_send_error(sess, res_cmd, error_code);
+        return;
+    }
+    reply->read = read;
+    reply->id = id;
+    if (session_manager_submit_db(sess, stats_pool_read, stats_pool_reply, reply) != 0) {
+        free(reply);
+        protocol_send_error(sess, res_cmd, error_code);
+    }
+}
+
+static int stats_leaderboard_async(int64_t limit, db_json_cb cb, void *arg) {
+    return dao_stats_get_leaderboard_async((int)limit, cb, arg);
+}
 
 // Giả sử payload JSON kiểu: { "user_id": 123 }
 // Còn nếu bạn store user_id trong session thì có thể bỏ đọc payload.
@@ -17,54 +109,86 @@ void stats_handle_get_profile(ClientSession *sess, uint16_t cmd, const char *pay
     int64_t user_id = sess->user_id; // hoặc parse từ payload
 
     if (user_id <= 0) {
-        fprintf(stderr, "[STATS] Invalid user_id: %ld\n", (long)user_id);
+        LOG_WARN(LOG_CAT_STATS, "Invalid user_id: %ld", (long)user_id);
         protocol_send_error(sess, CMD_RES_GET_PROFILE, "INVALID_USER_ID");
         return;
     }
 
-    fprintf(stderr, "[STATS] Getting profile for user_id: %ld\n", (long)user_id);
-    void *json_profile = NULL;
-    if (dao_stats_get_profile(user_id, &json_profile) != 0) {
-        fprintf(stderr, "[STATS] dao_stats_get_profile failed for user_id: %ld\n", (long)user_id);
-        protocol_send_error(sess, CMD_RES_GET_PROFILE, "GET_PROFILE_FAILED");
-        return;
+    LOG_DEBUG(LOG_CAT_STATS, "Getting profile for user_id: %ld", (long)user_id);
+    stats_read_async(sess, dao_stats_get_profile_async, user_id,
+                     CMD_RES_GET_PROFILE, "GET_PROFILE_FAILED");
+}
+
+// Payload (all optional): { "limit": 20, "around": 5 }
+void stats_handle_leaderboard(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
+    (void)cmd; (void)payload_len;
+    long long limit = LEADERBOARD_DEFAULT_LIMIT;
+    long long around = LEADERBOARD_DEFAULT_AROUND;
+    if (payload) {
+        JsonObject req;
+        util_json_parse(payload, &req);
+        util_json_obj_int64(&req, "limit", &limit);
+        util_json_obj_int64(&req, "around", &around);
     }
 
-    if (!json_profile) {
-        fprintf(stderr, "[STATS] json_profile is NULL\n");
-        protocol_send_error(sess, CMD_RES_GET_PROFILE, "GET_PROFILE_FAILED");
+    if (!leaderboard_is_loaded()) {
+        // Not seeded at startup: top list only, from the database
+        stats_read_async(sess, stats_leaderboard_async, LEADERBOARD_DEFAULT_LIMIT,
+                         CMD_RES_LEADERBOARD, "LEADERBOARD_FAILED");
         return;
     }
 
-    const char *json_str = (const char *)json_profile;
-    fprintf(stderr, "[STATS] Sending profile response: %s\n", json_str);
-    protocol_send_response(sess, CMD_RES_GET_PROFILE, json_str, strlen(json_str));
-    free(json_profile);
-}
-
-void stats_handle_leaderboard(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
-    (void)cmd; (void)payload; (void)payload_len;
-    void *json_leaderboard = NULL;
-    if (dao_stats_get_leaderboard(20, &json_leaderboard) != 0) {
+    char *json = leaderboard_json(sess->user_id, (int)limit, (int)around);
+    if (!json) {
         protocol_send_error(sess, CMD_RES_LEADERBOARD, "LEADERBOARD_FAILED");
         return;
     }
-    const char *json_str = (const char *)json_leaderboard;
-    protocol_send_response(sess, CMD_RES_LEADERBOARD, json_str, strlen(json_str));
-    free(json_leaderboard);
+    protocol_send_response(sess, CMD_RES_LEADERBOARD, json, strlen(json));
+    free(json);
 }
 
 void stats_handle_match_history(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
     (void)cmd; (void)payload; (void)payload_len;
-    int64_t user_id = sess->user_id;
-    void *json_history = NULL;
-    if (dao_stats_get_match_history(user_id, &json_history) != 0) {
-        protocol_send_error(sess, CMD_RES_MATCH_HISTORY, "MATCH_HISTORY_FAILED");
-        return;
+    stats_read_pool(sess, dao_stats_get_match_history, sess->user_id,
+                     CMD_RES_MATCH_HISTORY, "MATCH_HISTORY_FAILED");
+}
+
+// Avatar change: the UPDATE runs on the DB pool, the answer goes out from
+// the client's loop
+typedef struct {
+    SessionRef ref;
+    int64_t user_id;
+    char *avatar_path;
+    int rc;
+} AvatarJob;
+
+static void avatar_update_run(void *arg) {
+    AvatarJob *job = arg;
+    job->rc = dao_users_update_avatar(job->user_id, job->avatar_path);
+    if (job->rc == 0) user_directory_invalidate(job->user_id);
+}
+
+static void avatar_update_done(void *arg) {
+    AvatarJob *job = arg;
+    ClientSession *sess = session_ref_get(&job->ref);
+
+    if (job->rc != 0) {
+        LOG_ERROR(LOG_CAT_STATS, "dao_users_update_avatar failed for user_id: %ld", (long)job->user_id);
+        if (sess) protocol_send_error(sess, CMD_RES_UPDATE_AVATAR, "UPDATE_AVATAR_FAILED");
+    } else if (sess) {
+        // The path arrives decoded: escape it again for the response
+        char *esc_path = util_json_escape(job->avatar_path);
+        StrBuf response = STRBUF_INIT;
+        strbuf_appendf(&response, "{\"success\": true, \"avatar_path\": \"%s\"}",
+                       esc_path ? esc_path : "");
+        if (!response.failed) {
+            protocol_send_response(sess, CMD_RES_UPDATE_AVATAR, response.data, (uint32_t)response.len);
+        }
+        strbuf_free(&response);
+        free(esc_path);
     }
-    const char *json_str = (const char *)json_history;
-    protocol_send_response(sess, CMD_RES_MATCH_HISTORY, json_str, strlen(json_str));
-    free(json_history);
+    free(job->avatar_path);
+    free(job);
 }
 
 void stats_handle_update_avatar(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
@@ -72,7 +196,7 @@ void stats_handle_update_avatar(ClientSession *sess, uint16_t cmd, const char *p
     int64_t user_id = sess->user_id;
 
     if (user_id <= 0) {
-        fprintf(stderr, "[STATS] Invalid user_id: %ld\n", (long)user_id);
+        LOG_WARN(LOG_CAT_STATS, "Invalid user_id: %ld", (long)user_id);
         protocol_send_error(sess, CMD_RES_UPDATE_AVATAR, "INVALID_USER_ID");
         return;
     }
@@ -80,49 +204,49 @@ void stats_handle_update_avatar(ClientSession *sess, uint16_t cmd, const char *p
     // Parse JSON payload: { "avatar_path": "C:/path/to/image.jpg" }
     char *avatar_path = NULL;
     if (payload && payload_len > 0) {
-        avatar_path = util_json_get_string(payload, "avatar_path");
+        JsonObject req;
+        util_json_parse(payload, &req);
+        avatar_path = util_json_obj_string(&req, "avatar_path");
     }
 
     if (!avatar_path || strlen(avatar_path) == 0) {
-        fprintf(stderr, "[STATS] Invalid avatar_path in payload\n");
+        LOG_WARN(LOG_CAT_STATS, "Invalid avatar_path in payload");
         if (avatar_path) free(avatar_path);
         protocol_send_error(sess, CMD_RES_UPDATE_AVATAR, "INVALID_AVATAR_PATH");
         return;
     }
 
-    fprintf(stderr, "[STATS] Updating avatar for user_id: %ld, path: %s\n", (long)user_id, avatar_path);
+    LOG_DEBUG(LOG_CAT_STATS, "Updating avatar for user_id: %ld, path: %s", (long)user_id, avatar_path);
 
-    if (dao_users_update_avatar(user_id, avatar_path) != 0) {
-        fprintf(stderr, "[STATS] dao_users_update_avatar failed for user_id: %ld\n", (long)user_id);
+    AvatarJob *job = malloc(sizeof(AvatarJob));
+    if (!job) {
         free(avatar_path);
         protocol_send_error(sess, CMD_RES_UPDATE_AVATAR, "UPDATE_AVATAR_FAILED");
         return;
     }
-
-    // Send success response
-    char response[256];
-    snprintf(response, sizeof(response), "{\"success\": true, \"avatar_path\": \"%s\"}", avatar_path);
-    protocol_send_response(sess, CMD_RES_UPDATE_AVATAR, response, strlen(response));
-    free(avatar_path);
+    session_ref_init(&job->ref, sess);
+    job->user_id = user_id;
+    job->avatar_path = avatar_path;
+    job->rc = -1;
+    if (session_manager_submit_db(sess, avatar_update_run, avatar_update_done, job) != 0) {
+        free(job);
+        free(avatar_path);
+        protocol_send_error(sess, CMD_RES_UPDATE_AVATAR, "UPDATE_AVATAR_FAILED");
+    }
 }
 
 void stats_handle_get_onevn_history(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
     (void)cmd; (void)payload; (void)payload_len;
-    int64_t user_id = sess->user_id;
-    void *json_history = NULL;
-    if (dao_onevn_get_user_history(user_id, &json_history) != 0) {
-        protocol_send_error(sess, CMD_RES_GET_ONEVN_HISTORY, "ONEVN_HISTORY_FAILED");
-        return;
-    }
-    const char *json_str = (const char *)json_history;
-    protocol_send_response(sess, CMD_RES_GET_ONEVN_HISTORY, json_str, strlen(json_str));
-    free(json_history);
+    stats_read_pool(sess, dao_onevn_get_user_history, sess->user_id,
+                     CMD_RES_GET_ONEVN_HISTORY, "ONEVN_HISTORY_FAILED");
 }
 
 void stats_handle_get_replay_details(ClientSession *sess, uint16_t cmd, const char *payload, uint32_t payload_len) {
     (void)cmd;
     long long session_id_ll = 0;
-    util_json_get_int64(payload, "session_id", &session_id_ll);
+    JsonObject req;
+    util_json_parse(payload, &req);
+    util_json_obj_int64(&req, "session_id", &session_id_ll);
     int64_t session_id = (int64_t)session_id_ll;
     
     if (session_id <= 0) {
@@ -130,12 +254,7 @@ void stats_handle_get_replay_details(ClientSession *sess, uint16_t cmd, const ch
         return;
     }
     
-    void *json_replay = NULL;
-    if (dao_onevn_get_replay_details(session_id, &json_replay) != 0) {
-        protocol_send_error(sess, CMD_RES_GET_REPLAY_DETAILS, "REPLAY_DETAILS_FAILED");
-        return;
-    }
-    const char *json_str = (const char *)json_replay;
-    protocol_send_response(sess, CMD_RES_GET_REPLAY_DETAILS, json_str, strlen(json_str));
-    free(json_replay);
+    // One query on a pool connection; the loop keeps running meanwhile
+    stats_read_pool(sess, dao_onevn_get_replay_details, session_id,
+                     CMD_RES_GET_REPLAY_DETAILS, "REPLAY_DETAILS_FAILED");
 }
@@ -0,0 +1,189 @@
+// server/src/service/user_directory.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "service/user_directory.h"
+#include "dao/dao_users.h"
+#include "utils/idmap.h"
+#include "utils/json.h"
+#include "utils/log.h"
+
+typedef struct DirEntry {
+    int64_t user_id;
+    char *username_json;        // escaped, ready to put between quotes
+    char *avatar_json;
+    struct DirEntry *prev;      // LRU list, head = most recently used
+    struct DirEntry *next;
+} DirEntry;
+
+static struct {
+    pthread_mutex_t lock;
+    IdMap by_id;                // user_id -> DirEntry
+    int initialized;
+    DirEntry *head;
+    DirEntry *tail;
+} g_dir = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// ---- LRU list (caller holds g_dir.lock) -----------------------------------
+
+static void lru_unlink(DirEntry *e) {
+    if (e->prev) e->prev->next = e->next; else g_dir.head = e->next;
+    if (e->next) e->next->prev = e->prev; else g_dir.tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_front(DirEntry *e) {
+    e->prev = NULL;
+    e->next = g_dir.head;
+    if (g_dir.head) g_dir.head->prev = e;
+    g_dir.head = e;
+    if (!g_dir.tail) g_dir.tail = e;
+}
+
+static void entry_free(DirEntry *e) {
+    free(e->username_json);
+    free(e->avatar_json);
+    free(e);
+}
+
+static int dir_ensure_init_locked(void) {
+    if (g_dir.initialized) return 0;
+    if (idmap_init(&g_dir.by_id, 1024) != 0) return -1;
+    g_dir.initialized = 1;
+    return 0;
+}
+
+static void dir_remove_locked(DirEntry *e) {
+    idmap_remove(&g_dir.by_id, e->user_id);
+    lru_unlink(e);
+    entry_free(e);
+}
+
+// ---- public API ------------------------------------------------------------
+
+int user_directory_put(int64_t user_id, const char *username, const char *avatar_img) {
+    if (user_id <= 0 || !username) return -1;
+
+    // Escape outside the lock
+    DirEntry *e = calloc(1, sizeof(DirEntry));
+    if (!e) return -1;
+    e->user_id = user_id;
+    e->username_json = util_json_escape(username);
+    e->avatar_json = util_json_escape(avatar_img ? avatar_img : "");
+    if (!e->username_json || !e->avatar_json) {
+        entry_free(e);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_dir.lock);
+    if (dir_ensure_init_locked() != 0) {
+        pthread_mutex_unlock(&g_dir.lock);
+        entry_free(e);
+        return -1;
+    }
+
+    DirEntry *old = idmap_get(&g_dir.by_id, user_id);
+    if (old) dir_remove_locked(old);
+
+    if (idmap_put(&g_dir.by_id, user_id, e) != 0) {
+        pthread_mutex_unlock(&g_dir.lock);
+        entry_free(e);
+        return -1;
+    }
+    lru_push_front(e);
+
+    while (g_dir.by_id.count > USER_DIRECTORY_CAPACITY && g_dir.tail) {
+        dir_remove_locked(g_dir.tail);
+    }
+    pthread_mutex_unlock(&g_dir.lock);
+    return 0;
+}
+
+static void put_identity(int64_t user_id, const char *username, const char *avatar_img, void *arg) {
+    (void)arg;
+    user_directory_put(user_id, username, avatar_img);
+}
+
+int user_directory_prefetch(const int64_t *user_ids, int count) {
+    if (!user_ids || count <= 0) return 0;
+
+    int64_t *missing = malloc(sizeof(int64_t) * (size_t)count);
+    if (!missing) return -1;
+
+    int n = 0;
+    pthread_mutex_lock(&g_dir.lock);
+    for (int i = 0; i < count; i++) {
+        if (user_ids[i] <= 0) continue;
+        if (g_dir.initialized && idmap_get(&g_dir.by_id, user_ids[i])) continue;
+        missing[n++] = user_ids[i];
+    }
+    pthread_mutex_unlock(&g_dir.lock);
+
+    // Query without the lock; the callback takes it per row
+    int rc = 0;
+    if (n > 0) {
+        rc = dao_users_find_identities(missing, n, put_identity, NULL);
+        if (rc != 0) {
+            LOG_WARN(LOG_CAT_DB, "user directory: loading %d users failed", n);
+        }
+    }
+    free(missing);
+    return rc;
+}
+
+// Copy one field of user_id's entry into out; 1 if cached, 0 on a miss
+static int dir_copy(int64_t user_id, int want_avatar, char *out, size_t out_len) {
+    int found = 0;
+    pthread_mutex_lock(&g_dir.lock);
+    DirEntry *e = g_dir.initialized ? idmap_get(&g_dir.by_id, user_id) : NULL;
+    if (e) {
+        snprintf(out, out_len, "%s", want_avatar ? e->avatar_json : e->username_json);
+        lru_unlink(e);
+        lru_push_front(e);
+        found = 1;
+    }
+    pthread_mutex_unlock(&g_dir.lock);
+    return found;
+}
+
+static int dir_lookup(int64_t user_id, int want_avatar, char *out, size_t out_len) {
+    if (!out || out_len == 0) return -1;
+    out[0] = '\0';
+    if (user_id <= 0) return -1;
+
+    if (dir_copy(user_id, want_avatar, out, out_len)) return 0;
+
+    if (user_directory_prefetch(&user_id, 1) != 0) return -1;
+    return dir_copy(user_id, want_avatar, out, out_len) ? 0 : -1;
+}
+
+int user_directory_username_json(int64_t user_id, char *out, size_t out_len) {
+    return dir_lookup(user_id, 0, out, out_len);
+}
+
+int user_directory_avatar_json(int64_t user_id, char *out, size_t out_len) {
+    return dir_lookup(user_id, 1, out, out_len);
+}
+
+void user_directory_invalidate(int64_t user_id) {
+    pthread_mutex_lock(&g_dir.lock);
+    DirEntry *e = g_dir.initialized ? idmap_get(&g_dir.by_id, user_id) : NULL;
+    if (e) dir_remove_locked(e);
+    pthread_mutex_unlock(&g_dir.lock);
+}
+
+void user_directory_clear(void) {
+    pthread_mutex_lock(&g_dir.lock);
+    while (g_dir.head) {
+        DirEntry *e = g_dir.head;
+        g_dir.head = e->next;
+        entry_free(e);
+    }
+    g_dir.tail = NULL;
+    if (g_dir.initialized) {
+        idmap_free(&g_dir.by_id);
+        g_dir.initialized = 0;
+    }
+    pthread_mutex_unlock(&g_dir.lock);
+}
@@ -0,0 +1,65 @@
+// Unit test for utils/idmap (no DB needed)
+// Compile: make build/test_idmap
+#include <stdio.h>
+#include <stdint.h>
+#include "utils/idmap.h"
+
+#define N 50000
+
+static int failures = 0;
+
+static void check(int cond, const char *what) {
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+int main(void) {
+    IdMap map;
+    if (idmap_init(&map, 0) != 0) {
+        printf("idmap_init FAILED\n");
+        return 1;
+    }
+
+    // Values are never dereferenced, any non-NULL pointer will do
+    for (int64_t i = 1; i <= N; i++) {
+        idmap_put(&map, i * 7, (void *)(intptr_t)i);
+    }
+    check(map.count == N, "count after insert");
+
+    int found = 0;
+    for (int64_t i = 1; i <= N; i++) {
+        if (idmap_get(&map, i * 7) == (void *)(intptr_t)i) found++;
+    }
+    check(found == N, "get after insert");
+    check(idmap_get(&map, 3) == NULL, "get missing key");
+
+    // Remove every other key, the rest must stay reachable
+    for (int64_t i = 1; i <= N; i += 2) {
+        check(idmap_remove(&map, i * 7) == (void *)(intptr_t)i, "remove returns value");
+    }
+    found = 0;
+    int stale = 0;
+    for (int64_t i = 1; i <= N; i++) {
+        void *v = idmap_get(&map, i * 7);
+        if (i % 2 == 0 && v == (void *)(intptr_t)i) found++;
+        if (i % 2 == 1 && v != NULL) stale++;
+    }
+    check(found == N / 2, "remaining keys after remove");
+    check(stale == 0, "removed keys are gone");
+    check(map.count == N / 2, "count after remove");
+
+    // Replace keeps the count
+    idmap_put(&map, 14, (void *)(intptr_t)99);
+    check(idmap_get(&map, 14) == (void *)(intptr_t)99, "replace value");
+    check(map.count == N / 2, "count after replace");
+
+    idmap_free(&map);
+
+    if (failures == 0) {
+        printf("test_idmap OK\n");
+        return 0;
+    }
+    return 1;
+}
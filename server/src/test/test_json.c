@@ -0,0 +1,110 @@
+// Unit test for the request parser in utils/json (no DB needed)
+// Compile: make build/test_json
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/json.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *what) {
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static void check_string(const JsonObject *obj, const char *key, const char *expected, const char *what) {
+    char *s = util_json_obj_string(obj, key);
+    check(s && strcmp(s, expected) == 0, what);
+    free(s);
+}
+
+int main(void) {
+    JsonObject obj;
+
+    // Keys match exactly: not inside values, not as a suffix of other keys
+    const char *req = "{\"friend_id\": 7, \"note\": \"room_id: 99\", \"room_id\": 12, \"id\": 3}";
+    check(util_json_parse(req, &obj) == 0, "parse request");
+    check(obj.count == 4, "field count");
+    long long v = 0;
+    check(util_json_obj_int64(&obj, "room_id", &v) && v == 12, "room_id not taken from a string value");
+    check(util_json_obj_int64(&obj, "id", &v) && v == 3, "id not taken from friend_id");
+    check(!util_json_obj_int64(&obj, "missing", &v), "missing key");
+    check(!util_json_obj_int64(&obj, "note", &v), "string is not a number");
+
+    // Escapes are decoded
+    check(util_json_parse("{\"message\": \"a\\\"b\\\\c\\nd\\u00e9\\ud83d\\ude00\\/\"}", &obj) == 0,
+          "parse escapes");
+    check_string(&obj, "message", "a\"b\\c\nd\xc3\xa9\xf0\x9f\x98\x80/", "decode escapes");
+    check(util_json_parse("{\"message\": \"a\\u0000b\"}", &obj) == 0, "parse \\u0000");
+    check(util_json_obj_string(&obj, "message") == NULL, "reject embedded NUL");
+
+    // Numbers are validated
+    int i = 0;
+    double d = 0;
+    check(util_json_parse("{\"a\": -15, \"b\": 12.5, \"c\": 1e3, \"d\": 99999999999}", &obj) == 0,
+          "parse numbers");
+    check(util_json_obj_int(&obj, "a", &i) && i == -15, "negative int");
+    check(!util_json_obj_int(&obj, "b", &i), "fraction is not an int");
+    check(util_json_obj_double(&obj, "b", &d) && d == 12.5, "double");
+    check(util_json_obj_double(&obj, "c", &d) && d == 1000.0, "exponent");
+    check(!util_json_obj_int(&obj, "d", &i), "int out of range");
+    check(util_json_obj_int64(&obj, "d", &v) && v == 99999999999LL, "int64");
+    check(util_json_parse("{\"a\": 012}", &obj) != 0, "leading zero");
+    check(util_json_parse("{\"a\": 1.}", &obj) != 0, "missing fraction digits");
+    check(util_json_parse("{\"a\": 99999999999999999999}", &obj) == 0 &&
+          !util_json_obj_int64(&obj, "a", &v), "int64 overflow");
+
+    // Nested values are kept as spans; literals are typed
+    check(util_json_parse(" {\"ids\": [1, {\"x\": [true]}], \"ok\": false, \"n\": null} \n", &obj) == 0,
+          "parse nested");
+    const JsonField *f = util_json_find(&obj, "ids");
+    check(f && f->type == JSON_ARRAY && f->value_len == strlen("[1, {\"x\": [true]}]"), "array span");
+    f = util_json_find(&obj, "ok");
+    check(f && f->type == JSON_FALSE, "false literal");
+    f = util_json_find(&obj, "n");
+    check(f && f->type == JSON_NULL, "null literal");
+
+    // A repeated key keeps its first value
+    check(util_json_parse("{\"k\": 1, \"k\": 2}", &obj) == 0 && obj.count == 1 &&
+          util_json_obj_int64(&obj, "k", &v) && v == 1, "duplicate key");
+
+    // Invalid input leaves the object empty
+    const char *bad[] = {
+        "", "[]", "{", "{\"a\"}", "{\"a\": }", "{\"a\": 1,}", "{\"a\": 1} x",
+        "{\"a\": \"\\q\"}", "{\"a\": \"\\u12\"}", "{\"a\": tru}", "{a: 1}",
+        "{\"a\": \"line\nbreak\"}",
+    };
+    for (size_t k = 0; k < sizeof(bad) / sizeof(bad[0]); k++) {
+        int rc = util_json_parse(bad[k], &obj);
+        if (rc == 0 || obj.count != 0 || util_json_find(&obj, "a")) {
+            printf("FAILED: invalid input accepted: %s\n", bad[k]);
+            failures++;
+        }
+    }
+    check(util_json_parse(NULL, &obj) != 0, "NULL input");
+
+    // Deep nesting is refused rather than recursing without bound
+    char deep[256] = "{\"a\": ";
+    for (int k = 0; k < 40; k++) strcat(deep, "[");
+    for (int k = 0; k < 40; k++) strcat(deep, "]");
+    strcat(deep, "}");
+    check(util_json_parse(deep, &obj) != 0, "nesting limit");
+
+    // Field table limit
+    char many[2048] = "{";
+    for (int k = 0; k <= JSON_MAX_FIELDS; k++) {
+        char field[32];
+        snprintf(field, sizeof(field), "%s\"f%d\": %d", k ? ", " : "", k, k);
+        strcat(many, field);
+    }
+    strcat(many, "}");
+    check(util_json_parse(many, &obj) != 0, "too many fields");
+
+    if (failures == 0) {
+        printf("test_json OK\n");
+        return 0;
+    }
+    return 1;
+}
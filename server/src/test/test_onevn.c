@@ -11,7 +11,7 @@
 #include "db.h"
 #include "dao/dao_rooms.h"
 #include "dao/dao_onevn.h"
-#include "dao/dao_question.h"
+#include "service/question_bank.h"
 #include "dao/dao_stats.h"
 #include "dao/dao_users.h"
 #include "utils/json.h"
@@ -366,8 +366,8 @@ static void test_simulate_game(void) {
         }
         
         // Get random question
-        Question q;
-        if (dao_question_get_random(difficulty, &q) != 0) {
+        Question *q = NULL;
+        if (question_bank_draw(difficulty, &q, 1) != 1) {
             printf("❌ Không thể lấy câu hỏi %s\n", difficulty);
             break;
         }
@@ -377,11 +377,11 @@ static void test_simulate_game(void) {
         printf("║  ROUND %d/%d - %s                                    ║\n", 
                current_round, total_rounds, difficulty);
         printf("╚════════════════════════════════════════════════════════╝\n");
-        printf("\nCâu hỏi: %s\n", q.content);
-        printf("A. %s\n", q.op_a);
-        printf("B. %s\n", q.op_b);
-        printf("C. %s\n", q.op_c);
-        printf("D. %s\n", q.op_d);
+        printf("\nCâu hỏi: %s\n", q->content);
+        printf("A. %s\n", q->op_a);
+        printf("B. %s\n", q->op_b);
+        printf("C. %s\n", q->op_c);
+        printf("D. %s\n", q->op_d);
         printf("\n⏱️  Thời gian: 15 giây\n");
         
         // Simulate players answering
@@ -400,7 +400,7 @@ static void test_simulate_game(void) {
             double time_left = 10.0 + (rand() % 5); // 10-15 seconds
             
             // Check if correct
-            char correct_op = q.correct_op[0];
+            char correct_op = q->correct_op[0];
             int is_correct = (player_answer == correct_op);
             
             if (is_correct) {
@@ -431,6 +431,8 @@ static void test_simulate_game(void) {
             }
         }
         
+        question_release(q);
+        
         // Check if game should end
         if (active_players <= 1) {
             printf("\n⚠️  Chỉ còn %d người chơi còn lại. Kết thúc game!\n", active_players);
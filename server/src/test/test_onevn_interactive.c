@@ -45,7 +45,7 @@ static int kbhit(void) {
 #include "db.h"
 #include "dao/dao_rooms.h"
 #include "dao/dao_onevn.h"
-#include "dao/dao_question.h"
+#include "service/question_bank.h"
 
 // Interactive game simulation
 static void interactive_game_simulation(int64_t room_id, int easy_count, int medium_count, int hard_count) {
@@ -86,8 +86,8 @@ static void interactive_game_simulation(int64_t room_id, int easy_count, int med
         }
         
         // Get question
-        Question q;
-        if (dao_question_get_random(difficulty, &q) != 0) {
+        Question *q = NULL;
+        if (question_bank_draw(difficulty, &q, 1) != 1) {
             printf("❌ Không thể lấy câu hỏi\n");
             break;
         }
@@ -97,12 +97,14 @@ static void interactive_game_simulation(int64_t room_id, int easy_count, int med
         printf("║  ROUND %d/%d - %s                                    ║\n", 
                current_round, total_rounds, difficulty);
         printf("╚════════════════════════════════════════════════════════╝\n");
-        printf("\nCâu hỏi: %s\n", q.content);
-        printf("A. %s\n", q.op_a);
-        printf("B. %s\n", q.op_b);
-        printf("C. %s\n", q.op_c);
-        printf("D. %s\n", q.op_d);
+        printf("\nCâu hỏi: %s\n", q->content);
+        printf("A. %s\n", q->op_a);
+        printf("B. %s\n", q->op_b);
+        printf("C. %s\n", q->op_c);
+        printf("D. %s\n", q->op_d);
         printf("\n⏱️  Thời gian: 15 giây\n");
+        char correct_op = toupper(q->correct_op[0]);
+        question_release(q);
         printf("Đáp án của bạn (A/B/C/D, Q để thoát): ");
         fflush(stdout);
         
@@ -154,7 +156,6 @@ static void interactive_game_simulation(int64_t room_id, int easy_count, int med
         printf("%c\n", answer);
         
         // Check answer
-        char correct_op = toupper(q.correct_op[0]);
         time_t elapsed = time(NULL) - start_time;
         double time_left = 15.0 - elapsed;
         if (time_left < 0) time_left = 0;
@@ -6,7 +6,7 @@
 #include <time.h>
 #include "db.h"
 #include "service/quickmode_service.h"
-#include "dao/dao_question.h"
+#include "service/question_bank.h"
 #include "utils/timer.h"
 
 #define ANSWER_TIMEOUT 5  // 5 seconds
@@ -29,18 +29,20 @@ int main(void) {
     
     for (int round = 1; round <= 15; ++round) {
         const char *difficulty = (round <= 5) ? "EASY" : (round <= 10) ? "MEDIUM" : "HARD";
-        Question q;
-        if (dao_question_get_random(difficulty, &q) != 0) {
+        Question *q = NULL;
+        if (question_bank_draw(difficulty, &q, 1) != 1) {
             fprintf(stderr, "QM: failed to get question for difficulty=%s\n", difficulty);
             break;
         }
 
         printf("\n=== ROUND %d (%s) ===\n", round, difficulty);
-        printf("Q: %s\n", q.content);
-        printf("A: %s\n", q.op_a);
-        printf("B: %s\n", q.op_b);
-        printf("C: %s\n", q.op_c);
-        printf("D: %s\n", q.op_d);
+        printf("Q: %s\n", q->content);
+        printf("A: %s\n", q->op_a);
+        printf("B: %s\n", q->op_b);
+        printf("C: %s\n", q->op_c);
+        printf("D: %s\n", q->op_d);
+        char correct_op = q->correct_op[0];
+        question_release(q);
         printf("\n⏱️  Time: %d seconds\n", ANSWER_TIMEOUT);
         printf("Your answer (A/B/C/D): ");
         fflush(stdout);
@@ -88,7 +90,6 @@ answer_received:
         // Normalize
         if (ans >= 'a' && ans <= 'z') ans = ans - 'a' + 'A';
 
-        char correct_op = q.correct_op[0];
         if (correct_op >= 'a' && correct_op <= 'z') correct_op = correct_op - 'a' + 'A';
 
         if (ans == correct_op) {
@@ -0,0 +1,130 @@
+#include "utils/idmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IDMAP_MIN_CAPACITY 16
+
+// splitmix64 finalizer: spreads sequential ids over the whole table
+static size_t idmap_hash(int64_t key, size_t mask) {
+	uint64_t x = (uint64_t)key;
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (size_t)x & mask;
+}
+
+static size_t round_up_pow2(size_t n) {
+	size_t cap = IDMAP_MIN_CAPACITY;
+	while (cap < n) cap <<= 1;
+	return cap;
+}
+
+int idmap_init(IdMap *map, size_t initial_capacity) {
+	if (!map) return -1;
+	map->capacity = round_up_pow2(initial_capacity);
+	map->count = 0;
+	map->entries = calloc(map->capacity, sizeof(IdMapEntry));
+	if (!map->entries) {
+		map->capacity = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void idmap_free(IdMap *map) {
+	if (!map) return;
+	free(map->entries);
+	map->entries = NULL;
+	map->capacity = 0;
+	map->count = 0;
+}
+
+void idmap_clear(IdMap *map) {
+	if (!map || !map->entries) return;
+	memset(map->entries, 0, map->capacity * sizeof(IdMapEntry));
+	map->count = 0;
+}
+
+void *idmap_get(const IdMap *map, int64_t key) {
+	if (!map || !map->entries) return NULL;
+	size_t mask = map->capacity - 1;
+	size_t i = idmap_hash(key, mask);
+	while (map->entries[i].value) {
+		if (map->entries[i].key == key) return map->entries[i].value;
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+static int idmap_grow(IdMap *map) {
+	size_t new_cap = map->capacity ? map->capacity * 2 : IDMAP_MIN_CAPACITY;
+	IdMapEntry *entries = calloc(new_cap, sizeof(IdMapEntry));
+	if (!entries) return -1;
+
+	size_t mask = new_cap - 1;
+	for (size_t j = 0; j < map->capacity; j++) {
+		if (!map->entries[j].value) continue;
+		size_t i = idmap_hash(map->entries[j].key, mask);
+		while (entries[i].value) i = (i + 1) & mask;
+		entries[i] = map->entries[j];
+	}
+	free(map->entries);
+	map->entries = entries;
+	map->capacity = new_cap;
+	return 0;
+}
+
+int idmap_put(IdMap *map, int64_t key, void *value) {
+	if (!map || !value) return -1;
+	if ((map->count + 1) * 10 > map->capacity * 7) {
+		if (idmap_grow(map) < 0) return -1;
+	}
+
+	size_t mask = map->capacity - 1;
+	size_t i = idmap_hash(key, mask);
+	while (map->entries[i].value) {
+		if (map->entries[i].key == key) {
+			map->entries[i].value = value;
+			return 0;
+		}
+		i = (i + 1) & mask;
+	}
+	map->entries[i].key = key;
+	map->entries[i].value = value;
+	map->count++;
+	return 0;
+}
+
+void *idmap_remove(IdMap *map, int64_t key) {
+	if (!map || !map->entries) return NULL;
+	size_t mask = map->capacity - 1;
+	size_t i = idmap_hash(key, mask);
+	while (map->entries[i].value && map->entries[i].key != key) {
+		i = (i + 1) & mask;
+	}
+	if (!map->entries[i].value) return NULL;
+
+	void *old = map->entries[i].value;
+	map->count--;
+
+	// Backward-shift: pull later entries of the probe run into the hole
+	size_t hole = i;
+	size_t j = i;
+	while (1) {
+		j = (j + 1) & mask;
+		if (!map->entries[j].value) break;
+		size_t home = idmap_hash(map->entries[j].key, mask);
+		// Move j into hole unless its home lies cyclically in (hole, j]
+		int in_range = (hole <= j) ? (home > hole && home <= j)
+		                           : (home > hole || home <= j);
+		if (!in_range) {
+			map->entries[hole] = map->entries[j];
+			hole = j;
+		}
+	}
+	map->entries[hole].value = NULL;
+	map->entries[hole].key = 0;
+	return old;
+}
@@ -1,4 +1,6 @@
 #include "utils/json.h"
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -44,6 +46,323 @@ char *util_json_escape(const char *s) {
     return out;
 }
 
+// ---- Request payloads ------------------------------------------------------
+
+#define JSON_MAX_DEPTH 32
+#define JSON_INDEX_SIZE (JSON_MAX_FIELDS * 2)
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') ++p;
+    return p;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Four hex digits of a \u escape, or -1
+static int read_hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; ++i) {
+        int h = hex_value(p[i]);
+        if (h < 0) return -1;
+        v = (v << 4) | h;
+    }
+    return v;
+}
+
+// p is just past the opening quote. Returns the closing quote, or NULL.
+static const char *scan_string(const char *p) {
+    for (;;) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"') return p;
+        if (c == '\0' || c < 0x20) return NULL;
+        if (c != '\\') { ++p; continue; }
+        switch (p[1]) {
+            case '"': case '\\': case '/': case 'b':
+            case 'f': case 'n': case 'r': case 't':
+                p += 2;
+                break;
+            case 'u':
+                if (read_hex4(p + 2) < 0) return NULL;
+                p += 6;
+                break;
+            default:
+                return NULL;
+        }
+    }
+}
+
+// JSON number grammar. Returns the end, or NULL; *is_integer is set when
+// there is no fraction or exponent.
+static const char *scan_number(const char *p, int *is_integer) {
+    *is_integer = 1;
+    if (*p == '-') ++p;
+    if (*p == '0') {
+        ++p;
+    } else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') ++p;
+    } else {
+        return NULL;
+    }
+    if (*p == '.') {
+        *is_integer = 0;
+        ++p;
+        if (!(*p >= '0' && *p <= '9')) return NULL;
+        while (*p >= '0' && *p <= '9') ++p;
+    }
+    if (*p == 'e' || *p == 'E') {
+        *is_integer = 0;
+        ++p;
+        if (*p == '+' || *p == '-') ++p;
+        if (!(*p >= '0' && *p <= '9')) return NULL;
+        while (*p >= '0' && *p <= '9') ++p;
+    }
+    return p;
+}
+
+// Parse one value at p (no leading whitespace). Fills f->value/value_len/
+// type and returns the end of the value, or NULL.
+static const char *scan_value(const char *p, JsonField *f, int depth) {
+    if (depth > JSON_MAX_DEPTH) return NULL;
+    const char *start = p;
+    const char *end;
+    f->is_integer = 0;
+
+    switch (*p) {
+        case '"':
+            end = scan_string(p + 1);
+            if (!end) return NULL;
+            f->type = JSON_STRING;
+            f->value = p + 1;
+            f->value_len = (uint32_t)(end - (p + 1));
+            return end + 1;
+        case '{':
+        case '[': {
+            char close = *p == '{' ? '}' : ']';
+            JsonField inner;
+            p = skip_ws(p + 1);
+            if (*p != close) {
+                for (;;) {
+                    if (close == '}') {
+                        if (*p != '"') return NULL;
+                        p = scan_string(p + 1);
+                        if (!p) return NULL;
+                        p = skip_ws(p + 1);
+                        if (*p != ':') return NULL;
+                        p = skip_ws(p + 1);
+                    }
+                    p = scan_value(p, &inner, depth + 1);
+                    if (!p) return NULL;
+                    p = skip_ws(p);
+                    if (*p == close) break;
+                    if (*p != ',') return NULL;
+                    p = skip_ws(p + 1);
+                }
+            }
+            f->type = close == '}' ? JSON_OBJECT : JSON_ARRAY;
+            end = p + 1;
+            break;
+        }
+        case 't':
+            if (strncmp(p, "true", 4) != 0) return NULL;
+            f->type = JSON_TRUE;
+            end = p + 4;
+            break;
+        case 'f':
+            if (strncmp(p, "false", 5) != 0) return NULL;
+            f->type = JSON_FALSE;
+            end = p + 5;
+            break;
+        case 'n':
+            if (strncmp(p, "null", 4) != 0) return NULL;
+            f->type = JSON_NULL;
+            end = p + 4;
+            break;
+        default:
+            end = scan_number(p, &f->is_integer);
+            if (!end) return NULL;
+            f->type = JSON_NUMBER;
+            break;
+    }
+    f->value = start;
+    f->value_len = (uint32_t)(end - start);
+    return end;
+}
+
+// FNV-1a
+static size_t key_slot(const char *key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h & (JSON_INDEX_SIZE - 1);
+}
+
+static const JsonField *find_field(const JsonObject *obj, const char *key, size_t len) {
+    for (size_t slot = key_slot(key, len);; slot = (slot + 1) & (JSON_INDEX_SIZE - 1)) {
+        int i = obj->index[slot];
+        if (i == 0) return NULL;
+        const JsonField *f = &obj->fields[i - 1];
+        if (f->key_len == len && memcmp(f->key, key, len) == 0) return f;
+    }
+}
+
+int util_json_parse(const char *json, JsonObject *obj) {
+    if (!obj) return -1;
+    obj->count = 0;
+    memset(obj->index, 0, sizeof(obj->index));
+    if (!json) return -1;
+
+    const char *p = skip_ws(json);
+    if (*p != '{') return -1;
+    p = skip_ws(p + 1);
+    if (*p != '}') {
+        for (;;) {
+            if (*p != '"' || obj->count == JSON_MAX_FIELDS) goto fail;
+            JsonField *f = &obj->fields[obj->count];
+            const char *key_end = scan_string(p + 1);
+            if (!key_end) goto fail;
+            f->key = p + 1;
+            f->key_len = (uint32_t)(key_end - (p + 1));
+            p = skip_ws(key_end + 1);
+            if (*p != ':') goto fail;
+            p = scan_value(skip_ws(p + 1), f, 1);
+            if (!p) goto fail;
+
+            if (!find_field(obj, f->key, f->key_len)) {
+                size_t slot = key_slot(f->key, f->key_len);
+                while (obj->index[slot]) slot = (slot + 1) & (JSON_INDEX_SIZE - 1);
+                obj->index[slot] = (uint8_t)(++obj->count);
+            }
+
+            p = skip_ws(p);
+            if (*p == '}') break;
+            if (*p != ',') goto fail;
+            p = skip_ws(p + 1);
+        }
+    }
+    if (*skip_ws(p + 1) != '\0') goto fail;
+    return 0;
+
+fail:
+    obj->count = 0;
+    memset(obj->index, 0, sizeof(obj->index));
+    return -1;
+}
+
+const JsonField *util_json_find(const JsonObject *obj, const char *key) {
+    if (!obj || !key || obj->count == 0) return NULL;
+    return find_field(obj, key, strlen(key));
+}
+
+static size_t put_utf8(char *out, unsigned cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+char *util_json_obj_string(const JsonObject *obj, const char *key) {
+    const JsonField *f = util_json_find(obj, key);
+    if (!f || f->type != JSON_STRING) return NULL;
+
+    // Decoding never makes the text longer (\uXXXX is 6 bytes, UTF-8 at most 3,
+    // a surrogate pair 12 bytes for 4)
+    char *out = malloc(f->value_len + 1);
+    if (!out) return NULL;
+    const char *p = f->value;
+    const char *end = f->value + f->value_len;
+    size_t o = 0;
+    while (p < end) {
+        if (*p != '\\') {
+            out[o++] = *p++;
+            continue;
+        }
+        char c = p[1];
+        p += 2;
+        switch (c) {
+            case 'b': out[o++] = '\b'; break;
+            case 'f': out[o++] = '\f'; break;
+            case 'n': out[o++] = '\n'; break;
+            case 'r': out[o++] = '\r'; break;
+            case 't': out[o++] = '\t'; break;
+            case 'u': {
+                unsigned cp = (unsigned)read_hex4(p);
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF && p + 6 <= end && p[0] == '\\' && p[1] == 'u') {
+                    int lo = read_hex4(p + 2);
+                    if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + ((unsigned)lo - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (cp == 0) { free(out); return NULL; }
+                if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;  // lone surrogate
+                o += put_utf8(out + o, cp);
+                break;
+            }
+            default: out[o++] = c; break;   // " \ /
+        }
+    }
+    out[o] = '\0';
+    return out;
+}
+
+// Integer field into a long long; 0 on overflow or anything else
+static int field_integer(const JsonObject *obj, const char *key, long long *out) {
+    const JsonField *f = util_json_find(obj, key);
+    if (!f || f->type != JSON_NUMBER || !f->is_integer) return 0;
+    errno = 0;
+    long long v = strtoll(f->value, NULL, 10);
+    if (errno == ERANGE) return 0;
+    *out = v;
+    return 1;
+}
+
+int util_json_obj_int(const JsonObject *obj, const char *key, int *out) {
+    long long v;
+    if (!out || !field_integer(obj, key, &v) || v < INT_MIN || v > INT_MAX) return 0;
+    *out = (int)v;
+    return 1;
+}
+
+int util_json_obj_int64(const JsonObject *obj, const char *key, long long *out) {
+    long long v;
+    if (!out || !field_integer(obj, key, &v)) return 0;
+    *out = v;
+    return 1;
+}
+
+int util_json_obj_double(const JsonObject *obj, const char *key, double *out) {
+    const JsonField *f = util_json_find(obj, key);
+    if (!out || !f || f->type != JSON_NUMBER) return 0;
+    *out = strtod(f->value, NULL);
+    return 1;
+}
+
+// ---- Fragment scanning -----------------------------------------------------
+
 char *util_json_get_string(const char *json, const char *key) {
     if (!json || !key) return NULL;
     // find "key"
@@ -0,0 +1,315 @@
+// server/src/utils/log.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "utils/log.h"
+
+// Bounded multi-producer / single-consumer ring (per-slot sequence numbers,
+// Vyukov style): producers claim a slot with one CAS and publish it by
+// bumping its sequence, the writer thread consumes in order.
+#define LOG_RING_SIZE 4096             // power of two
+#define LOG_MSG_MAX 240
+#define LOG_OUT_BUF (64 * 1024)
+
+typedef struct {
+	size_t seq;
+	int64_t ts_ms;                     // CLOCK_REALTIME
+	uint8_t level;
+	uint8_t cat;
+	uint16_t len;
+	char text[LOG_MSG_MAX];
+} LogSlot;
+
+typedef struct {
+	LogSlot *slots;
+	size_t enqueue_pos;                // shared by producers
+	size_t dequeue_pos;                // writer thread only
+	uint64_t dropped;
+	int wake_fd;
+	int sleeping;                      // writer is (about to be) blocked on wake_fd
+	int stop;
+	int running;
+	pthread_t thread;
+} LogRing;
+
+unsigned char g_log_levels[LOG_CAT_COUNT] = {
+	[0 ... LOG_CAT_COUNT - 1] = LOG_LEVEL_INFO
+};
+
+static LogRing g_ring = { .wake_fd = -1 };
+
+static const char *const cat_names[LOG_CAT_COUNT] = {
+	[LOG_CAT_SERVER] = "SERVER",
+	[LOG_CAT_SESSION] = "SESSION",
+	[LOG_CAT_PROTOCOL] = "PROTOCOL",
+	[LOG_CAT_DISPATCHER] = "DISPATCHER",
+	[LOG_CAT_AUTH] = "AUTH",
+	[LOG_CAT_FRIENDS] = "FRIENDS",
+	[LOG_CAT_QUICKMODE] = "QM",
+	[LOG_CAT_ONEVN] = "ONEVN",
+	[LOG_CAT_STATS] = "STATS",
+	[LOG_CAT_DB] = "DB",
+};
+
+static const char *const level_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+static int64_t now_realtime_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// "HH:MM:SS.mmm LEVEL [CAT] text\n"; returns bytes written to out
+static size_t format_line(char *out, size_t cap, int64_t ts_ms, int level, int cat,
+                          const char *text, size_t len) {
+	time_t secs = (time_t)(ts_ms / 1000);
+	struct tm tm;
+	localtime_r(&secs, &tm);
+	int n = snprintf(out, cap, "%02d:%02d:%02d.%03d %-5s [%s] ",
+	                 tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(ts_ms % 1000),
+	                 level_names[level], cat_names[cat]);
+	if (n < 0) return 0;
+	size_t used = (size_t)n < cap ? (size_t)n : cap - 1;
+	if (len > cap - used - 1) len = cap - used - 1;
+	memcpy(out + used, text, len);
+	used += len;
+	out[used++] = '\n';
+	return used;
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n <= 0) return;
+		buf += n;
+		len -= (size_t)n;
+	}
+}
+
+static int parse_level(const char *s, size_t len) {
+	static const char *const names[] = { "debug", "info", "warn", "error", "off" };
+	for (int i = 0; i < 5; i++) {
+		if (strlen(names[i]) == len && strncasecmp(s, names[i], len) == 0) return i;
+	}
+	return -1;
+}
+
+static int parse_category(const char *s, size_t len) {
+	for (int i = 0; i < LOG_CAT_COUNT; i++) {
+		if (strlen(cat_names[i]) == len && strncasecmp(s, cat_names[i], len) == 0) return i;
+	}
+	return -1;
+}
+
+void log_set_level(LogCategory cat, int level) {
+	if ((int)cat < 0 || cat >= LOG_CAT_COUNT) return;
+	if (level < LOG_LEVEL_DEBUG) level = LOG_LEVEL_DEBUG;
+	if (level > LOG_LEVEL_OFF) level = LOG_LEVEL_OFF;
+	__atomic_store_n(&g_log_levels[cat], (unsigned char)level, __ATOMIC_RELAXED);
+}
+
+static void apply_spec(const char *spec) {
+	while (spec && *spec) {
+		const char *end = strchr(spec, ',');
+		size_t len = end ? (size_t)(end - spec) : strlen(spec);
+		const char *eq = memchr(spec, '=', len);
+		if (eq) {
+			int cat = parse_category(spec, (size_t)(eq - spec));
+			int level = parse_level(eq + 1, len - (size_t)(eq - spec) - 1);
+			if (cat >= 0 && level >= 0) log_set_level((LogCategory)cat, level);
+		} else {
+			int level = parse_level(spec, len);
+			if (level >= 0) {
+				for (int i = 0; i < LOG_CAT_COUNT; i++) log_set_level((LogCategory)i, level);
+			}
+		}
+		spec = end ? end + 1 : NULL;
+	}
+}
+
+// Writer side: take the next published slot, or NULL if the ring is empty
+static LogSlot *ring_peek(void) {
+	LogSlot *slot = &g_ring.slots[g_ring.dequeue_pos & (LOG_RING_SIZE - 1)];
+	size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	return (seq == g_ring.dequeue_pos + 1) ? slot : NULL;
+}
+
+static void ring_release(LogSlot *slot) {
+	__atomic_store_n(&slot->seq, g_ring.dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+	g_ring.dequeue_pos++;
+}
+
+static void *log_writer_main(void *arg) {
+	(void)arg;
+	char *out = malloc(LOG_OUT_BUF);
+	char *err = malloc(LOG_OUT_BUF);
+	if (!out || !err) {
+		free(out);
+		free(err);
+		return NULL;
+	}
+
+	for (;;) {
+		size_t out_len = 0, err_len = 0;
+		LogSlot *slot;
+		while ((slot = ring_peek()) != NULL) {
+			int to_err = slot->level >= LOG_LEVEL_WARN;
+			char *buf = to_err ? err : out;
+			size_t *len = to_err ? &err_len : &out_len;
+			if (LOG_OUT_BUF - *len < LOG_MSG_MAX + 64) {
+				write_all(to_err ? STDERR_FILENO : STDOUT_FILENO, buf, *len);
+				*len = 0;
+			}
+			*len += format_line(buf + *len, LOG_OUT_BUF - *len, slot->ts_ms,
+			                    slot->level, slot->cat, slot->text, slot->len);
+			ring_release(slot);
+		}
+
+		uint64_t dropped = __atomic_exchange_n(&g_ring.dropped, 0, __ATOMIC_RELAXED);
+		if (dropped > 0) {
+			char note[64];
+			int n = snprintf(note, sizeof(note), "dropped %llu messages (ring full)",
+			                 (unsigned long long)dropped);
+			err_len += format_line(err + err_len, LOG_OUT_BUF - err_len, now_realtime_ms(),
+			                       LOG_LEVEL_WARN, LOG_CAT_SERVER, note, (size_t)n);
+		}
+		if (out_len) write_all(STDOUT_FILENO, out, out_len);
+		if (err_len) write_all(STDERR_FILENO, err, err_len);
+
+		if (__atomic_load_n(&g_ring.stop, __ATOMIC_ACQUIRE)) {
+			if (ring_peek()) continue;   // drain what was queued before stop
+			break;
+		}
+
+		// Announce that we are going to sleep, then re-check so a message
+		// published in between is not missed (paired with log_write)
+		__atomic_store_n(&g_ring.sleeping, 1, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (ring_peek() || __atomic_load_n(&g_ring.stop, __ATOMIC_ACQUIRE)) {
+			__atomic_store_n(&g_ring.sleeping, 0, __ATOMIC_RELAXED);
+			continue;
+		}
+		uint64_t v;
+		if (read(g_ring.wake_fd, &v, sizeof(v)) < 0) {
+			// Interrupted: just loop and look at the ring again
+		}
+		__atomic_store_n(&g_ring.sleeping, 0, __ATOMIC_RELAXED);
+	}
+
+	free(out);
+	free(err);
+	return NULL;
+}
+
+int log_init(const char *spec) {
+	apply_spec(spec);
+	if (g_ring.running) return 0;
+
+	g_ring.slots = calloc(LOG_RING_SIZE, sizeof(LogSlot));
+	if (!g_ring.slots) return -1;
+	for (size_t i = 0; i < LOG_RING_SIZE; i++) g_ring.slots[i].seq = i;
+	g_ring.enqueue_pos = 0;
+	g_ring.dequeue_pos = 0;
+	g_ring.dropped = 0;
+	g_ring.stop = 0;
+	g_ring.sleeping = 0;
+
+	g_ring.wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (g_ring.wake_fd < 0) goto fail;
+	if (pthread_create(&g_ring.thread, NULL, log_writer_main, NULL) != 0) goto fail;
+
+	__atomic_store_n(&g_ring.running, 1, __ATOMIC_RELEASE);
+	return 0;
+
+fail:
+	if (g_ring.wake_fd >= 0) close(g_ring.wake_fd);
+	g_ring.wake_fd = -1;
+	free(g_ring.slots);
+	g_ring.slots = NULL;
+	return -1;
+}
+
+void log_shutdown(void) {
+	if (!__atomic_load_n(&g_ring.running, __ATOMIC_ACQUIRE)) return;
+
+	// Later messages go the synchronous path
+	__atomic_store_n(&g_ring.running, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_ring.stop, 1, __ATOMIC_RELEASE);
+	uint64_t one = 1;
+	if (write(g_ring.wake_fd, &one, sizeof(one)) < 0) {
+		// eventfd counter cannot overflow here
+	}
+	pthread_join(g_ring.thread, NULL);
+
+	close(g_ring.wake_fd);
+	g_ring.wake_fd = -1;
+	free(g_ring.slots);
+	g_ring.slots = NULL;
+}
+
+void log_write(LogCategory cat, int level, const char *fmt, ...) {
+	if ((int)cat < 0 || cat >= LOG_CAT_COUNT) return;
+	if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_ERROR) return;
+
+	char text[LOG_MSG_MAX];
+	va_list ap;
+	va_start(ap, fmt);
+	int n = vsnprintf(text, sizeof(text), fmt, ap);
+	va_end(ap);
+	if (n < 0) return;
+	size_t len = (size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1;
+	while (len > 0 && text[len - 1] == '\n') len--;
+
+	if (!__atomic_load_n(&g_ring.running, __ATOMIC_ACQUIRE)) {
+		// No writer thread: write the line directly
+		char line[LOG_MSG_MAX + 64];
+		size_t line_len = format_line(line, sizeof(line), now_realtime_ms(), level, cat, text, len);
+		FILE *stream = level >= LOG_LEVEL_WARN ? stderr : stdout;
+		fwrite(line, 1, line_len, stream);
+		fflush(stream);
+		return;
+	}
+
+	// Claim a slot; give up (and count the drop) if the writer is behind
+	size_t pos = __atomic_load_n(&g_ring.enqueue_pos, __ATOMIC_RELAXED);
+	LogSlot *slot;
+	for (;;) {
+		slot = &g_ring.slots[pos & (LOG_RING_SIZE - 1)];
+		size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&g_ring.enqueue_pos, &pos, pos + 1, 1,
+			                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			__atomic_fetch_add(&g_ring.dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&g_ring.enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->ts_ms = now_realtime_ms();
+	slot->level = (uint8_t)level;
+	slot->cat = (uint8_t)cat;
+	slot->len = (uint16_t)len;
+	memcpy(slot->text, text, len);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	// Only pay for the wakeup syscall when the writer is asleep
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&g_ring.sleeping, __ATOMIC_RELAXED) &&
+	    __atomic_exchange_n(&g_ring.sleeping, 0, __ATOMIC_SEQ_CST)) {
+		uint64_t one = 1;
+		if (write(g_ring.wake_fd, &one, sizeof(one)) < 0) {
+			// The writer will pick the message up on its next wakeup
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#include "utils/strbuf.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRBUF_MIN_CAPACITY 256
+
+void strbuf_init(StrBuf *sb) {
+	sb->data = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+	sb->failed = 0;
+}
+
+void strbuf_free(StrBuf *sb) {
+	free(sb->data);
+	strbuf_init(sb);
+}
+
+void strbuf_reset(StrBuf *sb) {
+	sb->len = 0;
+	sb->failed = 0;
+	if (sb->data) sb->data[0] = '\0';
+}
+
+// Make room for n more bytes plus the terminator
+static int strbuf_reserve(StrBuf *sb, size_t n) {
+	if (sb->failed) return -1;
+	if (sb->len + n < sb->cap) return 0;
+	size_t cap = sb->cap ? sb->cap : STRBUF_MIN_CAPACITY;
+	while (cap <= sb->len + n) cap *= 2;
+	char *p = realloc(sb->data, cap);
+	if (!p) {
+		sb->failed = 1;
+		return -1;
+	}
+	sb->data = p;
+	sb->cap = cap;
+	return 0;
+}
+
+void strbuf_append(StrBuf *sb, const char *s, size_t n) {
+	if (strbuf_reserve(sb, n) != 0) return;
+	memcpy(sb->data + sb->len, s, n);
+	sb->len += n;
+	sb->data[sb->len] = '\0';
+}
+
+void strbuf_appends(StrBuf *sb, const char *s) {
+	strbuf_append(sb, s, strlen(s));
+}
+
+void strbuf_appendf(StrBuf *sb, const char *fmt, ...) {
+	if (sb->failed) return;
+	va_list ap;
+	va_start(ap, fmt);
+	int need = vsnprintf(sb->data ? sb->data + sb->len : NULL,
+	                     sb->data ? sb->cap - sb->len : 0, fmt, ap);
+	va_end(ap);
+	if (need < 0) {
+		sb->failed = 1;
+		return;
+	}
+	if (sb->data && sb->len + (size_t)need < sb->cap) {
+		sb->len += (size_t)need;
+		return;
+	}
+
+	// Did not fit: grow and format again
+	if (strbuf_reserve(sb, (size_t)need) != 0) return;
+	va_start(ap, fmt);
+	vsnprintf(sb->data + sb->len, sb->cap - sb->len, fmt, ap);
+	va_end(ap);
+	sb->len += (size_t)need;
+}
+
+char *strbuf_detach(StrBuf *sb) {
+	char *s = sb->failed ? NULL : sb->data;
+	if (!s && !sb->failed) s = calloc(1, 1);
+	if (sb->failed) free(sb->data);
+	strbuf_init(sb);
+	return s;
+}
@@ -2,22 +2,11 @@
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 #include "utils/timer.h"
-
-// Simple timer struct for callback-based timers
-typedef struct {
-    int timer_id;
-    time_t start_time;
-    int timeout_seconds;
-    int64_t context_id;
-    timer_callback_t callback;
-    void *user_data;
-    int active;
-} CallbackTimer;
-
-#define MAX_CALLBACK_TIMERS 100
-static CallbackTimer callback_timers[MAX_CALLBACK_TIMERS];
-static int next_timer_id = 1;
+#include "utils/idmap.h"
 
 Timer timer_init(int timeout_seconds) {
     Timer t;
@@ -43,62 +32,327 @@ void timer_reset(Timer *timer) {
     timer->start_time = time(NULL);
 }
 
-// Callback-based timer functions (game_timer_* to avoid conflict with POSIX timer_create)
-int game_timer_create(int timeout_seconds, int64_t context_id, timer_callback_t callback, void *user_data) {
-    if (!callback) return -1;
-    
-    // Find free slot
-    for (int i = 0; i < MAX_CALLBACK_TIMERS; i++) {
-        if (!callback_timers[i].active) {
-            callback_timers[i].timer_id = next_timer_id++;
-            callback_timers[i].start_time = time(NULL);
-            callback_timers[i].timeout_seconds = timeout_seconds;
-            callback_timers[i].context_id = context_id;
-            callback_timers[i].callback = callback;
-            callback_timers[i].user_data = user_data;
-            callback_timers[i].active = 1;
-            return callback_timers[i].timer_id;
-        }
+// ========== Callback timers: hashed hierarchical timing wheel ==========
+//
+// One tick = 1 ms of CLOCK_MONOTONIC. Four levels of 256 slots cover
+// 256 ms, 65.5 s, 4.6 h and 49.7 days; a timer sits in the level matching
+// how far away it is and is cascaded down as the wheel turns, so create,
+// cancel and fire are O(1). A timerfd is armed for the next deadline (or
+// the next cascade) so the event loop sleeps exactly that long.
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 8
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_MAX_DELTA ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+#define LEVEL_NONE 0xFF
+
+typedef struct TimerNode {
+    struct TimerNode *prev;
+    struct TimerNode *next;
+    uint64_t expires;          // absolute tick (ms)
+    int timer_id;
+    uint8_t level;             // LEVEL_NONE while detached for firing
+    uint8_t slot;
+    int64_t context_id;
+    timer_callback_t callback;
+    void *user_data;
+} TimerNode;
+
+typedef struct {
+    TimerNode slots[WHEEL_LEVELS][WHEEL_SIZE];   // circular list sentinels
+    uint64_t occupied[WHEEL_LEVELS][WHEEL_SIZE / 64];
+    uint64_t current;          // last processed tick
+    int initialized;
+    int count;
+    int timer_fd;
+    IdMap by_id;               // timer_id -> node, for O(1) cancel
+} TimerWheel;
+
+static TimerWheel wheel = { .timer_fd = -1 };
+static int next_timer_id = 1;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void list_init(TimerNode *head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static int list_empty(const TimerNode *head) {
+    return head->next == head;
+}
+
+static void list_append(TimerNode *head, TimerNode *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void list_unlink(TimerNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = node;
+}
+
+static void wheel_init(void) {
+    if (wheel.initialized) return;
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        for (int s = 0; s < WHEEL_SIZE; s++) list_init(&wheel.slots[l][s]);
     }
-    return -1; // No free slots
+    memset(wheel.occupied, 0, sizeof(wheel.occupied));
+    wheel.current = now_ms();
+    wheel.count = 0;
+    idmap_init(&wheel.by_id, 64);
+    wheel.initialized = 1;
 }
 
-void game_timer_cancel(int timer_id) {
-    if (timer_id < 0) return;
-    
-    for (int i = 0; i < MAX_CALLBACK_TIMERS; i++) {
-        if (callback_timers[i].active && callback_timers[i].timer_id == timer_id) {
-            callback_timers[i].active = 0;
-            return;
+static void wheel_place(TimerNode *node) {
+    uint64_t delta = node->expires > wheel.current ? node->expires - wheel.current : 0;
+    uint64_t at = node->expires;
+    if (delta > WHEEL_MAX_DELTA) {
+        // Beyond the wheel: park in the farthest slot, re-placed on cascade
+        delta = WHEEL_MAX_DELTA;
+        at = wheel.current + WHEEL_MAX_DELTA;
+    }
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int slot = (int)((at >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+    node->level = (uint8_t)level;
+    node->slot = (uint8_t)slot;
+    list_append(&wheel.slots[level][slot], node);
+    wheel.occupied[level][slot >> 6] |= 1ULL << (slot & 63);
+}
+
+static void wheel_remove(TimerNode *node) {
+    int level = node->level;
+    int slot = node->slot;
+    list_unlink(node);
+    if (level != LEVEL_NONE && list_empty(&wheel.slots[level][slot])) {
+        wheel.occupied[level][slot >> 6] &= ~(1ULL << (slot & 63));
+    }
+}
+
+// Move every timer of a slot to the level matching its remaining time
+static void wheel_cascade(int level, int slot) {
+    TimerNode *head = &wheel.slots[level][slot];
+    TimerNode pending;
+    list_init(&pending);
+    while (!list_empty(head)) {
+        TimerNode *node = head->next;
+        list_unlink(node);
+        list_append(&pending, node);
+    }
+    wheel.occupied[level][slot >> 6] &= ~(1ULL << (slot & 63));
+
+    while (!list_empty(&pending)) {
+        TimerNode *node = pending.next;
+        list_unlink(node);
+        wheel_place(node);
+    }
+}
+
+// First occupied slot at or after start, wrapping around; -1 if none
+static int next_occupied(const uint64_t bits[WHEEL_SIZE / 64], int start) {
+    const int words = WHEEL_SIZE / 64;
+    for (int n = 0; n <= words; n++) {
+        int w = ((start >> 6) + n) % words;
+        uint64_t word = bits[w];
+        if (n == 0) {
+            word &= ~0ULL << (start & 63);
+        } else if (n == words) {
+            word &= (start & 63) ? ((1ULL << (start & 63)) - 1) : 0;
         }
+        if (word) return (w << 6) + __builtin_ctzll(word);
+    }
+    return -1;
+}
+
+// Tick at which the wheel next has work: an exact deadline on level 0,
+// otherwise the moment the nearest occupied higher-level slot cascades.
+static int wheel_next_tick(uint64_t *out) {
+    if (wheel.count == 0) return 0;
+
+    uint64_t best = UINT64_MAX;
+    int s = next_occupied(wheel.occupied[0], (int)((wheel.current + 1) & WHEEL_MASK));
+    if (s >= 0) {
+        uint64_t d = (uint64_t)((s - (int)(wheel.current & WHEEL_MASK)) & WHEEL_MASK);
+        best = wheel.current + (d ? d : WHEEL_SIZE);
+    }
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        uint64_t base = wheel.current >> shift;
+        s = next_occupied(wheel.occupied[level], (int)((base + 1) & WHEEL_MASK));
+        if (s < 0) continue;
+        uint64_t d = (uint64_t)((s - (int)(base & WHEEL_MASK)) & WHEEL_MASK);
+        uint64_t tick = (base + (d ? d : WHEEL_SIZE)) << shift;
+        if (tick < best) best = tick;
+    }
+    *out = best;
+    return best != UINT64_MAX;
+}
+
+// Arm the timerfd for the next tick with work (or disarm it)
+static void wheel_rearm(void) {
+    if (wheel.timer_fd < 0) return;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    uint64_t tick;
+    if (wheel_next_tick(&tick)) {
+        // it_value == 0 would disarm, so never arm for tick 0
+        if (tick == 0) tick = 1;
+        its.it_value.tv_sec = (time_t)(tick / 1000);
+        its.it_value.tv_nsec = (long)(tick % 1000) * 1000000L;
+    }
+    timerfd_settime(wheel.timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int game_timer_get_fd(void) {
+    wheel_init();
+    if (wheel.timer_fd < 0) {
+        wheel.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        wheel_rearm();
+    }
+    return wheel.timer_fd;
+}
+
+int game_timer_create_ms(int timeout_ms, int64_t context_id, timer_callback_t callback, void *user_data) {
+    if (!callback) return -1;
+    wheel_init();
+    if (timeout_ms < 0) timeout_ms = 0;
+
+    TimerNode *node = calloc(1, sizeof(TimerNode));
+    if (!node) return -1;
+
+    // Ids are small positive ints; skip any still in use after wrapping
+    do {
+        node->timer_id = next_timer_id;
+        next_timer_id = (next_timer_id == INT_MAX) ? 1 : next_timer_id + 1;
+    } while (idmap_get(&wheel.by_id, node->timer_id));
+
+    // Deadlines are relative to the real clock, not the last processed tick
+    uint64_t now = now_ms();
+    if (now < wheel.current) now = wheel.current;
+    node->expires = now + (uint64_t)timeout_ms;
+    if (node->expires <= wheel.current) node->expires = wheel.current + 1;
+    node->context_id = context_id;
+    node->callback = callback;
+    node->user_data = user_data;
+
+    if (idmap_put(&wheel.by_id, node->timer_id, node) < 0) {
+        free(node);
+        return -1;
     }
+    wheel_place(node);
+    wheel.count++;
+    wheel_rearm();
+    return node->timer_id;
+}
+
+// Callback-based timer functions (game_timer_* to avoid conflict with POSIX timer_create)
+int game_timer_create(int timeout_seconds, int64_t context_id, timer_callback_t callback, void *user_data) {
+    if (timeout_seconds > INT_MAX / 1000) timeout_seconds = INT_MAX / 1000;
+    return game_timer_create_ms(timeout_seconds * 1000, context_id, callback, user_data);
+}
+
+void game_timer_cancel(int timer_id) {
+    if (timer_id <= 0 || !wheel.initialized) return;
+
+    TimerNode *node = idmap_remove(&wheel.by_id, timer_id);
+    if (!node) return;
+    wheel_remove(node);
+    wheel.count--;
+    free(node);
+    // A cancelled timer may only make the timerfd fire early, which is
+    // harmless; skip the syscall and let the next run re-arm it.
 }
 
 void game_timer_check_and_run(void) {
-    time_t now = time(NULL);
-    
-    for (int i = 0; i < MAX_CALLBACK_TIMERS; i++) {
-        if (!callback_timers[i].active) continue;
-        
-        int elapsed = (int)(now - callback_timers[i].start_time);
-        if (elapsed >= callback_timers[i].timeout_seconds) {
-            // Timer expired, call callback
-            timer_callback_t cb = callback_timers[i].callback;
-            int64_t ctx_id = callback_timers[i].context_id;
-            void *user_data = callback_timers[i].user_data;
-            
-            // Mark as inactive before calling callback (in case callback cancels it)
-            callback_timers[i].active = 0;
-            
+    wheel_init();
+    uint64_t now = now_ms();
+
+    if (wheel.count == 0) {
+        // Nothing scheduled: jump straight to the present
+        if (now > wheel.current) wheel.current = now;
+        wheel_rearm();
+        return;
+    }
+
+    while (wheel.current < now) {
+        wheel.current++;
+        int slot = (int)(wheel.current & WHEEL_MASK);
+
+        // Entering a new lap of a level: pull the matching higher slot down
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (wheel.current & ((1ULL << (WHEEL_BITS * level)) - 1)) break;
+            wheel_cascade(level, (int)((wheel.current >> (WHEEL_BITS * level)) & WHEEL_MASK));
+        }
+
+        TimerNode *head = &wheel.slots[0][slot];
+        if (list_empty(head)) continue;
+
+        // Detach the expired slot; callbacks may create or cancel timers
+        TimerNode expired;
+        list_init(&expired);
+        while (!list_empty(head)) {
+            TimerNode *node = head->next;
+            list_unlink(node);
+            node->level = LEVEL_NONE;
+            list_append(&expired, node);
+        }
+        wheel.occupied[0][slot >> 6] &= ~(1ULL << (slot & 63));
+
+        while (!list_empty(&expired)) {
+            TimerNode *node = expired.next;
+            list_unlink(node);
+            idmap_remove(&wheel.by_id, node->timer_id);
+            wheel.count--;
+
+            timer_callback_t cb = node->callback;
+            int64_t ctx_id = node->context_id;
+            void *user_data = node->user_data;
+            free(node);
+
             // Call callback
             if (cb) {
                 cb(ctx_id, user_data);
             }
         }
+        if (wheel.count == 0) {
+            wheel.current = now;
+            break;
+        }
     }
+
+    wheel_rearm();
 }
 
 void game_timer_cleanup(void) {
-    // Remove inactive timers (already handled in game_timer_check_and_run)
-    // This function can be used for additional cleanup if needed
+    if (!wheel.initialized) return;
+
+    // Drop every pending timer without running it
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        for (int s = 0; s < WHEEL_SIZE; s++) {
+            TimerNode *head = &wheel.slots[l][s];
+            while (!list_empty(head)) {
+                TimerNode *node = head->next;
+                list_unlink(node);
+                free(node);
+            }
+        }
+    }
+    memset(wheel.occupied, 0, sizeof(wheel.occupied));
+    idmap_clear(&wheel.by_id);
+    wheel.count = 0;
+    wheel_rearm();
 }